@@ -0,0 +1,264 @@
+/**
+ * @file engmd_bench.c
+ * @brief engmd_table 等价性与性能对比 (主机运行，不参与固件构建)
+ *
+ * 用抓取的 AT+SPENGMD 响应和随机生成的响应，逐字段对比
+ * engmd_parse 与旧的 parse_cell_to_vec 输出，然后各跑 N 次计时。
+ *
+ * 构建运行: make bench && ./build/bench/engmd_bench [次数]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "engmd_table.h"
+
+/* ==================== 旧实现 (原 handlers.c) ==================== */
+
+static int parse_cell_to_vec(const char *input, char data[64][16][32]) {
+    char cleaned[4096];
+    strncpy(cleaned, input, sizeof(cleaned) - 1);
+    cleaned[sizeof(cleaned) - 1] = '\0';
+
+    /* 去除 OK 和换行符 */
+    char *ok_pos = strstr(cleaned, "OK");
+    if (ok_pos) *ok_pos = '\0';
+
+    /* 替换 \r\n 为空 */
+    char *p = cleaned;
+    char *dst = cleaned;
+    while (*p) {
+        if (*p != '\r' && *p != '\n') {
+            *dst++ = *p;
+        }
+        p++;
+    }
+    *dst = '\0';
+
+    int row = 0;
+    int col = 0;
+    char current_part[4096] = {0};
+    int part_len = 0;
+    char prev_char = 0;
+
+    p = cleaned;
+    while (*p && row < 64) {
+        char c = *p;
+
+        if (c == '-') {
+            if (prev_char == ',') {
+                /* 规则2: ,- 作为负数处理 */
+                current_part[part_len++] = c;
+            } else if (*(p + 1) == '-') {
+                /* 规则3: -- 分割换行并保留第二个 - */
+                if (part_len > 0) {
+                    current_part[part_len] = '\0';
+                    /* 按逗号分割 */
+                    col = 0;
+                    char *token = strtok(current_part, ",");
+                    while (token && col < 16) {
+                        while (*token == ' ') token++;
+                        strncpy(data[row][col], token, 31);
+                        data[row][col][31] = '\0';
+                        col++;
+                        token = strtok(NULL, ",");
+                    }
+                    row++;
+                    part_len = 0;
+                }
+                current_part[part_len++] = '-';
+                p++; /* 跳过下一个 - */
+            } else {
+                /* 规则1: 单独 - 换行 */
+                if (part_len > 0) {
+                    current_part[part_len] = '\0';
+                    col = 0;
+                    char *token = strtok(current_part, ",");
+                    while (token && col < 16) {
+                        while (*token == ' ') token++;
+                        strncpy(data[row][col], token, 31);
+                        data[row][col][31] = '\0';
+                        col++;
+                        token = strtok(NULL, ",");
+                    }
+                    row++;
+                    part_len = 0;
+                }
+            }
+        } else {
+            current_part[part_len++] = c;
+        }
+        prev_char = c;
+        p++;
+    }
+
+    /* 处理最后剩余部分 */
+    if (part_len > 0 && row < 64) {
+        current_part[part_len] = '\0';
+        col = 0;
+        char *token = strtok(current_part, ",");
+        while (token && col < 16) {
+            while (*token == ' ') token++;
+            strncpy(data[row][col], token, 31);
+            data[row][col][31] = '\0';
+            col++;
+            token = strtok(NULL, ",");
+        }
+        row++;
+    }
+
+    return row;
+}
+
+/* ==================== 抓取样本 ==================== */
+
+/* AT+SPENGMD=0,14,1 (5G 主小区，每行一个字段) */
+static const char SAMPLE_NR_SERVING[] =
+    "\r\n78-627264-501-1-0-30-100-273-0-0-1-0-0-4-1-"
+    "-8950--1125-1650-0-15-0-0-3-1-0-0-0-0-0-0-0-"
+    "460-01-1-0-12345678-0-0-0\r\n\r\nOK\r\n";
+
+/* AT+SPENGMD=0,14,2 (5G 邻小区，按列排列) */
+static const char SAMPLE_NR_NEIGHBOR[] =
+    "\r\n78,78,41,0-627264,633984,504990,627264-"
+    "501,223,88,17-"
+    "-9120,-10350,-11240,-12000-"
+    "-1150,-1420,-1680,-1990-"
+    "1210,530,-220,-460\r\n\r\nOK\r\n";
+
+/* AT+SPENGMD=0,6,0 (4G 主小区) */
+static const char SAMPLE_LTE_SERVING[] =
+    "\r\n3-1300-120-20-1-0-0-0-46000-0-0-0-1-2-2-0-0-0-0-0-0-0-0-0-0-0-0-0-0-0-0-0-0-"
+    "-9700--1080-1460-0-0-0-0-0-0-0\r\n\r\nOK\r\n";
+
+/* AT+SPENGMD=0,6,6 (4G 邻小区，每行一个小区) */
+static const char SAMPLE_LTE_NEIGHBOR[] =
+    "\r\n1300, 120,-9700,-1080,3,0-"
+    "1850, 301,-10520,-1260,3,0-"
+    "38950, 88,-11010,-1390,40,0-"
+    "100, 12,-12400,-1750,\r\n0,0-"
+    "40936, 455,-11860,-1540,41,0\r\n\r\nOK\r\n";
+
+static const struct {
+    const char *name;
+    const char *text;
+} g_samples[] = {
+    { "nr_serving",   SAMPLE_NR_SERVING },
+    { "nr_neighbor",  SAMPLE_NR_NEIGHBOR },
+    { "lte_serving",  SAMPLE_LTE_SERVING },
+    { "lte_neighbor", SAMPLE_LTE_NEIGHBOR },
+};
+
+#define SAMPLE_COUNT  (int)(sizeof(g_samples) / sizeof(g_samples[0]))
+
+/* ==================== 对比 ==================== */
+
+static char g_old[64][16][32];
+
+/* 逐字段对比，返回不一致的字段数 */
+static int compare(const char *name, const char *input) {
+    EngmdTable t;
+    char buf[32];
+    int diff = 0;
+
+    memset(g_old, 0, sizeof(g_old));
+    int old_rows = parse_cell_to_vec(input, g_old);
+    int new_rows = engmd_parse(&t, input);
+
+    if (old_rows != new_rows) {
+        printf("[%s] 行数不一致: old=%d new=%d\n", name, old_rows, new_rows);
+        return 1;
+    }
+
+    for (int r = 0; r < old_rows; r++) {
+        for (int c = 0; c < 16; c++) {
+            engmd_str(&t, r, c, buf, sizeof(buf));
+            if (strcmp(buf, g_old[r][c]) != 0) {
+                if (diff < 5) {
+                    printf("[%s] (%d,%d) old='%s' new='%s'\n", name, r, c, g_old[r][c], buf);
+                }
+                diff++;
+                continue;
+            }
+            if (engmd_int(&t, r, c) != atoi(g_old[r][c])) {
+                if (diff < 5) printf("[%s] (%d,%d) engmd_int 与 atoi 不一致\n", name, r, c);
+                diff++;
+            }
+        }
+    }
+    return diff;
+}
+
+/* 按 SPENGMD 的字符分布生成随机响应 */
+static void random_response(char *out, size_t size) {
+    static const char alphabet[] = "0123456789----,,,,  \r\n";
+    size_t len = (size_t)(rand() % (int)(size - 8));
+
+    for (size_t i = 0; i < len; i++) {
+        out[i] = alphabet[rand() % (int)(sizeof(alphabet) - 1)];
+    }
+    if (rand() % 2) {
+        memcpy(out + len, "\r\nOK\r\n", 7);
+    } else {
+        out[len] = '\0';
+    }
+}
+
+static double now_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000.0 + ts.tv_nsec / 1e6;
+}
+
+int main(int argc, char **argv) {
+    int iterations = argc > 1 ? atoi(argv[1]) : 100000;
+    int failed = 0;
+    char rnd[512];
+
+    if (iterations <= 0) iterations = 100000;
+
+    for (int i = 0; i < SAMPLE_COUNT; i++) {
+        int diff = compare(g_samples[i].name, g_samples[i].text);
+        printf("%-14s %s\n", g_samples[i].name, diff ? "不一致" : "一致");
+        failed += diff != 0;
+    }
+
+    srand(12345);
+    int rnd_failed = 0;
+    for (int i = 0; i < 20000; i++) {
+        random_response(rnd, sizeof(rnd));
+        if (compare("random", rnd) != 0) {
+            rnd_failed++;
+            if (rnd_failed == 1) printf("随机输入: \"%s\"\n", rnd);
+        }
+    }
+    printf("%-14s %d/20000 不一致\n", "random", rnd_failed);
+    failed += rnd_failed;
+
+    /* 计时: 每轮解析全部样本并读取全部字段 */
+    EngmdTable t;
+    volatile long sink = 0;
+    double t0 = now_ms();
+    for (int n = 0; n < iterations; n++) {
+        for (int i = 0; i < SAMPLE_COUNT; i++) {
+            int rows = parse_cell_to_vec(g_samples[i].text, g_old);
+            for (int r = 0; r < rows; r++) sink += atoi(g_old[r][0]);
+        }
+    }
+    double t1 = now_ms();
+    for (int n = 0; n < iterations; n++) {
+        for (int i = 0; i < SAMPLE_COUNT; i++) {
+            int rows = engmd_parse(&t, g_samples[i].text);
+            for (int r = 0; r < rows; r++) sink += engmd_int(&t, r, 0);
+        }
+    }
+    double t2 = now_ms();
+
+    printf("parse_cell_to_vec: %.3f us/次\n", (t1 - t0) * 1000.0 / iterations / SAMPLE_COUNT);
+    printf("engmd_parse:       %.3f us/次\n", (t2 - t1) * 1000.0 / iterations / SAMPLE_COUNT);
+    printf("栈占用: 旧 %zu 字节, 新 %zu 字节\n",
+           sizeof(g_old) + 2 * 4096, sizeof(EngmdTable));
+
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,274 @@
+/**
+ * @file proc_bench.c
+ * @brief proc_reader 等价性与性能对比 (主机运行，不参与固件构建)
+ *
+ * 用抓取的 /proc/meminfo 和电池 uevent，逐行对比 proc_scan_next 与
+ * 旧的 strtok+sscanf / fgets+strchr 解析结果，然后各跑 N 次计时。
+ * 样本先写入临时文件，经 proc_file_read 读回，覆盖 pread 路径。
+ *
+ * 构建运行: make bench && ./build/bench/proc_bench [次数]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "proc_reader.h"
+
+/* ==================== 抓取样本 ==================== */
+
+/* UDX710 /proc/meminfo */
+static const char SAMPLE_MEMINFO[] =
+    "MemTotal:         237880 kB\n"
+    "MemFree:           18876 kB\n"
+    "MemAvailable:      93140 kB\n"
+    "Buffers:            5212 kB\n"
+    "Cached:            81536 kB\n"
+    "SwapCached:            0 kB\n"
+    "Active:            95364 kB\n"
+    "Inactive:          56008 kB\n"
+    "Active(anon):      66096 kB\n"
+    "Inactive(anon):      736 kB\n"
+    "Active(file):      29268 kB\n"
+    "Inactive(file):    55272 kB\n"
+    "Unevictable:        1876 kB\n"
+    "Mlocked:               0 kB\n"
+    "SwapTotal:             0 kB\n"
+    "SwapFree:              0 kB\n"
+    "Dirty:                 4 kB\n"
+    "Writeback:             0 kB\n"
+    "AnonPages:         66508 kB\n"
+    "Mapped:            45784 kB\n"
+    "Shmem:              1664 kB\n"
+    "KReclaimable:       8196 kB\n"
+    "Slab:              21860 kB\n"
+    "SReclaimable:       8196 kB\n"
+    "SUnreclaim:        13664 kB\n"
+    "KernelStack:        3200 kB\n"
+    "PageTables:         2364 kB\n"
+    "NFS_Unstable:          0 kB\n"
+    "Bounce:                0 kB\n"
+    "WritebackTmp:          0 kB\n"
+    "CommitLimit:      118940 kB\n"
+    "Committed_AS:     623108 kB\n"
+    "VmallocTotal:   263061440 kB\n"
+    "VmallocUsed:       11452 kB\n"
+    "VmallocChunk:          0 kB\n"
+    "Percpu:              576 kB\n"
+    "CmaTotal:          16384 kB\n"
+    "CmaFree:             212 kB\n";
+
+/* /sys/class/power_supply/battery/uevent */
+static const char SAMPLE_UEVENT[] =
+    "POWER_SUPPLY_NAME=battery\n"
+    "POWER_SUPPLY_STATUS=Charging\n"
+    "POWER_SUPPLY_HEALTH=Good\n"
+    "POWER_SUPPLY_PRESENT=1\n"
+    "POWER_SUPPLY_TECHNOLOGY=Li-ion\n"
+    "POWER_SUPPLY_VOLTAGE_MAX_DESIGN=4400000\n"
+    "POWER_SUPPLY_VOLTAGE_NOW=4012000\n"
+    "POWER_SUPPLY_CURRENT_NOW=-452000\n"
+    "POWER_SUPPLY_CAPACITY=67\n"
+    "POWER_SUPPLY_TEMP=312\n"
+    "POWER_SUPPLY_CHARGE_FULL_DESIGN=3000000\n"
+    "POWER_SUPPLY_MODEL_NAME=UDX710 Battery\n";
+
+/* ==================== 旧实现 ==================== */
+
+/* 原 sysinfo.c parse_meminfo: strtok 按行 + sscanf */
+static void old_meminfo(const char *text, unsigned long out[3]) {
+    char buf[4096];
+    snprintf(buf, sizeof(buf), "%s", text);
+
+    char *line = strtok(buf, "\n");
+    while (line) {
+        unsigned long val;
+        if (sscanf(line, "MemTotal: %lu kB", &val) == 1) {
+            out[0] = val / 1024;
+        } else if (sscanf(line, "MemFree: %lu kB", &val) == 1) {
+            out[1] = val / 1024;
+        } else if (sscanf(line, "Cached: %lu kB", &val) == 1) {
+            out[2] = val / 1024;
+        }
+        line = strtok(NULL, "\n");
+    }
+}
+
+/* 现 sysinfo.c parse_meminfo */
+static void new_meminfo(const ProcFile *f, unsigned long out[3]) {
+    ProcScan scan = proc_scan_begin(f, ':');
+    ProcKV kv;
+    int found = 0;
+
+    while (found < 3 && proc_scan_next(&scan, &kv)) {
+        if (proc_kv_is(&kv, "MemTotal")) {
+            out[0] = (unsigned long)(proc_kv_ll(&kv) / 1024);
+            found++;
+        } else if (proc_kv_is(&kv, "MemFree")) {
+            out[1] = (unsigned long)(proc_kv_ll(&kv) / 1024);
+            found++;
+        } else if (proc_kv_is(&kv, "Cached")) {
+            out[2] = (unsigned long)(proc_kv_ll(&kv) / 1024);
+            found++;
+        }
+    }
+}
+
+/* ==================== 逐行对比 ==================== */
+
+/*
+ * 参考实现逐行切分: 旧 charge.c 的 strchr('=') 方式，
+ * 另外去掉两端空白以对应 proc_scan_next 的约定。
+ */
+static int compare_lines(const char *name, const char *text, const ProcFile *f, char sep) {
+    char buf[4096];
+    char key[128], val[128];
+    int diff = 0, lines = 0;
+
+    snprintf(buf, sizeof(buf), "%s", text);
+    ProcScan scan = proc_scan_begin(f, sep);
+    ProcKV kv;
+
+    for (char *line = strtok(buf, "\n"); line; line = strtok(NULL, "\n")) {
+        char *s = strchr(line, sep);
+        if (!s) continue;
+        *s = '\0';
+        char *k = line, *v = s + 1;
+        while (*k == ' ' || *k == '\t') k++;
+        while (*v == ' ' || *v == '\t') v++;
+        size_t kl = strlen(k), vl = strlen(v);
+        while (kl > 0 && (k[kl - 1] == ' ' || k[kl - 1] == '\t')) k[--kl] = '\0';
+        while (vl > 0 && (v[vl - 1] == ' ' || v[vl - 1] == '\t' || v[vl - 1] == '\r')) v[--vl] = '\0';
+
+        lines++;
+        if (!proc_scan_next(&scan, &kv)) {
+            printf("[%s] 第 %d 行: 扫描提前结束\n", name, lines);
+            return diff + 1;
+        }
+        snprintf(key, sizeof(key), "%.*s", (int)kv.key_len, kv.key);
+        proc_kv_copy(&kv, val, sizeof(val));
+        if (strcmp(key, k) != 0 || strcmp(val, v) != 0 || proc_kv_ll(&kv) != atoll(v)) {
+            printf("[%s] 第 %d 行: old='%s'='%s' new='%s'='%s'\n", name, lines, k, v, key, val);
+            diff++;
+        }
+    }
+    if (proc_scan_next(&scan, &kv)) {
+        printf("[%s] 扫描多出键 '%.*s'\n", name, (int)kv.key_len, kv.key);
+        diff++;
+    }
+    return diff;
+}
+
+/* 样本写入临时文件，用于经 proc_file_read 读回 */
+static int write_sample(char *path, const char *text) {
+    int fd = mkstemp(path);
+    if (fd < 0) return -1;
+    size_t len = strlen(text);
+    int ok = write(fd, text, len) == (ssize_t)len;
+    close(fd);
+    return ok ? 0 : -1;
+}
+
+static double now_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000.0 + ts.tv_nsec / 1e6;
+}
+
+int main(int argc, char **argv) {
+    int iterations = argc > 1 ? atoi(argv[1]) : 100000;
+    char mem_path[] = "/tmp/proc_bench_meminfo_XXXXXX";
+    char uevent_path[] = "/tmp/proc_bench_uevent_XXXXXX";
+    static char mem_buf[2048], uevent_buf[1024];
+    int failed = 0;
+
+    if (iterations <= 0) iterations = 100000;
+    if (write_sample(mem_path, SAMPLE_MEMINFO) != 0 ||
+        write_sample(uevent_path, SAMPLE_UEVENT) != 0) {
+        printf("无法写入临时文件\n");
+        return 1;
+    }
+
+    ProcFile mem = PROC_FILE_INIT(mem_path, mem_buf);
+    ProcFile uevent = PROC_FILE_INIT(uevent_path, uevent_buf);
+
+    if (proc_file_read(&mem) != (int)strlen(SAMPLE_MEMINFO) ||
+        proc_file_read(&uevent) != (int)strlen(SAMPLE_UEVENT)) {
+        printf("proc_file_read 长度不符\n");
+        failed++;
+    }
+
+    int diff = compare_lines("meminfo", SAMPLE_MEMINFO, &mem, ':');
+    printf("%-10s %s\n", "meminfo", diff ? "不一致" : "一致");
+    failed += diff != 0;
+
+    diff = compare_lines("uevent", SAMPLE_UEVENT, &uevent, '=');
+    printf("%-10s %s\n", "uevent", diff ? "不一致" : "一致");
+    failed += diff != 0;
+
+    unsigned long old_vals[3] = {0}, new_vals[3] = {0};
+    old_meminfo(SAMPLE_MEMINFO, old_vals);
+    new_meminfo(&mem, new_vals);
+    if (memcmp(old_vals, new_vals, sizeof(old_vals)) != 0) {
+        printf("parse_meminfo 不一致: old=%lu/%lu/%lu new=%lu/%lu/%lu\n",
+               old_vals[0], old_vals[1], old_vals[2], new_vals[0], new_vals[1], new_vals[2]);
+        failed++;
+    } else {
+        printf("%-10s 一致 (%lu/%lu/%lu MB)\n", "sysinfo", new_vals[0], new_vals[1], new_vals[2]);
+    }
+
+    /* 计时: 旧实现 fopen+fgets 读取 meminfo，新实现 pread 常驻 fd */
+    volatile unsigned long sink = 0;
+    char line[256];
+    double t0 = now_ms();
+    for (int n = 0; n < iterations; n++) {
+        FILE *fp = fopen(mem_path, "r");
+        if (!fp) break;
+        char buf[4096];
+        size_t len = fread(buf, 1, sizeof(buf) - 1, fp);
+        buf[len] = '\0';
+        fclose(fp);
+        old_meminfo(buf, old_vals);
+        sink += old_vals[0];
+    }
+    double t1 = now_ms();
+    for (int n = 0; n < iterations; n++) {
+        if (proc_file_read(&mem) <= 0) break;
+        new_meminfo(&mem, new_vals);
+        sink += new_vals[0];
+    }
+    double t2 = now_ms();
+    for (int n = 0; n < iterations; n++) {
+        FILE *fp = fopen(uevent_path, "r");
+        if (!fp) break;
+        while (fgets(line, sizeof(line), fp)) {
+            char *eq = strchr(line, '=');
+            if (eq && strncmp(line, "POWER_SUPPLY_CAPACITY", (size_t)(eq - line)) == 0) {
+                sink += (unsigned long)atoi(eq + 1);
+            }
+        }
+        fclose(fp);
+    }
+    double t3 = now_ms();
+    for (int n = 0; n < iterations; n++) {
+        if (proc_file_read(&uevent) <= 0) break;
+        ProcScan scan = proc_scan_begin(&uevent, '=');
+        ProcKV kv;
+        while (proc_scan_next(&scan, &kv)) {
+            if (proc_kv_is(&kv, "POWER_SUPPLY_CAPACITY")) sink += (unsigned long)proc_kv_ll(&kv);
+        }
+    }
+    double t4 = now_ms();
+
+    printf("meminfo  旧 fopen+sscanf: %.3f us/次, 新 pread+scan: %.3f us/次\n",
+           (t1 - t0) * 1000.0 / iterations, (t2 - t1) * 1000.0 / iterations);
+    printf("uevent   旧 fopen+fgets:  %.3f us/次, 新 pread+scan: %.3f us/次\n",
+           (t3 - t2) * 1000.0 / iterations, (t4 - t3) * 1000.0 / iterations);
+
+    proc_file_close(&mem);
+    proc_file_close(&uevent);
+    unlink(mem_path);
+    unlink(uevent_path);
+    return failed ? 1 : 0;
+}
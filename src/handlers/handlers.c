@@ -20,56 +20,20 @@
 #include "apn.h"
 #include "ofono.h"
 #include "json_builder.h"
-
-
-/* GET /api/info - 获取系统信息 */
-void handle_info(struct mg_connection *c, struct mg_http_message *hm) {
-    HTTP_CHECK_GET(c, hm);
-
-    SystemInfo info;
-    get_system_info(&info);
-
-    JsonBuilder *j = json_new();
-    json_obj_open(j);
-    json_add_str(j, "hostname", info.hostname);
-    json_add_str(j, "sysname", info.sysname);
-    json_add_str(j, "release", info.release);
-    json_add_str(j, "version", info.version);
-    json_add_str(j, "machine", info.machine);
-    json_add_ulong(j, "total_ram", info.total_ram);
-    json_add_ulong(j, "free_ram", info.free_ram);
-    json_add_ulong(j, "cached_ram", info.cached_ram);
-    json_add_double(j, "cpu_usage", info.cpu_usage);
-    json_add_double(j, "uptime", info.uptime);
-    json_add_str(j, "bridge_status", info.bridge_status);
-    json_add_str(j, "sim_slot", info.sim_slot);
-    json_add_str(j, "signal_strength", info.signal_strength);
-    json_add_double(j, "thermal_temp", info.thermal_temp);
-    json_add_str(j, "power_status", info.power_status);
-    json_add_str(j, "battery_health", info.battery_health);
-    json_add_int(j, "battery_capacity", info.battery_capacity);
-    json_add_str(j, "ssid", info.ssid);
-    json_add_str(j, "passwd", info.passwd);
-    json_add_str(j, "select_network_mode", info.select_network_mode);
-    json_add_int(j, "is_activated", info.is_activated);
-    json_add_str(j, "serial", info.serial);
-    json_add_str(j, "network_mode", info.network_mode);
-    json_add_bool(j, "airplane_mode", info.airplane_mode);
-    json_add_str(j, "imei", info.imei);
-    json_add_str(j, "iccid", info.iccid);
-    json_add_str(j, "imsi", info.imsi);
-    json_add_str(j, "carrier", info.carrier);
-    json_add_str(j, "network_type", info.network_type);
-    json_add_str(j, "network_band", info.network_band);
-    json_add_int(j, "qci", info.qci);
-    json_add_int(j, "downlink_rate", info.downlink_rate);
-    json_add_int(j, "uplink_rate", info.uplink_rate);
-    json_obj_close(j);
-
-    HTTP_OK_FREE(c, json_finish(j));
+#include "cell_sampler.h"
+#include "traffic.h"
+#include "client_traffic.h"
+#include "info_snapshot.h"
+#include "radio_job.h"
+
+
+/* 锁频/锁小区任务独占 AT 通道时返回 409，前端稍后重试即可 */
+static void reply_at_busy(struct mg_connection *c) {
+    mg_http_reply(c, 409, HTTP_CORS_HEADERS,
+                  "{\"Code\":1,\"Error\":\"射频重配置进行中，AT 通道被占用\",\"Data\":null,\"job_id\":%d}",
+                  radio_job_current_id());
 }
 
-
 /* POST /api/at - 执行 AT 命令 */
 void handle_execute_at(struct mg_connection *c, struct mg_http_message *hm) {
     HTTP_CHECK_POST(c, hm);
@@ -98,11 +62,22 @@ void handle_execute_at(struct mg_connection *c, struct mg_http_message *hm) {
 
     printf("执行 AT 命令: %s\n", cmd);
 
+    if (at_channel_reserved()) {
+        reply_at_busy(c);
+        return;
+    }
+
+    /* 执行 AT 命令 */
+    int rc = execute_at(cmd, &result);
+    if (rc != 0 && at_channel_reserved()) {
+        reply_at_busy(c);
+        return;
+    }
+
     JsonBuilder *j = json_new();
     json_obj_open(j);
 
-    /* 执行 AT 命令 */
-    if (execute_at(cmd, &result) == 0) {
+    if (rc == 0) {
         printf("AT 命令执行成功: %s\n", result);
         json_add_int(j, "Code", 0);
         json_add_str(j, "Error", "");
@@ -149,6 +124,7 @@ void handle_set_network(struct mg_connection *c, struct mg_http_message *hm) {
     }
 
     if (set_network_mode_for_slot(mode, strlen(slot) > 0 ? slot : NULL) == 0) {
+        info_snapshot_invalidate();
         HTTP_SUCCESS(c, "Network mode updated successfully");
     } else {
         HTTP_OK(c, "{\"status\":\"error\",\"message\":\"Failed to update network mode\"}");
@@ -176,6 +152,8 @@ void handle_switch(struct mg_connection *c, struct mg_http_message *hm) {
     JsonBuilder *j = json_new();
     json_obj_open(j);
     if (switch_slot(slot) == 0) {
+        info_snapshot_invalidate();
+        traffic_quota_invalidate();      /* 切卡会让新卡槽上线 */
         json_add_str(j, "status", "success");
         char msg[64];
         snprintf(msg, sizeof(msg), "Slot switched to %s successfully", slot);
@@ -206,6 +184,8 @@ void handle_airplane_mode(struct mg_connection *c, struct mg_http_message *hm) {
     }
 
     if (set_airplane_mode(enabled) == 0) {
+        info_snapshot_invalidate();
+        traffic_quota_invalidate();
         HTTP_SUCCESS(c, "Airplane mode updated successfully");
     } else {
         HTTP_ERROR(c, 500, "Failed to set airplane mode: AT command failed");
@@ -227,9 +207,13 @@ void handle_device_control(struct mg_connection *c, struct mg_http_message *hm)
 
     if (strcmp(action, "reboot") == 0) {
         HTTP_SUCCESS(c, "Reboot command sent");
+        traffic_flush();
+        client_traffic_flush();
         device_reboot();
     } else if (strcmp(action, "poweroff") == 0) {
         HTTP_SUCCESS(c, "Poweroff command sent");
+        traffic_flush();
+        client_traffic_flush();
         device_poweroff();
     } else {
         HTTP_ERROR(c, 400, "Invalid action. Must be 'reboot' or 'poweroff'");
@@ -248,127 +232,7 @@ void handle_clear_cache(struct mg_connection *c, struct mg_http_message *hm) {
 }
 
 
-/* 解析 AT 命令返回的小区数据 (Go: parseCellToVec) */
-/* 返回解析后的行数，data 是二维数组 [行][列] */
-int parse_cell_to_vec(const char *input, char data[64][16][32]) {
-    char cleaned[4096];
-    strncpy(cleaned, input, sizeof(cleaned) - 1);
-    cleaned[sizeof(cleaned) - 1] = '\0';
-
-    /* 去除 OK 和换行符 */
-    char *ok_pos = strstr(cleaned, "OK");
-    if (ok_pos) *ok_pos = '\0';
-    
-    /* 替换 \r\n 为空 */
-    char *p = cleaned;
-    char *dst = cleaned;
-    while (*p) {
-        if (*p != '\r' && *p != '\n') {
-            *dst++ = *p;
-        }
-        p++;
-    }
-    *dst = '\0';
-
-    int row = 0;
-    int col = 0;
-    char current_part[4096] = {0};
-    int part_len = 0;
-    char prev_char = 0;
-
-    p = cleaned;
-    while (*p && row < 64) {
-        char c = *p;
-        
-        if (c == '-') {
-            if (prev_char == ',') {
-                /* 规则2: ,- 作为负数处理 */
-                current_part[part_len++] = c;
-            } else if (*(p + 1) == '-') {
-                /* 规则3: -- 分割换行并保留第二个 - */
-                if (part_len > 0) {
-                    current_part[part_len] = '\0';
-                    /* 按逗号分割 */
-                    col = 0;
-                    char *token = strtok(current_part, ",");
-                    while (token && col < 16) {
-                        while (*token == ' ') token++;
-                        strncpy(data[row][col], token, 31);
-                        data[row][col][31] = '\0';
-                        col++;
-                        token = strtok(NULL, ",");
-                    }
-                    row++;
-                    part_len = 0;
-                }
-                current_part[part_len++] = '-';
-                p++; /* 跳过下一个 - */
-            } else {
-                /* 规则1: 单独 - 换行 */
-                if (part_len > 0) {
-                    current_part[part_len] = '\0';
-                    col = 0;
-                    char *token = strtok(current_part, ",");
-                    while (token && col < 16) {
-                        while (*token == ' ') token++;
-                        strncpy(data[row][col], token, 31);
-                        data[row][col][31] = '\0';
-                        col++;
-                        token = strtok(NULL, ",");
-                    }
-                    row++;
-                    part_len = 0;
-                }
-            }
-        } else {
-            current_part[part_len++] = c;
-        }
-        prev_char = c;
-        p++;
-    }
-
-    /* 处理最后剩余部分 */
-    if (part_len > 0 && row < 64) {
-        current_part[part_len] = '\0';
-        col = 0;
-        char *token = strtok(current_part, ",");
-        while (token && col < 16) {
-            while (*token == ' ') token++;
-            strncpy(data[row][col], token, 31);
-            data[row][col][31] = '\0';
-            col++;
-            token = strtok(NULL, ",");
-        }
-        row++;
-    }
-
-    return row;
-}
-
-/**
- * 判断当前网络是否为 5G
- * 通过 D-Bus 查询 oFono NetworkMonitor 获取网络类型
- * @return 1=5G, 0=4G/其他
- */
-static int is_5g_network(void) {
-    char tech[32] = {0};
-    int band = 0;
-    
-    /* 使用C语言D-Bus API获取网络信息 */
-    if (ofono_get_serving_cell_info(tech, sizeof(tech), &band) != 0) {
-        printf("D-Bus 查询网络类型失败，默认使用 4G\n");
-        return 0;
-    }
-
-    /* 判断网络类型 - 检查是否为 "nr" */
-    if (strcmp(tech, "nr") == 0) {
-        return 1; /* 5G */
-    }
-    
-    return 0; /* 4G 或其他 */
-}
-
-/* GET /api/current_band - 获取当前连接频段 */
+/* GET /api/current_band - 获取当前连接频段 (读取采样器快照) */
 void handle_get_current_band(struct mg_connection *c, struct mg_http_message *hm) {
     HTTP_CHECK_GET(c, hm);
 
@@ -376,80 +240,27 @@ void handle_get_current_band(struct mg_connection *c, struct mg_http_message *hm
     char band[32] = "N/A";
     int arfcn = 0, pci = 0;
     double rsrp = 0, rsrq = 0, sinr = 0;
-    char response[512];
 
-    /* 通过 D-Bus 判断网络类型 (与 Go 版本一致) */
-    int is_5g = is_5g_network();
-    char *result = NULL;
-
-    if (is_5g) {
-        /* 5G 网络: AT+SPENGMD=0,14,1 */
-        if (execute_at("AT+SPENGMD=0,14,1", &result) == 0 && result && strlen(result) > 100) {
-            char data[64][16][32] = {{{0}}};
-            int rows = parse_cell_to_vec(result, data);
-            
-            if (rows > 15) {
-                strcpy(net_type, "5G NR");
-                if (strlen(data[0][0]) > 0) {
-                    snprintf(band, sizeof(band), "N%s", data[0][0]);
-                }
-                if (strlen(data[1][0]) > 0) {
-                    arfcn = atoi(data[1][0]);
-                }
-                if (strlen(data[2][0]) > 0) {
-                    pci = atoi(data[2][0]);
-                }
-                if (strlen(data[3][0]) > 0) {
-                    rsrp = atof(data[3][0]) / 100.0;
-                }
-                if (strlen(data[4][0]) > 0) {
-                    rsrq = atof(data[4][0]) / 100.0;
-                }
-                if (strlen(data[15][0]) > 0) {
-                    sinr = atof(data[15][0]) / 100.0;
-                }
-                printf("当前连接5G频段: Band=%s, ARFCN=%d, PCI=%d, RSRP=%.2f, RSRQ=%.2f, SINR=%.2f\n",
-                       band, arfcn, pci, rsrp, rsrq, sinr);
-            }
+    const CellSnapshot *snap = cell_sampler_acquire();
+    if (snap && snap->has_serving) {
+        const CellMeasure *m = &snap->serving;
+        snprintf(net_type, sizeof(net_type), "%s", snap->is_5g ? "5G NR" : "4G LTE");
+        if (m->band[0]) {
+            snprintf(band, sizeof(band), "%s%s", snap->is_5g ? "N" : "B", m->band);
         }
-        if (result) { g_free(result); result = NULL; }
-    } else {
-        /* 4G 网络: AT+SPENGMD=0,6,0 */
-        if (execute_at("AT+SPENGMD=0,6,0", &result) == 0 && result && strlen(result) > 100) {
-            char data[64][16][32] = {{{0}}};
-            int rows = parse_cell_to_vec(result, data);
-            
-            if (rows > 33) {
-                strcpy(net_type, "4G LTE");
-                if (strlen(data[0][0]) > 0) {
-                    snprintf(band, sizeof(band), "B%s", data[0][0]);
-                }
-                if (strlen(data[1][0]) > 0) {
-                    arfcn = atoi(data[1][0]);
-                }
-                if (strlen(data[2][0]) > 0) {
-                    pci = atoi(data[2][0]);
-                }
-                if (strlen(data[3][0]) > 0) {
-                    rsrp = atof(data[3][0]) / 100.0;
-                }
-                if (strlen(data[4][0]) > 0) {
-                    rsrq = atof(data[4][0]) / 100.0;
-                }
-                if (strlen(data[33][0]) > 0) {
-                    sinr = atof(data[33][0]) / 100.0;
-                }
-                printf("当前连接4G频段: Band=%s, ARFCN=%d, PCI=%d, RSRP=%.2f, RSRQ=%.2f, SINR=%.2f\n",
-                       band, arfcn, pci, rsrp, rsrq, sinr);
-            }
-        }
-        if (result) { g_free(result); result = NULL; }
+        arfcn = m->arfcn;
+        pci = m->pci;
+        rsrp = m->rsrp;
+        rsrq = m->rsrq;
+        sinr = m->sinr;
     }
 
     JsonBuilder *j = json_new();
     json_obj_open(j);
     json_add_int(j, "Code", 0);
     json_add_str(j, "Error", "");
+    json_add_long(j, "generation", snap ? (long long)snap->generation : 0);
+    json_add_long(j, "timestamp", snap ? snap->timestamp : 0);
     json_key_obj_open(j, "Data");
     json_add_str(j, "network_type", net_type);
     json_add_str(j, "band", band);
@@ -460,6 +271,7 @@ void handle_get_current_band(struct mg_connection *c, struct mg_http_message *hm
     json_add_double(j, "sinr", sinr);
     json_obj_close(j);
     json_obj_close(j);
+    cell_snapshot_release(snap);
 
     HTTP_OK_FREE(c, json_finish(j));
 }
@@ -467,71 +279,157 @@ void handle_get_current_band(struct mg_connection *c, struct mg_http_message *hm
 
 /* ==================== 短信 API ==================== */
 #include "sms.h"
+#include "sms_outbox.h"
+
+typedef struct {
+    JsonBuilder *j;
+    int last_id;
+} SmsListCtx;
+
+static void sms_json_row(const SmsMessage *msg, void *user_data) {
+    SmsListCtx *ctx = (SmsListCtx *)user_data;
+    char time_str[32];
+    struct tm *tm_info = localtime(&msg->timestamp);
+    strftime(time_str, sizeof(time_str), "%Y-%m-%dT%H:%M:%S", tm_info);
+
+    json_arr_obj_open(ctx->j);
+    json_add_int(ctx->j, "id", msg->id);
+    json_add_str(ctx->j, "sender", msg->sender);
+    json_add_str(ctx->j, "content", msg->content);
+    json_add_str(ctx->j, "timestamp", time_str);
+    json_add_bool(ctx->j, "read", msg->is_read);
+    json_add_int(ctx->j, "parts", msg->parts);
+    json_obj_close(ctx->j);
+    ctx->last_id = msg->id;
+}
 
-/* GET /api/sms - 获取短信列表 */
+/*
+ * GET /api/sms - 获取短信列表
+ * 无参数时返回最新 100 条 (数组, 兼容旧客户端)；
+ * ?before_id=&since_id=&limit=&q=&sender= 时返回
+ * {messages, has_more, cursor}，cursor 为本页最后一条的 id
+ */
 void handle_sms_list(struct mg_connection *c, struct mg_http_message *hm) {
     HTTP_CHECK_GET(c, hm);
 
-    SmsMessage messages[100];
-    int count = sms_get_list(messages, 100);
-    
+    SmsQuery query = {0};
+    SmsListCtx ctx = { json_new(), 0 };
+    char num[16], q[256], sender[64];
+    int paged = hm->query.len > 0;
+    int has_more = 0;
+
+    if (mg_http_get_var(&hm->query, "before_id", num, sizeof(num)) > 0) query.before_id = atoi(num);
+    if (mg_http_get_var(&hm->query, "since_id", num, sizeof(num)) > 0) query.since_id = atoi(num);
+    if (mg_http_get_var(&hm->query, "limit", num, sizeof(num)) > 0) query.limit = atoi(num);
+    int q_len = mg_http_get_var(&hm->query, "q", q, sizeof(q));
+    if (q_len == -3 || q_len > SMS_QUERY_MAX_Q) {
+        json_free(ctx.j);
+        HTTP_ERROR(c, 400, "搜索关键字过长");
+        return;
+    }
+    if (q_len > 0) query.q = q;
+    if (mg_http_get_var(&hm->query, "sender", sender, sizeof(sender)) > 0) query.sender = sender;
+    if (!paged) query.limit = SMS_QUERY_MAX_LIMIT;
+
+    if (paged) {
+        json_obj_open(ctx.j);
+        json_arr_open(ctx.j, "messages");
+    } else {
+        json_arr_open(ctx.j, NULL);
+    }
+
+    int count = sms_query(&query, sms_json_row, &ctx, &has_more);
     if (count < 0) {
+        json_free(ctx.j);
         HTTP_ERROR(c, 500, "获取短信列表失败");
         return;
     }
 
-    /* 使用JSON Builder构建数组 */
-    JsonBuilder *j = json_new();
-    json_arr_open(j, NULL);
-    
-    for (int i = 0; i < count; i++) {
-        char time_str[32];
-        struct tm *tm_info = localtime(&messages[i].timestamp);
-        strftime(time_str, sizeof(time_str), "%Y-%m-%dT%H:%M:%S", tm_info);
-        
-        json_arr_obj_open(j);
-        json_add_int(j, "id", messages[i].id);
-        json_add_str(j, "sender", messages[i].sender);
-        json_add_str(j, "content", messages[i].content);
-        json_add_str(j, "timestamp", time_str);
-        json_add_bool(j, "read", messages[i].is_read);
-        json_obj_close(j);
+    json_arr_close(ctx.j);
+    if (paged) {
+        json_add_bool(ctx.j, "has_more", has_more);
+        if (count > 0) json_add_int(ctx.j, "cursor", ctx.last_id);
+        else json_add_null(ctx.j, "cursor");
+        json_obj_close(ctx.j);
     }
-    
-    json_arr_close(j);
-    HTTP_OK_FREE(c, json_finish(j));
+    HTTP_OK_FREE(c, json_finish(ctx.j));
 }
 
-/* POST /api/sms/send - 发送短信 */
+/* POST /api/sms/send - 提交短信到发送队列
+ * {"recipient": "...", "content": "..."} 或 {"recipients": ["...", ...], "content": "..."}
+ * 立即返回 sent_sms 记录 id，投递结果通过 /api/sms/sent 的 status 查看 */
 void handle_sms_send(struct mg_connection *c, struct mg_http_message *hm) {
     HTTP_CHECK_POST(c, hm);
 
-    char recipient[64] = {0};
-    char content[1024] = {0};
-    
-    /* 使用mongoose内置JSON解析 */
-    char *r = mg_json_get_str(hm->body, "$.recipient");
-    char *ct = mg_json_get_str(hm->body, "$.content");
-    if (r) { strncpy(recipient, r, sizeof(recipient) - 1); free(r); }
-    if (ct) { strncpy(content, ct, sizeof(content) - 1); free(ct); }
-
-    if (strlen(recipient) == 0 || strlen(content) == 0) {
+    char *content = mg_json_get_str(hm->body, "$.content");
+    if (!content || strlen(content) == 0) {
+        free(content);
         HTTP_ERROR(c, 400, "收件人和内容不能为空");
         return;
     }
+    if (strlen(content) > SMS_OUTBOX_MAX_CONTENT) {
+        free(content);
+        HTTP_ERROR(c, 400, "短信内容过长");
+        return;
+    }
 
-    char result_path[256] = {0};
-    if (sms_send(recipient, content, result_path, sizeof(result_path)) == 0) {
-        JsonBuilder *j = json_new();
-        json_obj_open(j);
-        json_add_str(j, "status", "success");
-        json_add_str(j, "message", "短信发送成功");
-        json_add_str(j, "path", result_path);
-        json_obj_close(j);
-        HTTP_OK_FREE(c, json_finish(j));
-    } else {
-        HTTP_ERROR(c, 500, "短信发送失败");
+    /* recipient 与 recipients[] 合并后一次入队 */
+    char *recipients[SMS_OUTBOX_MAX_RECIPIENTS];
+    int count = 0;
+    char *r = mg_json_get_str(hm->body, "$.recipient");
+    if (r && r[0]) recipients[count++] = r;
+    else free(r);
+    for (int i = 0; i < SMS_OUTBOX_MAX_RECIPIENTS && count < SMS_OUTBOX_MAX_RECIPIENTS; i++) {
+        char path[32];
+        snprintf(path, sizeof(path), "$.recipients[%d]", i);
+        r = mg_json_get_str(hm->body, path);
+        if (!r) break;
+        if (r[0]) recipients[count++] = r;
+        else free(r);
+    }
+
+    int id_list[SMS_OUTBOX_MAX_RECIPIENTS];
+    int accepted = 0, rejected = 0, first_id = -1;
+    JsonBuilder *ids = json_new();
+    json_arr_open(ids, NULL);
+    if (count > 0) {
+        accepted = sms_outbox_enqueue_many((const char *const *)recipients, count, content, id_list);
+        for (int i = 0; i < count; i++) {
+            if (id_list[i] > 0) {
+                json_arr_add_int(ids, id_list[i]);
+                if (first_id <= 0) first_id = id_list[i];
+            } else {
+                rejected++;
+            }
+        }
     }
+    for (int i = 0; i < count; i++) free(recipients[i]);
+    free(content);
+    json_arr_close(ids);
+
+    if (accepted < 0) {
+        json_free(ids);
+        HTTP_ERROR(c, 500, "写入发送记录失败");
+        return;
+    }
+    if (accepted == 0) {
+        json_free(ids);
+        if (rejected > 0) HTTP_ERROR(c, 503, "发送队列已满或号码无效");
+        else HTTP_ERROR(c, 400, "收件人和内容不能为空");
+        return;
+    }
+
+    char *ids_json = json_finish(ids);
+    JsonBuilder *j = json_new();
+    json_obj_open(j);
+    json_add_str(j, "status", "success");
+    json_add_str(j, "message", "短信已加入发送队列");
+    json_add_int(j, "id", first_id);
+    json_add_raw(j, "ids", ids_json);
+    json_add_int(j, "rejected", rejected);
+    json_obj_close(j);
+    free(ids_json);
+    HTTP_OK_FREE(c, json_finish(j));
 }
 
 /* DELETE /api/sms/:id - 删除短信 */
@@ -625,31 +523,31 @@ void handle_sms_webhook_test(struct mg_connection *c, struct mg_http_message *hm
     }
 }
 
+static void sms_sent_json_row(const SentSmsMessage *msg, void *user_data) {
+    JsonBuilder *j = (JsonBuilder *)user_data;
+
+    json_arr_obj_open(j);
+    json_add_int(j, "id", msg->id);
+    json_add_str(j, "recipient", msg->recipient);
+    json_add_str(j, "content", msg->content);
+    json_add_long(j, "timestamp", (long long)msg->timestamp);
+    json_add_str(j, "status", msg->status);
+    json_obj_close(j);
+}
+
 /* GET /api/sms/sent - 获取发送记录列表 */
 void handle_sms_sent_list(struct mg_connection *c, struct mg_http_message *hm) {
     HTTP_CHECK_GET(c, hm);
 
-    SentSmsMessage messages[150];
-    int count = sms_get_sent_list(messages, 150);
-    
-    if (count < 0) {
+    JsonBuilder *j = json_new();
+    json_arr_open(j, NULL);
+
+    if (sms_get_sent_list(SMS_SENT_LIST_LIMIT, sms_sent_json_row, j) < 0) {
+        json_free(j);
         HTTP_ERROR(c, 500, "获取发送记录失败");
         return;
     }
 
-    JsonBuilder *j = json_new();
-    json_arr_open(j, NULL);
-    
-    for (int i = 0; i < count; i++) {
-        json_arr_obj_open(j);
-        json_add_int(j, "id", messages[i].id);
-        json_add_str(j, "recipient", messages[i].recipient);
-        json_add_str(j, "content", messages[i].content);
-        json_add_long(j, "timestamp", (long long)messages[i].timestamp);
-        json_add_str(j, "status", messages[i].status);
-        json_obj_close(j);
-    }
-    
     json_arr_close(j);
     HTTP_OK_FREE(c, json_finish(j));
 }
@@ -665,6 +563,7 @@ void handle_sms_config_get(struct mg_connection *c, struct mg_http_message *hm)
     json_obj_open(j);
     json_add_int(j, "max_count", max_count);
     json_add_int(j, "max_sent_count", max_sent_count);
+    json_add_int(j, "max_kb", sms_get_max_kb());
     json_obj_close(j);
     HTTP_OK_FREE(c, json_finish(j));
 }
@@ -683,6 +582,10 @@ void handle_sms_config_save(struct mg_connection *c, struct mg_http_message *hm)
     if (mg_json_get_num(hm->body, "$.max_sent_count", &val)) {
         max_sent_count = (int)val;
     }
+    int max_kb = sms_get_max_kb();
+    if (mg_json_get_num(hm->body, "$.max_kb", &val)) {
+        max_kb = (int)val;
+    }
     
     if (max_count < 10 || max_count > 150) {
         HTTP_ERROR(c, 400, "收件箱最大存储数量必须在10-150之间");
@@ -693,14 +596,21 @@ void handle_sms_config_save(struct mg_connection *c, struct mg_http_message *hm)
         return;
     }
 
+    if (max_kb < 0 || max_kb > SMS_MAX_KB_LIMIT) {
+        HTTP_ERROR(c, 400, "短信容量上限必须在0-4096KB之间");
+        return;
+    }
+
     sms_set_max_count(max_count);
     sms_set_max_sent_count(max_sent_count);
+    sms_set_max_kb(max_kb);
     
     JsonBuilder *j = json_new();
     json_obj_open(j);
     json_add_str(j, "status", "success");
     json_add_int(j, "max_count", max_count);
     json_add_int(j, "max_sent_count", max_sent_count);
+    json_add_int(j, "max_kb", max_kb);
     json_obj_close(j);
     HTTP_OK_FREE(c, json_finish(j));
 }
@@ -15,13 +15,28 @@
 #include "handlers.h"
 #include "advanced.h"
 #include "traffic.h"
+#include "traffic_history.h"
+#include "client_traffic.h"
+#include "push_channel.h"
+#include "throughput.h"
+#include "signal_history.h"
+#include "info_snapshot.h"
+#include "thermal.h"
+#include "cpu_monitor.h"
+#include "webhook.h"
 #include "reboot.h"
 #include "charge.h"
 #include "sms.h"
+#include "sms_thread.h"
+#include "sms_outbox.h"
+#include "sms_rule.h"
 #include "usb_mode.h"
 #include "http_utils.h"
 #include "auth.h"
 #include "apn.h"
+#include "sim_identity.h"
+#include "radio_job.h"
+#include "cell_sampler.h"
 
 /* 嵌入式文件系统声明 (packed_fs.c) */
 extern int serve_packed_file(struct mg_connection *c, struct mg_http_message *hm);
@@ -107,6 +122,11 @@ static void http_handler(struct mg_connection *c, int ev, void *ev_data) {
             handle_auth_password(c, hm);
             return;
         }
+        /* 推送通道 - 浏览器无法为 WebSocket 设置请求头，Token 由 push_handle_upgrade 校验 */
+        else if (mg_match(hm->uri, mg_str("/api/ws"), NULL)) {
+            push_handle_upgrade(c, hm);
+            return;
+        }
 
         /* 认证中间件 - 检查Token */
         if (!is_auth_whitelist(uri)) {
@@ -160,6 +180,15 @@ static void http_handler(struct mg_connection *c, int ev, void *ev_data) {
         else if (mg_match(hm->uri, mg_str("/api/unlock_cell"), NULL)) {
             handle_unlock_cell(c, hm);
         }
+        else if (mg_match(hm->uri, mg_str("/api/radio_job"), NULL)) {
+            handle_radio_job(c, hm);
+        }
+        else if (mg_match(hm->uri, mg_str("/api/cell_sampler"), NULL)) {
+            handle_cell_sampler_config(c, hm);
+        }
+        else if (mg_match(hm->uri, mg_str("/api/signal/history"), NULL)) {
+            handle_signal_history(c, hm);
+        }
         /* 流量统计 API */
         else if (mg_match(hm->uri, mg_str("/api/get/Total"), NULL)) {
             handle_get_traffic_total(c, hm);
@@ -170,6 +199,18 @@ static void http_handler(struct mg_connection *c, int ev, void *ev_data) {
         else if (mg_match(hm->uri, mg_str("/api/set/total"), NULL)) {
             handle_set_traffic_limit(c, hm);
         }
+        else if (mg_match(hm->uri, mg_str("/api/traffic/history"), NULL)) {
+            handle_traffic_history(c, hm);
+        }
+        else if (mg_match(hm->uri, mg_str("/api/traffic/clients"), NULL)) {
+            handle_traffic_clients(c, hm);
+        }
+        else if (mg_match(hm->uri, mg_str("/api/traffic/client_quota"), NULL)) {
+            handle_traffic_client_quota(c, hm);
+        }
+        else if (mg_match(hm->uri, mg_str("/api/traffic/throughput"), NULL)) {
+            handle_traffic_throughput(c, hm);
+        }
         /* 系统时间 API */
         else if (mg_match(hm->uri, mg_str("/api/get/time"), NULL)) {
             handle_get_system_time(c, hm);
@@ -188,6 +229,12 @@ static void http_handler(struct mg_connection *c, int ev, void *ev_data) {
             handle_clear_cron(c, hm);
         }
         /* 充电控制 API */
+        else if (mg_match(hm->uri, mg_str("/api/system/cpu"), NULL)) {
+            handle_system_cpu(c, hm);
+        }
+        else if (mg_match(hm->uri, mg_str("/api/thermal"), NULL)) {
+            handle_thermal(c, hm);
+        }
         else if (mg_match(hm->uri, mg_str("/api/charge/config"), NULL)) {
             handle_charge_config(c, hm);
         }
@@ -204,6 +251,22 @@ static void http_handler(struct mg_connection *c, int ev, void *ev_data) {
         else if (mg_match(hm->uri, mg_str("/api/sms/send"), NULL)) {
             handle_sms_send(c, hm);
         }
+        else if (mg_match(hm->uri, mg_str("/api/sms/rules"), NULL)) {
+            if (hm->method.len == 4 && memcmp(hm->method.buf, "POST", 4) == 0) {
+                handle_sms_rules_save(c, hm);
+            } else {
+                handle_sms_rules_list(c, hm);
+            }
+        }
+        else if (mg_match(hm->uri, mg_str("/api/sms/rules/test"), NULL)) {
+            handle_sms_rules_test(c, hm);
+        }
+        else if (mg_match(hm->uri, mg_str("/api/sms/rules/*"), NULL)) {
+            handle_sms_rules_delete(c, hm);
+        }
+        else if (mg_match(hm->uri, mg_str("/api/sms/outbox"), NULL)) {
+            handle_sms_outbox(c, hm);
+        }
         else if (mg_match(hm->uri, mg_str("/api/sms/sent"), NULL)) {
             handle_sms_sent_list(c, hm);
         }
@@ -224,6 +287,9 @@ static void http_handler(struct mg_connection *c, int ev, void *ev_data) {
                 handle_sms_webhook_save(c, hm);
             }
         }
+        else if (mg_match(hm->uri, mg_str("/api/sms/webhook/status"), NULL)) {
+            handle_webhook_status(c, hm);
+        }
         else if (mg_match(hm->uri, mg_str("/api/sms/webhook/test"), NULL)) {
             handle_sms_webhook_test(c, hm);
         }
@@ -234,6 +300,12 @@ static void http_handler(struct mg_connection *c, int ev, void *ev_data) {
                 handle_sms_fix_set(c, hm);
             }
         }
+        else if (mg_match(hm->uri, mg_str("/api/sms/threads"), NULL)) {
+            handle_sms_threads(c, hm);
+        }
+        else if (mg_match(hm->uri, mg_str("/api/sms/threads/read"), NULL)) {
+            handle_sms_thread_read(c, hm);
+        }
         else if (mg_match(hm->uri, mg_str("/api/sms/*"), NULL)) {
             handle_sms_delete(c, hm);
         }
@@ -359,6 +431,12 @@ static void http_handler(struct mg_connection *c, int ev, void *ev_data) {
             HTTP_ERROR(c, 404, "Endpoint not found");
         }
     }
+    else if (ev == MG_EV_WS_MSG) {
+        push_handle_message(c, (struct mg_ws_message *)ev_data);
+    }
+    else if (ev == MG_EV_CLOSE) {
+        push_handle_close(c);
+    }
 }
 
 
@@ -370,11 +448,25 @@ int http_server_start(const char *port) {
         printf("警告: D-Bus 初始化失败 (高级网络功能将不可用)\n");
     }
 
+    /* 预热 SIM 身份缓存 (IMEI/ICCID/IMSI) */
+    sim_identity_init();
+    cpu_monitor_init();
+    info_snapshot_init();
+
     /* 初始化流量统计 */
     init_traffic();
+    client_traffic_init();
+    throughput_init();
+
+    /* 信号历史 (订阅小区采样器) */
+    signal_history_init();
 
-    /* 初始化充电控制 */
+    /* 初始化充电控制和过热保护 */
     init_charge();
+    thermal_init();
+
+    /* 载入未投递的 Webhook 任务 (短信模块入队依赖它) */
+    webhook_init();
 
     /* 初始化短信模块（必须在auth_init之前，因为auth依赖数据库） */
     if (sms_init("6677.db") != 0) {
@@ -393,6 +485,8 @@ int http_server_start(const char *port) {
 
     /* 初始化 mongoose */
     mg_mgr_init(&g_mgr);
+    push_init(&g_mgr);
+    webhook_start(&g_mgr);
 
     /* 构建监听地址 */
     snprintf(listen_addr, sizeof(listen_addr), "http://0.0.0.0:%s", port);
@@ -417,6 +511,9 @@ int http_server_start(const char *port) {
 void http_server_stop(void) {
     g_running = 0;
     mg_mgr_free(&g_mgr);
+    traffic_flush();
+    signal_history_flush();
+    client_traffic_flush();
     sms_deinit();
     close_dbus();
     printf("服务器已停止\n");
@@ -424,7 +521,6 @@ void http_server_stop(void) {
 
 void http_server_run(void) {
     GMainContext *context = g_main_context_default();
-    static int maintenance_counter = 0;
     
     while (g_running) {
         /* 处理GLib/D-Bus事件 - 优先处理，确保信号不丢失 */
@@ -434,11 +530,5 @@ void http_server_run(void) {
         
         /* 处理mongoose事件 - 减少超时时间以更快响应D-Bus信号 */
         mg_mgr_poll(&g_mgr, 10);  /* 10ms超时 */
-        
-        /* 每30秒执行一次短信模块维护（检查D-Bus连接） */
-        if (++maintenance_counter >= 3000) {  /* 3000 * 10ms = 30秒 */
-            maintenance_counter = 0;
-            sms_maintenance();
-        }
     }
 }
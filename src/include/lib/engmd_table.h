@@ -0,0 +1,90 @@
+/**
+ * @file engmd_table.h
+ * @brief AT+SPENGMD 工程模式响应的零拷贝解析器
+ *
+ * 单遍扫描原始响应，只记录每个字段的 (偏移, 长度)，不复制字符串。
+ * 行/列切分规则与旧的 parse_cell_to_vec 一致：
+ *   - 单独的 '-' 分隔行
+ *   - ",-" 中的 '-' 是负号
+ *   - "--" 分隔行，第二个 '-' 作为下一行首字段的负号
+ *   - 行内按 ',' 分列，忽略空字段，去除字段前导空格
+ *
+ * 使用示例:
+ *   EngmdTable t;
+ *   engmd_parse(&t, result);          // result 在使用 t 期间必须有效
+ *   int pci = engmd_int(&t, 2, 0);
+ *   double rsrp = engmd_fixed(&t, 3, 0, 100);
+ */
+
+#ifndef ENGMD_TABLE_H
+#define ENGMD_TABLE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define ENGMD_MAX_ROWS    64
+#define ENGMD_MAX_COLS    16
+#define ENGMD_MAX_FIELDS  (ENGMD_MAX_ROWS * ENGMD_MAX_COLS)
+
+/* 字段在原始响应中的位置 */
+typedef struct {
+    uint16_t off;
+    uint16_t len;
+} EngmdSpan;
+
+/* 解析结果 (约 4KB，旧实现每次调用需 40KB 栈) */
+typedef struct {
+    const char *src;                            /* 原始响应 (不持有) */
+    int rows;
+    uint16_t row_start[ENGMD_MAX_ROWS + 1];     /* 每行首字段在 spans 中的下标 */
+    EngmdSpan spans[ENGMD_MAX_FIELDS];
+} EngmdTable;
+
+/**
+ * @brief 解析 SPENGMD 响应 (截止到第一个 "OK")
+ * @param t 输出表
+ * @param input 原始响应，解析后不能释放或修改
+ * @return 行数
+ */
+int engmd_parse(EngmdTable *t, const char *input);
+
+/**
+ * @brief 获取某行的列数
+ */
+int engmd_cols(const EngmdTable *t, int row);
+
+/**
+ * @brief 获取字段长度 (不存在返回 0)
+ */
+int engmd_len(const EngmdTable *t, int row, int col);
+
+/**
+ * @brief 复制字段到缓冲区 (不存在时为空串)
+ * @return 字段长度
+ */
+int engmd_str(const EngmdTable *t, int row, int col, char *buf, size_t size);
+
+/**
+ * @brief 字段是否等于指定字符串
+ */
+int engmd_equals(const EngmdTable *t, int row, int col, const char *s);
+
+/**
+ * @brief 按整数解析字段 (语义同 atoi，不存在返回 0)
+ */
+int engmd_int(const EngmdTable *t, int row, int col);
+
+/**
+ * @brief 按定点数解析字段并除以 divisor (语义同 atof(x) / divisor，不使用浮点解析)
+ */
+double engmd_fixed(const EngmdTable *t, int row, int col, int divisor);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* ENGMD_TABLE_H */
@@ -0,0 +1,123 @@
+/**
+ * @file proc_reader.h
+ * @brief /proc 和 sysfs 文件的零分配读取与键值扫描
+ *
+ * 每个文件对应一个 ProcFile: fd 保持打开，每次读取 pread 到调用者提供的固定缓冲区。
+ * 会被整体替换的普通文件 (如 connman settings) 用 PROC_FILE_ONESHOT，每次读取后关闭。
+ *
+ * 键值扫描直接在缓冲区上返回 (指针, 长度)，不复制、不修改，支持两种格式:
+ *   "MemTotal:     999 kB"   (sep = ':')
+ *   "POWER_SUPPLY_STATUS=Charging"   (sep = '=')
+ *
+ * 使用示例:
+ *   static char buf[2048];
+ *   static ProcFile f = PROC_FILE_INIT("/proc/meminfo", buf);
+ *   if (proc_file_read(&f) > 0) {
+ *       ProcScan s = proc_scan_begin(&f, ':');
+ *       ProcKV kv;
+ *       while (proc_scan_next(&s, &kv)) {
+ *           if (proc_kv_is(&kv, "MemTotal")) total = proc_kv_ll(&kv);
+ *       }
+ *   }
+ */
+
+#ifndef PROC_READER_H
+#define PROC_READER_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* 一个被反复读取的文件 */
+typedef struct {
+    const char *path;       /* 必须在 ProcFile 生命周期内有效 */
+    int fd;
+    int oneshot;            /* 读取后关闭 (文件可能被 rename 替换) */
+    char *buf;
+    size_t cap;
+    size_t len;             /* 最近一次读取的长度 */
+} ProcFile;
+
+#define PROC_FILE_INIT(path, storage)    { (path), -1, 0, (storage), sizeof(storage), 0 }
+#define PROC_FILE_ONESHOT(path, storage) { (path), -1, 1, (storage), sizeof(storage), 0 }
+
+/* 扫描得到的一对键值 (指向 ProcFile 缓冲区，不以 '\0' 结尾) */
+typedef struct {
+    const char *key;
+    size_t key_len;
+    const char *val;
+    size_t val_len;
+} ProcKV;
+
+/* 扫描游标 */
+typedef struct {
+    const char *p;
+    const char *end;
+    char sep;
+} ProcScan;
+
+/**
+ * @brief 运行时初始化 (路径在运行时拼接时使用)
+ */
+void proc_file_init(ProcFile *f, const char *path, char *buf, size_t cap);
+
+/**
+ * @brief 从头读取整个文件到缓冲区并以 '\0' 结尾，fd 失效时重新打开一次
+ * @return 读取的字节数, -1 失败
+ */
+int proc_file_read(ProcFile *f);
+
+/**
+ * @brief 关闭 fd (缓冲区不受影响)
+ */
+void proc_file_close(ProcFile *f);
+
+/**
+ * @brief 读取只含一个整数的文件 (如 sysfs 计数器、温度)
+ * @return 0 成功, -1 失败
+ */
+int proc_file_read_ll(ProcFile *f, long long *out);
+
+/**
+ * @brief 从已打开的 fd 读取一个无符号整数
+ * @return 0 成功, -1 失败
+ */
+int proc_pread_u64(int fd, uint64_t *out);
+
+/**
+ * @brief 开始扫描 ProcFile 缓冲区 (也可用于任意内存)
+ */
+ProcScan proc_scan_begin(const ProcFile *f, char sep);
+ProcScan proc_scan_mem(const char *buf, size_t len, char sep);
+
+/**
+ * @brief 取下一对键值，跳过不含分隔符的行
+ *
+ * 键去除两端空白，值去除前导空白和行尾空白。
+ * @return 1 取到, 0 扫描结束
+ */
+int proc_scan_next(ProcScan *s, ProcKV *kv);
+
+/**
+ * @brief 键是否等于 name
+ */
+int proc_kv_is(const ProcKV *kv, const char *name);
+
+/**
+ * @brief 值开头的整数 ("999 kB" -> 999, "-1200" -> -1200)，没有数字时为 0
+ */
+long long proc_kv_ll(const ProcKV *kv);
+
+/**
+ * @brief 复制值到 out (截断并以 '\0' 结尾)
+ */
+void proc_kv_copy(const ProcKV *kv, char *out, size_t size);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* PROC_READER_H */
@@ -0,0 +1,97 @@
+/**
+ * @file cell_sampler.h
+ * @brief 小区测量后台采样器
+ *
+ * 统一查询服务小区和邻小区 (AT+SPENGMD)，发布不可变快照供
+ * /api/cells、/api/current_band 等读取，接口本身不再访问模组。
+ * 只在有订阅者时采样：HTTP 读取会续约一段租期，内部模块可显式订阅。
+ * AT 查询失败或响应为空时保留上一快照 (序号不变)，读者按 timestamp 判断新旧。
+ */
+
+#ifndef CELL_SAMPLER_H
+#define CELL_SAMPLER_H
+
+#include <glib.h>
+#include "mongoose.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define CELL_MAX_NEIGHBORS        32
+#define CELL_SAMPLE_DEFAULT_MS    5000
+#define CELL_SAMPLE_MIN_MS        1000
+#define CELL_SAMPLE_MAX_MS        60000
+
+/* 单个小区测量值 */
+typedef struct {
+    char band[16];      /* 频段号，不含 N/B 前缀 */
+    int arfcn;
+    int pci;
+    double rsrp;
+    double rsrq;
+    double sinr;
+} CellMeasure;
+
+/* 采样快照 (发布后只读，通过引用计数共享) */
+typedef struct {
+    gint ref;
+    guint64 generation;     /* 单调递增的快照序号 */
+    gint64 timestamp;       /* 采样时间 (Unix 秒) */
+    int is_5g;              /* 1=NR, 0=LTE */
+    int has_serving;
+    CellMeasure serving;
+    int neighbor_count;
+    CellMeasure neighbors[CELL_MAX_NEIGHBORS];
+} CellSnapshot;
+
+/* 快照更新回调 (主循环中调用) */
+typedef void (*cell_snapshot_callback_t)(const CellSnapshot *snap, void *user_data);
+
+/**
+ * @brief 获取当前快照并续约 HTTP 租期
+ *
+ * 没有快照或快照已过期时同步采样一次。
+ * @return 快照 (需 cell_snapshot_release 释放), 失败返回 NULL
+ */
+const CellSnapshot *cell_sampler_acquire(void);
+
+/**
+ * @brief 释放快照引用
+ */
+void cell_snapshot_release(const CellSnapshot *snap);
+
+/**
+ * @brief 注册订阅者，订阅期间按 interval_ms 采样
+ * @param interval_ms 期望采样间隔 (<=0 使用配置值)
+ * @param callback 每次发布新快照时调用 (可为 NULL)
+ * @param user_data 回调参数
+ * @return 订阅 ID (>0), -1 失败
+ */
+int cell_sampler_subscribe(int interval_ms, cell_snapshot_callback_t callback, void *user_data);
+
+/**
+ * @brief 注册被动订阅者: 只接收其他订阅者或 HTTP 读取触发的快照，本身不触发采样
+ * @return 订阅 ID (>0), -1 失败 (用 cell_sampler_unsubscribe 取消)
+ */
+int cell_sampler_observe(cell_snapshot_callback_t callback, void *user_data);
+
+/**
+ * @brief 取消订阅
+ */
+void cell_sampler_unsubscribe(int id);
+
+/**
+ * @brief 获取/设置默认采样间隔 (持久化到 config 表)
+ */
+int cell_sampler_get_interval(void);
+int cell_sampler_set_interval(int interval_ms);
+
+/* GET/POST /api/cell_sampler - 采样器状态与采样间隔 */
+void handle_cell_sampler_config(struct mg_connection *c, struct mg_http_message *hm);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* CELL_SAMPLER_H */
@@ -17,6 +17,19 @@ void handle_charge_config(struct mg_connection *c, struct mg_http_message *hm);
 void handle_charge_on(struct mg_connection *c, struct mg_http_message *hm);
 void handle_charge_off(struct mg_connection *c, struct mg_http_message *hm);
 
+/**
+ * @brief 设置充电开关
+ * @param enable 1=开启充电, 0=停止充电
+ * @return 0成功, -1失败
+ */
+int set_charging(int enable);
+
+/**
+ * @brief 读取充电开关
+ * @return 1=允许充电, 0=已停止, -1=读取失败
+ */
+int get_charging(void);
+
 /**
  * @brief 获取电池状态
  * @param capacity 输出电池电量百分比 (0-100)
@@ -0,0 +1,47 @@
+/**
+ * @file client_traffic.h
+ * @brief 终端 (USB/Wi-Fi 客户端) 流量统计与配额
+ *
+ * 通过 /proc/net/arp 发现局域网客户端，为每个客户端在 iptables 专用链中
+ * 添加按源/目的 IP 计数的规则，按需读取计数器累加到内存表。
+ * 设置了配额的客户端超限后在拦截链中丢弃其转发流量。
+ *
+ * 配额没有周期：用量一直累计到通过 reset 清零为止。设置了配额的客户端
+ * 用量会持久化，重启后恢复用量并重新拦截已超限的客户端；未设配额的
+ * 客户端只统计本次运行的流量。
+ */
+
+#ifndef CLIENT_TRAFFIC_H
+#define CLIENT_TRAFFIC_H
+
+#include "mongoose.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define CLIENT_MAX             64
+#define CLIENT_DISCOVER_SECS   15      /* 客户端发现/配额检查间隔 */
+#define CLIENT_SAVE_SECS       300     /* 配额客户端用量持久化间隔 */
+
+/**
+ * @brief 创建 iptables 计数链并启动客户端发现
+ */
+void client_traffic_init(void);
+
+/**
+ * @brief 读取最新计数并持久化配额客户端的用量 (退出/重启前调用)
+ */
+void client_traffic_flush(void);
+
+/* GET /api/traffic/clients?top=N&sort=total|rx|tx - 客户端流量排行 */
+void handle_traffic_clients(struct mg_connection *c, struct mg_http_message *hm);
+
+/* POST /api/traffic/client_quota - 设置客户端配额 {mac, quota[, reset]} */
+void handle_traffic_client_quota(struct mg_connection *c, struct mg_http_message *hm);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* CLIENT_TRAFFIC_H */
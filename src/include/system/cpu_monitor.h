@@ -0,0 +1,76 @@
+/**
+ * @file cpu_monitor.h
+ * @brief CPU 与关键进程资源监控
+ *
+ * 固定间隔读取 /proc/stat、/proc/loadavg 和关键进程的 /proc/<pid>/stat，
+ * 计算每核使用率、上下文切换/中断速率以及进程 CPU/RSS。
+ * 所有差值由采样定时器统一计算，读取接口只返回最近一次结果，
+ * 多个调用者之间互不影响。
+ */
+
+#ifndef CPU_MONITOR_H
+#define CPU_MONITOR_H
+
+#include <glib.h>
+#include "mongoose.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define CPU_MONITOR_MAX_CORES     8
+#define CPU_MONITOR_MAX_PROCS     8
+#define CPU_MONITOR_DEFAULT_SECS  2
+#define CPU_MONITOR_MIN_SECS      1
+#define CPU_MONITOR_MAX_SECS      60
+
+/* 单个关键进程 */
+typedef struct {
+    char name[16];          /* 进程名 (comm) */
+    int pid;                /* 0 表示未运行 */
+    double cpu;             /* 占用单核的百分比 (双核满载为 200) */
+    unsigned long rss_kb;
+    int threads;
+} CpuProcStat;
+
+/* 最近一次采样结果 */
+typedef struct {
+    gint64 time_ms;         /* Unix 毫秒 */
+    int interval_s;
+    int valid;              /* 是否已有两次采样 */
+    int core_count;
+    double total;           /* 总使用率 % */
+    double cores[CPU_MONITOR_MAX_CORES];
+    double iowait;          /* iowait 占比 % */
+    double load[3];         /* 1/5/15 分钟负载 */
+    double ctxt_rate;       /* 每秒上下文切换 */
+    double irq_rate;        /* 每秒中断 */
+    int procs_running;
+    int procs_blocked;
+    int proc_count;
+    CpuProcStat procs[CPU_MONITOR_MAX_PROCS];
+} CpuStats;
+
+/**
+ * @brief 读取配置 cpu_monitor_interval (秒) 并启动采样
+ */
+void cpu_monitor_init(void);
+
+/**
+ * @brief 复制最近一次采样结果
+ */
+void cpu_monitor_get(CpuStats *out);
+
+/**
+ * @brief 最近一次的总使用率 (%)，尚无结果时为 0
+ */
+double cpu_monitor_total(void);
+
+/* GET/POST /api/system/cpu - CPU 与关键进程资源 (POST 设置 interval) */
+void handle_system_cpu(struct mg_connection *c, struct mg_http_message *hm);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* CPU_MONITOR_H */
@@ -93,6 +93,32 @@ int db_query_rows(const char *sql, const char *separator, char *buf, size_t size
  */
 void db_escape_string(const char *src, char *dst, size_t size);
 
+/**
+ * 执行查询并返回全部结果行 (大小不受固定缓冲区限制)
+ * @param sql SQL语句
+ * @param len 输出长度 (可为NULL)
+ * @return malloc 分配的结果 (调用者 free), 失败返回 NULL
+ */
+char *db_query_rows_alloc(const char *sql, size_t *len);
+
+/**
+ * 解码 SQL hex() 的输出
+ * @param hex hex字符串
+ * @param out 输出缓冲区 (至少 strlen(hex)/2+1)
+ * @param size 输出缓冲区大小
+ */
+void db_hex_decode(const char *hex, char *out, size_t size);
+
+/**
+ * 生成文本字面量 CAST(X'..' AS TEXT)
+ * 内容以 hex 传入，不受 shell 和 SQL 引号影响
+ * @param src 源字符串
+ * @param dst 目标缓冲区 (至少 strlen(src)*2+20)
+ * @param size 目标缓冲区大小
+ * @return 0成功, -1缓冲区不足
+ */
+int db_text_literal(const char *src, char *dst, size_t size);
+
 /**
  * SQL字符串反转义
  * @param str 要反转义的字符串（原地修改）
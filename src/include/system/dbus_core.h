@@ -35,6 +35,103 @@ int is_dbus_initialized(void);
  */
 int execute_at(const char *command, char **result);
 
+/* ==================== AT 命令序列 ==================== */
+
+#define AT_WAIT_POLL_MS       100   /* 状态等待的轮询间隔 */
+
+/* 步骤标志 */
+#define AT_STEP_OPTIONAL      0x01  /* 失败不终止序列 */
+#define AT_STEP_ALWAYS        0x02  /* 前序步骤失败时仍执行 (如恢复射频) */
+
+/* 步骤结果码 */
+#define AT_STEP_OK            0
+#define AT_STEP_FAILED        -1    /* D-Bus 调用失败 */
+#define AT_STEP_UNEXPECTED    -2    /* 响应与期望不符 */
+#define AT_STEP_WAIT_TIMEOUT  -3    /* 等待状态超时 */
+#define AT_STEP_SKIPPED       -4    /* 前序步骤失败，未执行 */
+
+/* AT 序列步骤 */
+typedef struct {
+    const char *command;      /* AT 命令 */
+    const char *expect;       /* 期望响应包含的子串, NULL 表示不含 ERROR 即可 */
+    int timeout_ms;           /* 命令超时, 0 使用默认 8 秒 */
+    const char *wait_cmd;     /* 完成后轮询的状态查询命令, NULL 表示不等待 */
+    const char *wait_expect;  /* 状态查询响应需包含的子串 */
+    int wait_timeout_ms;      /* 状态等待超时 */
+    int flags;                /* AT_STEP_* 标志 */
+} AtStep;
+
+/* 步骤执行结果 */
+typedef struct {
+    int rc;                   /* AT_STEP_* 结果码 */
+    int elapsed_ms;           /* 本步耗时 (含状态等待) */
+    int polls;                /* 状态轮询次数 */
+} AtStepResult;
+
+/**
+ * @brief 判断响应是否满足期望
+ * @param expect 期望包含的子串, NULL 表示不含 ERROR 即可
+ * @return 1 满足, 0 不满足
+ */
+int at_response_matches(const char *response, const char *expect);
+
+/* 异步 AT 回调: rc 0 成功 (response 为去除首尾空白的响应), -1 失败 */
+typedef void (*AtAsyncCallback)(int rc, const char *response, void *user_data);
+
+/**
+ * @brief 异步发送 AT 命令，不阻塞主循环
+ *
+ * 不检查 AT 通道独占标志，供持有通道的 AT 序列 (execute_at_sequence) 使用。
+ * @param timeout_ms 命令超时, 0 使用默认 8 秒
+ * @return 0 已发出 (结果由回调返回), -1 参数无效或 D-Bus 不可用 (不回调)
+ */
+int execute_at_async(const char *command, int timeout_ms, AtAsyncCallback cb, void *user_data);
+
+/* 序列进度回调: step 为刚完成的步骤下标，结果已写入 results[step] */
+typedef void (*AtSequenceStepCallback)(int step, void *user_data);
+
+/* 序列结束回调: rc 0 成功, -1 有必选步骤失败; message 为首个失败原因 (成功时为空串) */
+typedef void (*AtSequenceDoneCallback)(int rc, const char *message, int total_ms, void *user_data);
+
+/**
+ * @brief 按脚本顺序异步执行一组 AT 命令
+ *
+ * 整个序列独占 AT 通道，每步经 execute_at_async 发送并在响应回调里推进，
+ * 校验响应，需要时按 AT_WAIT_POLL_MS 轮询状态直到满足条件，不使用固定延时，
+ * 也不阻塞主循环。必选步骤失败后，剩余步骤中只执行带 AT_STEP_ALWAYS
+ * 的步骤，其余标记为 AT_STEP_SKIPPED。on_done 回调前已释放 AT 通道。
+ *
+ * @param steps 步骤数组, 需保持有效直到 on_done 回调
+ * @param count 步骤数量
+ * @param results 输出每步结果 (长度为 count), 同样需保持有效
+ * @param on_step 每步完成回调 (可为 NULL)
+ * @param on_done 序列结束回调
+ * @return 0 已开始, -1 参数无效或已有序列在执行 (不回调)
+ */
+int execute_at_sequence(const AtStep *steps, int count, AtStepResult *results,
+                        AtSequenceStepCallback on_step, AtSequenceDoneCallback on_done,
+                        void *user_data);
+
+/**
+ * @brief 是否有 AT 序列正在执行
+ * @return 1 执行中, 0 空闲
+ */
+int at_sequence_running(void);
+
+/**
+ * @brief 独占/释放 AT 通道
+ *
+ * 独占期间 execute_at 等同步调用直接失败，避免其他命令插入锁频/锁小区序列中间。
+ * 独占时会等待其他线程正在执行的命令完成。
+ */
+void at_channel_reserve(int reserve);
+
+/**
+ * @brief AT 通道是否被独占
+ * @return 1 独占中, 0 空闲
+ */
+int at_channel_reserved(void);
+
 /**
  * @brief 获取最后一次错误信息
  * @return 错误信息字符串
@@ -24,6 +24,15 @@ extern "C" {
  */
 int run_command(char *output, size_t size, const char *cmd, ...);
 
+/**
+ * @brief 执行命令并获取完整输出 (缓冲区按输出大小增长)
+ * @param len 输出长度 (可为NULL)
+ * @param cmd 命令
+ * @param ... 参数列表 (以 NULL 结尾)
+ * @return malloc 分配的输出 (调用者 free), 命令失败返回 NULL
+ */
+char *run_command_alloc(size_t *len, const char *cmd, ...);
+
 /**
  * @brief 带超时执行命令
  * @param timeout_sec 超时秒数
@@ -0,0 +1,47 @@
+/**
+ * @file info_snapshot.h
+ * @brief /api/info 系统信息快照
+ *
+ * 按变化频率分层刷新: 静态字段启动时读取一次，慢变字段 (内存/温度/电池)
+ * 和模组字段 (信号/网络/QoS) 由定时器分别刷新，SIM 身份来自身份缓存。
+ * 渲染后的 JSON 缓存到下次刷新为止，请求只复制缓存。
+ * 定时器只在最近有请求时运行，空闲后自动停止。
+ */
+
+#ifndef INFO_SNAPSHOT_H
+#define INFO_SNAPSHOT_H
+
+#include "mongoose.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define INFO_SLOW_SECS     5        /* 慢变字段刷新间隔 */
+#define INFO_MODEM_SECS    10       /* 模组字段刷新间隔 */
+#define INFO_LEASE_SECS    30       /* 最后一次请求后继续刷新的时长 */
+
+/**
+ * @brief 读取静态字段 (启动时调用一次)
+ */
+void info_snapshot_init(void);
+
+/**
+ * @brief 标记模组字段过期 (切卡、改网络模式、飞行模式、射频重配置任务结束后调用)
+ */
+void info_snapshot_invalidate(void);
+
+/**
+ * @brief 获取渲染好的 JSON，必要时同步刷新过期分层
+ * @return 缓存的 JSON (下次刷新前有效，调用者不要释放)
+ */
+const char *info_snapshot_json(void);
+
+/* GET /api/info - 获取系统信息 */
+void handle_info(struct mg_connection *c, struct mg_http_message *hm);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* INFO_SNAPSHOT_H */
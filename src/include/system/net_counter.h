@@ -0,0 +1,71 @@
+/**
+ * @file net_counter.h
+ * @brief 网卡字节计数器 (读取 /sys/class/net/<iface>/statistics)
+ *
+ * 计数器文件保持打开，每次读取只需一次 pread。
+ * 累加时处理 32/64 位回绕、网卡重建 (ifindex 变化) 和计数清零。
+ */
+
+#ifndef NET_COUNTER_H
+#define NET_COUNTER_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define NET_IFACE_NAME_MAX  16
+
+/* 单个网卡的计数状态 */
+typedef struct {
+    char iface[NET_IFACE_NAME_MAX];
+    int rx_fd;
+    int tx_fd;
+    int ifindex;            /* 打开时的 ifindex, 变化说明网卡被重建 */
+    int primed;             /* last_rx/last_tx 是否有效 */
+    uint64_t last_rx;       /* 上次读到的原始计数 */
+    uint64_t last_tx;
+    uint64_t total_rx;      /* 累计字节数 */
+    uint64_t total_tx;
+    int wide_rx;            /* 曾超过 UINT32_MAX, 确定是 64 位计数 */
+    int wide_tx;
+} NetCounter;
+
+/**
+ * @brief 初始化计数器 (网卡不存在时也成功，之后读取时重试打开)
+ */
+void net_counter_init(NetCounter *nc, const char *iface);
+
+/**
+ * @brief 读取原始计数 (自网卡创建以来)
+ * @return 0成功, -1失败 (网卡不存在)
+ */
+int net_counter_read_raw(NetCounter *nc, uint64_t *rx, uint64_t *tx);
+
+/**
+ * @brief 读取当前计数并把增量累加到 total_rx/total_tx
+ * @return 0成功, -1失败 (累计值保持不变)
+ */
+int net_counter_update(NetCounter *nc);
+
+/**
+ * @brief 计算两次原始计数之间的增量
+ *
+ * cur < last 时: last 在 32 位范围内且回绕后增量合理则按 32 位回绕处理，
+ * 否则视为计数清零，增量为 cur。
+ * 这里只看两个原始值; net_counter_update 还会参考 wide_rx/wide_tx，
+ * 已确定为 64 位的计数下降一律视为清零。
+ */
+uint64_t net_counter_delta(uint64_t last, uint64_t cur);
+
+/**
+ * @brief 关闭计数器文件
+ */
+void net_counter_close(NetCounter *nc);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* NET_COUNTER_H */
@@ -0,0 +1,68 @@
+/**
+ * @file push_channel.h
+ * @brief WebSocket 推送通道 (/api/ws)
+ *
+ * 浏览器通过 /api/ws?token=xxx&topics=throughput,signal 建立连接并订阅主题，
+ * 之后也可发送 {"sub":"name"} / {"unsub":"name"} 调整订阅。
+ * 数据生产者通过 push_watchers() 判断是否有人订阅，没有订阅时不必采样。
+ * 推送帧格式: {"topic":"name","data":{...}}
+ */
+
+#ifndef PUSH_CHANNEL_H
+#define PUSH_CHANNEL_H
+
+#include "mongoose.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* 主题 (位掩码) */
+#define PUSH_TOPIC_THROUGHPUT   0x01
+#define PUSH_TOPIC_SIGNAL       0x02
+
+/* 订阅人数变化回调 (主循环中调用) */
+typedef void (*push_watch_callback_t)(unsigned topic, int watchers);
+
+/**
+ * @brief 初始化推送通道
+ */
+void push_init(struct mg_mgr *mgr);
+
+/**
+ * @brief 处理 /api/ws 升级请求 (自行校验 Token，浏览器无法为 WebSocket 设置请求头)
+ */
+void push_handle_upgrade(struct mg_connection *c, struct mg_http_message *hm);
+
+/**
+ * @brief 处理客户端发来的 WebSocket 消息
+ */
+void push_handle_message(struct mg_connection *c, struct mg_ws_message *wm);
+
+/**
+ * @brief 连接关闭时更新订阅计数
+ */
+void push_handle_close(struct mg_connection *c);
+
+/**
+ * @brief 主题当前订阅连接数
+ */
+int push_watchers(unsigned topic);
+
+/**
+ * @brief 注册订阅人数变化回调 (每个主题一个)
+ */
+void push_set_watch_callback(unsigned topic, push_watch_callback_t cb);
+
+/**
+ * @brief 向订阅了 topic 的连接推送一帧
+ * @param json data 字段内容 (JSON 对象)
+ * @return 发送的连接数
+ */
+int push_publish(unsigned topic, const char *json);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* PUSH_CHANNEL_H */
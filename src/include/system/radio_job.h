@@ -0,0 +1,59 @@
+/**
+ * @file radio_job.h
+ * @brief 射频重配置异步任务 (锁频/锁小区)
+ *
+ * AT 序列由 GLib 定时器驱动的状态机逐步执行，HTTP 请求立即返回任务 ID，
+ * 进度和结果通过 GET /api/radio_job?id=N 查询。同一时间只允许一个任务。
+ */
+
+#ifndef RADIO_JOB_H
+#define RADIO_JOB_H
+
+#include "mongoose.h"
+#include "dbus_core.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define RADIO_JOB_MAX_STEPS  8
+#define RADIO_JOB_BUSY       -2   /* 已有任务在执行 */
+
+/* 任务状态 */
+typedef enum {
+    RADIO_JOB_IDLE = 0,
+    RADIO_JOB_RUNNING,
+    RADIO_JOB_DONE,
+    RADIO_JOB_FAILED
+} RadioJobState;
+
+/**
+ * @brief 提交射频重配置任务
+ * @param name 任务名 (如 lock_bands)
+ * @param ok_msg 成功时的结果信息
+ * @param steps AT 步骤 (内容会被复制)
+ * @param count 步骤数量 (不超过 RADIO_JOB_MAX_STEPS)
+ * @return 任务 ID (>0), RADIO_JOB_BUSY 已有任务, -1 参数错误
+ */
+int radio_job_start(const char *name, const char *ok_msg, const AtStep *steps, int count);
+
+/**
+ * @brief 是否有任务正在执行
+ * @return 1 执行中, 0 空闲
+ */
+int radio_job_is_running(void);
+
+/**
+ * @brief 获取当前 (或最近) 任务 ID
+ * @return 任务 ID, 0 表示没有任务
+ */
+int radio_job_current_id(void);
+
+/* GET /api/radio_job?id=N - 查询任务进度 */
+void handle_radio_job(struct mg_connection *c, struct mg_http_message *hm);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* RADIO_JOB_H */
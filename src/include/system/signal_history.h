@@ -0,0 +1,51 @@
+/**
+ * @file signal_history.h
+ * @brief 服务小区信号质量历史 (RSRP/RSRQ/SINR/频段/PCI)
+ *
+ * 经共享的小区采样器低频采样 (默认 30 秒)，页面读取、实时推送产生的
+ * 快照也一并记录，不会重复发送 AT 命令。
+ * 历史写入固定大小的文件，定时只写回变化的块，重启后继续记录。
+ * 信号值以 0.1dB 定点数存储，相邻记录只保存差值 (zigzag varint)，
+ * 每个 4KB 块以关键帧开头，块写满后覆盖最旧的块。
+ * 换小区 (PCI/ARFCN/制式变化) 作为切换事件单独标记。
+ */
+
+#ifndef SIGNAL_HISTORY_H
+#define SIGNAL_HISTORY_H
+
+#include "mongoose.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define SIGNAL_HISTORY_FILE            "signal_history.dat"
+#define SIGNAL_HISTORY_CHUNKS          64       /* 64 x 4KB, 30 秒间隔约可保存两周 */
+#define SIGNAL_HISTORY_CHUNK_BYTES     4096
+#define SIGNAL_HISTORY_DEFAULT_SECS    30       /* 默认采样间隔 (秒) */
+#define SIGNAL_HISTORY_FLUSH_DEFAULT   10       /* 默认写回间隔 (分钟) */
+#define SIGNAL_HISTORY_MAX_POINTS      2000
+
+/**
+ * @brief 载入历史文件，按配置 signal_history_interval 订阅小区采样器
+ *
+ * <0 关闭; 0 只记录已有快照; >0 按该秒数主动采样 (默认 30)。
+ * 有 signal 主题的推送订阅者时按采样器默认间隔采样。
+ * 写回间隔由 signal_history_flush_min 配置 (分钟)。
+ */
+void signal_history_init(void);
+
+/**
+ * @brief 把修改过的块写回文件
+ * @return 写回的块数, -1失败
+ */
+int signal_history_flush(void);
+
+/* GET /api/signal/history?from=&to=&step= - 查询信号历史 (step>0 时按桶汇总 min/avg/max) */
+void handle_signal_history(struct mg_connection *c, struct mg_http_message *hm);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* SIGNAL_HISTORY_H */
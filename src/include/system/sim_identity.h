@@ -0,0 +1,62 @@
+/**
+ * @file sim_identity.h
+ * @brief SIM/模组身份信息缓存 (IMEI/ICCID/IMSI/运营商)
+ *
+ * 身份信息只在换卡、切卡时变化，缓存后 /api/info 不再每次发 AT 命令。
+ * 缓存由 SimManager PropertyChanged、DataCard 变化、切卡和 oFono 重启驱动失效。
+ */
+
+#ifndef SIM_IDENTITY_H
+#define SIM_IDENTITY_H
+
+#include <glib.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* 身份信息 */
+typedef struct {
+    char imei[20];
+    char iccid[24];
+    char imsi[20];
+    char carrier[32];
+    char modem_path[32];   /* 缓存所属的 RIL 路径 */
+} SimIdentity;
+
+/**
+ * @brief 初始化身份缓存 (启动时预热一次)
+ */
+void sim_identity_init(void);
+
+/**
+ * @brief 获取身份信息 (缓存失效时同步刷新)
+ * @param out 输出结构
+ * @return 0 成功, -1 失败 (out 中保留已知字段)
+ */
+int sim_identity_get(SimIdentity *out);
+
+/**
+ * @brief 使缓存失效，并在稍后后台刷新
+ * @param reason 失效原因 (用于日志)
+ */
+void sim_identity_invalidate(const char *reason);
+
+/**
+ * @brief AT 通道独占结束后调用，补做期间被推迟的刷新
+ */
+void sim_identity_resume(void);
+
+/**
+ * @brief 处理 SimManager PropertyChanged 信号
+ * @param modem_path 信号来源路径
+ * @param name 属性名
+ * @param value 属性值
+ */
+void sim_identity_on_sim_property(const char *modem_path, const char *name, GVariant *value);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* SIM_IDENTITY_H */
@@ -7,20 +7,39 @@
 #define SMS_H
 
 #include <time.h>
+#include <gio/gio.h>
 
 #ifdef __cplusplus
 extern "C" {
 #endif
 
-/* 短信数据结构 */
+/* 短信数据结构 - 正文不定长，不再截断到固定 1KB */
 typedef struct {
     int id;
     char sender[64];
-    char content[1024];
+    const char *content;    /* UTF-8 正文 (指向调用方或查询缓冲区，不归本结构所有) */
+    size_t content_len;     /* 正文字节数 */
     time_t timestamp;
     int is_read;
+    int parts;              /* 按编码和长度估算的分段数 (长短信由 oFono 合并后上报) */
 } SmsMessage;
 
+/* 短信列表查询条件 - 基于 id 主键的 keyset 分页 */
+#define SMS_QUERY_DEFAULT_LIMIT 20
+#define SMS_QUERY_MAX_LIMIT     100
+#define SMS_QUERY_MAX_Q         128     /* 关键字最大字节数 */
+
+typedef struct {
+    int before_id;          /* >0 时只返回 id < before_id 的短信 (向后翻页) */
+    int since_id;           /* >0 时只返回 id > since_id 的短信 (增量拉取, 按 id 升序) */
+    int limit;              /* 每页数量, 1..SMS_QUERY_MAX_LIMIT */
+    const char *q;          /* 内容关键字, 可为NULL, 最长 SMS_QUERY_MAX_Q 字节 */
+    const char *sender;     /* 发件人精确匹配, 可为NULL */
+} SmsQuery;
+
+/* 查询结果逐条回调, msg 及其 content 仅在回调期间有效 */
+typedef void (*SmsRowCallback)(const SmsMessage *msg, void *user_data);
+
 /* Webhook配置结构 */
 typedef struct {
     int enabled;
@@ -43,22 +62,48 @@ int sms_init(const char *db_path);
 void sms_deinit(void);
 
 /**
- * 发送短信
+ * 获取 oFono 可用时的系统总线连接 (发送队列使用)
+ * @return 连接, 不可用时返回 NULL
+ */
+GDBusConnection *sms_get_dbus_connection(void);
+
+/**
+ * 写入一条发送记录
  * @param recipient 收件人号码
  * @param content 短信内容
- * @param result_path 返回的消息路径(可为NULL)
- * @param path_size result_path缓冲区大小
+ * @param status 状态 (pending/submitted/sent/failed/unknown)
+ * @return 记录 id, -1失败
+ */
+int sms_sent_insert(const char *recipient, const char *content, const char *status);
+
+/**
+ * 同一内容写入多条发送记录 (群发)，在一个事务中完成
+ * @param recipients 收件人号码数组
+ * @param count 收件人数量
+ * @param ids 输出每个收件人的记录 id (长度为 count)
+ * @return 写入条数 (等于 count), -1失败
+ */
+int sms_sent_insert_many(const char *const *recipients, int count, const char *content,
+                         const char *status, int *ids);
+
+/**
+ * 更新发送记录状态
+ * @param id 记录 id
+ * @param status 新状态
  * @return 0成功, -1失败
  */
-int sms_send(const char *recipient, const char *content, char *result_path, size_t path_size);
+int sms_sent_set_status(int id, const char *status);
 
 /**
- * 获取短信列表
- * @param messages 输出数组
- * @param max_count 最大数量
- * @return 实际获取的数量, -1失败
+ * 按条件分页查询短信
+ * 默认按 id 降序; 设置 since_id 时按 id 升序返回新短信。
+ * @param query 查询条件
+ * @param cb 每条短信的回调
+ * @param user_data 回调参数
+ * @param has_more 输出: 是否还有下一页 (可为NULL)
+ * @return 返回的数量, -1失败
  */
-int sms_get_list(SmsMessage *messages, int max_count);
+int sms_query(const SmsQuery *query, SmsRowCallback cb, void *user_data, int *has_more);
 
 /**
  * 获取短信总数
@@ -99,22 +144,28 @@ int sms_save_webhook_config(const WebhookConfig *config);
  */
 int sms_test_webhook(void);
 
-/* 发送记录结构 */
+#define SMS_SENT_LIST_LIMIT     150     /* /api/sms/sent 返回的最大条数 */
+
+/* 发送记录结构 - 正文不定长 (排队短信最长 SMS_OUTBOX_MAX_CONTENT，转发内容另带发件人前缀) */
 typedef struct {
     int id;
     char recipient[64];
-    char content[1024];
+    const char *content;    /* UTF-8 正文 (指向查询缓冲区，不归本结构所有) */
+    size_t content_len;     /* 正文字节数 */
     time_t timestamp;
     char status[32];
 } SentSmsMessage;
 
+/* 发送记录逐条回调, msg 及其 content 仅在回调期间有效 */
+typedef void (*SentSmsRowCallback)(const SentSmsMessage *msg, void *user_data);
+
 /**
- * 获取发送记录列表
- * @param messages 输出数组
+ * 获取发送记录列表 (按 id 倒序)
  * @param max_count 最大数量
+ * @param cb 逐条回调
  * @return 实际获取的数量, -1失败
  */
-int sms_get_sent_list(SentSmsMessage *messages, int max_count);
+int sms_get_sent_list(int max_count, SentSmsRowCallback cb, void *user_data);
 
 /**
  * 获取最大存储数量配置
@@ -142,6 +193,22 @@ int sms_get_max_sent_count(void);
  */
 int sms_set_max_sent_count(int count);
 
+/* 短信容量上限的最大可设置值 (KB) */
+#define SMS_MAX_KB_LIMIT 4096
+
+/**
+ * 获取短信容量上限 (收件箱、发件箱各自的内容总字节数)
+ * @return 上限(KB), 0表示不限
+ */
+int sms_get_max_kb(void);
+
+/**
+ * 设置短信容量上限
+ * @param kb 上限(KB), 0表示不限
+ * @return 0成功, -1失败
+ */
+int sms_set_max_kb(int kb);
+
 /**
  * 删除发送记录
  * @param id 记录ID
@@ -155,12 +222,6 @@ int sms_delete_sent(int id);
  */
 int sms_check_status(void);
 
-/**
- * 定期维护短信模块（检查并恢复D-Bus连接）
- * 应在主循环中定期调用
- */
-void sms_maintenance(void);
-
 /**
  * 获取短信接收修复开关状态
  * @return 1开启, 0关闭
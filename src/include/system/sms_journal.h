@@ -0,0 +1,76 @@
+/**
+ * @file sms_journal.h
+ * @brief 短信收件日志 - 入库前先顺序追加到带 CRC 的日志文件
+ *
+ * 收到短信只做一次 append + fdatasync，数据库写入由定时器批量完成，
+ * 提交成功后清空日志。启动时重放日志，数据库忙、sqlite3 不可用
+ * 或写入失败时短信不会丢失。
+ *
+ * 记录格式 (本机字节序):
+ *   u32 magic | u32 payload_len | u32 crc32(payload) | payload
+ *   payload = i64 timestamp | i32 parts | i32 is_read |
+ *             sender\0 sent_time\0 hash\0 content\0
+ */
+
+#ifndef SMS_JOURNAL_H
+#define SMS_JOURNAL_H
+
+#include <time.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define SMS_JOURNAL_FILE        "sms_ingest.journal"    /* 与数据库同目录 */
+#define SMS_JOURNAL_MAGIC       0x4A534D53u             /* "SMSJ" */
+#define SMS_JOURNAL_MAX_RECORD  (64 * 1024)
+
+typedef struct {
+    time_t timestamp;
+    int parts;
+    int is_read;
+    const char *sender;
+    const char *sent_time;
+    const char *hash;
+    const char *content;
+} SmsJournalRecord;
+
+/* 重放回调，记录内的指针只在回调期间有效 */
+typedef void (*SmsJournalCallback)(const SmsJournalRecord *rec, void *user_data);
+
+/**
+ * @brief 打开 (必要时创建) 数据库目录下的日志文件
+ * 尾部不完整的记录 (掉电时写了一半) 在这里截掉，之后的追加接在有效记录后面
+ */
+int sms_journal_open(const char *db_path);
+
+void sms_journal_close(void);
+
+/**
+ * @brief 追加一条记录并落盘
+ * @return 0 成功, -1 失败 (文件未打开/写入失败，已回退半截记录)
+ */
+int sms_journal_append(const SmsJournalRecord *rec);
+
+/**
+ * @brief 按顺序回调全部有效记录，跳过中间损坏的数据继续向后查找
+ * @return 有效记录数, -1 读取失败
+ */
+int sms_journal_replay(SmsJournalCallback cb, void *user_data);
+
+/**
+ * @brief 记录已全部提交到数据库后清空日志
+ * @return 0 成功, -1 失败或上次重放后日志又有变化 (不清空，下次重放再处理)
+ */
+int sms_journal_reset(void);
+
+/**
+ * @brief 日志是否为空
+ */
+int sms_journal_empty(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* SMS_JOURNAL_H */
@@ -0,0 +1,67 @@
+/**
+ * @file sms_outbox.h
+ * @brief 短信发送队列 - 异步发送、限速、投递状态跟踪
+ *
+ * 提交时先写入 sent_sms (status=pending) 并立即返回记录 id，
+ * 队列按最小间隔逐条调用 MessageManager.SendMessage (异步)，oFono 接受后记为 submitted，
+ * 再根据 org.ofono.Message 的 PropertyChanged(State) 更新为 sent/failed。
+ * 重启后只重发 pending 记录; 遗留的 submitted 记录标记为 unknown。
+ */
+
+#ifndef SMS_OUTBOX_H
+#define SMS_OUTBOX_H
+
+#include "mongoose.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define SMS_OUTBOX_MAX_QUEUE        200     /* 排队上限 */
+#define SMS_OUTBOX_MAX_RECIPIENTS   100     /* 单次群发上限 */
+#define SMS_OUTBOX_MAX_CONTENT      1530    /* 约 10 段 UCS-2 长短信 */
+#define SMS_OUTBOX_DEFAULT_MS       3000    /* 默认发送间隔 */
+#define SMS_OUTBOX_MIN_MS           500
+
+typedef struct {
+    int queued;             /* 等待发送 */
+    int tracking;           /* 已交给 oFono，等待最终状态 */
+    int interval_ms;
+    unsigned long sent;     /* 本次运行累计 */
+    unsigned long failed;
+} SmsOutboxStats;
+
+/**
+ * @brief 读取配置 sms_send_interval_ms，恢复上次未发出的 pending 记录
+ */
+void sms_outbox_init(void);
+
+/**
+ * @brief 提交一条短信
+ * @return sent_sms 记录 id, -1 失败 (参数无效/队列已满/写库失败)
+ */
+int sms_outbox_enqueue(const char *recipient, const char *content);
+
+/**
+ * @brief 同一内容提交给多个收件人 (群发)，发送记录在一个事务中写入
+ * @param count 收件人数量 (不超过 SMS_OUTBOX_MAX_RECIPIENTS)
+ * @param ids 输出每个收件人的记录 id, 被拒绝的为 -1 (号码无效/队列已满)
+ * @return 接受的条数, -1 失败 (参数无效/写库失败)
+ */
+int sms_outbox_enqueue_many(const char *const *recipients, int count, const char *content, int *ids);
+
+/**
+ * @brief oFono (重新) 出现后调用: 重新订阅状态信号，补齐跟踪中消息的状态并恢复发送
+ */
+void sms_outbox_resync(void);
+
+void sms_outbox_get_stats(SmsOutboxStats *st);
+
+/* GET /api/sms/outbox - 队列状态 */
+void handle_sms_outbox(struct mg_connection *c, struct mg_http_message *hm);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* SMS_OUTBOX_H */
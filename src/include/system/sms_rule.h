@@ -0,0 +1,66 @@
+/**
+ * @file sms_rule.h
+ * @brief 短信规则引擎 - 按发件人/内容匹配收到的短信并执行动作
+ *
+ * 规则保存在 sms_rules 表，保存时编译正则并重建内存索引:
+ * 精确号码走哈希表，"前缀*" 与 "任意" 各一张有序表，
+ * 收到短信只检查候选规则，按优先级依次匹配内容正则。
+ * 动作: 转发到其他号码 / 调用 Webhook / 运行脚本 / 标记已读。
+ */
+
+#ifndef SMS_RULE_H
+#define SMS_RULE_H
+
+#include <time.h>
+#include "mongoose.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define SMS_RULE_MAX            64
+#define SMS_RULE_NAME_SIZE      64
+#define SMS_RULE_SENDER_SIZE    64      /* 号码、"前缀*" 或空 (任意) */
+#define SMS_RULE_PATTERN_SIZE   256     /* 内容正则，空表示不限 */
+#define SMS_RULE_TARGET_SIZE    256     /* 转发号码 / Webhook URL / 脚本名 */
+#define SMS_RULE_MAX_SCRIPTS    4       /* 同时运行的脚本数上限 */
+#define SMS_RULE_SCRIPTS_DIR    "/home/root/6677/Plugins/scripts"
+
+typedef enum {
+    SMS_RULE_FORWARD = 0,
+    SMS_RULE_WEBHOOK,
+    SMS_RULE_SCRIPT,
+    SMS_RULE_MARK_READ,
+    SMS_RULE_ACTION_COUNT
+} SmsRuleAction;
+
+/**
+ * @brief 建表并载入规则
+ */
+void sms_rule_init(void);
+
+/**
+ * @brief 对一条新短信执行匹配的规则 (入库前调用)
+ * 转发、Webhook、脚本都是异步投递，不阻塞主循环
+ * @param mark_read 输出: 是否有规则要求标记已读
+ * @return 命中的规则数
+ */
+int sms_rule_apply(const char *sender, const char *content, time_t timestamp, int *mark_read);
+
+/* GET /api/sms/rules - 规则列表 */
+void handle_sms_rules_list(struct mg_connection *c, struct mg_http_message *hm);
+
+/* POST /api/sms/rules - 新增或修改 (带 id) 规则 */
+void handle_sms_rules_save(struct mg_connection *c, struct mg_http_message *hm);
+
+/* DELETE /api/sms/rules/:id */
+void handle_sms_rules_delete(struct mg_connection *c, struct mg_http_message *hm);
+
+/* POST /api/sms/rules/test {"sender":"...","content":"..."} - 只匹配不执行 */
+void handle_sms_rules_test(struct mg_connection *c, struct mg_http_message *hm);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* SMS_RULE_H */
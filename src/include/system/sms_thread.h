@@ -0,0 +1,54 @@
+/**
+ * @file sms_thread.h
+ * @brief 短信会话索引 - 收件箱与发件箱按对方号码归并
+ *
+ * sms / sent_sms 每行保存规范化后的号码 (peer)，
+ * sms_threads 每个会话一行，保存最后一条预览、未读数和时间，
+ * 在写入短信时增量更新，删除短信由触发器回退计数。
+ */
+
+#ifndef SMS_THREAD_H
+#define SMS_THREAD_H
+
+#include <stddef.h>
+#include <time.h>
+#include "mongoose.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define SMS_PEER_SIZE           64
+#define SMS_PREVIEW_CHARS       60      /* 预览最多保留的字符数 (UTF-8) */
+#define SMS_THREADS_MAX_LIMIT   200
+
+/**
+ * @brief 号码规范化: 去掉空格/横线/括号，去掉 +86/0086/86 国家码
+ * 非数字的服务号 (如 "BANK") 原样保留
+ */
+void sms_peer_normalize(const char *addr, char *out, size_t size);
+
+/**
+ * @brief 生成更新会话索引的 SQL，追加到插入短信的同一事务中
+ * @param outgoing 1 表示发出的短信 (不计未读)
+ * @return 写入的长度, -1 缓冲区不足
+ */
+int sms_thread_update_sql(char *buf, size_t size, const char *peer, const char *addr,
+                          const char *content, time_t timestamp, int outgoing);
+
+/**
+ * @brief 创建删除触发器; 旧数据库首次升级时回填 peer 并重建索引
+ */
+void sms_thread_init(void);
+
+/* GET /api/sms/threads?limit=&before_ts= - 按最后一条时间倒序列出会话 */
+void handle_sms_threads(struct mg_connection *c, struct mg_http_message *hm);
+
+/* POST /api/sms/threads/read {"peer":"..."} - 会话标记为已读 (peer 为空则全部已读) */
+void handle_sms_thread_read(struct mg_connection *c, struct mg_http_message *hm);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* SMS_THREAD_H */
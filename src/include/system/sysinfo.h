@@ -54,6 +54,17 @@ typedef struct {
  */
 int get_system_info(SystemInfo *info);
 
+/**
+ * @brief 按刷新频率分组读取系统信息 (只覆盖本组字段)
+ *
+ * static: uname、序列号等启动后不变的字段
+ * slow:   内存、温度、电池、WiFi 名称、CPU 使用率
+ * modem:  卡槽、信号、网络模式/类型、QoS、飞行模式、SIM 身份
+ */
+void sysinfo_read_static(SystemInfo *info);
+void sysinfo_read_slow(SystemInfo *info);
+void sysinfo_read_modem(SystemInfo *info);
+
 /**
  * @brief 获取系统运行时间
  * @return 运行时间(秒), -1 失败
@@ -0,0 +1,79 @@
+/**
+ * @file thermal.h
+ * @brief 温度传感器读取与过热保护
+ *
+ * 启动时枚举 /sys/class/thermal/thermal_zone* 并保持 temp 文件打开，
+ * 之后每次读取只需 pread，不再 fork sh/cat/awk。
+ * 过热保护: 最高温度达到 thermal_limit 时停止充电，
+ * 降到 thermal_resume 以下后只恢复由保护自身关闭的充电。
+ */
+
+#ifndef THERMAL_H
+#define THERMAL_H
+
+#include "mongoose.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define THERMAL_MAX_ZONES       16
+#define THERMAL_WATCH_SECS      10      /* 过热保护检查间隔 */
+#define THERMAL_DEFAULT_HYST    5       /* 未配置恢复温度时的回差 (摄氏度) */
+
+/* 单个温区 */
+typedef struct {
+    int index;              /* thermal_zoneN 的 N */
+    char type[32];          /* 温区类型 (如 soc-thermal) */
+    int temp_mc;            /* 最近一次读数 (毫摄氏度) */
+    int valid;              /* 最近一次读取是否成功 */
+} ThermalZone;
+
+/**
+ * @brief 枚举温区并打开文件，按配置启动过热保护
+ */
+void thermal_init(void);
+
+/**
+ * @brief 重新读取所有温区
+ * @return 读取成功的温区数
+ */
+int thermal_refresh(void);
+
+/**
+ * @brief 复制最近一次读数
+ * @return 温区数量
+ */
+int thermal_get_zones(ThermalZone *out, int max);
+
+/**
+ * @brief 重新读取并返回平均温度 (摄氏度)
+ * @return 平均温度, -1 表示没有可用温区
+ */
+double thermal_get_average(void);
+
+/**
+ * @brief 最近一次读数中的最高温度 (摄氏度)
+ * @return 最高温度, -1 表示没有可用温区
+ */
+double thermal_get_max(void);
+
+/**
+ * @brief 过热保护是否正在阻止充电
+ */
+int thermal_charging_inhibited(void);
+
+/**
+ * @brief 充电开关被手动修改 (/api/charge/on|off) 时调用
+ * 过热解除后不再恢复保护前的开关状态
+ */
+void thermal_charging_overridden(void);
+
+/* GET/POST /api/thermal - 各温区温度和过热保护配置 */
+void handle_thermal(struct mg_connection *c, struct mg_http_message *hm);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* THERMAL_H */
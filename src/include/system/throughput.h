@@ -0,0 +1,70 @@
+/**
+ * @file throughput.h
+ * @brief 实时网速监测
+ *
+ * 以 250ms~1s 间隔读取 sipa_eth0 字节计数，瞬时速率写入无锁环形缓冲，
+ * 同时计算 EWMA 平滑速率和最近 60 秒峰值，每秒通过推送通道发送一帧。
+ * 只在有推送订阅或最近有 HTTP 查询时采样，无人观看时不运行定时器。
+ */
+
+#ifndef THROUGHPUT_H
+#define THROUGHPUT_H
+
+#include <stdint.h>
+#include <glib.h>
+#include "mongoose.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define THROUGHPUT_RING_SIZE      256     /* 2 的幂 */
+#define THROUGHPUT_DEFAULT_MS     500
+#define THROUGHPUT_MIN_MS         250
+#define THROUGHPUT_MAX_MS         1000
+#define THROUGHPUT_PEAK_WINDOW_MS 60000
+
+/* 环形缓冲中的一个采样 */
+typedef struct {
+    gint64 time_ms;         /* Unix 毫秒 */
+    uint32_t rx_rate;       /* 字节/秒 */
+    uint32_t tx_rate;
+} ThroughputSample;
+
+/* 当前速率汇总 */
+typedef struct {
+    gint64 time_ms;
+    uint32_t rx_rate;       /* 最近一次采样的瞬时速率 */
+    uint32_t tx_rate;
+    uint32_t rx_avg;        /* EWMA 平滑速率 */
+    uint32_t tx_avg;
+    uint32_t rx_peak;       /* 峰值窗口内最大瞬时速率 */
+    uint32_t tx_peak;
+    int interval_ms;
+    int active;
+} ThroughputStatus;
+
+/**
+ * @brief 初始化 (只注册推送订阅回调，不启动采样)
+ */
+void throughput_init(void);
+
+/**
+ * @brief 获取当前速率，并续约 HTTP 租期
+ */
+void throughput_get_status(ThroughputStatus *st);
+
+/**
+ * @brief 复制最近的采样 (时间升序)
+ * @return 复制的数量
+ */
+int throughput_history(ThroughputSample *out, int max);
+
+/* GET /api/traffic/throughput?samples=N - 当前网速和最近采样 */
+void handle_traffic_throughput(struct mg_connection *c, struct mg_http_message *hm);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* THROUGHPUT_H */
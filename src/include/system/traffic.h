@@ -13,6 +13,25 @@ extern "C" {
 #endif
 
 void init_traffic(void);
+
+/**
+ * @brief 获取 sipa_eth0 累计流量 (读取内核计数器，线程安全)
+ * @param rx 输出: 累计接收字节
+ * @param tx 输出: 累计发送字节
+ */
+void traffic_get_totals(long long *rx, long long *tx);
+
+/**
+ * @brief 立即把累计流量和流量历史写入存储 (退出/重启前调用)
+ */
+void traffic_flush(void);
+
+/**
+ * @brief 飞行模式被流量控制以外的途径修改后调用
+ * 丢弃缓存的执行状态并立即重新检查，超限时重新断网
+ */
+void traffic_quota_invalidate(void);
+
 void handle_get_traffic_total(struct mg_connection *c, struct mg_http_message *hm);
 void handle_get_traffic_config(struct mg_connection *c, struct mg_http_message *hm);
 void handle_set_traffic_limit(struct mg_connection *c, struct mg_http_message *hm);
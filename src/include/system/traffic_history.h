@@ -0,0 +1,47 @@
+/**
+ * @file traffic_history.h
+ * @brief 流量历史时间序列存储 (RRD 风格分级汇总)
+ *
+ * 每秒采样一次累计流量，增量同时累加到 秒/分/时/日/月 五级环形桶中。
+ * 秒级只保存在内存；其余各级存放在一个固定大小的文件镜像里，
+ * 只把修改过的页按固定间隔写回，限制闪存写入量。
+ */
+
+#ifndef TRAFFIC_HISTORY_H
+#define TRAFFIC_HISTORY_H
+
+#include "mongoose.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define TRAFFIC_HISTORY_FILE           "traffic_history.dat"
+#define TRAFFIC_HISTORY_FLUSH_DEFAULT  10     /* 默认写回间隔 (分钟) */
+#define TRAFFIC_HISTORY_MAX_POINTS     1500   /* 单次查询最多返回的点数 */
+
+/**
+ * @brief 加载历史文件并启动每秒采样 (依赖 init_traffic 已初始化计数器)
+ * @return 0成功, -1失败 (仍可在内存中记录)
+ */
+int traffic_history_init(void);
+
+/**
+ * @brief 把修改过的页写回文件
+ * @return 写回的页数, -1失败
+ */
+int traffic_history_flush(void);
+
+/**
+ * @brief 清空所有历史桶
+ */
+void traffic_history_reset(void);
+
+/* GET /api/traffic/history?from=&to=&step= - 按时间范围查询流量 */
+void handle_traffic_history(struct mg_connection *c, struct mg_http_message *hm);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* TRAFFIC_HISTORY_H */
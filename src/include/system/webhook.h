@@ -0,0 +1,78 @@
+/**
+ * @file webhook.h
+ * @brief Webhook 异步投递队列
+ *
+ * 使用 mongoose 自带的 HTTP 客户端在主循环内投递，不再 fork curl。
+ * 每个任务先写入磁盘队列 (webhook_spool/<id>.job)，投递成功或放弃后删除，
+ * 重启后继续投递。并发数有上限，失败按指数退避重试，
+ * 同一端点的连接在响应后保持一段时间供后续任务复用。
+ */
+
+#ifndef WEBHOOK_H
+#define WEBHOOK_H
+
+#include <stddef.h>
+#include <time.h>
+#include "mongoose.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define WEBHOOK_SPOOL_DIR      "webhook_spool"
+#define WEBHOOK_MAX_QUEUE      100      /* 队列满时丢弃最旧的任务 */
+#define WEBHOOK_MAX_INFLIGHT   2        /* 同时进行的请求数 */
+#define WEBHOOK_MAX_ATTEMPTS   8
+#define WEBHOOK_BACKOFF_BASE   5        /* 首次重试延迟 (秒)，之后每次翻倍 */
+#define WEBHOOK_BACKOFF_MAX    1800
+#define WEBHOOK_TIMEOUT_SECS   20       /* 单次请求超时 */
+#define WEBHOOK_IDLE_SECS      30       /* 空闲连接保持时间 */
+
+/* 投递统计 */
+typedef struct {
+    int queued;                 /* 等待投递 (含等待重试) */
+    int inflight;
+    int idle_conns;
+    unsigned long delivered;
+    unsigned long failed;       /* 放弃的任务 */
+    unsigned long retries;
+    unsigned long dropped;      /* 队列满被丢弃 */
+    int last_status;            /* 最近一次 HTTP 状态码, 0 表示网络错误 */
+    char last_error[128];
+    int last_latency_ms;
+    time_t last_success;
+} WebhookStats;
+
+/**
+ * @brief 载入磁盘队列 (可在 webhook_start 之前调用入队)
+ */
+void webhook_init(void);
+
+/**
+ * @brief 绑定事件管理器并开始投递
+ */
+void webhook_start(struct mg_mgr *mgr);
+
+/**
+ * @brief 加入投递队列
+ * @param url     http:// 或 https:// 地址
+ * @param headers 额外请求头, 每行 "Name: value"，可为 NULL
+ * @param body    请求体
+ * @param len     请求体长度
+ * @return 任务 ID, -1 失败
+ */
+long long webhook_enqueue(const char *url, const char *headers, const char *body, size_t len);
+
+/**
+ * @brief 获取投递统计
+ */
+void webhook_get_stats(WebhookStats *out);
+
+/* GET /api/sms/webhook/status - 投递队列状态 */
+void handle_webhook_status(struct mg_connection *c, struct mg_http_message *hm);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* WEBHOOK_H */
@@ -0,0 +1,90 @@
+/**
+ * @file webhook_template.h
+ * @brief Webhook 请求体模板 (预编译)
+ *
+ * 保存配置时把模板编译成片段列表 (字面量 / 变量 + 转义方式)，
+ * 发送时单遍线性渲染到输出缓冲区，不再对每个占位符反复复制整个 body。
+ *
+ * 语法:
+ *   #{sender}  #{content}  #{time}      使用默认转义
+ *   #{content|json}  #{content|url}  #{content|form}  #{content|raw}
+ * 默认转义由 Content-Type 决定: JSON (含未指定) -> json，
+ * application/x-www-form-urlencoded -> form，其他 -> raw。
+ * 未知变量按原样输出。
+ */
+
+#ifndef WEBHOOK_TEMPLATE_H
+#define WEBHOOK_TEMPLATE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define TPL_MAX_SEGMENTS  64
+
+/* 转义方式 */
+typedef enum {
+    TPL_ESC_RAW = 0,
+    TPL_ESC_JSON,           /* JSON 字符串内容 (不含引号) */
+    TPL_ESC_URL,            /* 百分号编码，空格为 %20 */
+    TPL_ESC_FORM            /* 表单编码，空格为 + */
+} TplEscape;
+
+/* 模板变量 */
+typedef enum {
+    TPL_VAR_SENDER = 0,
+    TPL_VAR_CONTENT,
+    TPL_VAR_TIME,
+    TPL_VAR_COUNT,
+    TPL_LITERAL = 0xff
+} TplVar;
+
+/* 一个片段: 字面量指向 src 中的 [off, off+len) */
+typedef struct {
+    uint8_t var;            /* TplVar */
+    uint8_t escape;         /* TplEscape */
+    uint16_t len;
+    uint32_t off;
+} TplSegment;
+
+/* 编译后的模板 */
+typedef struct {
+    char *src;              /* 模板原文副本 */
+    int count;
+    TplSegment segs[TPL_MAX_SEGMENTS];
+} WebhookTemplate;
+
+/**
+ * @brief 根据请求头推断默认转义方式
+ * @param headers 用户配置的请求头 (每行 "Name: value")，可为 NULL
+ */
+TplEscape tpl_default_escape(const char *headers);
+
+/**
+ * @brief 编译模板 (会先释放 tpl 中旧的内容)
+ * @return 0 成功, -1 片段过多 (超出部分按字面量合并)
+ */
+int tpl_compile(WebhookTemplate *tpl, const char *src, TplEscape def);
+
+/**
+ * @brief 释放模板
+ */
+void tpl_free(WebhookTemplate *tpl);
+
+/**
+ * @brief 渲染模板
+ * @param values 按 TplVar 索引的变量值, NULL 视为空串
+ * @param out 输出缓冲区 (总是以 '\0' 结尾)
+ * @return 输出长度, -1 表示缓冲区不足 (输出被截断)
+ */
+int tpl_render(const WebhookTemplate *tpl, const char *const values[TPL_VAR_COUNT],
+               char *out, size_t size);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* WEBHOOK_TEMPLATE_H */
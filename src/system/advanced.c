@@ -15,6 +15,8 @@
 #include "http_utils.h"
 #include "ofono.h"
 #include "json_builder.h"
+#include "radio_job.h"
+#include "cell_sampler.h"
 
 /* 频段映射结构 */
 typedef struct {
@@ -150,6 +152,53 @@ void handle_get_bands(struct mg_connection *c, struct mg_http_message *hm) {
 }
 
 
+/* ==================== 射频重配置序列 ==================== */
+
+#define RADIO_CMD_TIMEOUT_MS  10000  /* SFUN 开关协议栈的命令超时 */
+#define RADIO_ON_WAIT_MS      5000   /* 等待射频恢复 (+CFUN: 1) 的上限 */
+
+/* 关闭协议栈 */
+#define STEP_RADIO_OFF    {"AT+SFUN=5", NULL, RADIO_CMD_TIMEOUT_MS, NULL, NULL, 0, 0}
+/* 配置命令 (锁频/锁小区) */
+#define STEP_CONFIG(cmd)  {(cmd), NULL, 0, NULL, NULL, 0, 0}
+/* 打开协议栈并等待射频恢复，前序失败也要执行 */
+#define STEP_RADIO_ON     {"AT+SFUN=4", NULL, RADIO_CMD_TIMEOUT_MS, "AT+CFUN?", "+CFUN: 1", \
+                           RADIO_ON_WAIT_MS, AT_STEP_ALWAYS}
+/* 重新激活数据连接 */
+#define STEP_PDP_ACTIVATE {"AT+CGACT=0,1", NULL, 0, NULL, NULL, 0, AT_STEP_ALWAYS | AT_STEP_OPTIONAL}
+
+/* 提交重配置任务，立即返回任务 ID */
+static void submit_radio_job(struct mg_connection *c, const char *name, const AtStep *steps,
+                             int count, const char *ok_msg, int wrap_data) {
+    int job_id = radio_job_start(name, ok_msg, steps, count);
+
+    if (job_id == RADIO_JOB_BUSY) {
+        mg_http_reply(c, 409, HTTP_CORS_HEADERS,
+                      "{\"error\":\"射频重配置进行中\",\"job_id\":%d}", radio_job_current_id());
+        return;
+    }
+    if (job_id < 0) {
+        HTTP_ERROR(c, 500, "提交任务失败");
+        return;
+    }
+
+    JsonBuilder *j = json_new();
+    json_obj_open(j);
+    if (wrap_data) {
+        json_add_int(j, "Code", 0);
+        json_add_str(j, "Error", "");
+        json_key_obj_open(j, "Data");
+    }
+    json_add_bool(j, "success", 1);
+    json_add_str(j, "message", "任务已提交");
+    json_add_int(j, "job_id", job_id);
+    if (wrap_data) {
+        json_obj_close(j);
+    }
+    json_obj_close(j);
+    HTTP_OK_FREE(c, json_finish(j));
+}
+
 /* 查找频段映射 */
 static const BandMapping *find_band(const char *name) {
     for (int i = 0; band_map[i].name; i++) {
@@ -215,56 +264,29 @@ void handle_lock_bands(struct mg_connection *c, struct mg_http_message *hm) {
 
     printf("计算结果: 4G TDD=%d, 4G FDD=%d, 5G FDD=%d, 5G TDD=%d\n", tdd4G, fdd4G, fdd5G, tdd5G);
 
-    char *result = NULL;
-    char cmd[128];
-
-    /* 执行命令序列 */
-    /* 1. 关闭设备 */
-    if (execute_at("AT+SFUN=5", &result) != 0) {
-        HTTP_ERROR(c, 500, "关闭设备失败");
-        if (result) g_free(result);
-        return;
-    }
-    if (result) { g_free(result); result = NULL; }
-    usleep(300000);
-
-    /* 2. 解锁5G频段 */
-    execute_at("AT+SPLBAND=2,0,0,0,0", &result);
-    if (result) { g_free(result); result = NULL; }
-    usleep(300000);
+    char cmd4g[64], cmd5g[64];
+    AtStep steps[RADIO_JOB_MAX_STEPS] = {
+        STEP_RADIO_OFF,
+        STEP_CONFIG("AT+SPLBAND=2,0,0,0,0"),   /* 先解锁5G频段 */
+    };
+    int n = 2;
 
-    /* 3. 锁定4G频段 */
+    /* 锁定4G频段 */
     if (tdd4G != 0 || fdd4G != 0) {
-        snprintf(cmd, sizeof(cmd), "AT+SPLBAND=1,0,%d,0,%d,0", tdd4G, fdd4G);
-        execute_at(cmd, &result);
-        if (result) { g_free(result); result = NULL; }
-        usleep(300000);
+        snprintf(cmd4g, sizeof(cmd4g), "AT+SPLBAND=1,0,%d,0,%d,0", tdd4G, fdd4G);
+        steps[n++] = (AtStep)STEP_CONFIG(cmd4g);
     }
 
-    /* 4. 锁定5G频段 */
+    /* 锁定5G频段 */
     if (fdd5G != 0 || tdd5G != 0) {
-        snprintf(cmd, sizeof(cmd), "AT+SPLBAND=2,%d,0,%d,0", fdd5G, tdd5G);
-        execute_at(cmd, &result);
-        if (result) { g_free(result); result = NULL; }
-        usleep(300000);
+        snprintf(cmd5g, sizeof(cmd5g), "AT+SPLBAND=2,%d,0,%d,0", fdd5G, tdd5G);
+        steps[n++] = (AtStep)STEP_CONFIG(cmd5g);
     }
 
-    /* 5. 开启设备 */
-    execute_at("AT+SFUN=4", &result);
-    if (result) { g_free(result); result = NULL; }
-    usleep(300000);
-
-    /* 6. 激活网络 */
-    execute_at("AT+CGACT=0,1", &result);
-    if (result) g_free(result);
+    steps[n++] = (AtStep)STEP_RADIO_ON;
+    steps[n++] = (AtStep)STEP_PDP_ACTIVATE;
 
-    printf("频段锁定成功\n");
-    JsonBuilder *j = json_new();
-    json_obj_open(j);
-    json_add_bool(j, "success", 1);
-    json_add_str(j, "message", "频段锁定成功");
-    json_obj_close(j);
-    HTTP_OK_FREE(c, json_finish(j));
+    submit_radio_job(c, "lock_bands", steps, n, "频段锁定成功", 0);
 }
 
 
@@ -273,106 +295,16 @@ void handle_unlock_bands(struct mg_connection *c, struct mg_http_message *hm) {
     HTTP_CHECK_POST(c, hm);
 
     printf("开始解锁所有频段...\n");
-    char *result = NULL;
-
-    /* 1. 关闭设备 */
-    if (execute_at("AT+SFUN=5", &result) != 0) {
-        HTTP_ERROR(c, 500, "关闭设备失败");
-        if (result) g_free(result);
-        return;
-    }
-    if (result) { g_free(result); result = NULL; }
-    usleep(300000);
-
-    /* 2. 解锁4G频段 */
-    execute_at("AT+SPLBAND=1,0,0,0,0,0", &result);
-    if (result) { g_free(result); result = NULL; }
-    usleep(300000);
 
-    /* 3. 解锁5G频段 */
-    execute_at("AT+SPLBAND=2,0,0,0,0", &result);
-    if (result) { g_free(result); result = NULL; }
-    usleep(300000);
+    static const AtStep steps[] = {
+        STEP_RADIO_OFF,
+        STEP_CONFIG("AT+SPLBAND=1,0,0,0,0,0"),  /* 解锁4G频段 */
+        STEP_CONFIG("AT+SPLBAND=2,0,0,0,0"),    /* 解锁5G频段 */
+        STEP_RADIO_ON,
+        STEP_PDP_ACTIVATE,
+    };
 
-    /* 4. 开启设备 */
-    execute_at("AT+SFUN=4", &result);
-    if (result) { g_free(result); result = NULL; }
-    usleep(300000);
-
-    /* 5. 激活网络 */
-    execute_at("AT+CGACT=0,1", &result);
-    if (result) g_free(result);
-
-    printf("频段解锁成功\n");
-    JsonBuilder *j = json_new();
-    json_obj_open(j);
-    json_add_bool(j, "success", 1);
-    json_add_str(j, "message", "频段解锁成功");
-    json_obj_close(j);
-    HTTP_OK_FREE(c, json_finish(j));
-}
-
-/* 解析小区数据 (复用 handlers.c 中的函数) */
-extern int parse_cell_to_vec(const char *input, char data[64][16][32]);
-
-/**
- * 根据 NR ARFCN 推算 5G 频段
- * 参考 3GPP TS 38.104
- * @param arfcn NR 绝对频点号
- * @return 频段号字符串（不含N前缀），如 "41", "78"，未知返回空字符串
- */
-static const char* arfcn_to_nr_band(int arfcn) {
-    if (arfcn >= 422000 && arfcn <= 434000) return "1";   /* N1 (2100 MHz FDD) */
-    if (arfcn >= 361000 && arfcn <= 376000) return "3";   /* N3 (1800 MHz FDD) */
-    if (arfcn >= 185000 && arfcn <= 192000) return "8";   /* N8 (900 MHz FDD) */
-    if (arfcn >= 151600 && arfcn <= 160600) return "28";  /* N28 (700 MHz FDD) */
-    if (arfcn >= 499200 && arfcn <= 537999) return "41";  /* N41 (2600 MHz TDD) */
-    if (arfcn >= 620000 && arfcn <= 680000) return "78";  /* N77/N78 (3700 MHz TDD) */
-    if (arfcn >= 693334 && arfcn <= 733333) return "79";  /* N79 (4700 MHz TDD) */
-    return "";
-}
-
-/**
- * 根据 LTE EARFCN 推算 4G 频段
- * 参考 3GPP TS 36.101
- * @param earfcn LTE 绝对频点号
- * @return 频段号字符串（不含B前缀），如 "3", "41"，未知返回空字符串
- */
-static const char* earfcn_to_lte_band(int earfcn) {
-    if (earfcn >= 0 && earfcn <= 599) return "1";         /* B1 (2100 MHz FDD) */
-    if (earfcn >= 1200 && earfcn <= 1949) return "3";     /* B3 (1800 MHz FDD) */
-    if (earfcn >= 2400 && earfcn <= 2649) return "5";     /* B5 (850 MHz FDD) */
-    if (earfcn >= 2750 && earfcn <= 3449) return "7";     /* B7 (2600 MHz FDD) */
-    if (earfcn >= 3450 && earfcn <= 3799) return "8";     /* B8 (900 MHz FDD) */
-    if (earfcn >= 6150 && earfcn <= 6449) return "20";    /* B20 (800 MHz FDD) */
-    if (earfcn >= 9210 && earfcn <= 9659) return "28";    /* B28 (700 MHz FDD) */
-    if (earfcn >= 37750 && earfcn <= 38249) return "38";  /* B38 (2600 MHz TDD) */
-    if (earfcn >= 38250 && earfcn <= 38649) return "39";  /* B39 (1900 MHz TDD) */
-    if (earfcn >= 38650 && earfcn <= 39649) return "40";  /* B40 (2300 MHz TDD) */
-    if (earfcn >= 39650 && earfcn <= 41589) return "41";  /* B41 (2500 MHz TDD) */
-    return "";
-}
-
-/**
- * 判断当前网络是否为 5G
- * 通过 D-Bus 查询 oFono NetworkMonitor 获取网络类型
- * @return 1=5G, 0=4G/其他
- */
-static int is_5g_network(void) {
-    char tech[32] = {0};
-    
-    /* 使用 C 原生 D-Bus 调用获取网络类型 */
-    if (ofono_get_serving_cell_tech(tech, sizeof(tech)) != 0) {
-        printf("D-Bus 查询网络类型失败，默认使用 4G\n");
-        return 0;
-    }
-
-    /* 判断网络类型 - 检查是否为 "nr" */
-    if (strcmp(tech, "nr") == 0) {
-        return 1; /* 5G */
-    }
-    
-    return 0; /* 4G 或其他 */
+    submit_radio_job(c, "unlock_bands", steps, G_N_ELEMENTS(steps), "频段解锁成功", 0);
 }
 
 /* 辅助函数：添加小区对象到JSON Builder */
@@ -394,113 +326,39 @@ static void add_cell_to_json(JsonBuilder *j, const char *rat, const char *band_p
     json_obj_close(j);
 }
 
-/* GET /api/cells - 获取小区信息 */
+/* GET /api/cells - 获取小区信息 (读取采样器快照，不直接访问模组) */
 void handle_get_cells(struct mg_connection *c, struct mg_http_message *hm) {
     HTTP_CHECK_GET(c, hm);
 
-    printf("开始获取小区信息...\n");
-    char *result = NULL;
-    
-    /* 通过 D-Bus 判断网络类型 (与 Go 版本一致) */
-    int is_5g = is_5g_network();
-    printf("检测到%s网络\n", is_5g ? "5G" : "4G");
+    const CellSnapshot *snap = cell_sampler_acquire();
 
     JsonBuilder *j = json_new();
     json_obj_open(j);
     json_add_int(j, "Code", 0);
     json_add_str(j, "Error", "");
+    json_add_long(j, "generation", snap ? (long long)snap->generation : 0);
+    json_add_long(j, "timestamp", snap ? snap->timestamp : 0);
     json_arr_open(j, "Data");
-    
-    int cell_count = 0;
-
-    if (is_5g) {
-        /* 5G 主小区 */
-        if (execute_at("AT+SPENGMD=0,14,1", &result) == 0 && result) {
-            char data[64][16][32] = {{{0}}};
-            int rows = parse_cell_to_vec(result, data);
-            if (rows > 15) {
-                add_cell_to_json(j, "5G", "N", data[0][0],
-                    atoi(data[1][0]), atoi(data[2][0]),
-                    atof(data[3][0]) / 100.0, atof(data[4][0]) / 100.0,
-                    atof(data[15][0]) / 100.0, 1);
-                cell_count++;
-            }
-            g_free(result);
-            result = NULL;
-        }
 
-        /* 5G 邻小区 */
-        if (execute_at("AT+SPENGMD=0,14,2", &result) == 0 && result) {
-            char data[64][16][32] = {{{0}}};
-            int rows = parse_cell_to_vec(result, data);
-            if (rows > 5) {
-                int col_count = 0;
-                for (int i = 0; i < 16 && data[0][i][0]; i++) col_count++;
-                for (int i = 0; i < col_count; i++) {
-                    int arfcn = atoi(data[1][i]);
-                    int pci = atoi(data[2][i]);
-                    if (arfcn == 0 || pci == 0) continue;
-                    
-                    /* 频段处理：如果为空或"0"，通过 ARFCN 推算 */
-                    const char *band_str = data[0][i];
-                    if (strlen(band_str) == 0 || strcmp(band_str, "0") == 0) {
-                        band_str = arfcn_to_nr_band(arfcn);
-                    }
-                    
-                    add_cell_to_json(j, "5G", "N", band_str,
-                        arfcn, pci,
-                        atof(data[3][i]) / 100.0, atof(data[4][i]) / 100.0,
-                        atof(data[5][i]) / 100.0, 0);
-                    cell_count++;
-                }
-            }
-            g_free(result);
-        }
-    } else {
-        /* 4G 主小区 */
-        if (execute_at("AT+SPENGMD=0,6,0", &result) == 0 && result) {
-            char data[64][16][32] = {{{0}}};
-            int rows = parse_cell_to_vec(result, data);
-            if (rows > 33) {
-                add_cell_to_json(j, "4G", "B", data[0][0],
-                    atoi(data[1][0]), atoi(data[2][0]),
-                    atof(data[3][0]) / 100.0, atof(data[4][0]) / 100.0,
-                    atof(data[33][0]) / 100.0, 1);
-                cell_count++;
-            }
-            g_free(result);
-            result = NULL;
-        }
+    if (snap) {
+        const char *rat = snap->is_5g ? "5G" : "4G";
+        const char *prefix = snap->is_5g ? "N" : "B";
+        const CellMeasure *m = &snap->serving;
 
-        /* 4G 邻小区 */
-        if (execute_at("AT+SPENGMD=0,6,6", &result) == 0 && result) {
-            char data[64][16][32] = {{{0}}};
-            int rows = parse_cell_to_vec(result, data);
-            for (int i = 0; i < rows; i++) {
-                int arfcn = atoi(data[i][0]);
-                int pci = atoi(data[i][1]);
-                if (arfcn == 0 || pci == 0) continue;
-                
-                /* 频段处理：如果为空或"0"，通过 EARFCN 推算 */
-                const char *band = data[i][12];
-                if (strlen(band) == 0 || strcmp(band, "0") == 0) {
-                    band = earfcn_to_lte_band(arfcn);
-                    if (strlen(band) == 0) band = "0";  /* 未知频段默认显示0 */
-                }
-                
-                add_cell_to_json(j, "4G", "B", band,
-                    arfcn, pci,
-                    atof(data[i][2]) / 100.0, atof(data[i][3]) / 100.0,
-                    atof(data[i][6]) / 100.0, 0);
-                cell_count++;
-            }
-            g_free(result);
+        if (snap->has_serving) {
+            add_cell_to_json(j, rat, prefix, m->band, m->arfcn, m->pci,
+                             m->rsrp, m->rsrq, m->sinr, 1);
+        }
+        for (int i = 0; i < snap->neighbor_count; i++) {
+            m = &snap->neighbors[i];
+            add_cell_to_json(j, rat, prefix, m->band, m->arfcn, m->pci,
+                             m->rsrp, m->rsrq, m->sinr, 0);
         }
     }
 
     json_arr_close(j);
     json_obj_close(j);
-    printf("小区信息获取完成，共 %d 个小区\n", cell_count);
+    cell_snapshot_release(snap);
 
     HTTP_OK_FREE(c, json_finish(j));
 }
@@ -530,50 +388,19 @@ void handle_lock_cell(struct mg_connection *c, struct mg_http_message *hm) {
         band = "16"; /* 5G */
     }
 
-    char *result = NULL;
     char cmd[128];
-
-    /* 1. 关闭射频 */
-    execute_at("AT+SFUN=5", &result);
-    if (result) { g_free(result); result = NULL; }
-    usleep(300000);
-
-    /* 2. 解锁4G */
-    execute_at("AT+SPFORCEFRQ=12,0", &result);
-    if (result) { g_free(result); result = NULL; }
-    usleep(300000);
-
-    /* 3. 解锁5G */
-    execute_at("AT+SPFORCEFRQ=16,0", &result);
-    if (result) { g_free(result); result = NULL; }
-    usleep(300000);
-
-    /* 4. 锁定小区 */
     snprintf(cmd, sizeof(cmd), "AT+SPFORCEFRQ=%s,2,%s,%s", band, arfcn, pci);
-    execute_at(cmd, &result);
-    if (result) { g_free(result); result = NULL; }
-    usleep(300000);
-
-    /* 5. 打开射频 */
-    execute_at("AT+SFUN=4", &result);
-    if (result) { g_free(result); result = NULL; }
-    usleep(300000);
 
-    /* 6. 激活网络 */
-    execute_at("AT+CGACT=0,1", &result);
-    if (result) g_free(result);
+    AtStep steps[] = {
+        STEP_RADIO_OFF,
+        STEP_CONFIG("AT+SPFORCEFRQ=12,0"),  /* 解锁4G */
+        STEP_CONFIG("AT+SPFORCEFRQ=16,0"),  /* 解锁5G */
+        STEP_CONFIG(cmd),                   /* 锁定小区 */
+        STEP_RADIO_ON,
+        STEP_PDP_ACTIVATE,
+    };
 
-    printf("小区锁定成功\n");
-    JsonBuilder *j = json_new();
-    json_obj_open(j);
-    json_add_int(j, "Code", 0);
-    json_add_str(j, "Error", "");
-    json_key_obj_open(j, "Data");
-    json_add_bool(j, "success", 1);
-    json_add_str(j, "message", "小区锁定成功");
-    json_obj_close(j);
-    json_obj_close(j);
-    HTTP_OK_FREE(c, json_finish(j));
+    submit_radio_job(c, "lock_cell", steps, G_N_ELEMENTS(steps), "小区锁定成功", 1);
 }
 
 /* POST /api/unlock_cell - 解锁小区 */
@@ -581,41 +408,14 @@ void handle_unlock_cell(struct mg_connection *c, struct mg_http_message *hm) {
     HTTP_CHECK_POST(c, hm);
 
     printf("开始解锁小区...\n");
-    char *result = NULL;
-
-    /* 1. 关闭射频 */
-    execute_at("AT+SFUN=5", &result);
-    if (result) { g_free(result); result = NULL; }
-    usleep(300000);
 
-    /* 2. 解锁4G */
-    execute_at("AT+SPFORCEFRQ=12,0", &result);
-    if (result) { g_free(result); result = NULL; }
-    usleep(300000);
+    static const AtStep steps[] = {
+        STEP_RADIO_OFF,
+        STEP_CONFIG("AT+SPFORCEFRQ=12,0"),  /* 解锁4G */
+        STEP_CONFIG("AT+SPFORCEFRQ=16,0"),  /* 解锁5G */
+        STEP_RADIO_ON,
+        STEP_PDP_ACTIVATE,
+    };
 
-    /* 3. 解锁5G */
-    execute_at("AT+SPFORCEFRQ=16,0", &result);
-    if (result) { g_free(result); result = NULL; }
-    usleep(300000);
-
-    /* 4. 打开射频 */
-    execute_at("AT+SFUN=4", &result);
-    if (result) { g_free(result); result = NULL; }
-    usleep(300000);
-
-    /* 5. 激活网络 */
-    execute_at("AT+CGACT=0,1", &result);
-    if (result) g_free(result);
-
-    printf("小区解锁成功\n");
-    JsonBuilder *j = json_new();
-    json_obj_open(j);
-    json_add_int(j, "Code", 0);
-    json_add_str(j, "Error", "");
-    json_key_obj_open(j, "Data");
-    json_add_bool(j, "success", 1);
-    json_add_str(j, "message", "小区解锁成功");
-    json_obj_close(j);
-    json_obj_close(j);
-    HTTP_OK_FREE(c, json_finish(j));
+    submit_radio_job(c, "unlock_cell", steps, G_N_ELEMENTS(steps), "小区解锁成功", 1);
 }
@@ -11,6 +11,7 @@
 #include "airplane.h"
 #include "sysinfo.h"
 #include "ofono.h"
+#include "dbus_core.h"
 
 int send_at(const char *cmd, char **result) {
     GDBusConnection *conn = NULL;
@@ -22,6 +23,9 @@ int send_at(const char *cmd, char **result) {
     if (!cmd || !result) return -1;
     *result = NULL;
 
+    /* 锁频/锁小区任务执行中，不插入其他命令 */
+    if (at_channel_reserved()) return -1;
+
     /* 获取当前 RIL 路径 */
     if (get_current_slot(slot, ril_path) != 0 || strcmp(ril_path, "unknown") == 0) {
         strcpy(ril_path, "/ril_0");  /* 默认使用 ril_0 */
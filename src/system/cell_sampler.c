@@ -0,0 +1,418 @@
+/**
+ * @file cell_sampler.c
+ * @brief 小区测量后台采样器实现
+ *
+ * 多个页面/标签同时轮询时共享同一份快照，模组查询次数只取决于采样间隔。
+ * 射频重配置任务执行期间暂停采样。
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <glib.h>
+#include "mongoose.h"
+#include "cell_sampler.h"
+#include "dbus_core.h"
+#include "ofono.h"
+#include "database.h"
+#include "radio_job.h"
+#include "engmd_table.h"
+#include "http_utils.h"
+#include "json_builder.h"
+
+#define CELL_LEASE_SECS       30   /* HTTP 读取后保持采样的时长 */
+#define CELL_MAX_SUBSCRIBERS  8
+
+/* 订阅者 */
+typedef struct {
+    int id;
+    int interval_ms;            /* 0 表示被动订阅 */
+    cell_snapshot_callback_t callback;
+    void *user_data;
+} CellSubscriber;
+
+static CellSnapshot *g_snapshot = NULL;
+static gint64 g_snapshot_mono_us = 0;   /* 当前快照的采样时刻 (单调时钟) */
+static guint64 g_generation = 0;
+static pthread_mutex_t g_snap_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+static CellSubscriber g_subs[CELL_MAX_SUBSCRIBERS];
+static int g_next_sub_id = 1;
+static gint64 g_lease_until_us = 0;
+static int g_interval_ms = 0;           /* 0 表示尚未从配置加载 */
+static guint g_timer_id = 0;
+static int g_timer_interval = 0;
+
+/* ==================== 频段推算 ==================== */
+
+/**
+ * 根据 NR ARFCN 推算 5G 频段
+ * 参考 3GPP TS 38.104
+ * @param arfcn NR 绝对频点号
+ * @return 频段号字符串（不含N前缀），如 "41", "78"，未知返回空字符串
+ */
+static const char* arfcn_to_nr_band(int arfcn) {
+    if (arfcn >= 422000 && arfcn <= 434000) return "1";   /* N1 (2100 MHz FDD) */
+    if (arfcn >= 361000 && arfcn <= 376000) return "3";   /* N3 (1800 MHz FDD) */
+    if (arfcn >= 185000 && arfcn <= 192000) return "8";   /* N8 (900 MHz FDD) */
+    if (arfcn >= 151600 && arfcn <= 160600) return "28";  /* N28 (700 MHz FDD) */
+    if (arfcn >= 499200 && arfcn <= 537999) return "41";  /* N41 (2600 MHz TDD) */
+    if (arfcn >= 620000 && arfcn <= 680000) return "78";  /* N77/N78 (3700 MHz TDD) */
+    if (arfcn >= 693334 && arfcn <= 733333) return "79";  /* N79 (4700 MHz TDD) */
+    return "";
+}
+
+/**
+ * 根据 LTE EARFCN 推算 4G 频段
+ * 参考 3GPP TS 36.101
+ * @param earfcn LTE 绝对频点号
+ * @return 频段号字符串（不含B前缀），如 "3", "41"，未知返回空字符串
+ */
+static const char* earfcn_to_lte_band(int earfcn) {
+    if (earfcn >= 0 && earfcn <= 599) return "1";         /* B1 (2100 MHz FDD) */
+    if (earfcn >= 1200 && earfcn <= 1949) return "3";     /* B3 (1800 MHz FDD) */
+    if (earfcn >= 2400 && earfcn <= 2649) return "5";     /* B5 (850 MHz FDD) */
+    if (earfcn >= 2750 && earfcn <= 3449) return "7";     /* B7 (2600 MHz FDD) */
+    if (earfcn >= 3450 && earfcn <= 3799) return "8";     /* B8 (900 MHz FDD) */
+    if (earfcn >= 6150 && earfcn <= 6449) return "20";    /* B20 (800 MHz FDD) */
+    if (earfcn >= 9210 && earfcn <= 9659) return "28";    /* B28 (700 MHz FDD) */
+    if (earfcn >= 37750 && earfcn <= 38249) return "38";  /* B38 (2600 MHz TDD) */
+    if (earfcn >= 38250 && earfcn <= 38649) return "39";  /* B39 (1900 MHz TDD) */
+    if (earfcn >= 38650 && earfcn <= 39649) return "40";  /* B40 (2300 MHz TDD) */
+    if (earfcn >= 39650 && earfcn <= 41589) return "41";  /* B41 (2500 MHz TDD) */
+    return "";
+}
+
+/* ==================== 采样 ==================== */
+
+/* 填充服务小区: 工程模式按行排列，每行第 0 列 */
+static void fill_serving(CellMeasure *m, const EngmdTable *t, int sinr_row) {
+    engmd_str(t, 0, 0, m->band, sizeof(m->band));
+    m->arfcn = engmd_int(t, 1, 0);
+    m->pci = engmd_int(t, 2, 0);
+    m->rsrp = engmd_fixed(t, 3, 0, 100);
+    m->rsrq = engmd_fixed(t, 4, 0, 100);
+    m->sinr = engmd_fixed(t, sinr_row, 0, 100);
+}
+
+/*
+ * 查询一次 AT+SPENGMD 并解析
+ * @return 行数, -1 命令失败 (模组忙、射频任务占用通道等)
+ */
+static int query_engmd(const char *cmd, EngmdTable *t) {
+    char *result = NULL;
+    int rows = -1;
+
+    if (execute_at(cmd, &result) == 0 && result) {
+        rows = engmd_parse(t, result);
+        if (rows < 0) rows = 0;
+    }
+    g_free(result);
+    return rows;
+}
+
+/* @return 0 成功, -1 查询失败或服务小区响应为空 (本次结果不可用) */
+static int sample_5g(CellSnapshot *s, EngmdTable *t) {
+    int rows;
+
+    /* 5G 主小区 */
+    if ((rows = query_engmd("AT+SPENGMD=0,14,1", t)) <= 0) return -1;
+    if (rows > 15) {
+        fill_serving(&s->serving, t, 15);
+        s->has_serving = 1;
+    }
+
+    /* 5G 邻小区 (按列排列，每列一个小区) */
+    if ((rows = query_engmd("AT+SPENGMD=0,14,2", t)) < 0) return -1;
+    if (rows > 5) {
+        int col_count = 0;
+        while (col_count < engmd_cols(t, 0) && engmd_len(t, 0, col_count) > 0) col_count++;
+        for (int i = 0; i < col_count && s->neighbor_count < CELL_MAX_NEIGHBORS; i++) {
+            CellMeasure *m = &s->neighbors[s->neighbor_count];
+            m->arfcn = engmd_int(t, 1, i);
+            m->pci = engmd_int(t, 2, i);
+            if (m->arfcn == 0 || m->pci == 0) continue;
+
+            /* 频段为空或"0"时通过 ARFCN 推算 */
+            engmd_str(t, 0, i, m->band, sizeof(m->band));
+            if (m->band[0] == '\0' || strcmp(m->band, "0") == 0) {
+                snprintf(m->band, sizeof(m->band), "%s", arfcn_to_nr_band(m->arfcn));
+            }
+            m->rsrp = engmd_fixed(t, 3, i, 100);
+            m->rsrq = engmd_fixed(t, 4, i, 100);
+            m->sinr = engmd_fixed(t, 5, i, 100);
+            s->neighbor_count++;
+        }
+    }
+    return 0;
+}
+
+/* @return 0 成功, -1 查询失败或服务小区响应为空 (本次结果不可用) */
+static int sample_4g(CellSnapshot *s, EngmdTable *t) {
+    int rows;
+
+    /* 4G 主小区 */
+    if ((rows = query_engmd("AT+SPENGMD=0,6,0", t)) <= 0) return -1;
+    if (rows > 33) {
+        fill_serving(&s->serving, t, 33);
+        s->has_serving = 1;
+    }
+
+    /* 4G 邻小区 (按行排列，每行一个小区) */
+    if ((rows = query_engmd("AT+SPENGMD=0,6,6", t)) < 0) return -1;
+    for (int i = 0; i < rows && s->neighbor_count < CELL_MAX_NEIGHBORS; i++) {
+        CellMeasure *m = &s->neighbors[s->neighbor_count];
+        m->arfcn = engmd_int(t, i, 0);
+        m->pci = engmd_int(t, i, 1);
+        if (m->arfcn == 0 || m->pci == 0) continue;
+
+        /* 频段为空或"0"时通过 EARFCN 推算，未知显示 0 */
+        engmd_str(t, i, 12, m->band, sizeof(m->band));
+        if (m->band[0] == '\0' || strcmp(m->band, "0") == 0) {
+            const char *band = earfcn_to_lte_band(m->arfcn);
+            snprintf(m->band, sizeof(m->band), "%s", band[0] ? band : "0");
+        }
+        m->rsrp = engmd_fixed(t, i, 2, 100);
+        m->rsrq = engmd_fixed(t, i, 3, 100);
+        m->sinr = engmd_fixed(t, i, 6, 100);
+        s->neighbor_count++;
+    }
+    return 0;
+}
+
+/* 查询模组并发布新快照 */
+static void sample_and_publish(void) {
+    CellSnapshot *s = g_new0(CellSnapshot, 1);
+    CellSnapshot *old;
+    EngmdTable t;
+    char tech[32] = {0};
+
+    s->ref = 1;
+    s->timestamp = g_get_real_time() / G_USEC_PER_SEC;
+
+    /* 通过 D-Bus 判断网络类型 */
+    if (ofono_get_serving_cell_tech(tech, sizeof(tech)) != 0) {
+        printf("[CellSampler] D-Bus 查询网络类型失败，默认使用 4G\n");
+    }
+    s->is_5g = strcmp(tech, "nr") == 0;
+
+    /* 读取失败时保留上一快照，不发布空结果，也不递增序号 */
+    if ((s->is_5g ? sample_5g(s, &t) : sample_4g(s, &t)) != 0) {
+        printf("[CellSampler] 读取小区测量失败，保留快照 #%llu\n", (unsigned long long)g_generation);
+        g_free(s);
+        return;
+    }
+
+    pthread_mutex_lock(&g_snap_mutex);
+    s->generation = ++g_generation;
+    old = g_snapshot;
+    g_snapshot = s;
+    g_snapshot_mono_us = g_get_monotonic_time();
+    pthread_mutex_unlock(&g_snap_mutex);
+
+    cell_snapshot_release(old);
+
+    printf("[CellSampler] 快照 #%llu: %s, 服务小区=%d, 邻小区=%d\n",
+           (unsigned long long)s->generation, s->is_5g ? "5G" : "4G",
+           s->has_serving, s->neighbor_count);
+
+    for (int i = 0; i < CELL_MAX_SUBSCRIBERS; i++) {
+        if (g_subs[i].id > 0 && g_subs[i].callback) {
+            g_subs[i].callback(s, g_subs[i].user_data);
+        }
+    }
+}
+
+/* ==================== 调度 ==================== */
+
+int cell_sampler_get_interval(void) {
+    if (g_interval_ms == 0) {
+        int v = config_get_int("cell_sample_interval", CELL_SAMPLE_DEFAULT_MS);
+        if (v < CELL_SAMPLE_MIN_MS) v = CELL_SAMPLE_MIN_MS;
+        if (v > CELL_SAMPLE_MAX_MS) v = CELL_SAMPLE_MAX_MS;
+        g_interval_ms = v;
+    }
+    return g_interval_ms;
+}
+
+/* 当前需要的采样间隔: 所有订阅者中最短的，无订阅者返回 0 */
+static int effective_interval(void) {
+    int iv = 0;
+
+    if (g_get_monotonic_time() < g_lease_until_us) {
+        iv = cell_sampler_get_interval();
+    }
+    for (int i = 0; i < CELL_MAX_SUBSCRIBERS; i++) {
+        if (g_subs[i].id > 0 && g_subs[i].interval_ms > 0 && (iv == 0 || g_subs[i].interval_ms < iv)) {
+            iv = g_subs[i].interval_ms;
+        }
+    }
+    return iv;
+}
+
+static gboolean sampler_tick(gpointer user_data);
+
+/* 按当前订阅情况启动/调整/停止定时器 */
+static void reschedule(void) {
+    int iv = effective_interval();
+
+    if (iv == g_timer_interval && (iv == 0 || g_timer_id > 0)) return;
+
+    if (g_timer_id > 0) {
+        g_source_remove(g_timer_id);
+        g_timer_id = 0;
+    }
+    g_timer_interval = iv;
+    if (iv > 0) {
+        g_timer_id = g_timeout_add(iv, sampler_tick, NULL);
+        printf("[CellSampler] 采样间隔 %dms\n", iv);
+    } else {
+        printf("[CellSampler] 无订阅者，停止采样\n");
+    }
+}
+
+static gboolean sampler_tick(gpointer user_data) {
+    (void)user_data;
+
+    if (effective_interval() == 0) {
+        g_timer_id = 0;
+        g_timer_interval = 0;
+        printf("[CellSampler] 无订阅者，停止采样\n");
+        return G_SOURCE_REMOVE;
+    }
+
+    /* 锁频/锁小区期间射频关闭，跳过本次采样 */
+    if (!radio_job_is_running()) {
+        sample_and_publish();
+    }
+
+    /* 订阅变化后间隔可能不同，重建定时器 */
+    if (effective_interval() != g_timer_interval) {
+        g_timer_id = 0;
+        reschedule();
+        return G_SOURCE_REMOVE;
+    }
+    return G_SOURCE_CONTINUE;
+}
+
+/* ==================== 对外接口 ==================== */
+
+const CellSnapshot *cell_sampler_acquire(void) {
+    CellSnapshot *snap;
+    gint64 now = g_get_monotonic_time();
+    int fresh;
+
+    /* HTTP 读取续约租期 */
+    g_lease_until_us = now + (gint64)CELL_LEASE_SECS * G_USEC_PER_SEC;
+    reschedule();
+
+    pthread_mutex_lock(&g_snap_mutex);
+    fresh = g_snapshot && now - g_snapshot_mono_us <= (gint64)g_timer_interval * 2000;
+    pthread_mutex_unlock(&g_snap_mutex);
+
+    /* 首次读取或空闲后重新读取时同步采样，保证返回的数据不过期 */
+    if (!fresh && !radio_job_is_running()) {
+        sample_and_publish();
+    }
+
+    pthread_mutex_lock(&g_snap_mutex);
+    snap = g_snapshot;
+    if (snap) g_atomic_int_inc(&snap->ref);
+    pthread_mutex_unlock(&g_snap_mutex);
+
+    return snap;
+}
+
+void cell_snapshot_release(const CellSnapshot *snap) {
+    CellSnapshot *s = (CellSnapshot *)snap;
+    if (s && g_atomic_int_dec_and_test(&s->ref)) {
+        g_free(s);
+    }
+}
+
+static int add_subscriber(int interval_ms, cell_snapshot_callback_t callback, void *user_data) {
+    for (int i = 0; i < CELL_MAX_SUBSCRIBERS; i++) {
+        if (g_subs[i].id == 0) {
+            g_subs[i].id = g_next_sub_id++;
+            g_subs[i].interval_ms = interval_ms;
+            g_subs[i].callback = callback;
+            g_subs[i].user_data = user_data;
+            reschedule();
+            return g_subs[i].id;
+        }
+    }
+    return -1;
+}
+
+int cell_sampler_subscribe(int interval_ms, cell_snapshot_callback_t callback, void *user_data) {
+    if (interval_ms <= 0) interval_ms = cell_sampler_get_interval();
+    if (interval_ms < CELL_SAMPLE_MIN_MS) interval_ms = CELL_SAMPLE_MIN_MS;
+    return add_subscriber(interval_ms, callback, user_data);
+}
+
+int cell_sampler_observe(cell_snapshot_callback_t callback, void *user_data) {
+    return add_subscriber(0, callback, user_data);
+}
+
+void cell_sampler_unsubscribe(int id) {
+    for (int i = 0; i < CELL_MAX_SUBSCRIBERS; i++) {
+        if (g_subs[i].id == id) {
+            memset(&g_subs[i], 0, sizeof(g_subs[i]));
+            reschedule();
+            return;
+        }
+    }
+}
+
+int cell_sampler_set_interval(int interval_ms) {
+    if (interval_ms < CELL_SAMPLE_MIN_MS || interval_ms > CELL_SAMPLE_MAX_MS) {
+        return -1;
+    }
+    if (config_set_int("cell_sample_interval", interval_ms) != 0) {
+        return -1;
+    }
+    g_interval_ms = interval_ms;
+    reschedule();
+    return 0;
+}
+
+/* GET/POST /api/cell_sampler - 采样器状态与采样间隔 */
+void handle_cell_sampler_config(struct mg_connection *c, struct mg_http_message *hm) {
+    HTTP_HANDLE_OPTIONS(c, hm);
+
+    if (http_is_method(hm, "POST")) {
+        double interval = 0;
+        if (!mg_json_get_num(hm->body, "$.interval_ms", &interval)) {
+            HTTP_ERROR(c, 400, "Missing interval_ms");
+            return;
+        }
+        if (cell_sampler_set_interval((int)interval) != 0) {
+            HTTP_ERROR(c, 400, "interval_ms out of range (1000-60000)");
+            return;
+        }
+    } else if (!http_is_method(hm, "GET")) {
+        http_method_error(c);
+        return;
+    }
+
+    int subscribers = 0, observers = 0;
+    for (int i = 0; i < CELL_MAX_SUBSCRIBERS; i++) {
+        if (g_subs[i].id == 0) continue;
+        if (g_subs[i].interval_ms > 0) subscribers++;
+        else observers++;
+    }
+    gint64 lease_ms = (g_lease_until_us - g_get_monotonic_time()) / 1000;
+
+    JsonBuilder *j = json_new();
+    json_obj_open(j);
+    json_add_int(j, "interval_ms", cell_sampler_get_interval());
+    json_add_bool(j, "active", g_timer_id > 0);
+    json_add_int(j, "current_interval_ms", g_timer_interval);
+    json_add_int(j, "subscribers", subscribers);
+    json_add_int(j, "observers", observers);
+    json_add_long(j, "lease_remaining_ms", lease_ms > 0 ? lease_ms : 0);
+    json_add_long(j, "generation", (long long)g_generation);
+    json_obj_close(j);
+    HTTP_OK_FREE(c, json_finish(j));
+}
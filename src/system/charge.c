@@ -18,6 +18,8 @@
 #include "mongoose.h"
 #include "charge.h"
 #include "database.h"  /* 使用数据库配置函数 */
+#include "thermal.h"
+#include "proc_reader.h"
 #include "http_utils.h"
 #include "json_builder.h"
 
@@ -53,46 +55,40 @@ static battery_change_callback_t battery_callback = NULL;
 
 
 
+/* 电池 uevent 文件 (fd 常驻) */
+static char battery_uevent_buf[UEVENT_BUFFER_SIZE];
+static ProcFile battery_uevent = PROC_FILE_INIT(BATTERY_UEVENT, battery_uevent_buf);
+
 /* 读取电池信息 */
 static void get_battery_info(BatteryInfo *info) {
     memset(info, 0, sizeof(BatteryInfo));
     strcpy(info->status, "Unknown");
     strcpy(info->health, "Unknown");
 
-    FILE *f = fopen(BATTERY_UEVENT, "r");
-    if (!f) return;
-
-    char line[256];
-    while (fgets(line, sizeof(line), f)) {
-        char *eq = strchr(line, '=');
-        if (!eq) continue;
-        *eq = '\0';
-        char *key = line;
-        char *value = eq + 1;
-        /* 去除换行 */
-        size_t len = strlen(value);
-        if (len > 0 && value[len - 1] == '\n') value[len - 1] = '\0';
-
-        if (strcmp(key, "POWER_SUPPLY_STATUS") == 0) {
-            strncpy(info->status, value, sizeof(info->status) - 1);
-        } else if (strcmp(key, "POWER_SUPPLY_HEALTH") == 0) {
-            strncpy(info->health, value, sizeof(info->health) - 1);
-        } else if (strcmp(key, "POWER_SUPPLY_CAPACITY") == 0) {
-            info->capacity = atoi(value);
-        } else if (strcmp(key, "POWER_SUPPLY_TEMP") == 0) {
-            info->temperature = atoi(value);
-        } else if (strcmp(key, "POWER_SUPPLY_VOLTAGE_NOW") == 0) {
-            info->voltage_now = atoi(value);
-        } else if (strcmp(key, "POWER_SUPPLY_CURRENT_NOW") == 0) {
-            info->current_now = atoi(value);
+    if (proc_file_read(&battery_uevent) <= 0) return;
+
+    ProcScan scan = proc_scan_begin(&battery_uevent, '=');
+    ProcKV kv;
+    while (proc_scan_next(&scan, &kv)) {
+        if (proc_kv_is(&kv, "POWER_SUPPLY_STATUS")) {
+            proc_kv_copy(&kv, info->status, sizeof(info->status));
+        } else if (proc_kv_is(&kv, "POWER_SUPPLY_HEALTH")) {
+            proc_kv_copy(&kv, info->health, sizeof(info->health));
+        } else if (proc_kv_is(&kv, "POWER_SUPPLY_CAPACITY")) {
+            info->capacity = (int)proc_kv_ll(&kv);
+        } else if (proc_kv_is(&kv, "POWER_SUPPLY_TEMP")) {
+            info->temperature = (int)proc_kv_ll(&kv);
+        } else if (proc_kv_is(&kv, "POWER_SUPPLY_VOLTAGE_NOW")) {
+            info->voltage_now = (int)proc_kv_ll(&kv);
+        } else if (proc_kv_is(&kv, "POWER_SUPPLY_CURRENT_NOW")) {
+            info->current_now = (int)proc_kv_ll(&kv);
         }
     }
-    fclose(f);
 }
 
 
 /* 设置充电开关 */
-static int set_charging(int enable) {
+int set_charging(int enable) {
     FILE *f = fopen(BATTERY_STOP_CHARGE, "w");
     if (!f) return -1;
     /* enable=1 开启充电 -> 写入 0; enable=0 停止充电 -> 写入 1 */
@@ -101,6 +97,16 @@ static int set_charging(int enable) {
     return 0;
 }
 
+/* 读取充电开关 */
+int get_charging(void) {
+    char buf[8];
+    ProcFile f = PROC_FILE_ONESHOT(BATTERY_STOP_CHARGE, buf);
+    long long v;
+
+    if (proc_file_read_ll(&f, &v) != 0) return -1;
+    return v == 0 ? 1 : 0;
+}
+
 /* 加载充电配置 - 从SQLite数据库读取 */
 static void load_charge_config(void) {
     charge_config.enabled = config_get_int("charge_enabled", 0);
@@ -137,8 +143,8 @@ static void check_and_control_charging(void) {
         printf("[charge] 电量(%d%%)>=停止阈值(%d%%)，停止充电\n", info.capacity, stop);
         set_charging(0);
     }
-    /* 低于启动阈值且未充电 -> 开始充电 */
-    else if (info.capacity <= start && !is_charging) {
+    /* 低于启动阈值且未充电 -> 开始充电 (过热保护期间不恢复) */
+    else if (info.capacity <= start && !is_charging && !thermal_charging_inhibited()) {
         printf("[charge] 电量(%d%%)<=启动阈值(%d%%)，开始充电\n", info.capacity, start);
         set_charging(1);
     }
@@ -400,6 +406,7 @@ void handle_charge_on(struct mg_connection *c, struct mg_http_message *hm) {
     JsonBuilder *j = json_new();
     json_obj_open(j);
     
+    thermal_charging_overridden();
     if (set_charging(1) != 0) {
         json_add_int(j, "Code", 1);
         json_add_str(j, "Error", "开启充电失败");
@@ -421,6 +428,7 @@ void handle_charge_off(struct mg_connection *c, struct mg_http_message *hm) {
     JsonBuilder *j = json_new();
     json_obj_open(j);
     
+    thermal_charging_overridden();
     if (set_charging(0) != 0) {
         json_add_int(j, "Code", 1);
         json_add_str(j, "Error", "停止充电失败");
@@ -0,0 +1,471 @@
+/**
+ * @file client_traffic.c
+ * @brief 终端流量统计与配额实现
+ *
+ * iptables 结构:
+ *   FORWARD -> UOOLS_BLOCK (超配额客户端 DROP)
+ *           -> UOOLS_ACCT  (每个客户端 -s IP / -d IP 两条无目标计数规则)
+ * 发现客户端只读 /proc/net/arp，不 fork；只有新客户端加规则、读取计数器时才调用 iptables。
+ *
+ * 启动时两条链会被清空，因此设置了配额的客户端的用量持久化到 config
+ * (client_rx_/client_tx_<MAC>)，重新发现时恢复用量并重新下发拦截规则。
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <glib.h>
+#include "mongoose.h"
+#include "client_traffic.h"
+#include "exec_utils.h"
+#include "database.h"
+#include "http_utils.h"
+#include "json_builder.h"
+
+#define ACCT_CHAIN     "UOOLS_ACCT"
+#define BLOCK_CHAIN    "UOOLS_BLOCK"
+#define ARP_PATH       "/proc/net/arp"
+#define READ_MIN_US    (1 * G_USEC_PER_SEC)   /* 两次读取计数器的最小间隔 */
+
+typedef struct {
+    char mac[18];
+    char ip[16];
+    char iface[16];
+    guint64 rx_bytes;           /* 下载 (发往客户端) */
+    guint64 tx_bytes;           /* 上传 (来自客户端) */
+    guint64 rx_pkts;
+    guint64 tx_pkts;
+    guint64 raw[4];             /* 上次读到的规则计数: rx_bytes, tx_bytes, rx_pkts, tx_pkts */
+    double rate_rx;             /* 字节/秒 */
+    double rate_tx;
+    long long quota;            /* 配额 (字节), 0 表示不限 */
+    guint64 saved_rx;           /* 上次持久化的用量 */
+    guint64 saved_tx;
+    int blocked;
+    time_t first_seen;
+    time_t last_seen;
+} ClientEntry;
+
+static ClientEntry g_clients[CLIENT_MAX];
+static int g_client_count = 0;
+static int g_quota_count = 0;       /* 设置了配额的客户端数 */
+static gint64 g_last_read_us = 0;
+static int g_available = 0;         /* iptables 链是否创建成功 */
+static gint64 g_last_save_us = 0;
+
+/* ==================== iptables ==================== */
+
+static int ipt(const char *a1, const char *a2, const char *a3, const char *a4,
+               const char *a5, const char *a6, const char *a7) {
+    char output[256];
+    return run_command(output, sizeof(output), "iptables", "-t", "filter",
+                       a1, a2, a3, a4, a5, a6, a7, NULL);
+}
+
+static void client_rules(const ClientEntry *e, const char *op) {
+    ipt(op, ACCT_CHAIN, "-s", e->ip, NULL, NULL, NULL);
+    ipt(op, ACCT_CHAIN, "-d", e->ip, NULL, NULL, NULL);
+}
+
+static void block_rules(const ClientEntry *e, const char *op) {
+    ipt(op, BLOCK_CHAIN, "-s", e->ip, "-j", "DROP", NULL);
+    ipt(op, BLOCK_CHAIN, "-d", e->ip, "-j", "DROP", NULL);
+}
+
+/* 重新创建专用链，插入到 FORWARD 最前面 (拦截链在计数链之前) */
+static int setup_chains(void) {
+    const char *chains[] = {ACCT_CHAIN, BLOCK_CHAIN};
+
+    for (int i = 0; i < 2; i++) {
+        ipt("-N", chains[i], NULL, NULL, NULL, NULL, NULL);
+        ipt("-F", chains[i], NULL, NULL, NULL, NULL, NULL);
+        while (ipt("-D", "FORWARD", "-j", chains[i], NULL, NULL, NULL) == 0) {}
+        if (ipt("-I", "FORWARD", "1", "-j", chains[i], NULL, NULL) != 0) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+/* ==================== 客户端表 ==================== */
+
+/* config 键: <prefix><MAC 去掉冒号> */
+static void client_key(const char *prefix, const char *mac, char *key, size_t size) {
+    char hex[13];
+    int n = 0;
+    for (const char *p = mac; *p && n < 12; p++) {
+        if (*p != ':') hex[n++] = *p;
+    }
+    hex[n] = '\0';
+    snprintf(key, size, "%s%s", prefix, hex);
+}
+
+/* 只持久化设置了配额的客户端，用量未变化时不写库 */
+static void save_usage(ClientEntry *e) {
+    char key[32];
+
+    if (e->quota <= 0 || (e->rx_bytes == e->saved_rx && e->tx_bytes == e->saved_tx)) return;
+    client_key("client_rx_", e->mac, key, sizeof(key));
+    if (config_set_ll(key, (long long)e->rx_bytes) != 0) return;
+    client_key("client_tx_", e->mac, key, sizeof(key));
+    if (config_set_ll(key, (long long)e->tx_bytes) != 0) return;
+    e->saved_rx = e->rx_bytes;
+    e->saved_tx = e->tx_bytes;
+}
+
+static void load_usage(ClientEntry *e) {
+    char key[32];
+
+    client_key("client_rx_", e->mac, key, sizeof(key));
+    e->rx_bytes = e->saved_rx = (guint64)config_get_ll(key, 0);
+    client_key("client_tx_", e->mac, key, sizeof(key));
+    e->tx_bytes = e->saved_tx = (guint64)config_get_ll(key, 0);
+}
+
+static ClientEntry *find_by_mac(const char *mac) {
+    for (int i = 0; i < g_client_count; i++) {
+        if (strcmp(g_clients[i].mac, mac) == 0) return &g_clients[i];
+    }
+    return NULL;
+}
+
+static ClientEntry *find_by_ip(const char *ip) {
+    for (int i = 0; i < g_client_count; i++) {
+        if (strcmp(g_clients[i].ip, ip) == 0) return &g_clients[i];
+    }
+    return NULL;
+}
+
+static void set_blocked(ClientEntry *e, int blocked) {
+    if (e->blocked == blocked) return;
+    printf("[ClientTraffic] %s (%s) %s\n", e->mac, e->ip, blocked ? "超出配额，已拦截" : "解除拦截");
+    block_rules(e, blocked ? "-A" : "-D");
+    e->blocked = blocked;
+    /* 拦截状态变化时立即落盘，重启后按同样的用量恢复拦截 */
+    save_usage(e);
+}
+
+static void check_quota(ClientEntry *e) {
+    set_blocked(e, e->quota > 0 && (long long)(e->rx_bytes + e->tx_bytes) >= e->quota);
+}
+
+/* 表满时淘汰最久未出现且没有配额的客户端 */
+static ClientEntry *alloc_entry(void) {
+    if (g_client_count < CLIENT_MAX) {
+        return &g_clients[g_client_count++];
+    }
+
+    ClientEntry *victim = NULL;
+    for (int i = 0; i < CLIENT_MAX; i++) {
+        if (g_clients[i].quota == 0 && (!victim || g_clients[i].last_seen < victim->last_seen)) {
+            victim = &g_clients[i];
+        }
+    }
+    if (victim && victim->ip[0]) {
+        client_rules(victim, "-D");
+    }
+    return victim;
+}
+
+static void read_counters(void);
+
+static void add_client(const char *ip, const char *mac, const char *iface, time_t now) {
+    ClientEntry *e = find_by_mac(mac);
+
+    if (e) {
+        e->last_seen = now;
+        if (strcmp(e->ip, ip) == 0) return;
+
+        /* IP 变化: 先把旧规则上的计数累加进来，再迁移规则 */
+        printf("[ClientTraffic] %s IP 变化 %s -> %s\n", mac, e->ip, ip);
+        read_counters();
+        if (e->blocked) block_rules(e, "-D");
+        client_rules(e, "-D");
+        snprintf(e->ip, sizeof(e->ip), "%s", ip);
+        memset(e->raw, 0, sizeof(e->raw));
+        client_rules(e, "-A");
+        if (e->blocked) block_rules(e, "-A");
+        return;
+    }
+
+    /* 同一 IP 换了设备，旧记录不再计数 */
+    ClientEntry *old = find_by_ip(ip);
+    if (old) {
+        set_blocked(old, 0);
+        client_rules(old, "-D");
+        old->ip[0] = '\0';
+    }
+
+    e = alloc_entry();
+    if (!e) return;
+
+    memset(e, 0, sizeof(*e));
+    snprintf(e->mac, sizeof(e->mac), "%s", mac);
+    snprintf(e->ip, sizeof(e->ip), "%s", ip);
+    snprintf(e->iface, sizeof(e->iface), "%s", iface);
+    e->first_seen = now;
+    e->last_seen = now;
+
+    char key[32];
+    client_key("client_quota_", mac, key, sizeof(key));
+    e->quota = config_get_ll(key, 0);
+    if (e->quota > 0) {
+        g_quota_count++;
+        load_usage(e);
+    }
+
+    client_rules(e, "-A");
+    printf("[ClientTraffic] 新客户端 %s (%s) @%s\n", mac, ip, iface);
+    check_quota(e);
+}
+
+/* WAN/回环接口上的邻居不是终端 */
+static int is_lan_iface(const char *iface) {
+    return strncmp(iface, "sipa", 4) != 0 && strncmp(iface, "rmnet", 5) != 0 &&
+           strncmp(iface, "seth", 4) != 0 && strcmp(iface, "lo") != 0;
+}
+
+static void discover_clients(void) {
+    FILE *fp = fopen(ARP_PATH, "r");
+    char line[256];
+    time_t now = time(NULL);
+
+    if (!fp) return;
+
+    /* 跳过表头 */
+    if (!fgets(line, sizeof(line), fp)) {
+        fclose(fp);
+        return;
+    }
+    while (fgets(line, sizeof(line), fp)) {
+        char ip[16], hwtype[8], flags[8], mac[18], mask[8], iface[16];
+        if (sscanf(line, "%15s %7s %7s %17s %7s %15s", ip, hwtype, flags, mac, mask, iface) != 6) {
+            continue;
+        }
+        /* 0x2 = ATF_COM, 未完成解析的条目 MAC 全零 */
+        if (!(strtol(flags, NULL, 16) & 0x2) || !is_lan_iface(iface)) {
+            continue;
+        }
+        add_client(ip, mac, iface, now);
+    }
+    fclose(fp);
+}
+
+/* ==================== 计数器 ==================== */
+
+static void apply_counter(ClientEntry *e, int idx, guint64 raw, guint64 *total) {
+    /* 规则被重建时计数从 0 开始 */
+    *total += raw >= e->raw[idx] ? raw - e->raw[idx] : raw;
+    e->raw[idx] = raw;
+}
+
+/* 读取计数链，累加到客户端表 */
+static void read_counters(void) {
+    static char output[16384];
+    gint64 now = g_get_monotonic_time();
+    double dt = g_last_read_us > 0 ? (double)(now - g_last_read_us) / G_USEC_PER_SEC : 0;
+
+    if (!g_available || run_command(output, sizeof(output), "iptables", "-t", "filter",
+                                    "-nvxL", ACCT_CHAIN, NULL) != 0) {
+        return;
+    }
+
+    guint64 prev_rx[CLIENT_MAX], prev_tx[CLIENT_MAX];
+    for (int i = 0; i < g_client_count; i++) {
+        prev_rx[i] = g_clients[i].rx_bytes;
+        prev_tx[i] = g_clients[i].tx_bytes;
+    }
+
+    char *save = NULL;
+    for (char *line = strtok_r(output, "\n", &save); line; line = strtok_r(NULL, "\n", &save)) {
+        unsigned long long pkts, bytes;
+        if (sscanf(line, "%llu %llu", &pkts, &bytes) != 2) continue;
+
+        /* 最后两列为 source / destination (无目标规则时 target 列为空) */
+        char *tok[16];
+        int n = 0;
+        char *tsave = NULL;
+        for (char *t = strtok_r(line, " \t", &tsave); t && n < 16; t = strtok_r(NULL, " \t", &tsave)) {
+            tok[n++] = t;
+        }
+        if (n < 4) continue;
+
+        char *src = tok[n - 2], *dst = tok[n - 1];
+        int upload = strcmp(dst, "0.0.0.0/0") == 0;
+        char *ip = upload ? src : dst;
+        char *slash = strchr(ip, '/');
+        if (slash) *slash = '\0';
+
+        ClientEntry *e = find_by_ip(ip);
+        if (!e) continue;
+        if (upload) {
+            apply_counter(e, 1, bytes, &e->tx_bytes);
+            apply_counter(e, 3, pkts, &e->tx_pkts);
+        } else {
+            apply_counter(e, 0, bytes, &e->rx_bytes);
+            apply_counter(e, 2, pkts, &e->rx_pkts);
+        }
+    }
+
+    for (int i = 0; i < g_client_count; i++) {
+        ClientEntry *e = &g_clients[i];
+        /* 计数被重置 (如清零、客户端换位) 时本轮速率记为 0 */
+        if (dt > 0) {
+            e->rate_rx = e->rx_bytes >= prev_rx[i] ? (double)(e->rx_bytes - prev_rx[i]) / dt : 0;
+            e->rate_tx = e->tx_bytes >= prev_tx[i] ? (double)(e->tx_bytes - prev_tx[i]) / dt : 0;
+        }
+        check_quota(e);
+    }
+    g_last_read_us = now;
+}
+
+static gboolean client_tick(gpointer user_data) {
+    (void)user_data;
+    discover_clients();
+    /* 没有配额时计数器只在查询时读取 */
+    if (g_quota_count > 0) {
+        read_counters();
+        if (g_get_monotonic_time() - g_last_save_us >= (gint64)CLIENT_SAVE_SECS * G_USEC_PER_SEC) {
+            client_traffic_flush();
+        }
+    }
+    return G_SOURCE_CONTINUE;
+}
+
+void client_traffic_flush(void) {
+    if (!g_available) return;
+    read_counters();
+    for (int i = 0; i < g_client_count; i++) {
+        save_usage(&g_clients[i]);
+    }
+    g_last_save_us = g_get_monotonic_time();
+}
+
+void client_traffic_init(void) {
+    if (setup_chains() != 0) {
+        printf("[ClientTraffic] iptables 不可用，终端流量统计已禁用\n");
+        return;
+    }
+    g_available = 1;
+    discover_clients();
+    g_timeout_add_seconds(CLIENT_DISCOVER_SECS, client_tick, NULL);
+    printf("[ClientTraffic] 已初始化, %d 个客户端\n", g_client_count);
+}
+
+/* ==================== HTTP ==================== */
+
+static const char *g_sort_key = "total";
+
+static guint64 sort_value(const ClientEntry *e) {
+    if (strcmp(g_sort_key, "rx") == 0) return e->rx_bytes;
+    if (strcmp(g_sort_key, "tx") == 0) return e->tx_bytes;
+    if (strcmp(g_sort_key, "rate") == 0) return (guint64)(e->rate_rx + e->rate_tx);
+    return e->rx_bytes + e->tx_bytes;
+}
+
+static int compare_clients(const void *a, const void *b) {
+    guint64 va = sort_value(*(ClientEntry * const *)a);
+    guint64 vb = sort_value(*(ClientEntry * const *)b);
+    return va < vb ? 1 : (va > vb ? -1 : 0);
+}
+
+/* GET /api/traffic/clients?top=N&sort=total|rx|tx|rate - 客户端流量排行 */
+void handle_traffic_clients(struct mg_connection *c, struct mg_http_message *hm) {
+    HTTP_CHECK_GET(c, hm);
+
+    if (!g_available) {
+        HTTP_ERROR(c, 503, "Client accounting unavailable");
+        return;
+    }
+
+    char top_str[16] = {0}, sort[16] = "total";
+    int top = CLIENT_MAX;
+    if (mg_http_get_var(&hm->query, "top", top_str, sizeof(top_str)) > 0 && atoi(top_str) > 0) {
+        top = atoi(top_str);
+    }
+    mg_http_get_var(&hm->query, "sort", sort, sizeof(sort));
+
+    discover_clients();
+    if (g_get_monotonic_time() - g_last_read_us >= READ_MIN_US) {
+        read_counters();
+    }
+
+    ClientEntry *list[CLIENT_MAX];
+    int n = 0;
+    for (int i = 0; i < g_client_count; i++) {
+        list[n++] = &g_clients[i];
+    }
+    g_sort_key = sort;
+    qsort(list, n, sizeof(list[0]), compare_clients);
+    g_sort_key = "total";
+    if (n > top) n = top;
+
+    JsonBuilder *j = json_new();
+    json_obj_open(j);
+    json_add_int(j, "count", g_client_count);
+    json_arr_open(j, "clients");
+    for (int i = 0; i < n; i++) {
+        const ClientEntry *e = list[i];
+        json_arr_obj_open(j);
+        json_add_str(j, "mac", e->mac);
+        json_add_str(j, "ip", e->ip);
+        json_add_str(j, "iface", e->iface);
+        json_add_long(j, "rx", (long long)e->rx_bytes);
+        json_add_long(j, "tx", (long long)e->tx_bytes);
+        json_add_long(j, "rx_packets", (long long)e->rx_pkts);
+        json_add_long(j, "tx_packets", (long long)e->tx_pkts);
+        json_add_long(j, "rx_rate", (long long)e->rate_rx);
+        json_add_long(j, "tx_rate", (long long)e->rate_tx);
+        json_add_long(j, "quota", e->quota);
+        json_add_bool(j, "blocked", e->blocked);
+        json_add_long(j, "first_seen", (long long)e->first_seen);
+        json_add_long(j, "last_seen", (long long)e->last_seen);
+        json_obj_close(j);
+    }
+    json_arr_close(j);
+    json_obj_close(j);
+    HTTP_OK_FREE(c, json_finish(j));
+}
+
+/* POST /api/traffic/client_quota - 设置客户端配额 {mac, quota[, reset]} */
+void handle_traffic_client_quota(struct mg_connection *c, struct mg_http_message *hm) {
+    HTTP_CHECK_POST(c, hm);
+
+    char *mac = mg_json_get_str(hm->body, "$.mac");
+    long long quota = mg_json_get_long(hm->body, "$.quota", -1);
+    bool reset = false;
+    mg_json_get_bool(hm->body, "$.reset", &reset);
+
+    ClientEntry *e = mac ? find_by_mac(mac) : NULL;
+    free(mac);
+    if (!e) {
+        HTTP_ERROR(c, 404, "Client not found");
+        return;
+    }
+
+    if (quota >= 0 && quota != e->quota) {
+        char key[32];
+        client_key("client_quota_", e->mac, key, sizeof(key));
+        config_set_ll(key, quota);
+        g_quota_count += (quota > 0) - (e->quota > 0);
+        /* 新设置配额时库里可能残留旧用量，强制写入当前值 */
+        if (e->quota <= 0) e->saved_rx = e->saved_tx = G_MAXUINT64;
+        e->quota = quota;
+    }
+    if (reset) {
+        e->rx_bytes = e->tx_bytes = 0;
+        e->rx_pkts = e->tx_pkts = 0;
+    }
+    check_quota(e);
+    save_usage(e);
+
+    JsonBuilder *j = json_new();
+    json_obj_open(j);
+    json_add_bool(j, "success", 1);
+    json_add_str(j, "mac", e->mac);
+    json_add_long(j, "quota", e->quota);
+    json_add_bool(j, "blocked", e->blocked);
+    json_obj_close(j);
+    HTTP_OK_FREE(c, json_finish(j));
+}
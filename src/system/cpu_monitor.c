@@ -0,0 +1,379 @@
+/**
+ * @file cpu_monitor.c
+ * @brief CPU 与关键进程资源监控实现
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <glib.h>
+#include "mongoose.h"
+#include "cpu_monitor.h"
+#include "proc_reader.h"
+#include "database.h"
+#include "http_utils.h"
+#include "json_builder.h"
+
+#define RESCAN_SECS  30     /* 关键进程退出后重新查找的最小间隔 */
+
+/* 需要跟踪的守护进程 (本进程另外加入) */
+static const char *g_watch_names[] = {"ofonod", "vnstatd", "connmand"};
+
+/* 一行 cpu 计数 */
+typedef struct {
+    guint64 busy;
+    guint64 iowait;
+    guint64 total;
+} CpuTimes;
+
+/* 进程跟踪状态 */
+typedef struct {
+    char name[16];
+    int pid;
+    char path[32];
+    char buf[512];
+    ProcFile stat;          /* /proc/<pid>/stat (fd 常驻) */
+    int primed;
+    guint64 ticks;          /* utime + stime */
+} ProcTrack;
+
+static CpuStats g_stats;
+static int g_interval_s = CPU_MONITOR_DEFAULT_SECS;
+static guint g_timer = 0;
+
+static char g_stat_buf[16384];
+static ProcFile g_stat_file = PROC_FILE_INIT("/proc/stat", g_stat_buf);
+static char g_load_buf[128];
+static ProcFile g_load_file = PROC_FILE_INIT("/proc/loadavg", g_load_buf);
+
+static int g_primed = 0;
+static gint64 g_last_us = 0;
+static CpuTimes g_prev[CPU_MONITOR_MAX_CORES + 1];     /* [0] 为汇总行 */
+static guint64 g_prev_ctxt = 0, g_prev_intr = 0;
+
+static ProcTrack g_procs[CPU_MONITOR_MAX_PROCS];
+static int g_proc_count = 0;
+static gint64 g_last_scan_us = 0;
+static long g_clk_tck = 100;
+static long g_page_kb = 4;
+
+static guint64 next_u64(char **p) {
+    return g_ascii_strtoull(*p, p, 10);
+}
+
+static double pct(guint64 part, guint64 whole) {
+    return whole > 0 ? (double)part * 100.0 / whole : 0;
+}
+
+/* ==================== 进程 ==================== */
+
+static int read_comm(int pid, char *out, size_t size) {
+    char path[32], buf[32];
+    snprintf(path, sizeof(path), "/proc/%d/comm", pid);
+    ProcFile f = PROC_FILE_ONESHOT(path, buf);
+    if (proc_file_read(&f) <= 0) return -1;
+    buf[strcspn(buf, "\n")] = '\0';
+    g_strlcpy(out, buf, size);      /* comm 最长 15 字符 */
+    return 0;
+}
+
+static void track_pid(ProcTrack *t, int pid) {
+    proc_file_close(&t->stat);
+    snprintf(t->path, sizeof(t->path), "/proc/%d/stat", pid);
+    proc_file_init(&t->stat, t->path, t->buf, sizeof(t->buf));
+    t->pid = proc_file_read(&t->stat) > 0 ? pid : 0;
+    t->primed = 0;
+}
+
+/* 为未运行的守护进程查找 pid */
+static void scan_processes(void) {
+    DIR *dir = opendir("/proc");
+    struct dirent *ent;
+
+    if (!dir) return;
+    while ((ent = readdir(dir)) != NULL) {
+        char comm[16];
+        if (!isdigit((unsigned char)ent->d_name[0])) continue;
+        int pid = atoi(ent->d_name);
+        if (read_comm(pid, comm, sizeof(comm)) != 0) continue;
+
+        for (int i = 0; i < g_proc_count; i++) {
+            if (g_procs[i].pid == 0 && strcmp(g_procs[i].name, comm) == 0) {
+                track_pid(&g_procs[i], pid);
+                break;
+            }
+        }
+    }
+    closedir(dir);
+    g_last_scan_us = g_get_monotonic_time();
+}
+
+/* 读取 /proc/<pid>/stat: comm 之后依次为 state(3) ... utime(14) stime(15) ... num_threads(20) ... rss(24) */
+static int sample_process(ProcTrack *t, CpuProcStat *out, double dt_s) {
+    if (t->pid == 0) return -1;
+    /* 进程退出后 pread 失败，重新打开也找不到同一路径 */
+    if (proc_file_read(&t->stat) <= 0) {
+        proc_file_close(&t->stat);
+        t->pid = 0;
+        return -1;
+    }
+
+    char *p = strrchr(t->buf, ')');
+    if (!p) return -1;
+    p += 2;
+
+    guint64 fields[22] = {0};
+    for (int i = 0; i < 22 && *p; i++) {
+        while (*p == ' ') p++;
+        if (i == 0) {
+            p++;                /* state 为单个字符 */
+            continue;
+        }
+        fields[i] = next_u64(&p);
+    }
+
+    guint64 ticks = fields[11] + fields[12];
+    out->threads = (int)fields[17];
+    out->rss_kb = (unsigned long)(fields[21] * g_page_kb);
+    out->cpu = 0;
+    if (t->primed && dt_s > 0 && ticks >= t->ticks) {
+        out->cpu = (double)(ticks - t->ticks) / g_clk_tck / dt_s * 100.0;
+    }
+    t->ticks = ticks;
+    t->primed = 1;
+    return 0;
+}
+
+/* ==================== 采样 ==================== */
+
+static void parse_cpu_line(char *p, CpuTimes *out) {
+    guint64 v[8] = {0};
+    for (int i = 0; i < 8; i++) v[i] = next_u64(&p);
+    /* user nice system idle iowait irq softirq steal */
+    out->iowait = v[4];
+    out->busy = v[0] + v[1] + v[2] + v[5] + v[6] + v[7];
+    out->total = out->busy + v[3] + v[4];
+}
+
+static void sample_stat(CpuStats *st, int primed, double dt_s) {
+    CpuTimes now[CPU_MONITOR_MAX_CORES + 1];
+    guint64 ctxt = 0, intr = 0;
+    int seen[CPU_MONITOR_MAX_CORES + 1] = {0};
+
+    if (proc_file_read(&g_stat_file) <= 0) return;
+
+    for (char *line = g_stat_buf; line && *line; ) {
+        char *next = strchr(line, '\n');
+        if (next) *next++ = '\0';
+
+        if (strncmp(line, "cpu", 3) == 0) {
+            char *p = line + 3;
+            int idx = 0;
+            if (isdigit((unsigned char)*p)) {
+                idx = (int)next_u64(&p) + 1;
+            }
+            if (idx <= CPU_MONITOR_MAX_CORES) {
+                parse_cpu_line(p, &now[idx]);
+                seen[idx] = 1;
+                if (idx > st->core_count) st->core_count = idx;
+            }
+        } else if (strncmp(line, "ctxt ", 5) == 0) {
+            char *p = line + 5;
+            ctxt = next_u64(&p);
+        } else if (strncmp(line, "intr ", 5) == 0) {
+            char *p = line + 5;
+            intr = next_u64(&p);
+        } else if (strncmp(line, "procs_running ", 14) == 0) {
+            st->procs_running = atoi(line + 14);
+        } else if (strncmp(line, "procs_blocked ", 14) == 0) {
+            st->procs_blocked = atoi(line + 14);
+        }
+        line = next;
+    }
+
+    for (int i = 0; i <= CPU_MONITOR_MAX_CORES; i++) {
+        if (!seen[i]) continue;
+        /* 离线核心重新上线时计数可能回退，此时跳过一轮 */
+        if (primed && now[i].total > g_prev[i].total && now[i].busy >= g_prev[i].busy) {
+            guint64 total_d = now[i].total - g_prev[i].total;
+            double usage = pct(now[i].busy - g_prev[i].busy, total_d);
+            if (i == 0) {
+                st->total = usage;
+                st->iowait = now[i].iowait >= g_prev[i].iowait ?
+                             pct(now[i].iowait - g_prev[i].iowait, total_d) : 0;
+            } else {
+                st->cores[i - 1] = usage;
+            }
+        }
+        g_prev[i] = now[i];
+    }
+
+    if (primed && dt_s > 0) {
+        st->ctxt_rate = ctxt >= g_prev_ctxt ? (ctxt - g_prev_ctxt) / dt_s : 0;
+        st->irq_rate = intr >= g_prev_intr ? (intr - g_prev_intr) / dt_s : 0;
+    }
+    g_prev_ctxt = ctxt;
+    g_prev_intr = intr;
+}
+
+static void sample_load(CpuStats *st) {
+    if (proc_file_read(&g_load_file) <= 0) return;
+    char *p = g_load_buf;
+    for (int i = 0; i < 3; i++) {
+        st->load[i] = g_ascii_strtod(p, &p);
+    }
+}
+
+static gboolean cpu_monitor_tick(gpointer user_data) {
+    gint64 now = g_get_monotonic_time();
+    int need_scan = 0;
+    (void)user_data;
+
+    /* 使用实测间隔计算速率，定时器抖动不影响结果 */
+    double dt_s = g_primed ? (double)(now - g_last_us) / G_USEC_PER_SEC : 0;
+    CpuStats st = g_stats;
+    st.interval_s = g_interval_s;
+    g_last_us = now;
+
+    sample_stat(&st, g_primed, dt_s);
+    sample_load(&st);
+
+    st.proc_count = g_proc_count;
+    for (int i = 0; i < g_proc_count; i++) {
+        CpuProcStat *out = &st.procs[i];
+        g_strlcpy(out->name, g_procs[i].name, sizeof(out->name));
+        if (sample_process(&g_procs[i], out, dt_s) != 0) {
+            memset(out, 0, sizeof(*out));
+            g_strlcpy(out->name, g_procs[i].name, sizeof(out->name));
+            need_scan = 1;
+        }
+        out->pid = g_procs[i].pid;
+    }
+    if (need_scan && now - g_last_scan_us >= (gint64)RESCAN_SECS * G_USEC_PER_SEC) {
+        scan_processes();
+    }
+
+    st.valid = g_primed;
+    st.time_ms = g_get_real_time() / 1000;
+    g_stats = st;
+    g_primed = 1;
+    return G_SOURCE_CONTINUE;
+}
+
+static void cpu_monitor_schedule(void) {
+    if (g_timer > 0) g_source_remove(g_timer);
+    g_timer = g_timeout_add_seconds(g_interval_s, cpu_monitor_tick, NULL);
+}
+
+void cpu_monitor_init(void) {
+    g_clk_tck = sysconf(_SC_CLK_TCK);
+    if (g_clk_tck <= 0) g_clk_tck = 100;
+    g_page_kb = sysconf(_SC_PAGESIZE) / 1024;
+    if (g_page_kb <= 0) g_page_kb = 4;
+
+    g_interval_s = config_get_int("cpu_monitor_interval", CPU_MONITOR_DEFAULT_SECS);
+    if (g_interval_s < CPU_MONITOR_MIN_SECS || g_interval_s > CPU_MONITOR_MAX_SECS) {
+        g_interval_s = CPU_MONITOR_DEFAULT_SECS;
+    }
+
+    /* 本进程 + 守护进程 */
+    g_proc_count = 0;
+    ProcTrack *self = &g_procs[g_proc_count++];
+    memset(self, 0, sizeof(*self));
+    self->stat.fd = -1;
+    if (read_comm(getpid(), self->name, sizeof(self->name)) != 0) {
+        snprintf(self->name, sizeof(self->name), "self");
+    }
+    track_pid(self, getpid());
+
+    for (size_t i = 0; i < G_N_ELEMENTS(g_watch_names) && g_proc_count < CPU_MONITOR_MAX_PROCS; i++) {
+        ProcTrack *t = &g_procs[g_proc_count++];
+        memset(t, 0, sizeof(*t));
+        t->stat.fd = -1;
+        snprintf(t->name, sizeof(t->name), "%s", g_watch_names[i]);
+    }
+    scan_processes();
+
+    /* 立即建立基线，一个周期后即有有效数据 */
+    cpu_monitor_tick(NULL);
+    cpu_monitor_schedule();
+    printf("[CPU] 资源监控已启动, 间隔 %d 秒\n", g_interval_s);
+}
+
+void cpu_monitor_get(CpuStats *out) {
+    *out = g_stats;
+}
+
+double cpu_monitor_total(void) {
+    return g_stats.valid ? g_stats.total : 0;
+}
+
+/* GET/POST /api/system/cpu - CPU 与关键进程资源 (POST 设置 interval) */
+void handle_system_cpu(struct mg_connection *c, struct mg_http_message *hm) {
+    HTTP_HANDLE_OPTIONS(c, hm);
+
+    if (http_is_method(hm, "POST")) {
+        double interval = 0;
+        if (!mg_json_get_num(hm->body, "$.interval", &interval) ||
+            interval < CPU_MONITOR_MIN_SECS || interval > CPU_MONITOR_MAX_SECS) {
+            HTTP_ERROR(c, 400, "interval out of range (1-60)");
+            return;
+        }
+        g_interval_s = (int)interval;
+        config_set_int("cpu_monitor_interval", g_interval_s);
+        cpu_monitor_schedule();
+    } else if (!http_is_method(hm, "GET")) {
+        http_method_error(c);
+        return;
+    }
+
+    CpuStats st;
+    cpu_monitor_get(&st);
+
+    JsonBuilder *j = json_new();
+    json_obj_open(j);
+    json_add_long(j, "t", st.time_ms);
+    json_add_int(j, "interval", g_interval_s);
+    json_add_bool(j, "valid", st.valid);
+    json_add_double(j, "usage", st.total);
+    json_add_double(j, "iowait", st.iowait);
+    /* 数值数组用紧凑格式 */
+    /* 放不下的核心丢弃，保证数组闭合 */
+    char cores[CPU_MONITOR_MAX_CORES * 8 + 4];
+    size_t len = 0;
+    cores[len++] = '[';
+    for (int i = 0; i < st.core_count; i++) {
+        size_t room = sizeof(cores) - len - 1;
+        int n = snprintf(cores + len, room, "%s%.1f", i ? "," : "", st.cores[i]);
+        if (n < 0 || (size_t)n >= room) break;
+        len += (size_t)n;
+    }
+    cores[len++] = ']';
+    cores[len] = '\0';
+    json_add_raw(j, "cores", cores);
+    char load[96];
+    snprintf(load, sizeof(load), "[%.2f,%.2f,%.2f]", st.load[0], st.load[1], st.load[2]);
+    json_add_raw(j, "load", load);
+    json_add_double(j, "ctxt_rate", st.ctxt_rate);
+    json_add_double(j, "irq_rate", st.irq_rate);
+    json_add_int(j, "procs_running", st.procs_running);
+    json_add_int(j, "procs_blocked", st.procs_blocked);
+    json_arr_open(j, "processes");
+    for (int i = 0; i < st.proc_count; i++) {
+        const CpuProcStat *p = &st.procs[i];
+        json_arr_obj_open(j);
+        json_add_str(j, "name", p->name);
+        json_add_int(j, "pid", p->pid);
+        json_add_bool(j, "running", p->pid > 0);
+        json_add_double(j, "cpu", p->cpu);
+        json_add_ulong(j, "rss_kb", p->rss_kb);
+        json_add_int(j, "threads", p->threads);
+        json_obj_close(j);
+    }
+    json_arr_close(j);
+    json_obj_close(j);
+    HTTP_OK_FREE(c, json_finish(j));
+}
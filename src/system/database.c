@@ -56,6 +56,15 @@ static int db_create_tables(void) {
         "max_sent_count INTEGER DEFAULT 10,"
         "sms_fix_enabled INTEGER DEFAULT 0"
         ");"
+        "CREATE TABLE IF NOT EXISTS sms_threads ("
+        "peer TEXT PRIMARY KEY,"
+        "address TEXT,"
+        "last_ts INTEGER DEFAULT 0,"
+        "last_preview TEXT DEFAULT '',"
+        "last_dir INTEGER DEFAULT 0,"
+        "unread INTEGER DEFAULT 0,"
+        "total INTEGER DEFAULT 0"
+        ");"
         "CREATE TABLE IF NOT EXISTS config ("
         "key TEXT PRIMARY KEY,"
         "value TEXT"
@@ -93,6 +102,24 @@ int db_init(const char *path) {
     
     /* 为旧数据库添加新字段（忽略错误，字段可能已存在） */
     db_execute("ALTER TABLE sms_config ADD COLUMN sms_fix_enabled INTEGER DEFAULT 0;");
+    db_execute("ALTER TABLE sms ADD COLUMN peer TEXT;");
+    db_execute("ALTER TABLE sent_sms ADD COLUMN peer TEXT;");
+    db_execute("ALTER TABLE sms ADD COLUMN hash TEXT;");
+    db_execute("ALTER TABLE sms ADD COLUMN sent_time TEXT;");
+    db_execute("ALTER TABLE sms ADD COLUMN parts INTEGER DEFAULT 1;");
+    db_execute("ALTER TABLE sms ADD COLUMN bytes INTEGER;");
+    db_execute("ALTER TABLE sent_sms ADD COLUMN bytes INTEGER;");
+
+    /* 正文字节数入库时写入，容量裁剪只读这一列; 补齐旧记录 */
+    db_execute("UPDATE sms SET bytes = length(CAST(content AS BLOB)) WHERE bytes IS NULL;"
+               "UPDATE sent_sms SET bytes = length(CAST(content AS BLOB)) WHERE bytes IS NULL;");
+
+    /* 索引依赖上面补齐的字段，放在 ALTER 之后 */
+    db_execute("CREATE INDEX IF NOT EXISTS idx_sms_sender_ts ON sms(sender, timestamp);"
+               "CREATE INDEX IF NOT EXISTS idx_sms_peer ON sms(peer, id);"
+               "CREATE INDEX IF NOT EXISTS idx_sent_sms_peer ON sent_sms(peer, id);"
+               "CREATE INDEX IF NOT EXISTS idx_sms_hash ON sms(hash);"
+               "CREATE INDEX IF NOT EXISTS idx_sms_threads_ts ON sms_threads(last_ts, peer);");
     
     g_db_initialized = 1;
     printf("[DB] 数据库初始化完成\n");
@@ -242,6 +269,34 @@ int db_query_rows(const char *sql, const char *separator, char *buf, size_t size
     return 0;
 }
 
+char *db_query_rows_alloc(const char *sql, size_t *len) {
+    char cmd[2048];
+    const char *tmp_sql = "/tmp/db_query.tmp";
+    char *output;
+
+    if (!sql) return NULL;
+
+    pthread_mutex_lock(&g_db_mutex);
+    /* 长SQL经临时文件传入，避免命令行长度和引号限制 */
+    if (strlen(sql) > 1000 || strchr(sql, '"') || strchr(sql, '\n')) {
+        FILE *fp = fopen(tmp_sql, "w");
+        if (!fp) {
+            pthread_mutex_unlock(&g_db_mutex);
+            return NULL;
+        }
+        fputs(sql, fp);
+        fclose(fp);
+        snprintf(cmd, sizeof(cmd), "sqlite3 '%s' < %s", g_db_path, tmp_sql);
+        output = run_command_alloc(len, "sh", "-c", cmd, NULL);
+        unlink(tmp_sql);
+    } else {
+        snprintf(cmd, sizeof(cmd), "sqlite3 '%s' \"%s\"", g_db_path, sql);
+        output = run_command_alloc(len, "sh", "-c", cmd, NULL);
+    }
+    pthread_mutex_unlock(&g_db_mutex);
+
+    return output;
+}
 
 /*============================================================================
  * 字符串处理
@@ -280,6 +335,40 @@ void db_escape_string(const char *src, char *dst, size_t size) {
     dst[j] = '\0';
 }
 
+static int hex_nibble(char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    return -1;
+}
+
+void db_hex_decode(const char *hex, char *out, size_t size) {
+    size_t j = 0;
+
+    if (!out || size == 0) return;
+    while (hex && hex[0] && hex[1] && j < size - 1) {
+        int hi = hex_nibble(hex[0]), lo = hex_nibble(hex[1]);
+        if (hi < 0 || lo < 0) break;
+        out[j++] = (char)((hi << 4) | lo);
+        hex += 2;
+    }
+    out[j] = '\0';
+}
+
+int db_text_literal(const char *src, char *dst, size_t size) {
+    static const char digits[] = "0123456789ABCDEF";
+    size_t len = strlen(src);
+    if (size < len * 2 + 20) return -1;
+
+    char *p = dst + sprintf(dst, "CAST(X'");
+    for (size_t i = 0; i < len; i++) {
+        *p++ = digits[(unsigned char)src[i] >> 4];
+        *p++ = digits[(unsigned char)src[i] & 0x0F];
+    }
+    strcpy(p, "' AS TEXT)");
+    return 0;
+}
+
 void db_unescape_string(char *str) {
     if (!str) return;
     
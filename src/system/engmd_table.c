@@ -0,0 +1,244 @@
+/**
+ * @file engmd_table.c
+ * @brief AT+SPENGMD 工程模式响应的零拷贝解析器实现
+ */
+
+#include <string.h>
+#include "engmd_table.h"
+
+#define NO_FIELD  ((size_t)-1)
+
+/* 解析过程状态 */
+typedef struct {
+    EngmdTable *t;
+    int fields;           /* 已记录字段数 */
+    int row_cols;         /* 当前行已记录列数 */
+    int row_open;         /* 当前行是否已有内容 */
+    size_t field_start;   /* 当前字段起点, NO_FIELD 表示无 */
+    size_t field_end;     /* 当前字段最后一个有效字符之后 */
+} ParseState;
+
+#define IS_EOL(c)  ((c) == '\r' || (c) == '\n')
+
+/*
+ * 结束当前字段: 去前导空格后记录 span (空格字段保留为空列)。
+ * 字段中间的换行留在 span 内，由访问函数跳过，与旧实现先删除换行的结果一致。
+ */
+static void close_field(ParseState *st) {
+    size_t start = st->field_start;
+    size_t end = st->field_end;
+
+    if (start == NO_FIELD) return;
+    st->field_start = NO_FIELD;
+
+    if (st->row_cols >= ENGMD_MAX_COLS || st->fields >= ENGMD_MAX_FIELDS) return;
+
+    while (start < end && (st->t->src[start] == ' ' || IS_EOL(st->t->src[start]))) start++;
+    st->t->spans[st->fields].off = (uint16_t)start;
+    st->t->spans[st->fields].len = (uint16_t)(end - start);
+    st->fields++;
+    st->row_cols++;
+}
+
+/* 结束当前行 (只有有内容的行才计数) */
+static void close_row(ParseState *st) {
+    close_field(st);
+    if (!st->row_open) return;
+
+    st->t->rows++;
+    st->t->row_start[st->t->rows] = (uint16_t)st->fields;
+    st->row_cols = 0;
+    st->row_open = 0;
+}
+
+/* 查找下一个非换行字符 */
+static char next_char(const char *s, size_t i, size_t len) {
+    for (i = i + 1; i < len; i++) {
+        if (!IS_EOL(s[i])) return s[i];
+    }
+    return '\0';
+}
+
+/* 跳过换行找到下一个字符的下标 */
+static size_t next_index(const char *s, size_t i, size_t len) {
+    for (i = i + 1; i < len; i++) {
+        if (!IS_EOL(s[i])) return i;
+    }
+    return len;
+}
+
+int engmd_parse(EngmdTable *t, const char *input) {
+    ParseState st = {t, 0, 0, 0, NO_FIELD, 0};
+    char prev = 0;
+    size_t len;
+
+    t->src = input;
+    t->rows = 0;
+    t->row_start[0] = 0;
+    if (!input) return 0;
+
+    /* 截止到第一个 OK，偏移用 16 位存储 */
+    const char *ok = strstr(input, "OK");
+    len = ok ? (size_t)(ok - input) : strlen(input);
+    if (len > UINT16_MAX) len = UINT16_MAX;
+
+    for (size_t i = 0; i < len && t->rows < ENGMD_MAX_ROWS; i++) {
+        char c = input[i];
+
+        /* 换行不属于任何字段，也不影响 '-' 规则判断 */
+        if (IS_EOL(c)) {
+            continue;
+        }
+
+        if (c == '-') {
+            if (prev == ',') {
+                /* 规则2: ,- 作为负数 */
+                if (st.field_start == NO_FIELD) st.field_start = i;
+                st.field_end = i + 1;
+                st.row_open = 1;
+            } else if (next_char(input, i, len) == '-') {
+                /* 规则3: -- 换行，第二个 - 作为新行首字段的负号 */
+                close_row(&st);
+                i = next_index(input, i, len);
+                st.field_start = i;
+                st.field_end = i + 1;
+                st.row_open = 1;
+            } else {
+                /* 规则1: 单独 - 换行 */
+                close_row(&st);
+            }
+        } else if (c == ',') {
+            close_field(&st);
+            st.row_open = 1;
+        } else {
+            if (st.field_start == NO_FIELD) st.field_start = i;
+            st.field_end = i + 1;
+            st.row_open = 1;
+        }
+        prev = c;
+    }
+
+    if (t->rows < ENGMD_MAX_ROWS) {
+        close_row(&st);
+    }
+    return t->rows;
+}
+
+/* 定位字段，不存在返回 NULL */
+static const EngmdSpan *find_span(const EngmdTable *t, int row, int col) {
+    if (!t || row < 0 || row >= t->rows || col < 0) return NULL;
+    int idx = t->row_start[row] + col;
+    if (idx >= t->row_start[row + 1]) return NULL;
+    return &t->spans[idx];
+}
+
+int engmd_cols(const EngmdTable *t, int row) {
+    if (!t || row < 0 || row >= t->rows) return 0;
+    return t->row_start[row + 1] - t->row_start[row];
+}
+
+int engmd_len(const EngmdTable *t, int row, int col) {
+    const EngmdSpan *sp = find_span(t, row, col);
+    int n = 0;
+
+    if (!sp) return 0;
+    for (int i = 0; i < sp->len; i++) {
+        if (!IS_EOL(t->src[sp->off + i])) n++;
+    }
+    return n;
+}
+
+int engmd_str(const EngmdTable *t, int row, int col, char *buf, size_t size) {
+    const EngmdSpan *sp = find_span(t, row, col);
+    size_t n = 0;
+
+    if (!buf || size == 0) return 0;
+    if (sp) {
+        for (int i = 0; i < sp->len && n < size - 1; i++) {
+            char c = t->src[sp->off + i];
+            if (!IS_EOL(c)) buf[n++] = c;
+        }
+    }
+    buf[n] = '\0';
+    return (int)n;
+}
+
+int engmd_equals(const EngmdTable *t, int row, int col, const char *s) {
+    const EngmdSpan *sp = find_span(t, row, col);
+    size_t n = 0;
+
+    if (!s) s = "";
+    if (sp) {
+        for (int i = 0; i < sp->len; i++) {
+            char c = t->src[sp->off + i];
+            if (IS_EOL(c)) continue;
+            if (s[n] != c) return 0;
+            n++;
+        }
+    }
+    return s[n] == '\0';
+}
+
+/* 逐个读取字段中的有效字符 */
+typedef struct {
+    const char *p;
+    const char *end;
+} FieldCursor;
+
+static int cursor_init(FieldCursor *fc, const EngmdTable *t, int row, int col) {
+    const EngmdSpan *sp = find_span(t, row, col);
+    if (!sp) return 0;
+    fc->p = t->src + sp->off;
+    fc->end = fc->p + sp->len;
+    return 1;
+}
+
+static char cursor_peek(FieldCursor *fc) {
+    while (fc->p < fc->end && IS_EOL(*fc->p)) fc->p++;
+    return fc->p < fc->end ? *fc->p : '\0';
+}
+
+int engmd_int(const EngmdTable *t, int row, int col) {
+    FieldCursor fc;
+    int neg = 0;
+    long v = 0;
+    char c;
+
+    if (!cursor_init(&fc, t, row, col)) return 0;
+
+    c = cursor_peek(&fc);
+    if (c == '-' || c == '+') { neg = (c == '-'); fc.p++; }
+    while ((c = cursor_peek(&fc)) >= '0' && c <= '9') {
+        v = v * 10 + (c - '0');
+        fc.p++;
+    }
+    return (int)(neg ? -v : v);
+}
+
+double engmd_fixed(const EngmdTable *t, int row, int col, int divisor) {
+    FieldCursor fc;
+    int neg = 0;
+    int64_t mantissa = 0;
+    int64_t scale = 1;
+    char c;
+
+    if (divisor == 0 || !cursor_init(&fc, t, row, col)) return 0;
+
+    c = cursor_peek(&fc);
+    if (c == '-' || c == '+') { neg = (c == '-'); fc.p++; }
+    while ((c = cursor_peek(&fc)) >= '0' && c <= '9') {
+        mantissa = mantissa * 10 + (c - '0');
+        fc.p++;
+    }
+    /* 小数部分最多取 6 位 */
+    if (cursor_peek(&fc) == '.') {
+        fc.p++;
+        while ((c = cursor_peek(&fc)) >= '0' && c <= '9' && scale < 1000000) {
+            mantissa = mantissa * 10 + (c - '0');
+            scale *= 10;
+            fc.p++;
+        }
+    }
+    if (neg) mantissa = -mantissa;
+    return (double)mantissa / (double)(scale * divisor);
+}
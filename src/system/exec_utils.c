@@ -72,6 +72,79 @@ int run_command(char *output, size_t size, const char *cmd, ...) {
     return WIFEXITED(status) && WEXITSTATUS(status) == 0 ? 0 : -1;
 }
 
+char *run_command_alloc(size_t *len, const char *cmd, ...) {
+    va_list args;
+    char *argv[32];
+    int argc = 0;
+
+    argv[argc++] = (char *)cmd;
+    va_start(args, cmd);
+    char *arg;
+    while ((arg = va_arg(args, char *)) != NULL && argc < 31) {
+        argv[argc++] = arg;
+    }
+    va_end(args);
+    argv[argc] = NULL;
+
+    int pipefd[2];
+    if (pipe(pipefd) == -1) return NULL;
+
+    pid_t pid = fork();
+    if (pid == -1) {
+        close(pipefd[0]);
+        close(pipefd[1]);
+        return NULL;
+    }
+
+    if (pid == 0) {
+        close(pipefd[0]);
+        dup2(pipefd[1], STDOUT_FILENO);
+        dup2(pipefd[1], STDERR_FILENO);
+        close(pipefd[1]);
+        execvp(cmd, argv);
+        _exit(127);
+    }
+
+    close(pipefd[1]);
+
+    /* 读满后按两倍扩容 */
+    size_t cap = 4096, total = 0;
+    char *output = (char *)malloc(cap);
+    ssize_t n;
+    while (output) {
+        if (total + 1 >= cap) {
+            char *bigger = (char *)realloc(output, cap * 2);
+            if (!bigger) {
+                free(output);
+                output = NULL;
+                break;
+            }
+            output = bigger;
+            cap *= 2;
+        }
+        n = read(pipefd[0], output + total, cap - 1 - total);
+        if (n <= 0) break;
+        total += n;
+    }
+    close(pipefd[0]);
+
+    int status;
+    waitpid(pid, &status, 0);
+
+    if (!output) return NULL;
+    if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+        free(output);
+        return NULL;
+    }
+
+    while (total > 0 && (output[total-1] == '\n' || output[total-1] == '\r' || output[total-1] == ' ')) {
+        total--;
+    }
+    output[total] = '\0';
+    if (len) *len = total;
+    return output;
+}
+
 int run_command_timeout(int timeout_sec, char *output, size_t size, const char *cmd, ...) {
     /* 简化实现：直接调用 run_command */
     /* TODO: 实现真正的超时机制 */
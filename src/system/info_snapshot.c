@@ -0,0 +1,130 @@
+/**
+ * @file info_snapshot.c
+ * @brief /api/info 系统信息快照实现
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <glib.h>
+#include "mongoose.h"
+#include "info_snapshot.h"
+#include "sysinfo.h"
+#include "dbus_core.h"
+#include "http_utils.h"
+#include "json_builder.h"
+
+static SystemInfo g_info;
+static char *g_json = NULL;             /* 渲染缓存，NULL 表示需要重新渲染 */
+static gint64 g_slow_at = 0;            /* 各分层上次刷新的单调时间 (微秒)，0 表示过期 */
+static gint64 g_modem_at = 0;
+static gint64 g_lease_until = 0;
+static guint g_timer = 0;
+
+static int is_stale(gint64 at, int secs, gint64 now) {
+    return at == 0 || now - at >= (gint64)secs * G_USEC_PER_SEC;
+}
+
+/* 刷新过期的分层，返回是否有变化 */
+static int refresh_stale(gint64 now) {
+    int changed = 0;
+
+    if (is_stale(g_slow_at, INFO_SLOW_SECS, now)) {
+        sysinfo_read_slow(&g_info);
+        g_slow_at = now;
+        changed = 1;
+    }
+    /* 射频重配置任务独占 AT 通道时保留上次的模组字段，任务结束后再刷新 */
+    if (is_stale(g_modem_at, INFO_MODEM_SECS, now) && !at_channel_reserved()) {
+        sysinfo_read_modem(&g_info);
+        g_modem_at = now;
+        changed = 1;
+    }
+    if (changed) {
+        free(g_json);
+        g_json = NULL;
+    }
+    return changed;
+}
+
+static gboolean info_tick(gpointer user_data) {
+    gint64 now = g_get_monotonic_time();
+    (void)user_data;
+
+    if (now >= g_lease_until) {
+        g_timer = 0;
+        return G_SOURCE_REMOVE;
+    }
+    /* 留半个周期的容差，定时器抖动时不会跳过一轮 */
+    refresh_stale(now + INFO_SLOW_SECS * G_USEC_PER_SEC / 2);
+    return G_SOURCE_CONTINUE;
+}
+
+static char *render(const SystemInfo *info) {
+    JsonBuilder *j = json_new();
+    json_obj_open(j);
+    json_add_str(j, "hostname", info->hostname);
+    json_add_str(j, "sysname", info->sysname);
+    json_add_str(j, "release", info->release);
+    json_add_str(j, "version", info->version);
+    json_add_str(j, "machine", info->machine);
+    json_add_ulong(j, "total_ram", info->total_ram);
+    json_add_ulong(j, "free_ram", info->free_ram);
+    json_add_ulong(j, "cached_ram", info->cached_ram);
+    json_add_double(j, "cpu_usage", info->cpu_usage);
+    json_add_double(j, "uptime", info->uptime);
+    json_add_str(j, "bridge_status", info->bridge_status);
+    json_add_str(j, "sim_slot", info->sim_slot);
+    json_add_str(j, "signal_strength", info->signal_strength);
+    json_add_double(j, "thermal_temp", info->thermal_temp);
+    json_add_str(j, "power_status", info->power_status);
+    json_add_str(j, "battery_health", info->battery_health);
+    json_add_int(j, "battery_capacity", info->battery_capacity);
+    json_add_str(j, "ssid", info->ssid);
+    json_add_str(j, "passwd", info->passwd);
+    json_add_str(j, "select_network_mode", info->select_network_mode);
+    json_add_int(j, "is_activated", info->is_activated);
+    json_add_str(j, "serial", info->serial);
+    json_add_str(j, "network_mode", info->network_mode);
+    json_add_bool(j, "airplane_mode", info->airplane_mode);
+    json_add_str(j, "imei", info->imei);
+    json_add_str(j, "iccid", info->iccid);
+    json_add_str(j, "imsi", info->imsi);
+    json_add_str(j, "carrier", info->carrier);
+    json_add_str(j, "network_type", info->network_type);
+    json_add_str(j, "network_band", info->network_band);
+    json_add_int(j, "qci", info->qci);
+    json_add_int(j, "downlink_rate", info->downlink_rate);
+    json_add_int(j, "uplink_rate", info->uplink_rate);
+    json_obj_close(j);
+    return json_finish(j);
+}
+
+void info_snapshot_init(void) {
+    memset(&g_info, 0, sizeof(g_info));
+    sysinfo_read_static(&g_info);
+}
+
+void info_snapshot_invalidate(void) {
+    g_modem_at = 0;
+}
+
+const char *info_snapshot_json(void) {
+    gint64 now = g_get_monotonic_time();
+
+    g_lease_until = now + (gint64)INFO_LEASE_SECS * G_USEC_PER_SEC;
+    refresh_stale(now);
+    if (!g_timer) {
+        g_timer = g_timeout_add_seconds(INFO_SLOW_SECS, info_tick, NULL);
+    }
+    if (!g_json) {
+        g_json = render(&g_info);
+    }
+    return g_json ? g_json : "{}";
+}
+
+/* GET /api/info - 获取系统信息 */
+void handle_info(struct mg_connection *c, struct mg_http_message *hm) {
+    HTTP_CHECK_GET(c, hm);
+    HTTP_OK(c, info_snapshot_json());
+}
@@ -10,6 +10,7 @@
 #include "modem.h"
 #include "sysinfo.h"
 #include "ofono.h"
+#include "sim_identity.h"
 
 /* 有效的网络模式 */
 static const char *valid_modes[] = {"lte_only", "nr_5g_only", "nr_5g_lte_auto", "nsa_only", NULL};
@@ -111,6 +112,9 @@ int switch_slot(const char *slot) {
         return -1;
     }
 
+    /* 数据卡已变化，身份信息需重读 */
+    sim_identity_invalidate("switch_slot");
+
     /* 等待系统状态更新 */
     sleep(1);
 
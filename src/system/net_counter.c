@@ -0,0 +1,121 @@
+/**
+ * @file net_counter.c
+ * @brief 网卡字节计数器实现
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include "net_counter.h"
+#include "proc_reader.h"
+
+#define NET_SYSFS_DIR  "/sys/class/net"
+
+/* 32 位回绕后允许的最大增量，超过则认为是计数清零 */
+#define NET_WRAP32_MAX_DELTA  0x80000000ULL
+
+static int open_stat(const char *iface, const char *name) {
+    char path[128];
+    snprintf(path, sizeof(path), NET_SYSFS_DIR "/%s/statistics/%s", iface, name);
+    return open(path, O_RDONLY | O_CLOEXEC);
+}
+
+static int read_ifindex(const char *iface) {
+    char path[128];
+    uint64_t idx = 0;
+    int fd;
+
+    snprintf(path, sizeof(path), NET_SYSFS_DIR "/%s/ifindex", iface);
+    fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return 0;
+    proc_pread_u64(fd, &idx);
+    close(fd);
+    return (int)idx;
+}
+
+static int open_files(NetCounter *nc) {
+    nc->rx_fd = open_stat(nc->iface, "rx_bytes");
+    nc->tx_fd = open_stat(nc->iface, "tx_bytes");
+    if (nc->rx_fd < 0 || nc->tx_fd < 0) {
+        net_counter_close(nc);
+        return -1;
+    }
+    nc->ifindex = read_ifindex(nc->iface);
+    return 0;
+}
+
+void net_counter_init(NetCounter *nc, const char *iface) {
+    memset(nc, 0, sizeof(*nc));
+    snprintf(nc->iface, sizeof(nc->iface), "%s", iface);
+    nc->rx_fd = -1;
+    nc->tx_fd = -1;
+    open_files(nc);
+}
+
+void net_counter_close(NetCounter *nc) {
+    if (nc->rx_fd >= 0) close(nc->rx_fd);
+    if (nc->tx_fd >= 0) close(nc->tx_fd);
+    nc->rx_fd = -1;
+    nc->tx_fd = -1;
+}
+
+int net_counter_read_raw(NetCounter *nc, uint64_t *rx, uint64_t *tx) {
+    /* 网卡被删除后旧 fd 读取失败，重新打开一次 */
+    for (int attempt = 0; attempt < 2; attempt++) {
+        if (nc->rx_fd < 0 && open_files(nc) != 0) {
+            return -1;
+        }
+        if (proc_pread_u64(nc->rx_fd, rx) == 0 && proc_pread_u64(nc->tx_fd, tx) == 0) {
+            return 0;
+        }
+        net_counter_close(nc);
+    }
+    return -1;
+}
+
+/* maybe_32bit: 该计数从未超过 UINT32_MAX, 才允许按 32 位回绕处理 */
+static uint64_t counter_delta(uint64_t last, uint64_t cur, int maybe_32bit) {
+    if (cur >= last) return cur - last;
+
+    if (maybe_32bit && last <= UINT32_MAX) {
+        uint64_t wrapped = cur + (((uint64_t)UINT32_MAX + 1) - last);
+        if (wrapped < NET_WRAP32_MAX_DELTA) return wrapped;
+    }
+    return cur;
+}
+
+uint64_t net_counter_delta(uint64_t last, uint64_t cur) {
+    return counter_delta(last, cur, 1);
+}
+
+int net_counter_update(NetCounter *nc) {
+    int old_ifindex = nc->ifindex;
+    uint64_t rx, tx;
+
+    if (net_counter_read_raw(nc, &rx, &tx) != 0) {
+        return -1;
+    }
+
+    /* 64 位计数的 cur < last 只能是清零，不能按 32 位回绕累加 */
+    if (rx > UINT32_MAX) nc->wide_rx = 1;
+    if (tx > UINT32_MAX) nc->wide_tx = 1;
+
+    if (nc->primed) {
+        if (nc->ifindex != old_ifindex) {
+            /* 网卡重建，新计数从 0 开始 */
+            printf("[NetCounter] %s 已重建 (ifindex %d -> %d)\n", nc->iface, old_ifindex, nc->ifindex);
+            nc->total_rx += rx;
+            nc->total_tx += tx;
+        } else {
+            nc->total_rx += counter_delta(nc->last_rx, rx, !nc->wide_rx);
+            nc->total_tx += counter_delta(nc->last_tx, tx, !nc->wide_tx);
+        }
+    }
+
+    nc->last_rx = rx;
+    nc->last_tx = tx;
+    nc->primed = 1;
+    return 0;
+}
@@ -17,6 +17,7 @@
 #include "ofono.h"
 #include "dbus_core.h"
 #include "sysinfo.h"
+#include "sim_identity.h"
 
 /* ==================== 常量定义 ==================== */
 #define OFONO_MODEM_IFACE   "org.ofono.Modem"
@@ -33,6 +34,7 @@ int ofono_is_data_monitor_running(void);
 static GDBusConnection *g_dbus_conn = NULL;
 static GDBusProxy *g_modem_proxy = NULL;
 static pthread_mutex_t g_at_mutex = PTHREAD_MUTEX_INITIALIZER;
+static volatile int g_at_reserved = 0;     /* 射频重配置任务独占 AT 通道 */
 static char g_last_error[512] = {0};
 static char g_modem_path[64] = DEFAULT_MODEM_PATH;
 
@@ -156,37 +158,15 @@ void close_dbus(void) {
     printf("D-Bus 连接已关闭\n");
 }
 
-int execute_at(const char *command, char **result) {
+/* 发送一条 AT 命令 (调用者需持有 g_at_mutex) */
+static int execute_at_locked(const char *command, int timeout_ms, char **result) {
     GError *error = NULL;
     GVariant *ret = NULL;
     int rc = -1;
     int retry;
 
-    if (!command || !result) {
-        set_error("无效的参数");
-        return -1;
-    }
     *result = NULL;
-
-    /* 去除首尾空白 */
-    while (*command == ' ' || *command == '\t') command++;
-
-    /* 验证 AT 命令格式 */
-    if (!validate_at_command(command)) {
-        set_error("无效的 AT 命令格式: %s", command);
-        return -1;
-    }
-
-    /* 检查 D-Bus 是否已初始化 */
-    if (!is_dbus_initialized()) {
-        printf("D-Bus 未初始化，尝试初始化...\n");
-        if (init_dbus() != 0) {
-            return -1;
-        }
-    }
-
-    /* 获取互斥锁，确保串行执行 */
-    pthread_mutex_lock(&g_at_mutex);
+    if (timeout_ms <= 0) timeout_ms = AT_COMMAND_TIMEOUT;
 
     printf("准备发送 AT 命令: %s\n", command);
 
@@ -200,7 +180,7 @@ int execute_at(const char *command, char **result) {
             "SendAtcmd",
             g_variant_new("(s)", command),
             G_DBUS_CALL_FLAGS_NONE,
-            AT_COMMAND_TIMEOUT,
+            timeout_ms,
             NULL,
             &error
         );
@@ -252,10 +232,331 @@ int execute_at(const char *command, char **result) {
         break;
     }
 
+    return rc;
+}
+
+/* 检查并准备 D-Bus 连接 */
+static int prepare_at_channel(void) {
+    if (!is_dbus_initialized()) {
+        printf("D-Bus 未初始化，尝试初始化...\n");
+        if (init_dbus() != 0) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+int execute_at(const char *command, char **result) {
+    int rc;
+
+    if (!command || !result) {
+        set_error("无效的参数");
+        return -1;
+    }
+    *result = NULL;
+
+    /* 去除首尾空白 */
+    while (*command == ' ' || *command == '\t') command++;
+
+    /* 验证 AT 命令格式 */
+    if (!validate_at_command(command)) {
+        set_error("无效的 AT 命令格式: %s", command);
+        return -1;
+    }
+
+    /* 检查 D-Bus 是否已初始化 */
+    if (prepare_at_channel() != 0) {
+        return -1;
+    }
+
+    /* 获取互斥锁，确保串行执行 */
+    pthread_mutex_lock(&g_at_mutex);
+    if (g_at_reserved) {
+        set_error("射频重配置进行中，AT 通道被占用");
+        rc = -1;
+    } else {
+        rc = execute_at_locked(command, AT_COMMAND_TIMEOUT, result);
+    }
     pthread_mutex_unlock(&g_at_mutex);
     return rc;
 }
 
+/* ==================== AT 命令序列 ==================== */
+
+/* 判断响应是否满足期望: expect 为 NULL 时只要求不含 ERROR */
+int at_response_matches(const char *response, const char *expect) {
+    if (!response) return 0;
+    if (expect) return strstr(response, expect) != NULL;
+    return strstr(response, "ERROR") == NULL;
+}
+
+void at_channel_reserve(int reserve) {
+    /* 加锁后设置: 其他线程正在执行的同步命令先完成，之后的调用都能看到标志 */
+    pthread_mutex_lock(&g_at_mutex);
+    g_at_reserved = reserve ? 1 : 0;
+    pthread_mutex_unlock(&g_at_mutex);
+}
+
+int at_channel_reserved(void) {
+    return g_at_reserved;
+}
+
+typedef struct {
+    char *command;
+    int timeout_ms;
+    int retries;
+    AtAsyncCallback cb;
+    void *user_data;
+} AtAsyncCall;
+
+static void at_async_send(AtAsyncCall *call);
+
+static void at_async_done(AtAsyncCall *call, int rc, const char *response) {
+    call->cb(rc, response, call->user_data);
+    g_free(call->command);
+    g_free(call);
+}
+
+static gboolean at_async_retry_cb(gpointer user_data) {
+    at_async_send((AtAsyncCall *)user_data);
+    return G_SOURCE_REMOVE;
+}
+
+static void on_at_async_reply(GObject *source, GAsyncResult *res, gpointer user_data) {
+    AtAsyncCall *call = (AtAsyncCall *)user_data;
+    GError *error = NULL;
+    GVariant *ret = g_dbus_proxy_call_finish(G_DBUS_PROXY(source), res, &error);
+
+    if (!ret) {
+        printf("调用 SendAtcmd 失败 (%s): %s\n", call->command, error ? error->message : "unknown");
+        /* 与同步路径一致: 操作进行中时 500ms 后重试 */
+        if (error && strstr(error->message, "Operation already in progress") &&
+            call->retries++ < MAX_RETRIES) {
+            g_error_free(error);
+            g_timeout_add(500, at_async_retry_cb, call);
+            return;
+        }
+        set_error("调用 SendAtcmd 失败: %s", error ? error->message : "unknown");
+        if (error) g_error_free(error);
+        at_async_done(call, -1, NULL);
+        return;
+    }
+
+    const gchar *res_str = NULL;
+    g_variant_get(ret, "(&s)", &res_str);
+    char *response = g_strstrip(g_strdup(res_str ? res_str : ""));
+    printf("AT 命令 (%s) 响应: %s\n", call->command, response);
+    at_async_done(call, 0, response);
+    g_free(response);
+    g_variant_unref(ret);
+}
+
+static void at_async_send(AtAsyncCall *call) {
+    g_dbus_proxy_call(g_modem_proxy, "SendAtcmd", g_variant_new("(s)", call->command),
+                      G_DBUS_CALL_FLAGS_NONE, call->timeout_ms, NULL, on_at_async_reply, call);
+}
+
+int execute_at_async(const char *command, int timeout_ms, AtAsyncCallback cb, void *user_data) {
+    if (!command || !cb || !validate_at_command(command)) {
+        set_error("无效的 AT 命令: %s", command ? command : "");
+        return -1;
+    }
+    if (prepare_at_channel() != 0) {
+        return -1;
+    }
+
+    AtAsyncCall *call = g_new0(AtAsyncCall, 1);
+    call->command = g_strdup(command);
+    call->timeout_ms = timeout_ms > 0 ? timeout_ms : AT_COMMAND_TIMEOUT;
+    call->cb = cb;
+    call->user_data = user_data;
+    printf("准备发送 AT 命令 (异步): %s\n", command);
+    at_async_send(call);
+    return 0;
+}
+
+/* 序列步骤间隔: 大于 0 才能让出主循环给 mongoose (见 http_server_run) */
+#define AT_SEQ_STEP_GAP_MS  10
+
+/* 当前执行的 AT 序列 (AT 通道独占，同一时间只有一个) */
+typedef struct {
+    const AtStep *steps;
+    AtStepResult *results;
+    int count;
+    int current;                /* 当前步骤下标 */
+    int failed;                 /* 已有必选步骤失败 */
+    int waiting;                /* 当前步骤处于状态等待阶段 */
+    gint64 start_us;
+    gint64 step_start_us;
+    gint64 wait_deadline_us;
+    char message[256];          /* 首个失败原因 */
+    AtSequenceStepCallback on_step;
+    AtSequenceDoneCallback on_done;
+    void *user_data;
+} AtSequence;
+
+static AtSequence g_seq;
+static int g_seq_running = 0;
+
+static gboolean seq_tick(gpointer user_data);
+
+static void seq_schedule(guint delay_ms) {
+    g_timeout_add(delay_ms, seq_tick, NULL);
+}
+
+static void seq_fail(const char *fmt, ...) {
+    if (g_seq.failed) return;
+    g_seq.failed = 1;
+
+    va_list args;
+    va_start(args, fmt);
+    vsnprintf(g_seq.message, sizeof(g_seq.message), fmt, args);
+    va_end(args);
+}
+
+static void seq_finish(void) {
+    AtSequence seq = g_seq;
+    int total_ms = (int)((g_get_monotonic_time() - seq.start_us) / 1000);
+
+    /* 先释放通道再回调，回调里可以直接发起新的 AT 调用 */
+    g_seq_running = 0;
+    at_channel_reserve(0);
+    seq.on_done(seq.failed ? -1 : 0, seq.message, total_ms, seq.user_data);
+}
+
+/* 当前步骤完成，进入下一步 */
+static void seq_complete_step(void) {
+    const AtStep *step = &g_seq.steps[g_seq.current];
+    AtStepResult *res = &g_seq.results[g_seq.current];
+
+    res->elapsed_ms = (int)((g_get_monotonic_time() - g_seq.step_start_us) / 1000);
+    printf("[AT序列] 步骤 %d/%d %s: rc=%d, %dms\n", g_seq.current + 1, g_seq.count,
+           step->command, res->rc, res->elapsed_ms);
+
+    if (res->rc == AT_STEP_FAILED && !(step->flags & AT_STEP_OPTIONAL)) {
+        seq_fail("%s", g_last_error);
+    }
+
+    if (g_seq.on_step) {
+        g_seq.on_step(g_seq.current, g_seq.user_data);
+    }
+
+    g_seq.waiting = 0;
+    g_seq.current++;
+    if (g_seq.current >= g_seq.count) {
+        seq_finish();
+    } else {
+        seq_schedule(AT_SEQ_STEP_GAP_MS);
+    }
+}
+
+/* 状态查询响应 */
+static void on_seq_poll_reply(int rc, const char *response, void *user_data) {
+    const AtStep *step = &g_seq.steps[g_seq.current];
+    AtStepResult *res = &g_seq.results[g_seq.current];
+    (void)user_data;
+
+    res->polls++;
+    if (rc == 0 && at_response_matches(response, step->wait_expect)) {
+        seq_complete_step();
+    } else if (g_get_monotonic_time() >= g_seq.wait_deadline_us) {
+        res->rc = AT_STEP_WAIT_TIMEOUT;
+        if (!(step->flags & AT_STEP_OPTIONAL)) {
+            seq_fail("%s 等待 %s 超时", step->command, step->wait_expect ? step->wait_expect : "");
+        }
+        seq_complete_step();
+    } else {
+        seq_schedule(AT_WAIT_POLL_MS);
+    }
+}
+
+/* 步骤命令响应 */
+static void on_seq_step_reply(int rc, const char *response, void *user_data) {
+    const AtStep *step = &g_seq.steps[g_seq.current];
+    AtStepResult *res = &g_seq.results[g_seq.current];
+    (void)user_data;
+
+    if (rc != 0) {
+        res->rc = AT_STEP_FAILED;
+    } else if (!at_response_matches(response, step->expect)) {
+        res->rc = AT_STEP_UNEXPECTED;
+        if (!(step->flags & AT_STEP_OPTIONAL)) {
+            seq_fail("%s 响应不符: %s", step->command, response);
+        }
+    } else {
+        res->rc = AT_STEP_OK;
+    }
+
+    if (res->rc == AT_STEP_OK && step->wait_cmd) {
+        g_seq.waiting = 1;
+        g_seq.wait_deadline_us = g_seq.step_start_us + (gint64)step->wait_timeout_ms * 1000;
+        seq_schedule(AT_WAIT_POLL_MS);
+        return;
+    }
+    seq_complete_step();
+}
+
+static gboolean seq_tick(gpointer user_data) {
+    (void)user_data;
+
+    if (!g_seq_running || g_seq.current >= g_seq.count) {
+        return G_SOURCE_REMOVE;
+    }
+
+    const AtStep *step = &g_seq.steps[g_seq.current];
+
+    if (!g_seq.waiting) {
+        g_seq.step_start_us = g_get_monotonic_time();
+
+        /* 已失败时只执行收尾步骤 (恢复射频) */
+        if (g_seq.failed && !(step->flags & AT_STEP_ALWAYS)) {
+            g_seq.results[g_seq.current].rc = AT_STEP_SKIPPED;
+            seq_complete_step();
+        } else if (execute_at_async(step->command, step->timeout_ms, on_seq_step_reply, NULL) != 0) {
+            on_seq_step_reply(-1, NULL, NULL);
+        }
+        return G_SOURCE_REMOVE;
+    }
+
+    /* 状态等待阶段: 每次回调查询一次 */
+    if (execute_at_async(step->wait_cmd, step->timeout_ms, on_seq_poll_reply, NULL) != 0) {
+        on_seq_poll_reply(-1, NULL, NULL);
+    }
+    return G_SOURCE_REMOVE;
+}
+
+int execute_at_sequence(const AtStep *steps, int count, AtStepResult *results,
+                        AtSequenceStepCallback on_step, AtSequenceDoneCallback on_done,
+                        void *user_data) {
+    if (!steps || !results || !on_done || count <= 0) {
+        set_error("无效的参数");
+        return -1;
+    }
+    if (g_seq_running) {
+        set_error("已有 AT 序列在执行");
+        return -1;
+    }
+
+    memset(&g_seq, 0, sizeof(g_seq));
+    memset(results, 0, sizeof(AtStepResult) * count);
+    g_seq.steps = steps;
+    g_seq.results = results;
+    g_seq.count = count;
+    g_seq.on_step = on_step;
+    g_seq.on_done = on_done;
+    g_seq.user_data = user_data;
+    g_seq.start_us = g_get_monotonic_time();
+    g_seq_running = 1;
+
+    at_channel_reserve(1);
+    seq_schedule(0);
+    return 0;
+}
+
+int at_sequence_running(void) {
+    return g_seq_running;
+}
+
 /* ==================== ofono.h 接口实现 ==================== */
 
 int ofono_init(void) {
@@ -1585,6 +1886,7 @@ int ofono_is_watchdog_running(void) {
 static guint g_context_signal_id = 0;      /* ConnectionContext 信号订阅 ID */
 static guint g_network_signal_id = 0;      /* NetworkRegistration 信号订阅 ID */
 static guint g_manager_signal_id = 0;      /* Manager 信号订阅 ID (监听切卡) */
+static guint g_sim_signal_id = 0;          /* SimManager 信号订阅 ID (插拔卡) */
 static guint g_ofono_monitor_watch_id = 0; /* oFono 服务监控 ID */
 static volatile int g_data_monitor_running = 0;
 static GDBusConnection *g_monitor_dbus_conn = NULL;
@@ -1726,6 +2028,7 @@ static void on_manager_property_changed(GDBusConnection *conn, const gchar *send
     if (g_strcmp0(prop_name, "DataCard") == 0) {
         const gchar *new_datacard = g_variant_get_string(prop_value, NULL);
         printf("[DataMonitor] 检测到切卡: %s\n", new_datacard);
+        sim_identity_invalidate("DataCard 变化");
         
         /* 重新订阅信号（使用新的卡槽路径） */
         printf("[DataMonitor] 重新订阅信号...\n");
@@ -1761,6 +2064,31 @@ static void on_manager_property_changed(GDBusConnection *conn, const gchar *send
     g_variant_unref(prop_value);
 }
 
+/**
+ * SimManager PropertyChanged 信号回调
+ * 插拔卡、ICCID/IMSI 变化时更新身份缓存
+ */
+static void on_sim_property_changed(GDBusConnection *conn, const gchar *sender_name,
+    const gchar *object_path, const gchar *interface_name, const gchar *signal_name,
+    GVariant *parameters, gpointer user_data) {
+    
+    (void)conn; (void)sender_name; (void)interface_name; (void)signal_name; (void)user_data;
+    
+    if (!g_variant_is_of_type(parameters, G_VARIANT_TYPE("(sv)"))) {
+        return;
+    }
+    
+    const gchar *prop_name = NULL;
+    GVariant *prop_value = NULL;
+    g_variant_get(parameters, "(&sv)", &prop_name, &prop_value);
+    
+    if (prop_name && prop_value) {
+        sim_identity_on_sim_property(object_path, prop_name, prop_value);
+    }
+    
+    if (prop_value) g_variant_unref(prop_value);
+}
+
 /**
  * 订阅数据监听信号
  */
@@ -1893,6 +2221,41 @@ static void subscribe_data_monitor_signals(void) {
         NULL, NULL
     );
     printf("[DataMonitor] Manager 信号订阅 ID: %u (监听切卡)\n", g_manager_signal_id);
+    
+    /* 添加 D-Bus match 规则 - SimManager PropertyChanged (插拔卡) */
+    result = g_dbus_connection_call_sync(
+        g_monitor_dbus_conn,
+        "org.freedesktop.DBus",
+        "/org/freedesktop/DBus",
+        "org.freedesktop.DBus",
+        "AddMatch",
+        g_variant_new("(s)", "type='signal',interface='org.ofono.SimManager',member='PropertyChanged'"),
+        NULL,
+        G_DBUS_CALL_FLAGS_NONE,
+        -1, NULL, &error
+    );
+    
+    if (error) {
+        printf("[DataMonitor] 添加 SimManager match 规则失败: %s\n", error->message);
+        g_error_free(error);
+        error = NULL;
+    } else {
+        if (result) g_variant_unref(result);
+    }
+    
+    /* 订阅 SimManager PropertyChanged 信号 (所有卡槽，回调中按路径过滤) */
+    g_sim_signal_id = g_dbus_connection_signal_subscribe(
+        g_monitor_dbus_conn,
+        OFONO_SERVICE,
+        "org.ofono.SimManager",
+        "PropertyChanged",
+        NULL,
+        NULL,
+        G_DBUS_SIGNAL_FLAGS_NONE,
+        on_sim_property_changed,
+        NULL, NULL
+    );
+    printf("[DataMonitor] SimManager 信号订阅 ID: %u\n", g_sim_signal_id);
 }
 
 /**
@@ -1916,6 +2279,11 @@ static void unsubscribe_data_monitor_signals(void) {
         printf("[DataMonitor] 已取消 Manager 信号订阅\n");
     }
     g_manager_signal_id = 0;
+    
+    if (g_sim_signal_id > 0 && g_monitor_dbus_conn) {
+        g_dbus_connection_signal_unsubscribe(g_monitor_dbus_conn, g_sim_signal_id);
+    }
+    g_sim_signal_id = 0;
 }
 
 /**
@@ -1930,6 +2298,9 @@ static void on_ofono_monitor_appeared(GDBusConnection *conn, const gchar *name,
     /* 重新订阅信号 */
     subscribe_data_monitor_signals();
     
+    /* oFono 重启后 SIM 状态未知，身份信息需重读 */
+    sim_identity_invalidate("oFono 启动");
+    
     /* 立即检查一次数据连接状态 */
     char result[256];
     if (ofono_check_and_restore_data(result, sizeof(result)) >= 0) {
@@ -1947,6 +2318,7 @@ static void on_ofono_monitor_vanished(GDBusConnection *conn, const gchar *name,
     
     /* 取消信号订阅 */
     unsubscribe_data_monitor_signals();
+    sim_identity_invalidate("oFono 停止");
 }
 
 /**
@@ -0,0 +1,133 @@
+/**
+ * @file proc_reader.c
+ * @brief /proc 和 sysfs 文件的零分配读取与键值扫描实现
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include "proc_reader.h"
+
+void proc_file_init(ProcFile *f, const char *path, char *buf, size_t cap) {
+    f->path = path;
+    f->fd = -1;
+    f->oneshot = 0;
+    f->buf = buf;
+    f->cap = cap;
+    f->len = 0;
+}
+
+int proc_file_read(ProcFile *f) {
+    f->len = 0;
+    if (f->cap < 2) return -1;
+
+    for (int attempt = 0; attempt < 2; attempt++) {
+        if (f->fd < 0) f->fd = open(f->path, O_RDONLY | O_CLOEXEC);
+        if (f->fd < 0) break;
+
+        ssize_t n = pread(f->fd, f->buf, f->cap - 1, 0);
+        if (n >= 0) {
+            f->buf[n] = '\0';
+            f->len = (size_t)n;
+            if (f->oneshot) proc_file_close(f);
+            return (int)n;
+        }
+        proc_file_close(f);
+    }
+    f->buf[0] = '\0';
+    return -1;
+}
+
+void proc_file_close(ProcFile *f) {
+    if (f->fd >= 0) close(f->fd);
+    f->fd = -1;
+}
+
+int proc_file_read_ll(ProcFile *f, long long *out) {
+    char *end;
+
+    if (proc_file_read(f) <= 0) return -1;
+    long long v = strtoll(f->buf, &end, 10);
+    if (end == f->buf) return -1;
+    *out = v;
+    return 0;
+}
+
+int proc_pread_u64(int fd, uint64_t *out) {
+    char buf[32];
+    char *end;
+
+    ssize_t n = pread(fd, buf, sizeof(buf) - 1, 0);
+    if (n <= 0) return -1;
+    buf[n] = '\0';
+    uint64_t v = strtoull(buf, &end, 10);
+    if (end == buf) return -1;
+    *out = v;
+    return 0;
+}
+
+ProcScan proc_scan_mem(const char *buf, size_t len, char sep) {
+    ProcScan s = {buf, buf + len, sep};
+    return s;
+}
+
+ProcScan proc_scan_begin(const ProcFile *f, char sep) {
+    return proc_scan_mem(f->buf, f->len, sep);
+}
+
+static int is_blank(char c) {
+    return c == ' ' || c == '\t' || c == '\r';
+}
+
+int proc_scan_next(ProcScan *s, ProcKV *kv) {
+    while (s->p < s->end) {
+        const char *line = s->p;
+        const char *eol = memchr(line, '\n', (size_t)(s->end - line));
+        if (!eol) eol = s->end;
+        s->p = eol < s->end ? eol + 1 : eol;
+
+        const char *sep = memchr(line, s->sep, (size_t)(eol - line));
+        if (!sep) continue;
+
+        const char *k = line, *ke = sep;
+        while (k < ke && is_blank(*k)) k++;
+        while (ke > k && is_blank(ke[-1])) ke--;
+
+        const char *v = sep + 1, *ve = eol;
+        while (v < ve && is_blank(*v)) v++;
+        while (ve > v && is_blank(ve[-1])) ve--;
+
+        kv->key = k;
+        kv->key_len = (size_t)(ke - k);
+        kv->val = v;
+        kv->val_len = (size_t)(ve - v);
+        return 1;
+    }
+    return 0;
+}
+
+int proc_kv_is(const ProcKV *kv, const char *name) {
+    size_t n = strlen(name);
+    return kv->key_len == n && memcmp(kv->key, name, n) == 0;
+}
+
+long long proc_kv_ll(const ProcKV *kv) {
+    long long v = 0;
+    size_t i = 0;
+    int neg = kv->val_len > 0 && kv->val[0] == '-';
+
+    for (i = neg; i < kv->val_len; i++) {
+        unsigned d = (unsigned)(kv->val[i] - '0');
+        if (d > 9) break;
+        v = v * 10 + d;
+    }
+    return neg ? -v : v;
+}
+
+void proc_kv_copy(const ProcKV *kv, char *out, size_t size) {
+    if (size == 0) return;
+    size_t n = kv->val_len < size - 1 ? kv->val_len : size - 1;
+    memcpy(out, kv->val, n);
+    out[n] = '\0';
+}
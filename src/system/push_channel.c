@@ -0,0 +1,179 @@
+/**
+ * @file push_channel.c
+ * @brief WebSocket 推送通道实现
+ *
+ * 订阅掩码保存在 mg_connection::data 中，不额外分配内存。
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <glib.h>
+#include "mongoose.h"
+#include "push_channel.h"
+#include "auth.h"
+#include "http_utils.h"
+
+#define PUSH_MAGIC        0x50555348u   /* "PUSH" */
+#define PUSH_MAX_TOPICS   8
+#define PUSH_MAX_BACKLOG  (64 * 1024)   /* 发送缓冲超过此值时丢帧，防止慢客户端占满内存 */
+
+/* 存放在 c->data 中的连接状态 */
+typedef struct {
+    uint32_t magic;
+    uint32_t topics;
+} PushConnData;
+
+static const char *g_topic_names[PUSH_MAX_TOPICS] = {"throughput", "signal"};
+
+static struct mg_mgr *g_mgr = NULL;
+static int g_watchers[PUSH_MAX_TOPICS];
+static push_watch_callback_t g_watch_cb[PUSH_MAX_TOPICS];
+
+static PushConnData *conn_data(struct mg_connection *c) {
+    PushConnData *d = (PushConnData *)c->data;
+    return d->magic == PUSH_MAGIC ? d : NULL;
+}
+
+static unsigned topic_from_name(const char *name, size_t len) {
+    for (int i = 0; i < PUSH_MAX_TOPICS; i++) {
+        if (g_topic_names[i] && strlen(g_topic_names[i]) == len &&
+            strncmp(g_topic_names[i], name, len) == 0) {
+            return 1u << i;
+        }
+    }
+    return 0;
+}
+
+static const char *topic_name(unsigned topic) {
+    for (int i = 0; i < PUSH_MAX_TOPICS; i++) {
+        if (topic == (1u << i)) return g_topic_names[i] ? g_topic_names[i] : "";
+    }
+    return "";
+}
+
+/* 修改订阅并通知订阅人数发生变化的主题 */
+static void set_topics(PushConnData *d, uint32_t topics) {
+    uint32_t changed = d->topics ^ topics;
+
+    d->topics = topics;
+    for (int i = 0; i < PUSH_MAX_TOPICS; i++) {
+        if (!(changed & (1u << i))) continue;
+        g_watchers[i] += (topics & (1u << i)) ? 1 : -1;
+        if (g_watch_cb[i]) g_watch_cb[i](1u << i, g_watchers[i]);
+    }
+}
+
+/* 解析逗号分隔的主题列表 */
+static uint32_t parse_topics(const char *list) {
+    uint32_t mask = 0;
+    const char *p = list;
+
+    while (*p) {
+        const char *end = strchr(p, ',');
+        size_t len = end ? (size_t)(end - p) : strlen(p);
+        mask |= topic_from_name(p, len);
+        if (!end) break;
+        p = end + 1;
+    }
+    return mask;
+}
+
+/* Token 只允许字母数字，避免拼入 SQL */
+static int token_valid(const char *token) {
+    if (!token[0]) return 0;
+    for (const char *p = token; *p; p++) {
+        if (!g_ascii_isalnum(*p)) return 0;
+    }
+    return auth_verify_token(token) == 0;
+}
+
+void push_init(struct mg_mgr *mgr) {
+    g_mgr = mgr;
+}
+
+void push_handle_upgrade(struct mg_connection *c, struct mg_http_message *hm) {
+    char token[65] = {0};
+    char topics[128] = {0};
+
+    /* 优先使用 Authorization 头，其次是查询参数 */
+    struct mg_str *auth = mg_http_get_header(hm, "Authorization");
+    if (auth && auth->len > 7 && auth->len - 7 < sizeof(token) &&
+        strncmp(auth->buf, "Bearer ", 7) == 0) {
+        memcpy(token, auth->buf + 7, auth->len - 7);
+    } else {
+        mg_http_get_var(&hm->query, "token", token, sizeof(token));
+    }
+    if (!token_valid(token)) {
+        HTTP_JSON(c, 401, "{\"status\":\"error\",\"message\":\"未授权，请先登录\"}");
+        return;
+    }
+
+    mg_http_get_var(&hm->query, "topics", topics, sizeof(topics));
+
+    mg_ws_upgrade(c, hm, NULL);
+
+    PushConnData *d = (PushConnData *)c->data;
+    memset(d, 0, sizeof(*d));
+    d->magic = PUSH_MAGIC;
+    set_topics(d, parse_topics(topics));
+    printf("[Push] 新连接 %lu, 订阅 0x%x\n", c->id, d->topics);
+}
+
+void push_handle_message(struct mg_connection *c, struct mg_ws_message *wm) {
+    PushConnData *d = conn_data(c);
+    char *name;
+
+    if (!d) return;
+
+    if ((name = mg_json_get_str(wm->data, "$.sub")) != NULL) {
+        set_topics(d, d->topics | parse_topics(name));
+        free(name);
+    }
+    if ((name = mg_json_get_str(wm->data, "$.unsub")) != NULL) {
+        set_topics(d, d->topics & ~parse_topics(name));
+        free(name);
+    }
+}
+
+void push_handle_close(struct mg_connection *c) {
+    PushConnData *d = conn_data(c);
+    if (!d) return;
+
+    set_topics(d, 0);
+    d->magic = 0;
+    printf("[Push] 连接 %lu 关闭\n", c->id);
+}
+
+int push_watchers(unsigned topic) {
+    int n = 0;
+    for (int i = 0; i < PUSH_MAX_TOPICS; i++) {
+        if (topic & (1u << i)) n += g_watchers[i];
+    }
+    return n;
+}
+
+void push_set_watch_callback(unsigned topic, push_watch_callback_t cb) {
+    for (int i = 0; i < PUSH_MAX_TOPICS; i++) {
+        if (topic & (1u << i)) g_watch_cb[i] = cb;
+    }
+}
+
+int push_publish(unsigned topic, const char *json) {
+    int sent = 0;
+
+    if (!g_mgr || push_watchers(topic) == 0) return 0;
+
+    for (struct mg_connection *c = g_mgr->conns; c; c = c->next) {
+        PushConnData *d;
+        if (!c->is_websocket || c->is_closing || !(d = conn_data(c)) || !(d->topics & topic)) {
+            continue;
+        }
+        if (c->send.len > PUSH_MAX_BACKLOG) {
+            continue;
+        }
+        mg_ws_printf(c, WEBSOCKET_OP_TEXT, "{\"topic\":\"%s\",\"data\":%s}", topic_name(topic), json);
+        sent++;
+    }
+    return sent;
+}
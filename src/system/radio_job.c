@@ -0,0 +1,171 @@
+/**
+ * @file radio_job.c
+ * @brief 射频重配置异步任务实现
+ *
+ * 步骤由 execute_at_sequence 异步执行: 每步一条 AT 命令 (或一次状态查询)，
+ * 响应回调里推进，等待期间主循环继续处理 HTTP 请求。任务执行期间独占
+ * AT 通道，其他模块的 AT 调用直接失败，不会插入到序列中间。
+ * 这里只负责任务编号、步骤复制和进度查询。
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <glib.h>
+#include "mongoose.h"
+#include "radio_job.h"
+#include "http_utils.h"
+#include "json_builder.h"
+#include "sim_identity.h"
+#include "info_snapshot.h"
+
+typedef struct {
+    int id;
+    char name[32];
+    char ok_msg[64];
+    RadioJobState state;
+    AtStep steps[RADIO_JOB_MAX_STEPS];
+    AtStepResult results[RADIO_JOB_MAX_STEPS];
+    int count;
+    int current;                /* 已完成的步骤数 */
+    gint64 start_us;
+    int total_ms;
+    char message[256];
+} RadioJob;
+
+static RadioJob g_job;
+static int g_next_job_id = 1;
+
+static const char *job_state_name(RadioJobState state) {
+    switch (state) {
+        case RADIO_JOB_RUNNING: return "running";
+        case RADIO_JOB_DONE:    return "done";
+        case RADIO_JOB_FAILED:  return "failed";
+        default:                return "idle";
+    }
+}
+
+/* 释放任务持有的步骤字符串 */
+static void job_free_steps(RadioJob *job) {
+    for (int i = 0; i < job->count; i++) {
+        g_free((char *)job->steps[i].command);
+        g_free((char *)job->steps[i].expect);
+        g_free((char *)job->steps[i].wait_cmd);
+        g_free((char *)job->steps[i].wait_expect);
+    }
+    memset(job->steps, 0, sizeof(job->steps));
+    job->count = 0;
+}
+
+static void on_job_step(int step, void *user_data) {
+    (void)user_data;
+    g_job.current = step + 1;
+}
+
+static void on_job_done(int rc, const char *message, int total_ms, void *user_data) {
+    (void)user_data;
+    g_job.total_ms = total_ms;
+    if (rc != 0) {
+        g_job.state = RADIO_JOB_FAILED;
+        snprintf(g_job.message, sizeof(g_job.message), "%s", message);
+    } else {
+        g_job.state = RADIO_JOB_DONE;
+        snprintf(g_job.message, sizeof(g_job.message), "%s", g_job.ok_msg);
+    }
+    printf("[RadioJob] 任务 %d (%s) 结束: %s, 耗时 %dms\n", g_job.id, g_job.name,
+           job_state_name(g_job.state), g_job.total_ms);
+
+    /* 任务期间推迟的身份/系统信息刷新在这里补上 */
+    sim_identity_resume();
+    info_snapshot_invalidate();
+}
+
+int radio_job_start(const char *name, const char *ok_msg, const AtStep *steps, int count) {
+    if (!steps || count <= 0 || count > RADIO_JOB_MAX_STEPS) {
+        return -1;
+    }
+    if (g_job.state == RADIO_JOB_RUNNING) {
+        printf("[RadioJob] 任务 %d (%s) 执行中，拒绝新任务 %s\n", g_job.id, g_job.name, name);
+        return RADIO_JOB_BUSY;
+    }
+    if (at_sequence_running()) {
+        printf("[RadioJob] AT 序列执行中，拒绝新任务 %s\n", name);
+        return RADIO_JOB_BUSY;
+    }
+
+    job_free_steps(&g_job);
+    memset(&g_job, 0, sizeof(g_job));
+
+    g_job.id = g_next_job_id++;
+    snprintf(g_job.name, sizeof(g_job.name), "%s", name ? name : "radio");
+    snprintf(g_job.ok_msg, sizeof(g_job.ok_msg), "%s", ok_msg ? ok_msg : "完成");
+    for (int i = 0; i < count; i++) {
+        g_job.steps[i] = steps[i];
+        g_job.steps[i].command = g_strdup(steps[i].command);
+        g_job.steps[i].expect = g_strdup(steps[i].expect);
+        g_job.steps[i].wait_cmd = g_strdup(steps[i].wait_cmd);
+        g_job.steps[i].wait_expect = g_strdup(steps[i].wait_expect);
+    }
+    g_job.count = count;
+    g_job.state = RADIO_JOB_RUNNING;
+    g_job.start_us = g_get_monotonic_time();
+    snprintf(g_job.message, sizeof(g_job.message), "执行中");
+
+    if (execute_at_sequence(g_job.steps, count, g_job.results, on_job_step, on_job_done, NULL) != 0) {
+        g_job.state = RADIO_JOB_FAILED;
+        snprintf(g_job.message, sizeof(g_job.message), "%s", dbus_get_last_error());
+        return -1;
+    }
+    printf("[RadioJob] 提交任务 %d (%s), %d 步\n", g_job.id, g_job.name, count);
+    return g_job.id;
+}
+
+int radio_job_is_running(void) {
+    return g_job.state == RADIO_JOB_RUNNING ? 1 : 0;
+}
+
+int radio_job_current_id(void) {
+    return g_job.id;
+}
+
+/* GET /api/radio_job?id=N - 查询任务进度 */
+void handle_radio_job(struct mg_connection *c, struct mg_http_message *hm) {
+    HTTP_CHECK_GET(c, hm);
+
+    char id_str[16] = {0};
+    int id = g_job.id;
+    if (mg_http_get_var(&hm->query, "id", id_str, sizeof(id_str)) > 0) {
+        id = atoi(id_str);
+    }
+
+    if (id <= 0 || id != g_job.id) {
+        HTTP_ERROR(c, 404, "Job not found");
+        return;
+    }
+
+    int elapsed_ms = g_job.state == RADIO_JOB_RUNNING
+        ? (int)((g_get_monotonic_time() - g_job.start_us) / 1000)
+        : g_job.total_ms;
+
+    JsonBuilder *j = json_new();
+    json_obj_open(j);
+    json_add_int(j, "id", g_job.id);
+    json_add_str(j, "name", g_job.name);
+    json_add_str(j, "state", job_state_name(g_job.state));
+    json_add_int(j, "step", g_job.current);
+    json_add_int(j, "total", g_job.count);
+    json_add_int(j, "elapsed_ms", elapsed_ms);
+    json_add_str(j, "message", g_job.message);
+    json_arr_open(j, "steps");
+    for (int i = 0; i < g_job.count; i++) {
+        json_arr_obj_open(j);
+        json_add_str(j, "command", g_job.steps[i].command);
+        json_add_bool(j, "done", i < g_job.current);
+        json_add_int(j, "rc", g_job.results[i].rc);
+        json_add_int(j, "elapsed_ms", g_job.results[i].elapsed_ms);
+        json_obj_close(j);
+    }
+    json_arr_close(j);
+    json_obj_close(j);
+    HTTP_OK_FREE(c, json_finish(j));
+}
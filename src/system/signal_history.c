@@ -0,0 +1,562 @@
+/**
+ * @file signal_history.c
+ * @brief 服务小区信号质量历史实现
+ *
+ * 记录格式 (块内连续存放):
+ *   flags (1 字节) | dt (varint, 距上条记录的秒数)
+ *   [CELL] is_5g (1 字节) | arfcn (varint) | pci (varint) | band 长度 + 内容
+ *   [!NOSERV] rsrp/rsrq/sinr 差值 (zigzag varint, 0.1dB)
+ * 关键帧的差值以 0 为基准，即绝对值。
+ *
+ * 文件布局: [ShHeader][64 个块]，大小固定，与内存中的块数组一致。
+ * 只有当前写入块会变化，按块记录脏标志，定时 pwrite 写回。
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <stdint.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <glib.h>
+#include "mongoose.h"
+#include "signal_history.h"
+#include "cell_sampler.h"
+#include "push_channel.h"
+#include "database.h"
+#include "http_utils.h"
+#include "json_builder.h"
+
+#define REC_KEY        0x01    /* 块内第一条，差值以 0 为基准 */
+#define REC_HANDOVER   0x02    /* 服务小区切换 */
+#define REC_NOSERV     0x04    /* 无服务小区，不含信号值 */
+#define REC_CELL       0x08    /* 携带小区标识 (关键帧或小区变化) */
+#define REC_MAX_BYTES  64      /* 单条记录最大长度 */
+
+#define SH_MAGIC       0x53484953u   /* "SHIS" */
+#define SH_VERSION     1
+
+typedef struct {
+    gint64 start_ts;
+    gint64 end_ts;
+    int used;                   /* 0 表示空块 */
+    int count;
+    uint8_t data[SIGNAL_HISTORY_CHUNK_BYTES];
+} SignalChunk;
+
+/* 解码后的一条记录 */
+typedef struct {
+    gint64 ts;
+    int flags;
+    int is_5g;
+    int arfcn;
+    int pci;
+    char band[16];
+    int rsrp;                   /* 0.1dB */
+    int rsrq;
+    int sinr;
+} SignalPoint;
+
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t chunks;
+    uint32_t chunk_bytes;
+    int32_t cur;                /* 当前写入块, -1 表示没有记录 */
+    uint8_t reserved[44];
+} ShHeader;
+
+static SignalChunk g_chunks[SIGNAL_HISTORY_CHUNKS];
+static int g_cur = -1;              /* 当前写入块 */
+static guint64 g_dirty = 0;         /* 脏块位图 */
+static int g_header_dirty = 0;
+static int g_fd = -1;
+static SignalPoint g_prev;          /* 编码基准 (上一条记录) */
+static guint64 g_last_generation = 0;
+static int g_live_id = 0;           /* 有推送订阅者时驱动采样 */
+
+/* ==================== 编码 ==================== */
+
+static int put_varint(uint8_t *p, guint64 v) {
+    int n = 0;
+    while (v >= 0x80) {
+        p[n++] = (uint8_t)(v | 0x80);
+        v >>= 7;
+    }
+    p[n++] = (uint8_t)v;
+    return n;
+}
+
+static int get_varint(const uint8_t *p, const uint8_t *end, guint64 *v) {
+    int n = 0, shift = 0;
+    *v = 0;
+    while (p + n < end && shift < 64) {
+        uint8_t b = p[n++];
+        *v |= (guint64)(b & 0x7f) << shift;
+        if (!(b & 0x80)) return n;
+        shift += 7;
+    }
+    return -1;
+}
+
+static guint64 zigzag(int v) {
+    return v < 0 ? ((guint64)(-(gint64)v) << 1) - 1 : (guint64)v << 1;
+}
+
+static int unzigzag(guint64 v) {
+    return (v & 1) ? -(int)((v + 1) >> 1) : (int)(v >> 1);
+}
+
+/* 四舍五入到 0.1dB (不依赖 libm) */
+static int to_fixed(double v) {
+    return (int)(v >= 0 ? v * 10.0 + 0.5 : v * 10.0 - 0.5);
+}
+
+/* 频段转为带引号的 JSON 字符串 (来自模组响应，可能含任意字符) */
+#define BAND_JSON_SIZE  (16 * 6 + 3)
+
+static void band_json(const char *band, char *out, size_t size) {
+    mg_snprintf(out, size, "%m", MG_ESC(band));
+}
+
+static int same_cell(const SignalPoint *a, const SignalPoint *b) {
+    return a->is_5g == b->is_5g && a->arfcn == b->arfcn && a->pci == b->pci;
+}
+
+/* 开始新块，覆盖最旧的块 */
+static SignalChunk *next_chunk(gint64 ts) {
+    g_cur = (g_cur + 1) % SIGNAL_HISTORY_CHUNKS;
+    g_header_dirty = 1;
+    SignalChunk *ch = &g_chunks[g_cur];
+    ch->start_ts = ts;
+    ch->end_ts = ts;
+    ch->used = 0;
+    ch->count = 0;
+    return ch;
+}
+
+static void append(const SignalPoint *pt, int has_serving) {
+    SignalChunk *ch = g_cur >= 0 ? &g_chunks[g_cur] : NULL;
+    int flags = 0;
+
+    if (!ch || ch->used + REC_MAX_BYTES > SIGNAL_HISTORY_CHUNK_BYTES) {
+        ch = next_chunk(pt->ts);
+        memset(&g_prev, 0, sizeof(g_prev));
+        g_prev.ts = pt->ts;
+        flags |= REC_KEY;
+    }
+    if (!has_serving) {
+        flags |= REC_NOSERV;
+    } else if ((flags & REC_KEY) || !same_cell(&g_prev, pt)) {
+        flags |= REC_CELL;
+        /* 从无服务恢复不算切换 */
+        if (!(flags & REC_KEY) && g_prev.arfcn != 0) flags |= REC_HANDOVER;
+    }
+
+    uint8_t *p = ch->data + ch->used;
+    int n = 0;
+    p[n++] = (uint8_t)flags;
+    n += put_varint(p + n, (guint64)(pt->ts > g_prev.ts ? pt->ts - g_prev.ts : 0));
+
+    if (flags & REC_CELL) {
+        size_t blen = strnlen(pt->band, sizeof(pt->band) - 1);
+        p[n++] = (uint8_t)pt->is_5g;
+        n += put_varint(p + n, (guint64)(pt->arfcn > 0 ? pt->arfcn : 0));
+        n += put_varint(p + n, (guint64)(pt->pci > 0 ? pt->pci : 0));
+        p[n++] = (uint8_t)blen;
+        memcpy(p + n, pt->band, blen);
+        n += (int)blen;
+    }
+    if (!(flags & REC_NOSERV)) {
+        n += put_varint(p + n, zigzag(pt->rsrp - g_prev.rsrp));
+        n += put_varint(p + n, zigzag(pt->rsrq - g_prev.rsrq));
+        n += put_varint(p + n, zigzag(pt->sinr - g_prev.sinr));
+    }
+
+    ch->used += n;
+    ch->count++;
+    ch->end_ts = pt->ts;
+    g_dirty |= (guint64)1 << g_cur;
+
+    /* 无服务记录不改变信号基准，只推进时间 */
+    if (flags & REC_NOSERV) {
+        g_prev.ts = pt->ts;
+    } else {
+        g_prev = *pt;
+    }
+}
+
+/* ==================== 解码 ==================== */
+
+typedef void (*point_fn)(const SignalPoint *pt, void *ctx);
+
+/*
+ * 按顺序解码一个块内 [from, to] 的记录
+ * @param last 输出解码到的最后一条记录 (可为 NULL)，即续写时的编码基准
+ * @return 完整解码的字节数 (遇到损坏记录时小于 used)
+ */
+static int chunk_foreach(const SignalChunk *ch, gint64 from, gint64 to, point_fn fn, void *ctx,
+                         SignalPoint *last) {
+    const uint8_t *p = ch->data, *end = ch->data + ch->used;
+    const uint8_t *done = p;
+    SignalPoint cur;
+    memset(&cur, 0, sizeof(cur));
+    cur.ts = ch->start_ts;
+
+    while (p < end) {
+        guint64 v;
+        int n;
+
+        cur.flags = *p++;
+        if ((n = get_varint(p, end, &v)) < 0) break;
+        p += n;
+        cur.ts += (gint64)v;
+
+        if (cur.flags & REC_CELL) {
+            if (p >= end) break;
+            cur.is_5g = *p++;
+            if ((n = get_varint(p, end, &v)) < 0) break;
+            p += n;
+            cur.arfcn = (int)v;
+            if ((n = get_varint(p, end, &v)) < 0) break;
+            p += n;
+            cur.pci = (int)v;
+            if (p >= end) break;
+            size_t blen = *p++;
+            if (blen >= sizeof(cur.band) || p + blen > end) break;
+            memcpy(cur.band, p, blen);
+            cur.band[blen] = '\0';
+            p += blen;
+        }
+        if (!(cur.flags & REC_NOSERV)) {
+            int *fields[3] = {&cur.rsrp, &cur.rsrq, &cur.sinr};
+            for (int i = 0; i < 3; i++) {
+                if ((n = get_varint(p, end, &v)) < 0) return (int)(done - ch->data);
+                p += n;
+                *fields[i] += unzigzag(v);
+            }
+        }
+
+        done = p;
+        if (last) *last = cur;
+        if (cur.ts > to) break;
+        if (cur.ts >= from && fn) fn(&cur, ctx);
+    }
+    return (int)(done - ch->data);
+}
+
+/* 按时间顺序遍历 [from, to] 内的记录 */
+static void history_foreach(gint64 from, gint64 to, point_fn fn, void *ctx) {
+    if (g_cur < 0) return;
+
+    for (int k = 1; k <= SIGNAL_HISTORY_CHUNKS; k++) {
+        const SignalChunk *ch = &g_chunks[(g_cur + k) % SIGNAL_HISTORY_CHUNKS];
+        if (ch->count == 0 || ch->end_ts < from || ch->start_ts > to) continue;
+        chunk_foreach(ch, from, to, fn, ctx, NULL);
+    }
+}
+
+/* ==================== 文件 ==================== */
+
+int signal_history_flush(void) {
+    int written = 0;
+
+    if (g_fd < 0) return -1;
+
+    for (int i = 0; i < SIGNAL_HISTORY_CHUNKS; i++) {
+        if (!(g_dirty & ((guint64)1 << i))) continue;
+        off_t off = (off_t)(sizeof(ShHeader) + sizeof(SignalChunk) * i);
+        if (pwrite(g_fd, &g_chunks[i], sizeof(SignalChunk), off) != (ssize_t)sizeof(SignalChunk)) {
+            printf("[SignalHistory] 写回失败: chunk %d\n", i);
+            return -1;
+        }
+        g_dirty &= ~((guint64)1 << i);
+        written++;
+    }
+    if (g_header_dirty) {
+        ShHeader h;
+        memset(&h, 0, sizeof(h));
+        h.magic = SH_MAGIC;
+        h.version = SH_VERSION;
+        h.chunks = SIGNAL_HISTORY_CHUNKS;
+        h.chunk_bytes = SIGNAL_HISTORY_CHUNK_BYTES;
+        h.cur = g_cur;
+        if (pwrite(g_fd, &h, sizeof(h), 0) != (ssize_t)sizeof(h)) {
+            printf("[SignalHistory] 写回文件头失败\n");
+            return -1;
+        }
+        g_header_dirty = 0;
+        written++;
+    }
+    if (written > 0) {
+        fdatasync(g_fd);
+    }
+    return written;
+}
+
+/* 载入历史文件，成功后从当前块最后一条记录继续编码 */
+static int history_load(void) {
+    size_t file_size = sizeof(ShHeader) + sizeof(g_chunks);
+    struct stat st;
+    ShHeader h;
+
+    if (fstat(g_fd, &st) != 0 || (size_t)st.st_size != file_size ||
+        pread(g_fd, &h, sizeof(h), 0) != (ssize_t)sizeof(h) ||
+        h.magic != SH_MAGIC || h.version != SH_VERSION ||
+        h.chunks != SIGNAL_HISTORY_CHUNKS || h.chunk_bytes != SIGNAL_HISTORY_CHUNK_BYTES ||
+        h.cur < -1 || h.cur >= SIGNAL_HISTORY_CHUNKS ||
+        pread(g_fd, g_chunks, sizeof(g_chunks), sizeof(h)) != (ssize_t)sizeof(g_chunks)) {
+        return -1;
+    }
+
+    for (int i = 0; i < SIGNAL_HISTORY_CHUNKS; i++) {
+        if (g_chunks[i].used < 0 || g_chunks[i].used > SIGNAL_HISTORY_CHUNK_BYTES) {
+            memset(&g_chunks[i], 0, sizeof(g_chunks[i]));
+            g_dirty |= (guint64)1 << i;
+        }
+    }
+    g_cur = h.cur;
+    if (g_cur >= 0) {
+        /* 掉电时写了一半的记录丢弃，新记录接在最后一条完整记录后面 */
+        SignalChunk *ch = &g_chunks[g_cur];
+        ch->used = chunk_foreach(ch, G_MININT64, G_MAXINT64, NULL, NULL, &g_prev);
+    }
+    return 0;
+}
+
+static void history_open(void) {
+    g_fd = open(SIGNAL_HISTORY_FILE, O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if (g_fd < 0) {
+        printf("[SignalHistory] 无法打开 %s，历史仅保存在内存\n", SIGNAL_HISTORY_FILE);
+        return;
+    }
+    if (history_load() == 0) {
+        printf("[SignalHistory] 已加载 %s\n", SIGNAL_HISTORY_FILE);
+        return;
+    }
+
+    memset(g_chunks, 0, sizeof(g_chunks));
+    g_cur = -1;
+    if (ftruncate(g_fd, (off_t)(sizeof(ShHeader) + sizeof(g_chunks))) == 0) {
+        g_dirty = ~(guint64)0;
+        g_header_dirty = 1;
+        signal_history_flush();
+    }
+    printf("[SignalHistory] 已新建 %s\n", SIGNAL_HISTORY_FILE);
+}
+
+static gboolean history_flush_tick(gpointer user_data) {
+    (void)user_data;
+    signal_history_flush();
+    return G_SOURCE_CONTINUE;
+}
+
+/* ==================== 采样 ==================== */
+
+static void on_snapshot(const CellSnapshot *snap, void *user_data) {
+    SignalPoint pt;
+    (void)user_data;
+
+    if (snap->generation == g_last_generation) return;
+    g_last_generation = snap->generation;
+
+    memset(&pt, 0, sizeof(pt));
+    pt.ts = snap->timestamp;
+    if (snap->has_serving) {
+        pt.is_5g = snap->is_5g;
+        pt.arfcn = snap->serving.arfcn;
+        pt.pci = snap->serving.pci;
+        snprintf(pt.band, sizeof(pt.band), "%s", snap->serving.band);
+        pt.rsrp = to_fixed(snap->serving.rsrp);
+        pt.rsrq = to_fixed(snap->serving.rsrq);
+        pt.sinr = to_fixed(snap->serving.sinr);
+    }
+    append(&pt, snap->has_serving);
+
+    if (snap->has_serving && push_watchers(PUSH_TOPIC_SIGNAL) > 0) {
+        char frame[256], band[BAND_JSON_SIZE];
+        band_json(pt.band, band, sizeof(band));
+        snprintf(frame, sizeof(frame),
+                 "{\"t\":%lld,\"rat\":\"%s\",\"band\":%s,\"arfcn\":%d,\"pci\":%d,"
+                 "\"rsrp\":%.1f,\"rsrq\":%.1f,\"sinr\":%.1f}",
+                 (long long)pt.ts, pt.is_5g ? "5G" : "4G", band, pt.arfcn, pt.pci,
+                 pt.rsrp / 10.0, pt.rsrq / 10.0, pt.sinr / 10.0);
+        push_publish(PUSH_TOPIC_SIGNAL, frame);
+    }
+}
+
+/* 实时推送有人订阅时才主动采样 */
+static void on_watchers_changed(unsigned topic, int watchers) {
+    (void)topic;
+    if (watchers > 0 && g_live_id <= 0) {
+        g_live_id = cell_sampler_subscribe(0, NULL, NULL);
+    } else if (watchers == 0 && g_live_id > 0) {
+        cell_sampler_unsubscribe(g_live_id);
+        g_live_id = 0;
+    }
+}
+
+void signal_history_init(void) {
+    int secs = config_get_int("signal_history_interval", SIGNAL_HISTORY_DEFAULT_SECS);
+    if (secs < 0) {
+        printf("[SignalHistory] 已关闭\n");
+        return;
+    }
+    if (cell_sampler_observe(on_snapshot, NULL) < 0) {
+        printf("[SignalHistory] 订阅采样器失败\n");
+        return;
+    }
+    push_set_watch_callback(PUSH_TOPIC_SIGNAL, on_watchers_changed);
+
+    history_open();
+    int flush_min = config_get_int("signal_history_flush_min", SIGNAL_HISTORY_FLUSH_DEFAULT);
+    if (flush_min < 1) flush_min = 1;
+    g_timeout_add_seconds((guint)flush_min * 60, history_flush_tick, NULL);
+
+    if (secs > 0) {
+        cell_sampler_subscribe(secs * 1000, NULL, NULL);
+        printf("[SignalHistory] 主动记录间隔 %d 秒\n", secs);
+    } else {
+        printf("[SignalHistory] 被动记录已有快照\n");
+    }
+}
+
+/* ==================== 查询 ==================== */
+
+/* 汇总桶 */
+typedef struct {
+    gint64 ts;
+    int n;
+    int min[3], max[3];
+    gint64 sum[3];
+} SignalBucket;
+
+typedef struct {
+    GString *points;
+    GString *handovers;
+    int point_count;
+    int handover_count;
+    gint64 from;
+    long step;
+    SignalBucket bucket;
+    SignalPoint last;       /* 上一条有服务记录，用于切换事件的来源小区 */
+} QueryCtx;
+
+static void flush_bucket(QueryCtx *q) {
+    SignalBucket *b = &q->bucket;
+    if (b->n == 0) return;
+
+    g_string_append_printf(q->points, "%s[%lld,%d", q->point_count ? "," : "", (long long)b->ts, b->n);
+    for (int i = 0; i < 3; i++) {
+        g_string_append_printf(q->points, ",%.1f,%.1f,%.1f",
+                               b->min[i] / 10.0, (double)b->sum[i] / b->n / 10.0, b->max[i] / 10.0);
+    }
+    g_string_append_c(q->points, ']');
+    q->point_count++;
+    b->n = 0;
+}
+
+static void collect_point(const SignalPoint *pt, void *ctx) {
+    QueryCtx *q = ctx;
+
+    if (pt->flags & REC_NOSERV) return;
+
+    /* 切换以查询范围内的相邻记录判断，跨块同样有效 */
+    if (q->last.arfcn && !same_cell(&q->last, pt)) {
+        char band[BAND_JSON_SIZE];
+        band_json(pt->band, band, sizeof(band));
+        g_string_append_printf(q->handovers,
+            "%s{\"t\":%lld,\"from\":{\"arfcn\":%d,\"pci\":%d},\"to\":{\"rat\":\"%s\",\"band\":%s,\"arfcn\":%d,\"pci\":%d}}",
+            q->handover_count ? "," : "", (long long)pt->ts, q->last.arfcn, q->last.pci,
+            pt->is_5g ? "5G" : "4G", band, pt->arfcn, pt->pci);
+        q->handover_count++;
+    }
+    q->last = *pt;
+
+    if (q->step <= 0) {
+        if (q->point_count >= SIGNAL_HISTORY_MAX_POINTS) return;
+        g_string_append_printf(q->points, "%s[%lld,%.1f,%.1f,%.1f,%d,%d]",
+                               q->point_count ? "," : "", (long long)pt->ts,
+                               pt->rsrp / 10.0, pt->rsrq / 10.0, pt->sinr / 10.0, pt->arfcn, pt->pci);
+        q->point_count++;
+        return;
+    }
+
+    gint64 key = q->from + (pt->ts - q->from) / q->step * q->step;
+    SignalBucket *b = &q->bucket;
+    if (b->n > 0 && key != b->ts) flush_bucket(q);
+    if (b->n == 0) {
+        b->ts = key;
+        for (int i = 0; i < 3; i++) {
+            b->min[i] = INT_MAX;
+            b->max[i] = INT_MIN;
+            b->sum[i] = 0;
+        }
+    }
+    int vals[3] = {pt->rsrp, pt->rsrq, pt->sinr};
+    for (int i = 0; i < 3; i++) {
+        if (vals[i] < b->min[i]) b->min[i] = vals[i];
+        if (vals[i] > b->max[i]) b->max[i] = vals[i];
+        b->sum[i] += vals[i];
+    }
+    b->n++;
+}
+
+static long query_long(struct mg_http_message *hm, const char *name, long def) {
+    char buf[32];
+    if (mg_http_get_var(&hm->query, name, buf, sizeof(buf)) > 0) {
+        return atol(buf);
+    }
+    return def;
+}
+
+/* GET /api/signal/history?from=&to=&step= - 查询信号历史 (step>0 时按桶汇总 min/avg/max) */
+void handle_signal_history(struct mg_connection *c, struct mg_http_message *hm) {
+    HTTP_CHECK_GET(c, hm);
+
+    gint64 now = g_get_real_time() / G_USEC_PER_SEC;
+    long to = query_long(hm, "to", (long)now);
+    long from = query_long(hm, "from", to - 3600);
+    long step = query_long(hm, "step", 0);
+    if (from > to || step < 0) {
+        HTTP_ERROR(c, 400, "Invalid range");
+        return;
+    }
+    if (step > 0 && (to - from) / step + 1 > SIGNAL_HISTORY_MAX_POINTS) {
+        HTTP_ERROR(c, 400, "Too many points, increase step");
+        return;
+    }
+
+    QueryCtx q;
+    memset(&q, 0, sizeof(q));
+    q.points = g_string_new("[");
+    q.handovers = g_string_new("[");
+    q.from = from;
+    q.step = step;
+    history_foreach(from, to, collect_point, &q);
+    flush_bucket(&q);
+    g_string_append_c(q.points, ']');
+    g_string_append_c(q.handovers, ']');
+
+    JsonBuilder *j = json_new();
+    json_obj_open(j);
+    json_add_long(j, "from", from);
+    json_add_long(j, "to", to);
+    json_add_long(j, "step", step);
+    json_add_int(j, "count", q.point_count);
+    if (step > 0) {
+        json_add_raw(j, "columns", "[\"t\",\"n\",\"rsrp_min\",\"rsrp_avg\",\"rsrp_max\","
+                                   "\"rsrq_min\",\"rsrq_avg\",\"rsrq_max\",\"sinr_min\",\"sinr_avg\",\"sinr_max\"]");
+    } else {
+        json_add_raw(j, "columns", "[\"t\",\"rsrp\",\"rsrq\",\"sinr\",\"arfcn\",\"pci\"]");
+    }
+    json_add_raw(j, "points", q.points->str);
+    json_add_raw(j, "handovers", q.handovers->str);
+    json_obj_close(j);
+
+    g_string_free(q.points, TRUE);
+    g_string_free(q.handovers, TRUE);
+    HTTP_OK_FREE(c, json_finish(j));
+}
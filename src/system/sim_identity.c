@@ -0,0 +1,192 @@
+/**
+ * @file sim_identity.c
+ * @brief SIM/模组身份信息缓存实现
+ *
+ * 启动时读取一次 IMEI/ICCID/IMSI，之后只在以下事件时失效重读：
+ * - SimManager PropertyChanged (插拔卡、ICCID/IMSI 变化)
+ * - Manager DataCard 变化、switch_slot 切卡
+ * - oFono 服务重启
+ *
+ * 射频重配置任务独占 AT 通道期间不刷新，保留旧值，任务结束后补一次刷新。
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <glib.h>
+#include "sim_identity.h"
+#include "airplane.h"
+#include "sysinfo.h"
+#include "dbus_core.h"
+
+#define IDENTITY_RETRY_SECS       30    /* 读取不完整时 (如无卡) 的重试间隔 */
+#define IDENTITY_REFRESH_DELAY_MS 3000  /* 事件触发后延迟刷新，等待 SIM 就绪 */
+
+static SimIdentity g_identity;
+static int g_identity_valid = 0;
+static gint64 g_last_attempt = 0;       /* 上次读取时间 (单调时钟, 秒) */
+static guint g_refresh_timer_id = 0;
+static int g_refresh_deferred = 0;      /* AT 通道被占用，刷新推迟到任务结束 */
+static pthread_mutex_t g_identity_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+/* 重新读取身份信息 (需持有锁) */
+static void refresh_locked(void) {
+    SimIdentity tmp;
+    char slot[16], ril_path[32];
+    int ok_imei, ok_iccid, ok_imsi;
+
+    memset(&tmp, 0, sizeof(tmp));
+    if (get_current_slot(slot, ril_path) == 0 && strcmp(ril_path, "unknown") != 0) {
+        g_strlcpy(tmp.modem_path, ril_path, sizeof(tmp.modem_path));
+    }
+
+    ok_imei = get_imei(tmp.imei, sizeof(tmp.imei)) == 0;
+    ok_iccid = get_iccid(tmp.iccid, sizeof(tmp.iccid)) == 0;
+    ok_imsi = get_imsi(tmp.imsi, sizeof(tmp.imsi)) == 0;
+    if (ok_imsi) {
+        g_strlcpy(tmp.carrier, get_carrier_from_imsi(tmp.imsi), sizeof(tmp.carrier));
+    }
+
+    /* IMEI 不随 SIM 变化，本次没读到时沿用旧值 */
+    if (!ok_imei && g_identity.imei[0]) {
+        g_strlcpy(tmp.imei, g_identity.imei, sizeof(tmp.imei));
+    }
+
+    /* 读取中途 AT 通道被射频任务占用: 失败不代表无卡，保留旧值，任务结束后重读 */
+    if ((!ok_imei || !ok_iccid || !ok_imsi) && at_channel_reserved()) {
+        if (!ok_iccid) g_strlcpy(tmp.iccid, g_identity.iccid, sizeof(tmp.iccid));
+        if (!ok_imsi) {
+            g_strlcpy(tmp.imsi, g_identity.imsi, sizeof(tmp.imsi));
+            g_strlcpy(tmp.carrier, g_identity.carrier, sizeof(tmp.carrier));
+        }
+        g_identity = tmp;
+        g_identity_valid = 0;
+        g_last_attempt = 0;
+        g_refresh_deferred = 1;
+        printf("[Identity] AT 通道被占用，保留旧值，任务结束后刷新\n");
+        return;
+    }
+
+    g_identity = tmp;
+    g_identity_valid = ok_imei && ok_iccid && ok_imsi;
+    g_last_attempt = g_get_monotonic_time() / G_USEC_PER_SEC;
+
+    printf("[Identity] 刷新完成: imei=%s iccid=%s imsi=%s (%s)\n",
+           tmp.imei, tmp.iccid, tmp.imsi, g_identity_valid ? "完整" : "不完整");
+}
+
+static gboolean refresh_timer_cb(gpointer user_data) {
+    SimIdentity tmp;
+    (void)user_data;
+
+    g_refresh_timer_id = 0;
+    sim_identity_get(&tmp);
+    return G_SOURCE_REMOVE;
+}
+
+/* 合并短时间内的多次事件，只刷新一次 */
+static void schedule_refresh(void) {
+    if (g_refresh_timer_id > 0) {
+        g_source_remove(g_refresh_timer_id);
+    }
+    g_refresh_timer_id = g_timeout_add(IDENTITY_REFRESH_DELAY_MS, refresh_timer_cb, NULL);
+}
+
+void sim_identity_init(void) {
+    SimIdentity tmp;
+    sim_identity_get(&tmp);
+}
+
+int sim_identity_get(SimIdentity *out) {
+    int rc;
+
+    if (!out) return -1;
+
+    pthread_mutex_lock(&g_identity_mutex);
+    if (!g_identity_valid) {
+        gint64 now = g_get_monotonic_time() / G_USEC_PER_SEC;
+        if (at_channel_reserved()) {
+            g_refresh_deferred = 1;
+        } else if (g_last_attempt == 0 || now - g_last_attempt >= IDENTITY_RETRY_SECS) {
+            refresh_locked();
+        }
+    }
+    *out = g_identity;
+    rc = g_identity_valid ? 0 : -1;
+    pthread_mutex_unlock(&g_identity_mutex);
+
+    return rc;
+}
+
+void sim_identity_invalidate(const char *reason) {
+    pthread_mutex_lock(&g_identity_mutex);
+    g_identity_valid = 0;
+    g_last_attempt = 0;
+    pthread_mutex_unlock(&g_identity_mutex);
+
+    printf("[Identity] 缓存失效: %s\n", reason ? reason : "unknown");
+    schedule_refresh();
+}
+
+void sim_identity_resume(void) {
+    int deferred;
+
+    pthread_mutex_lock(&g_identity_mutex);
+    deferred = g_refresh_deferred;
+    g_refresh_deferred = 0;
+    pthread_mutex_unlock(&g_identity_mutex);
+
+    if (deferred) {
+        printf("[Identity] AT 通道已释放，补做推迟的刷新\n");
+        schedule_refresh();
+    }
+}
+
+void sim_identity_on_sim_property(const char *modem_path, const char *name, GVariant *value) {
+    if (!name || !value) return;
+
+    pthread_mutex_lock(&g_identity_mutex);
+
+    /* 只处理当前数据卡的 SIM */
+    if (g_identity.modem_path[0] && modem_path && strcmp(g_identity.modem_path, modem_path) != 0) {
+        pthread_mutex_unlock(&g_identity_mutex);
+        return;
+    }
+
+    if (strcmp(name, "CardIdentifier") == 0 && g_variant_is_of_type(value, G_VARIANT_TYPE_STRING)) {
+        strncpy(g_identity.iccid, g_variant_get_string(value, NULL), sizeof(g_identity.iccid) - 1);
+        g_identity.iccid[sizeof(g_identity.iccid) - 1] = '\0';
+        pthread_mutex_unlock(&g_identity_mutex);
+        return;
+    }
+
+    if (strcmp(name, "SubscriberIdentity") == 0 && g_variant_is_of_type(value, G_VARIANT_TYPE_STRING)) {
+        strncpy(g_identity.imsi, g_variant_get_string(value, NULL), sizeof(g_identity.imsi) - 1);
+        g_identity.imsi[sizeof(g_identity.imsi) - 1] = '\0';
+        memset(g_identity.carrier, 0, sizeof(g_identity.carrier));
+        g_strlcpy(g_identity.carrier, get_carrier_from_imsi(g_identity.imsi), sizeof(g_identity.carrier));
+        pthread_mutex_unlock(&g_identity_mutex);
+        return;
+    }
+
+    if (strcmp(name, "Present") == 0 && g_variant_is_of_type(value, G_VARIANT_TYPE_BOOLEAN)) {
+        gboolean present = g_variant_get_boolean(value);
+        if (!present) {
+            /* 拔卡：清空 SIM 相关字段，保留 IMEI，按重试间隔再读 */
+            g_identity.iccid[0] = '\0';
+            g_identity.imsi[0] = '\0';
+            g_identity.carrier[0] = '\0';
+            g_identity_valid = 0;
+            g_last_attempt = g_get_monotonic_time() / G_USEC_PER_SEC;
+            pthread_mutex_unlock(&g_identity_mutex);
+            printf("[Identity] SIM 已拔出 (%s)\n", modem_path ? modem_path : "");
+            return;
+        }
+        pthread_mutex_unlock(&g_identity_mutex);
+        sim_identity_invalidate("SIM 插入");
+        return;
+    }
+
+    pthread_mutex_unlock(&g_identity_mutex);
+}
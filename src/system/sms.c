@@ -11,6 +11,12 @@
 #include "sms.h"
 #include "database.h"
 #include "exec_utils.h"
+#include "webhook.h"
+#include "webhook_template.h"
+#include "sms_thread.h"
+#include "sms_outbox.h"
+#include "sms_rule.h"
+#include "sms_journal.h"
 
 /* 短信模块专用互斥锁 */
 static pthread_mutex_t g_sms_mutex = PTHREAD_MUTEX_INITIALIZER;
@@ -19,9 +25,11 @@ static guint g_signal_subscription_id = 0;
 static guint g_name_watch_id = 0;
 static int g_sms_initialized = 0;
 static int g_ofono_available = 0;
+static int g_sms_fts = 0;           /* 内容全文索引可用 */
 
-/* Webhook配置 */
+/* Webhook配置及编译后的请求体模板 */
 static WebhookConfig g_webhook_config = {0};
+static WebhookTemplate g_webhook_tpl = {0};
 
 /* 最大短信存储数量 */
 #define DEFAULT_MAX_SMS_COUNT 50
@@ -29,78 +37,352 @@ static WebhookConfig g_webhook_config = {0};
 static int g_max_sms_count = DEFAULT_MAX_SMS_COUNT;
 static int g_max_sent_count = DEFAULT_MAX_SENT_COUNT;
 
+/* 每张表内容总字节上限 (KB, 0 表示不限)，与条数上限同时生效 */
+#define DEFAULT_MAX_SMS_KB 256
+static int g_max_sms_kb = DEFAULT_MAX_SMS_KB;
+
+/* 写入后延迟清理，连续收到的短信只触发一次 */
+#define SMS_TRIM_DELAY_MS 2000
+static guint g_trim_timer = 0;
+
+/* 收件日志批量入库: 首条写入后稍等合并，失败按指数退避重试 */
+#define SMS_FLUSH_DELAY_MS      500
+#define SMS_FLUSH_RETRY_MS      5000
+#define SMS_FLUSH_RETRY_MAX_MS  (5 * 60 * 1000)
+static guint g_flush_timer = 0;
+static guint g_flush_backoff_ms = 0;
+
 /* 前向声明 */
 static void on_incoming_message(GDBusConnection *conn, const gchar *sender_name,
     const gchar *object_path, const gchar *interface_name, const gchar *signal_name,
     GVariant *parameters, gpointer user_data);
-static int save_sms_to_db(const char *sender, const char *content, time_t timestamp);
-static int save_sent_sms_to_db(const char *recipient, const char *content, time_t timestamp, const char *status);
+static int save_sms_to_db(const SmsJournalRecord *rec);
+static void sms_schedule_flush(void);
 static void send_webhook_notification(const SmsMessage *msg);
+static void compile_webhook_template(void);
 static void load_sms_config(void);
+static void sms_schedule_trim(void);
 static void subscribe_sms_signal(void);
 static void unsubscribe_sms_signal(void);
 static void on_ofono_appeared(GDBusConnection *conn, const gchar *name, const gchar *name_owner, gpointer user_data);
 static void on_ofono_vanished(GDBusConnection *conn, const gchar *name, gpointer user_data);
 static void apply_sms_fix_on_init(void);
+static void sms_bus_attach(GDBusConnection *conn);
+static void sms_catch_up(void);
+static void on_dbus_connection_closed(GDBusConnection *conn, gboolean remote_peer_vanished,
+    GError *error, gpointer user_data);
+static void sms_bus_reconnect_later(void);
 
-/* Hex解码函数 - 将hex字符串解码为原始字节 */
-static void hex_decode(const char *hex, char *out, size_t out_size) {
-    size_t i = 0, j = 0;
-    size_t hex_len = strlen(hex);
-    
-    while (i < hex_len && j < out_size - 1) {
-        unsigned int byte;
-        if (sscanf(hex + i, "%2x", &byte) == 1) {
-            out[j++] = (char)byte;
-            i += 2;
-        } else {
-            break;
-        }
+/*
+ * 按条数和字节数裁剪一张表
+ * 条数: 第 n+1 新的 id 之前全部删除，走主键倒序，只读 n+1 行
+ * 字节: 从新到旧累加 bytes 列，超过上限的那一条及更旧的删除。
+ *   先按总量判断，未超限时只做一次求和; 超限时用相关子查询找分界
+ *   (条数裁剪后最多 150 行，不依赖 SQLite 3.25 的窗口函数)
+ * keep: 额外的保留条件 (如发送队列中的记录)，满足条件的行不删除，可为 NULL
+ */
+static int append_trim_sql(char *sql, size_t size, const char *table, int max_count, int max_kb,
+                           const char *keep) {
+    const char *and_not = keep ? " AND NOT " : "";
+    if (!keep) keep = "";
+
+    int len = snprintf(sql, size,
+        "DELETE FROM %s WHERE id <= (SELECT id FROM %s ORDER BY id DESC LIMIT 1 OFFSET %d)%s%s;",
+        table, table, max_count, and_not, keep);
+    if (max_kb > 0 && len > 0 && (size_t)len < size) {
+        len += snprintf(sql + len, size - len,
+            "DELETE FROM %s WHERE (SELECT SUM(bytes) FROM %s) > %d AND id <= "
+            "(SELECT a.id FROM %s a WHERE (SELECT SUM(b.bytes) FROM %s b WHERE b.id >= a.id) > %d "
+            "ORDER BY a.id DESC LIMIT 1)%s%s;",
+            table, table, max_kb * 1024, table, table, max_kb * 1024, and_not, keep);
     }
-    out[j] = '\0';
+    return len;
 }
 
-/* 保存短信到数据库 */
-static int save_sms_to_db(const char *sender, const char *content, time_t timestamp) {
+static void sms_trim_now(void) {
     char sql[2048];
-    char escaped_content[1024];
-    
-    /* 转义单引号 */
-    size_t j = 0;
-    for (size_t i = 0; content[i] && j < sizeof(escaped_content) - 2; i++) {
-        if (content[i] == '\'') {
-            escaped_content[j++] = '\'';
-            escaped_content[j++] = '\'';
-        } else {
-            escaped_content[j++] = content[i];
+    int len = append_trim_sql(sql, sizeof(sql), "sms", g_max_sms_count, g_max_sms_kb, NULL);
+    /* 还在发送队列中的记录要等最终状态写回，不能删除 */
+    append_trim_sql(sql + len, sizeof(sql) - len, "sent_sms", g_max_sent_count, g_max_sms_kb,
+                    "status IN ('pending','submitted')");
+
+    pthread_mutex_lock(&g_sms_mutex);
+    db_execute(sql);
+    pthread_mutex_unlock(&g_sms_mutex);
+}
+
+static gboolean sms_trim_cb(gpointer user_data) {
+    (void)user_data;
+    g_trim_timer = 0;
+    sms_trim_now();
+    return G_SOURCE_REMOVE;
+}
+
+static void sms_schedule_trim(void) {
+    if (g_trim_timer == 0) {
+        g_trim_timer = g_timeout_add(SMS_TRIM_DELAY_MS, sms_trim_cb, NULL);
+    }
+}
+
+/* 任意长度文本转为 CAST(X'..' AS TEXT) 字面量 (g_free 释放) */
+static char *sql_literal_dup(const char *text) {
+    size_t size = strlen(text) * 2 + 20;
+    char *lit = g_malloc(size);
+    db_text_literal(text, lit, size);
+    return lit;
+}
+
+/*============================================================================
+ * 收件入库: 去重、分段估算
+ *============================================================================*/
+
+#define SMS_HASH_LEN            16
+#define SMS_DEDUP_SLOTS         64
+#define SMS_DEDUP_WINDOW_SECS   (24 * 3600)     /* 有 SentTime 时的去重窗口 */
+#define SMS_DEDUP_NOTIME_SECS   600             /* 无 SentTime 时只挡短时间内的重发 */
+
+typedef struct {
+    char hash[SMS_HASH_LEN + 1];
+    time_t ts;
+} SmsSeen;
+
+/* 最近入库短信的指纹，启动时从数据库回填，去重不需要额外查询 */
+static SmsSeen g_seen[SMS_DEDUP_SLOTS];
+static int g_seen_next = 0;
+
+/* 指纹 = SHA1(发件人, 短信中心时间戳, 正文) 前 64 位 */
+static void sms_fingerprint(const char *sender, const char *sent_time, const char *content,
+                            char out[SMS_HASH_LEN + 1]) {
+    GChecksum *ck = g_checksum_new(G_CHECKSUM_SHA1);
+    g_checksum_update(ck, (const guchar *)sender, strlen(sender));
+    g_checksum_update(ck, (const guchar *)"\x1f", 1);
+    g_checksum_update(ck, (const guchar *)sent_time, strlen(sent_time));
+    g_checksum_update(ck, (const guchar *)"\x1f", 1);
+    g_checksum_update(ck, (const guchar *)content, strlen(content));
+    g_strlcpy(out, g_checksum_get_string(ck), SMS_HASH_LEN + 1);
+    g_checksum_free(ck);
+}
+
+static int sms_seen_recently(const char *hash, int has_sent_time, time_t now) {
+    time_t window = has_sent_time ? SMS_DEDUP_WINDOW_SECS : SMS_DEDUP_NOTIME_SECS;
+    for (int i = 0; i < SMS_DEDUP_SLOTS; i++) {
+        if (g_seen[i].ts > 0 && now - g_seen[i].ts < window && strcmp(g_seen[i].hash, hash) == 0) {
+            return 1;
         }
     }
-    escaped_content[j] = '\0';
-    
+    return 0;
+}
+
+static void sms_remember(const char *hash, time_t ts) {
+    g_strlcpy(g_seen[g_seen_next].hash, hash, sizeof(g_seen[0].hash));
+    g_seen[g_seen_next].ts = ts;
+    g_seen_next = (g_seen_next + 1) % SMS_DEDUP_SLOTS;
+}
+
+static void sms_dedup_seed(void) {
+    char sql[160];
+    char *rows;
+
     snprintf(sql, sizeof(sql),
-        "INSERT INTO sms (sender, content, timestamp, is_read) VALUES ('%s', '%s', %ld, 0);",
-        sender, escaped_content, (long)timestamp);
-    
+        "SELECT hash || '|' || timestamp FROM sms WHERE hash IS NOT NULL ORDER BY id DESC LIMIT %d;",
+        SMS_DEDUP_SLOTS);
+    rows = db_query_rows_alloc(sql, NULL);
+    if (!rows) return;
+
+    for (char *line = strtok(rows, "\n"); line; line = strtok(NULL, "\n")) {
+        char *sep = strchr(line, '|');
+        if (!sep || sep - line != SMS_HASH_LEN) continue;
+        *sep = '\0';
+        sms_remember(line, (time_t)atol(sep + 1));
+    }
+    free(rows);
+}
+
+/*
+ * 估算分段数: 全部落在 GSM 7bit 字符集内按 160/153 septet 分段，
+ * 否则按 UCS-2 的 70/67 个 UTF-16 单元分段
+ */
+static int sms_estimate_parts(const char *content) {
+    size_t septets = 0, units = 0;
+    int ucs2 = !g_utf8_validate(content, -1, NULL);
+
+    for (const char *p = content; !ucs2 && *p; p = g_utf8_next_char(p)) {
+        gunichar ch = g_utf8_get_char(p);
+        if (ch >= 0x80 && ch != 0x20AC) ucs2 = 1;
+        else septets += (ch == 0x20AC || strchr("^{}\\[]~|", (int)ch)) ? 2 : 1;
+    }
+    if (!ucs2) return septets <= 160 ? 1 : (int)((septets + 152) / 153);
+
+    for (const char *p = content; *p; p = g_utf8_next_char(p)) {
+        units += g_utf8_get_char(p) > 0xFFFF ? 2 : 1;
+    }
+    return units <= 70 ? 1 : (int)((units + 66) / 67);
+}
+
+/* 追加一条短信及会话索引更新的 SQL - 正文以 hex 字面量写入，长度不受限 */
+static void append_sms_insert_sql(GString *sql, const SmsJournalRecord *rec) {
+    char peer[SMS_PEER_SIZE];
+    char thread_sql[1024];
+
+    sms_peer_normalize(rec->sender, peer, sizeof(peer));
+    char *sender_lit = sql_literal_dup(rec->sender);
+    char *peer_lit = sql_literal_dup(peer);
+    char *content_lit = sql_literal_dup(rec->content);
+    char *sent_lit = sql_literal_dup(rec->sent_time);
+
+    g_string_append_printf(sql,
+        "INSERT INTO sms (sender, content, timestamp, is_read, peer, hash, sent_time, parts, bytes) "
+        "VALUES (%s, %s, %ld, %d, %s, '%s', %s, %d, %zu);",
+        sender_lit, content_lit, (long)rec->timestamp, rec->is_read ? 1 : 0, peer_lit,
+        rec->hash, sent_lit, rec->parts, strlen(rec->content));
+    if (sms_thread_update_sql(thread_sql, sizeof(thread_sql), peer, rec->sender, rec->content,
+                              rec->timestamp, 0) > 0) {
+        g_string_append(sql, thread_sql);
+        /* 规则标记已读的短信不计入会话未读数 */
+        if (rec->is_read) g_string_append_printf(sql, "UPDATE sms_threads SET unread = unread - 1 WHERE peer = %s;", peer_lit);
+    }
+    g_free(sender_lit);
+    g_free(peer_lit);
+    g_free(content_lit);
+    g_free(sent_lit);
+}
+
+/* 执行一批插入，.bail 保证出错时整个事务回滚而不是部分提交 */
+static int commit_sms_sql(GString *sql) {
+    g_string_prepend(sql, ".bail on\nBEGIN;");
+    g_string_append(sql, "COMMIT;");
+
     pthread_mutex_lock(&g_sms_mutex);
-    int ret = db_execute(sql);
+    int ret = db_execute(sql->str);
     pthread_mutex_unlock(&g_sms_mutex);
-    
-    /* 清理超出限制的旧短信 */
+
+    if (ret == 0) sms_schedule_trim();
+    return ret;
+}
+
+/* 日志不可用时直接入库 */
+static int save_sms_to_db(const SmsJournalRecord *rec) {
+    GString *sql = g_string_sized_new(strlen(rec->content) * 2 + 1024);
+    append_sms_insert_sql(sql, rec);
+    int ret = commit_sms_sql(sql);
+    g_string_free(sql, TRUE);
+
+    if (ret != 0) printf("[SMS] 短信保存失败!\n");
+    return ret;
+}
+
+typedef struct {
+    GString *sql;
+    GHashTable *committed;      /* "hash:timestamp" -> 已在库中 */
+    int count;
+} SmsFlushCtx;
+
+static void collect_journal_hash(const SmsJournalRecord *rec, void *user_data) {
+    GString *in = (GString *)user_data;
+    g_string_append_printf(in, "%s'%s'", in->len ? "," : "", rec->hash);
+}
+
+static void append_journal_record(const SmsJournalRecord *rec, void *user_data) {
+    SmsFlushCtx *ctx = (SmsFlushCtx *)user_data;
+    char key[SMS_HASH_LEN + 24];
+
+    snprintf(key, sizeof(key), "%s:%ld", rec->hash, (long)rec->timestamp);
+    if (g_hash_table_contains(ctx->committed, key)) return;
+    append_sms_insert_sql(ctx->sql, rec);
+    ctx->count++;
+}
+
+/*
+ * 日志中的短信一次性入库并清空日志
+ * 上次提交成功但未来得及清空日志时，按 hash+timestamp 跳过已在库中的记录
+ * @return 入库条数, -1 失败 (日志保留，稍后重试)
+ */
+static int sms_ingest_flush(void) {
+    if (sms_journal_empty()) return 0;
+
+    GString *in = g_string_new(NULL);
+    if (sms_journal_replay(collect_journal_hash, in) < 0) {
+        g_string_free(in, TRUE);
+        return -1;
+    }
+
+    SmsFlushCtx ctx = { g_string_new(NULL), g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL), 0 };
+    int ret = 0;
+    if (in->len > 0) {
+        char *query = g_strdup_printf(
+            "SELECT hash || ':' || timestamp FROM sms WHERE hash IN (%s);", in->str);
+        char *rows = db_query_rows_alloc(query, NULL);
+        g_free(query);
+        if (!rows) {
+            ret = -1;
+        } else {
+            for (char *line = strtok(rows, "\n"); line; line = strtok(NULL, "\n")) {
+                g_hash_table_add(ctx.committed, g_strdup(line));
+            }
+            free(rows);
+        }
+    }
+    g_string_free(in, TRUE);
+
     if (ret == 0) {
-        printf("[SMS] 短信保存成功，当前最大限制: %d\n", g_max_sms_count);
-        snprintf(sql, sizeof(sql),
-            "DELETE FROM sms WHERE id NOT IN (SELECT id FROM sms ORDER BY id DESC LIMIT %d);",
-            g_max_sms_count);
-        pthread_mutex_lock(&g_sms_mutex);
-        db_execute(sql);
-        pthread_mutex_unlock(&g_sms_mutex);
-    } else {
-        printf("[SMS] 短信保存失败!\n");
+        sms_journal_replay(append_journal_record, &ctx);
+        if (ctx.count > 0 && commit_sms_sql(ctx.sql) != 0) ret = -1;
+        else ret = ctx.count;
     }
-    
+    if (ret >= 0) sms_journal_reset();
+
+    g_string_free(ctx.sql, TRUE);
+    g_hash_table_destroy(ctx.committed);
+
+    if (ret > 0) printf("[SMS] %d 条短信已从日志入库\n", ret);
+    else if (ret < 0) printf("[SMS] 日志入库失败，稍后重试\n");
     return ret;
 }
 
+static gboolean sms_flush_cb(gpointer user_data) {
+    (void)user_data;
+    g_flush_timer = 0;
+
+    if (sms_ingest_flush() < 0) {
+        g_flush_backoff_ms = g_flush_backoff_ms ? g_flush_backoff_ms * 2 : SMS_FLUSH_RETRY_MS;
+        if (g_flush_backoff_ms > SMS_FLUSH_RETRY_MAX_MS) g_flush_backoff_ms = SMS_FLUSH_RETRY_MAX_MS;
+        g_flush_timer = g_timeout_add(g_flush_backoff_ms, sms_flush_cb, NULL);
+    } else {
+        g_flush_backoff_ms = 0;
+    }
+    return G_SOURCE_REMOVE;
+}
+
+static void sms_schedule_flush(void) {
+    if (g_flush_timer == 0) {
+        g_flush_timer = g_timeout_add(SMS_FLUSH_DELAY_MS, sms_flush_cb, NULL);
+    }
+}
+
+/*
+ * 内容全文索引 - FTS5 外部内容表 + trigram 分词 (支持中文子串)
+ * sqlite3 未编译 FTS5 时退化为 instr 扫描
+ */
+static void sms_fts_init(void) {
+    int exists = db_query_int("SELECT COUNT(*) FROM sqlite_master WHERE name='sms_fts';", 0);
+
+    if (!exists) {
+        if (db_execute("CREATE VIRTUAL TABLE sms_fts USING fts5(content, content='sms', "
+                       "content_rowid='id', tokenize='trigram');") != 0) {
+            printf("[SMS] sqlite3 不支持 FTS5 trigram，关键字搜索使用顺序扫描\n");
+            return;
+        }
+        db_execute("INSERT INTO sms_fts(sms_fts) VALUES('rebuild');");
+    }
+
+    db_execute(
+        "CREATE TRIGGER IF NOT EXISTS sms_fts_ai AFTER INSERT ON sms BEGIN "
+        "INSERT INTO sms_fts(rowid, content) VALUES (new.id, new.content); END;"
+        "CREATE TRIGGER IF NOT EXISTS sms_fts_ad AFTER DELETE ON sms BEGIN "
+        "INSERT INTO sms_fts(sms_fts, rowid, content) VALUES ('delete', old.id, old.content); END;");
+    g_sms_fts = 1;
+}
+
 /* 订阅短信信号 */
 static void subscribe_sms_signal(void) {
     if (!g_sms_dbus_conn) {
@@ -165,8 +447,9 @@ static void on_ofono_appeared(GDBusConnection *conn, const gchar *name,
     printf("[SMS] oFono服务已启动: %s (owner: %s)\n", name, name_owner);
     g_ofono_available = 1;
     
-    /* 重新订阅短信信号 */
+    /* 立即重新订阅，再补做断开期间积压的工作 */
     subscribe_sms_signal();
+    sms_catch_up();
 }
 
 /* oFono服务消失回调 */
@@ -180,7 +463,72 @@ static void on_ofono_vanished(GDBusConnection *conn, const gchar *name, gpointer
     unsubscribe_sms_signal();
 }
 
-/* D-Bus连接关闭回调 */
+/*
+ * 断开期间的补偿: oFono 发出的 IncomingMessage 不会缓存，信号本身无法补收，
+ * 这里把收件日志中尚未入库的短信写入数据库，并让发送队列按 oFono 当前的
+ * 消息列表校正投递状态、立即恢复发送
+ */
+static void sms_catch_up(void) {
+    if (!sms_journal_empty()) {
+        if (g_flush_timer > 0) g_source_remove(g_flush_timer);
+        g_flush_timer = 0;
+        g_flush_backoff_ms = 0;
+        if (sms_ingest_flush() < 0) sms_schedule_flush();
+    }
+    sms_outbox_resync();
+}
+
+/* 重连退避: 系统总线不可用时没有事件可等，只能按间隔重试 */
+#define SMS_BUS_RETRY_MIN_MS    1000
+#define SMS_BUS_RETRY_MAX_MS    30000
+static guint g_bus_retry_timer = 0;
+static guint g_bus_retry_ms = 0;
+
+static void on_bus_ready(GObject *source, GAsyncResult *res, gpointer user_data) {
+    (void)source; (void)user_data;
+    GError *error = NULL;
+    GDBusConnection *conn = g_bus_get_finish(res, &error);
+
+    if (!conn) {
+        printf("[SMS] D-Bus重新连接失败: %s\n", error ? error->message : "未知错误");
+        if (error) g_error_free(error);
+        sms_bus_reconnect_later();
+        return;
+    }
+    printf("[SMS] D-Bus重新连接成功\n");
+    g_bus_retry_ms = 0;
+    sms_bus_attach(conn);
+    g_object_unref(conn);
+}
+
+static gboolean sms_bus_reconnect_cb(gpointer user_data) {
+    (void)user_data;
+    g_bus_retry_timer = 0;
+
+    /* 放下已关闭的连接，g_bus_get 会建立新的共享连接 */
+    if (g_sms_dbus_conn) {
+        g_signal_handlers_disconnect_by_func(g_sms_dbus_conn, on_dbus_connection_closed, NULL);
+        g_object_unref(g_sms_dbus_conn);
+        g_sms_dbus_conn = NULL;
+    }
+    g_bus_get(G_BUS_TYPE_SYSTEM, NULL, on_bus_ready, NULL);
+    return G_SOURCE_REMOVE;
+}
+
+static void sms_bus_reconnect_later(void) {
+    if (g_bus_retry_timer > 0) return;
+
+    /* 连接刚断开时立即重连，之后失败才退避 */
+    if (g_bus_retry_ms == 0) {
+        g_bus_retry_timer = g_idle_add(sms_bus_reconnect_cb, NULL);
+        g_bus_retry_ms = SMS_BUS_RETRY_MIN_MS;
+    } else {
+        g_bus_retry_timer = g_timeout_add(g_bus_retry_ms, sms_bus_reconnect_cb, NULL);
+        g_bus_retry_ms = MIN(g_bus_retry_ms * 2, SMS_BUS_RETRY_MAX_MS);
+    }
+}
+
+/* D-Bus连接关闭回调 - 立即安排重连，不等待轮询 */
 static void on_dbus_connection_closed(GDBusConnection *conn, gboolean remote_peer_vanished,
     GError *error, gpointer user_data) {
     (void)conn; (void)user_data;
@@ -188,11 +536,29 @@ static void on_dbus_connection_closed(GDBusConnection *conn, gboolean remote_pee
     printf("[SMS] D-Bus连接已关闭! remote_peer_vanished=%d, error=%s\n", 
            remote_peer_vanished, error ? error->message : "无");
     
-    /* 清理状态 */
+    /* 订阅和名称监控随连接失效; 连接引用留到重连时在主循环里释放 */
     g_signal_subscription_id = 0;
-    g_name_watch_id = 0;
+    if (g_name_watch_id > 0) {
+        g_bus_unwatch_name(g_name_watch_id);
+        g_name_watch_id = 0;
+    }
     g_ofono_available = 0;
-    g_sms_dbus_conn = NULL;
+    sms_bus_reconnect_later();
+}
+
+/* 接管一个总线连接: 关闭时重连，oFono 出现/消失时订阅/退订 */
+static void sms_bus_attach(GDBusConnection *conn) {
+    g_sms_dbus_conn = g_object_ref(conn);
+
+    /* 共享的系统总线连接默认在关闭时退出进程 */
+    g_dbus_connection_set_exit_on_close(conn, FALSE);
+    g_signal_connect(conn, "closed", G_CALLBACK(on_dbus_connection_closed), NULL);
+
+    /* oFono 已在运行时 appeared 会在下一次主循环迭代中回调 */
+    g_name_watch_id = g_bus_watch_name_on_connection(
+        conn, "org.ofono", G_BUS_NAME_WATCHER_FLAGS_NONE,
+        on_ofono_appeared, on_ofono_vanished, NULL, NULL);
+    printf("[SMS] oFono服务监控ID: %u\n", g_name_watch_id);
 }
 
 /* D-Bus信号处理 - 接收新短信 */
@@ -229,118 +595,98 @@ static void on_incoming_message(GDBusConnection *conn, const gchar *sender_name,
         g_variant_unref(sender_var);
     }
     
+    /* 短信中心时间戳，重发的短信保持不变，用于去重 */
+    const gchar *sent_time = "";
+    GVariant *sent_var = g_variant_lookup_value(props, "SentTime", G_VARIANT_TYPE_STRING);
+    if (sent_var) sent_time = g_variant_get_string(sent_var, NULL);
+    
     printf("[SMS] 新短信 - 发件人: %s, 内容: %s\n", sender, content);
     
-    /* 保存到数据库 */
+    /* 未确认 (+CNMA) 的直发短信会被网络重发，相同指纹的只入库一次 */
     time_t now = time(NULL);
-    if (save_sms_to_db(sender, content, now) == 0) {
-        printf("[SMS] 短信已保存到数据库\n");
+    char hash[SMS_HASH_LEN + 1];
+    sms_fingerprint(sender, sent_time, content, hash);
+    if (sms_seen_recently(hash, sent_time[0] != '\0', now)) {
+        printf("[SMS] 重复短信已忽略 (%s)\n", hash);
+        if (sent_var) g_variant_unref(sent_var);
+        g_variant_unref(props);
+        return;
+    }
+    
+    /* 规则引擎: 转发/Webhook/脚本异步投递，标记已读在入库时生效 */
+    int mark_read = 0;
+    sms_rule_apply(sender, content, now, &mark_read);
+    
+    /* 先顺序写入收件日志，数据库由定时器批量写入 */
+    int parts = sms_estimate_parts(content);
+    SmsJournalRecord rec = {
+        .timestamp = now, .parts = parts, .is_read = mark_read,
+        .sender = sender, .sent_time = sent_time, .hash = hash, .content = content
+    };
+    int stored = 0;
+    if (sms_journal_append(&rec) == 0) {
+        stored = 1;
+        sms_schedule_flush();
+    } else {
+        stored = save_sms_to_db(&rec) == 0;
+    }
+    
+    if (stored) {
+        printf("[SMS] 短信已保存 (%zu 字节, %d 段)\n", strlen(content), parts);
+        sms_remember(hash, now);
         
         /* 发送Webhook通知 */
         if (g_webhook_config.enabled && strlen(g_webhook_config.url) > 0) {
             SmsMessage msg = {0};
             strncpy(msg.sender, sender, sizeof(msg.sender) - 1);
-            strncpy(msg.content, content, sizeof(msg.content) - 1);
+            msg.content = content;
+            msg.content_len = strlen(content);
             msg.timestamp = now;
+            msg.parts = parts;
             send_webhook_notification(&msg);
         }
     }
     
+    if (sent_var) g_variant_unref(sent_var);
+    
     g_variant_unref(props);
 }
 
 /* 发送Webhook通知 */
 static void send_webhook_notification(const SmsMessage *msg) {
+    static char body[16384];
+
     if (!g_webhook_config.enabled || strlen(g_webhook_config.url) == 0) {
         return;
     }
     
     printf("[SMS] 发送Webhook通知到: %s\n", g_webhook_config.url);
     
-    /* 替换变量 */
-    char body[4096];
-    strncpy(body, g_webhook_config.body, sizeof(body) - 1);
-    body[sizeof(body) - 1] = '\0';
-    
-    /* 简单的变量替换 */
-    char *p;
-    char temp[4096];
-    
-    /* 替换 #{sender} */
-    while ((p = strstr(body, "#{sender}")) != NULL) {
-        *p = '\0';
-        snprintf(temp, sizeof(temp), "%s%s%s", body, msg->sender, p + 9);
-        strncpy(body, temp, sizeof(body) - 1);
-    }
-    
-    /* 替换 #{content} */
-    while ((p = strstr(body, "#{content}")) != NULL) {
-        *p = '\0';
-        snprintf(temp, sizeof(temp), "%s%s%s", body, msg->content, p + 10);
-        strncpy(body, temp, sizeof(body) - 1);
-    }
-    
-    /* 替换 #{time} */
     char time_str[32];
     struct tm *tm_info = localtime(&msg->timestamp);
     strftime(time_str, sizeof(time_str), "%Y-%m-%d %H:%M:%S", tm_info);
-    while ((p = strstr(body, "#{time}")) != NULL) {
-        *p = '\0';
-        snprintf(temp, sizeof(temp), "%s%s%s", body, time_str, p + 7);
-        strncpy(body, temp, sizeof(body) - 1);
-    }
-    
-    /* 将body写入临时文件，避免shell转义问题 */
-    const char *tmp_file = "/tmp/webhook_body.json";
-    FILE *fp = fopen(tmp_file, "w");
-    if (fp) {
-        fputs(body, fp);
-        fclose(fp);
-    } else {
-        printf("[SMS] 无法创建临时文件\n");
-        return;
-    }
-    
-    /* 构建curl命令 */
-    char cmd[8192];
-    char headers_part[1024] = "";
-    
-    /* 解析自定义headers（格式：Header1: Value1\nHeader2: Value2） */
-    if (strlen(g_webhook_config.headers) > 0) {
-        char headers_copy[512];
-        strncpy(headers_copy, g_webhook_config.headers, sizeof(headers_copy) - 1);
-        headers_copy[sizeof(headers_copy) - 1] = '\0';
-        
-        char *line = strtok(headers_copy, "\n");
-        while (line) {
-            /* 跳过空行 */
-            while (*line == ' ' || *line == '\r') line++;
-            if (strlen(line) > 0 && strchr(line, ':')) {
-                char header_arg[256];
-                /* 去除行尾的\r */
-                char *cr = strchr(line, '\r');
-                if (cr) *cr = '\0';
-                snprintf(header_arg, sizeof(header_arg), " -H '%s'", line);
-                strncat(headers_part, header_arg, sizeof(headers_part) - strlen(headers_part) - 1);
-            }
-            line = strtok(NULL, "\n");
-        }
+
+    const char *values[TPL_VAR_COUNT];
+    values[TPL_VAR_SENDER] = msg->sender;
+    values[TPL_VAR_CONTENT] = msg->content;
+    values[TPL_VAR_TIME] = time_str;
+
+    int len = tpl_render(&g_webhook_tpl, values, body, sizeof(body));
+    if (len < 0) {
+        printf("[SMS] Webhook请求体过长，已截断\n");
+        len = (int)strlen(body);
     }
-    
-    /* 默认添加Content-Type（如果用户没有指定） */
-    /* 使用 sh -c 包装命令，确保 curl 完成后删除临时文件 */
-    if (strstr(headers_part, "Content-Type") == NULL) {
-        snprintf(cmd, sizeof(cmd),
-            "sh -c \"curl -s -X POST '%s' -H 'Content-Type: application/json'%s -d @%s; rm -f %s\" &",
-            g_webhook_config.url, headers_part, tmp_file, tmp_file);
-    } else {
-        snprintf(cmd, sizeof(cmd),
-            "sh -c \"curl -s -X POST '%s'%s -d @%s; rm -f %s\" &",
-            g_webhook_config.url, headers_part, tmp_file, tmp_file);
+
+    /* 交给投递队列，headers 由队列规范化并补 Content-Type */
+    webhook_enqueue(g_webhook_config.url, g_webhook_config.headers, body, (size_t)len);
+}
+
+/* 编译请求体模板 (配置变化时调用) */
+static void compile_webhook_template(void) {
+    TplEscape def = tpl_default_escape(g_webhook_config.headers);
+    if (tpl_compile(&g_webhook_tpl, g_webhook_config.body, def) != 0) {
+        printf("[SMS] Webhook模板占位符过多，超出部分按原文输出\n");
     }
-    
-    printf("[SMS] 执行: %s\n", cmd);
-    system(cmd);
 }
 
 /* 初始化短信模块 */
@@ -360,41 +706,35 @@ int sms_init(const char *db_path) {
     }
     
     printf("[SMS] 数据库路径: %s\n", db_get_path());
+    sms_fts_init();
+    sms_thread_init();
+    
+    /* 重放上次未入库的收件日志，之后再回填去重指纹 */
+    if (sms_journal_open(db_get_path()) == 0 && sms_ingest_flush() < 0) {
+        sms_schedule_flush();
+    }
+    sms_dedup_seed();
+    sms_outbox_init();
+    sms_rule_init();
     
     /* 加载配置 */
     load_sms_config();
     sms_get_webhook_config(&g_webhook_config);
+    compile_webhook_template();
     
-    /* 连接D-Bus */
-    g_sms_dbus_conn = g_bus_get_sync(G_BUS_TYPE_SYSTEM, NULL, &error);
-    if (!g_sms_dbus_conn) {
+    /* 连接D-Bus，订阅由 oFono 名称监控的 appeared 回调完成 */
+    GDBusConnection *conn = g_bus_get_sync(G_BUS_TYPE_SYSTEM, NULL, &error);
+    if (!conn) {
         printf("[SMS] D-Bus连接失败: %s\n", error ? error->message : "未知错误");
         if (error) g_error_free(error);
         return -1;
     }
-    
-    /* 监听D-Bus连接关闭事件 */
-    g_signal_connect(g_sms_dbus_conn, "closed", G_CALLBACK(on_dbus_connection_closed), NULL);
-    
-    /* 监控oFono服务状态 - 当服务重启时自动重新订阅 */
-    g_name_watch_id = g_bus_watch_name_on_connection(
-        g_sms_dbus_conn,
-        "org.ofono",
-        G_BUS_NAME_WATCHER_FLAGS_NONE,
-        on_ofono_appeared,
-        on_ofono_vanished,
-        NULL, NULL
-    );
-    
-    printf("[SMS] oFono服务监控ID: %u\n", g_name_watch_id);
+    sms_bus_attach(conn);
+    g_object_unref(conn);
     
     /* 应用短信修复设置 - 在D-Bus连接后执行 */
     apply_sms_fix_on_init();
     
-    /* 立即尝试订阅信号（如果oFono已经运行） */
-    subscribe_sms_signal();
-    g_ofono_available = 1;  /* 假设oFono可用，后续会通过监控更新 */
-    
     printf("[SMS] 短信模块初始化成功\n");
     g_sms_initialized = 1;
     return 0;
@@ -413,155 +753,169 @@ void sms_deinit(void) {
         g_name_watch_id = 0;
     }
     
+    if (g_bus_retry_timer > 0) {
+        g_source_remove(g_bus_retry_timer);
+        g_bus_retry_timer = 0;
+    }
     if (g_sms_dbus_conn) {
+        g_signal_handlers_disconnect_by_func(g_sms_dbus_conn, on_dbus_connection_closed, NULL);
         g_object_unref(g_sms_dbus_conn);
         g_sms_dbus_conn = NULL;
     }
     
+    /* 退出前把日志中的短信入库 */
+    if (g_flush_timer > 0) {
+        g_source_remove(g_flush_timer);
+        g_flush_timer = 0;
+        sms_ingest_flush();
+    }
+    sms_journal_close();
+    
+    /* 退出前完成未执行的清理 */
+    if (g_trim_timer > 0) {
+        g_source_remove(g_trim_timer);
+        g_trim_timer = 0;
+        sms_trim_now();
+    }
+    
     g_ofono_available = 0;
     g_sms_initialized = 0;
     printf("[SMS] 短信模块已关闭\n");
 }
 
 
-/* 发送短信 */
-int sms_send(const char *recipient, const char *content, char *result_path, size_t path_size) {
-    GError *error = NULL;
-    GVariant *result = NULL;
-    
-    if (!recipient || !content || strlen(recipient) == 0 || strlen(content) == 0) {
-        printf("发送短信参数无效\n");
-        return -1;
-    }
-    
-    if (!g_sms_dbus_conn || !g_ofono_available) {
-        printf("[SMS] D-Bus未连接或oFono服务不可用\n");
-        return -1;
-    }
-    
-    printf("[SMS] 发送短信到 %s: %s\n", recipient, content);
-    
-    /* 调用 org.ofono.MessageManager.SendMessage */
-    result = g_dbus_connection_call_sync(
-        g_sms_dbus_conn,
-        "org.ofono",
-        "/ril_0",
-        "org.ofono.MessageManager",
-        "SendMessage",
-        g_variant_new("(ss)", recipient, content),
-        G_VARIANT_TYPE("(o)"),
-        G_DBUS_CALL_FLAGS_NONE,
-        15000,  /* 15秒超时 */
-        NULL,
-        &error
-    );
-    
-    if (!result) {
-        printf("[SMS] 发送短信失败: %s\n", error ? error->message : "未知错误");
-        if (error) g_error_free(error);
-        return -1;
-    }
-    
-    /* 获取返回的消息路径 */
-    const gchar *path = NULL;
-    g_variant_get(result, "(&o)", &path);
-    
-    if (result_path && path_size > 0 && path) {
-        strncpy(result_path, path, path_size - 1);
-        result_path[path_size - 1] = '\0';
-    }
-    
-    printf("[SMS] 短信发送成功，路径: %s\n", path ? path : "N/A");
-    g_variant_unref(result);
-    
-    /* 保存发送记录到数据库 */
-    save_sent_sms_to_db(recipient, content, time(NULL), "sent");
-    
-    return 0;
+/* 获取 D-Bus 连接 (oFono 可用时) */
+GDBusConnection *sms_get_dbus_connection(void) {
+    return (g_sms_dbus_conn && g_ofono_available) ? g_sms_dbus_conn : NULL;
 }
 
-/* 获取短信列表 - 使用hex编码避免特殊字符问题，兼容无JSON扩展的SQLite */
-int sms_get_list(SmsMessage *messages, int max_count) {
-    char sql[512];
-    char *output = NULL;
-    
-    if (!messages || max_count <= 0) return -1;
-    
-    /* 分配大缓冲区 */
-    output = (char *)malloc(256 * 1024);
-    if (!output) return -1;
-    
-    /* 使用hex编码content字段，用|分隔，每行一条记录 */
-    snprintf(sql, sizeof(sql),
-        "SELECT id || '|' || sender || '|' || hex(content) || '|' || timestamp || '|' || is_read FROM sms ORDER BY id DESC LIMIT %d;",
-        max_count);
-    
-    pthread_mutex_lock(&g_sms_mutex);
-    int ret = db_query_string(sql, output, 256 * 1024);
-    pthread_mutex_unlock(&g_sms_mutex);
-    
-    if (ret != 0 || strlen(output) == 0) {
-        printf("[SMS] 获取短信列表失败或为空\n");
-        free(output);
-        return 0;
+/*
+ * 解析查询输出 - 格式: id|sender|hex_content|timestamp|is_read|parts\n
+ * 前 max 条交给回调，返回实际行数 (可能为 max+1，用于判断是否还有下一页)
+ * 正文解码到按需增长的缓冲区，内存占用与最长的一条成正比
+ */
+/* 解码 hex 正文到按需增长的缓冲区，返回值在下次调用前有效 */
+static const char *decode_body(const char *hex) {
+    static char *body = NULL;
+    static size_t body_cap = 0;
+    size_t need = strlen(hex) / 2 + 1;
+
+    if (need > body_cap) {
+        char *bigger = realloc(body, need);
+        if (!bigger) return NULL;
+        body = bigger;
+        body_cap = need;
     }
-    
-    /* 解析输出 - 格式: id|sender|hex_content|timestamp|is_read\n */
-    int count = 0;
+    db_hex_decode(hex, body, body_cap);
+    return body;
+}
+
+static int parse_sms_rows(char *output, int max, SmsRowCallback cb, void *user_data) {
+    SmsMessage msg;
+    int rows = 0;
     char *line = output;
-    char *next_line;
-    
-    while (line && *line && count < max_count) {
-        /* 找到行尾 */
-        next_line = strchr(line, '\n');
-        if (next_line) {
-            *next_line = '\0';
-            next_line++;
-        }
-        
-        /* 跳过空行 */
-        if (strlen(line) == 0) {
-            line = next_line;
-            continue;
-        }
-        
-        /* 解析字段: id|sender|hex_content|timestamp|is_read */
-        char *fields[5] = {NULL};
+
+    while (line && *line) {
+        char *next_line = strchr(line, '\n');
+        if (next_line) *next_line++ = '\0';
+
+        char *fields[6] = {NULL};
         int field_count = 0;
         char *p = line;
-        char *field_start = p;
-        
-        while (*p && field_count < 5) {
+        fields[field_count++] = p;
+        while (*p && field_count < 6) {
             if (*p == '|') {
                 *p = '\0';
-                fields[field_count++] = field_start;
-                field_start = p + 1;
+                fields[field_count++] = p + 1;
             }
             p++;
         }
-        if (field_count < 5 && field_start) {
-            fields[field_count++] = field_start;
-        }
-        
-        if (field_count >= 5) {
-            messages[count].id = atoi(fields[0]);
-            strncpy(messages[count].sender, fields[1], sizeof(messages[count].sender) - 1);
-            messages[count].sender[sizeof(messages[count].sender) - 1] = '\0';
-            
-            /* hex解码content */
-            hex_decode(fields[2], messages[count].content, sizeof(messages[count].content));
-            
-            messages[count].timestamp = (time_t)atol(fields[3]);
-            messages[count].is_read = atoi(fields[4]);
-            count++;
+
+        if (field_count == 6) {
+            if (rows < max) {
+                const char *body = decode_body(fields[2]);
+                if (!body) break;
+                memset(&msg, 0, sizeof(msg));
+                msg.id = atoi(fields[0]);
+                strncpy(msg.sender, fields[1], sizeof(msg.sender) - 1);
+                msg.content = body;
+                msg.content_len = strlen(body);
+                msg.timestamp = (time_t)atol(fields[3]);
+                msg.is_read = atoi(fields[4]);
+                msg.parts = atoi(fields[5]);
+                cb(&msg, user_data);
+            }
+            rows++;
         }
-        
         line = next_line;
     }
-    
+    return rows;
+}
+
+/* UTF-8 字符数 (trigram 分词要求关键字至少 3 个字符) */
+static int utf8_chars(const char *s) {
+    int n = 0;
+    for (; *s; s++) {
+        if (((unsigned char)*s & 0xC0) != 0x80) n++;
+    }
+    return n;
+}
+
+int sms_query(const SmsQuery *query, SmsRowCallback cb, void *user_data, int *has_more) {
+    char where[1024] = "1";
+    char lit[SMS_QUERY_MAX_Q * 2 + 20];
+    char sql[2048];
+    size_t off = 1;
+
+    if (has_more) *has_more = 0;
+    if (!query || !cb) return -1;
+
+    int limit = query->limit > 0 ? query->limit : SMS_QUERY_DEFAULT_LIMIT;
+    if (limit > SMS_QUERY_MAX_LIMIT) limit = SMS_QUERY_MAX_LIMIT;
+
+    if (query->before_id > 0) {
+        off += snprintf(where + off, sizeof(where) - off, " AND id < %d", query->before_id);
+    }
+    if (query->since_id > 0) {
+        off += snprintf(where + off, sizeof(where) - off, " AND id > %d", query->since_id);
+    }
+    if (query->sender && query->sender[0]) {
+        if (db_text_literal(query->sender, lit, sizeof(lit)) != 0) return 0;
+        off += snprintf(where + off, sizeof(where) - off, " AND sender = %s", lit);
+    }
+    if (query->q && query->q[0]) {
+        if (db_text_literal(query->q, lit, sizeof(lit)) != 0) return -1;
+        if (g_sms_fts && utf8_chars(query->q) >= 3) {
+            /* 关键字整体作为一个 FTS5 短语，避免被解析为查询语法 */
+            off += snprintf(where + off, sizeof(where) - off,
+                " AND id IN (SELECT rowid FROM sms_fts WHERE sms_fts MATCH "
+                "char(34)||replace(%s,char(34),char(34)||char(34))||char(34))", lit);
+        } else {
+            off += snprintf(where + off, sizeof(where) - off, " AND instr(content, %s) > 0", lit);
+        }
+    }
+    if (off >= sizeof(where)) return -1;
+
+    /* 多取一条判断是否还有下一页 */
+    snprintf(sql, sizeof(sql),
+        "SELECT id || '|' || sender || '|' || hex(content) || '|' || timestamp || '|' || is_read "
+        "|| '|' || COALESCE(parts, 1) FROM sms WHERE %s ORDER BY id %s LIMIT %d;",
+        where, query->since_id > 0 ? "ASC" : "DESC", limit + 1);
+
+    pthread_mutex_lock(&g_sms_mutex);
+    char *output = db_query_rows_alloc(sql, NULL);
+    pthread_mutex_unlock(&g_sms_mutex);
+
+    if (!output) {
+        printf("[SMS] 查询短信失败\n");
+        return -1;
+    }
+
+    int rows = parse_sms_rows(output, limit, cb, user_data);
     free(output);
-    printf("[SMS] 获取到 %d 条短信\n", count);
-    return count;
+
+    if (has_more) *has_more = rows > limit;
+    return rows > limit ? limit : rows;
 }
 
 /* 获取短信总数 */
@@ -675,6 +1029,7 @@ int sms_save_webhook_config(const WebhookConfig *config) {
     if (ret == 0) {
         /* 更新内存中的配置 */
         memcpy(&g_webhook_config, config, sizeof(WebhookConfig));
+        compile_webhook_template();
         printf("[SMS] Webhook配置保存成功\n");
     } else {
         printf("[SMS] Webhook配置保存失败\n");
@@ -689,8 +1044,10 @@ int sms_test_webhook(void) {
         .id = 0,
         .sender = "+8613800138000",
         .content = "这是一条测试短信",
+        .content_len = sizeof("这是一条测试短信") - 1,
         .timestamp = time(NULL),
-        .is_read = 0
+        .is_read = 0,
+        .parts = 1
     };
     
     if (!g_webhook_config.enabled || strlen(g_webhook_config.url) == 0) {
@@ -709,44 +1066,6 @@ int sms_check_status(void) {
     return g_sms_initialized && g_sms_dbus_conn && g_ofono_available && g_signal_subscription_id > 0;
 }
 
-/* 定期维护短信模块 - 增强版 */
-void sms_maintenance(void) {
-    static int check_count = 0;
-    check_count++;
-    
-    /* 每10次检查输出一次状态（约10秒一次，假设1秒调用一次） */
-    if (check_count % 10 == 0) {
-        printf("[SMS] 维护检查 #%d - D-Bus: %p, oFono: %d, 订阅ID: %u\n",
-               check_count, (void*)g_sms_dbus_conn, g_ofono_available, g_signal_subscription_id);
-    }
-    
-    if (!g_sms_initialized) {
-        return;
-    }
-    
-    /* 检查D-Bus连接是否有效 */
-    if (!g_sms_dbus_conn || g_dbus_connection_is_closed(g_sms_dbus_conn)) {
-        printf("[SMS] D-Bus连接无效，尝试重新连接...\n");
-        GError *error = NULL;
-        g_sms_dbus_conn = g_bus_get_sync(G_BUS_TYPE_SYSTEM, NULL, &error);
-        if (g_sms_dbus_conn) {
-            printf("[SMS] D-Bus重新连接成功\n");
-            g_signal_connect(g_sms_dbus_conn, "closed", G_CALLBACK(on_dbus_connection_closed), NULL);
-            subscribe_sms_signal();
-        } else {
-            printf("[SMS] D-Bus重新连接失败: %s\n", error ? error->message : "未知错误");
-            if (error) g_error_free(error);
-        }
-        return;
-    }
-    
-    /* 检查信号订阅是否丢失 */
-    if (g_signal_subscription_id == 0) {
-        printf("[SMS] 检测到信号订阅丢失，重新订阅...\n");
-        subscribe_sms_signal();
-    }
-}
-
 /* 获取短信接收修复开关状态 */
 int sms_get_fix_enabled(void) {
     const char *sql = "SELECT sms_fix_enabled FROM sms_config WHERE id = 1;";
@@ -806,40 +1125,72 @@ static void apply_sms_fix_on_init(void) {
     }
 }
 
-/* 保存发送记录到数据库 */
-static int save_sent_sms_to_db(const char *recipient, const char *content, time_t timestamp, const char *status) {
-    char sql[2048];
-    char escaped_content[1024];
-    
-    size_t j = 0;
-    for (size_t i = 0; content[i] && j < sizeof(escaped_content) - 2; i++) {
-        if (content[i] == '\'') {
-            escaped_content[j++] = '\'';
-            escaped_content[j++] = '\'';
-        } else {
-            escaped_content[j++] = content[i];
+/* 保存发送记录到数据库，返回记录 id */
+int sms_sent_insert(const char *recipient, const char *content, const char *status) {
+    int id;
+    return sms_sent_insert_many(&recipient, 1, content, status, &id) == 1 ? id : -1;
+}
+
+/* 同一内容发给多个收件人: 一个事务写入，一次 sqlite3 调用 */
+int sms_sent_insert_many(const char *const *recipients, int count, const char *content,
+                         const char *status, int *ids) {
+    time_t timestamp = time(NULL);
+    char peer[SMS_PEER_SIZE];
+    char thread_sql[1024];
+
+    if (!recipients || !content || !ids || count <= 0) return -1;
+
+    char *content_lit = sql_literal_dup(content);
+    GString *sql = g_string_sized_new((strlen(content_lit) + 1024) * (size_t)count);
+
+    g_string_append(sql, "BEGIN;");
+    for (int i = 0; i < count; i++) {
+        sms_peer_normalize(recipients[i], peer, sizeof(peer));
+        char *recipient_lit = sql_literal_dup(recipients[i]);
+        char *peer_lit = sql_literal_dup(peer);
+
+        /* 每条插入后立即取回 id (在会话索引写入之前取，避免被覆盖) */
+        g_string_append_printf(sql,
+            "INSERT INTO sent_sms (recipient, content, timestamp, status, peer, bytes) "
+            "VALUES (%s, %s, %ld, '%s', %s, %zu);SELECT last_insert_rowid();",
+            recipient_lit, content_lit, (long)timestamp, status, peer_lit, strlen(content));
+        if (sms_thread_update_sql(thread_sql, sizeof(thread_sql), peer, recipients[i], content, timestamp, 1) > 0) {
+            g_string_append(sql, thread_sql);
         }
+        g_free(recipient_lit);
+        g_free(peer_lit);
     }
-    escaped_content[j] = '\0';
-    
-    snprintf(sql, sizeof(sql),
-        "INSERT INTO sent_sms (recipient, content, timestamp, status) VALUES ('%s', '%s', %ld, '%s');",
-        recipient, escaped_content, (long)timestamp, status);
+    g_string_append(sql, "COMMIT;");
+    g_free(content_lit);
+
+    pthread_mutex_lock(&g_sms_mutex);
+    char *output = db_query_rows_alloc(sql->str, NULL);
+    pthread_mutex_unlock(&g_sms_mutex);
+    g_string_free(sql, TRUE);
+
+    /* 输出按插入顺序每行一个 id，不足说明事务失败 */
+    int n = 0;
+    for (char *line = output ? strtok(output, "\n") : NULL; line && n < count; line = strtok(NULL, "\n")) {
+        ids[n] = atoi(line);
+        if (ids[n] <= 0) break;
+        n++;
+    }
+    free(output);
+    if (n < count) return -1;
+
+    sms_schedule_trim();
+    return n;
+}
+
+/* 更新发送记录状态 */
+int sms_sent_set_status(int id, const char *status) {
+    char sql[128];
+    snprintf(sql, sizeof(sql), "UPDATE sent_sms SET status = '%s' WHERE id = %d;", status, id);
     
     pthread_mutex_lock(&g_sms_mutex);
     int ret = db_execute(sql);
     pthread_mutex_unlock(&g_sms_mutex);
     
-    /* 清理超出限制的旧发送记录 */
-    if (ret == 0) {
-        snprintf(sql, sizeof(sql),
-            "DELETE FROM sent_sms WHERE id NOT IN (SELECT id FROM sent_sms ORDER BY id DESC LIMIT %d);",
-            g_max_sent_count);
-        pthread_mutex_lock(&g_sms_mutex);
-        db_execute(sql);
-        pthread_mutex_unlock(&g_sms_mutex);
-    }
-    
     return ret;
 }
 
@@ -856,87 +1207,63 @@ int sms_delete_sent(int id) {
 }
 
 /* 获取发送记录列表 - 使用hex编码避免特殊字符问题，兼容无JSON扩展的SQLite */
-int sms_get_sent_list(SentSmsMessage *messages, int max_count) {
-    char sql[512];
-    char *output = NULL;
-    
-    if (!messages || max_count <= 0) return -1;
-    
-    /* 分配大缓冲区 */
-    output = (char *)malloc(256 * 1024);
-    if (!output) return -1;
-    
+int sms_get_sent_list(int max_count, SentSmsRowCallback cb, void *user_data) {
+    char sql[256];
+    SentSmsMessage msg;
+    int count = 0;
+
+    if (!cb || max_count <= 0) return -1;
+
     /* 使用hex编码content字段，用|分隔，每行一条记录 */
     snprintf(sql, sizeof(sql),
-        "SELECT id || '|' || recipient || '|' || hex(content) || '|' || timestamp || '|' || status FROM sent_sms ORDER BY id DESC LIMIT %d;",
-        max_count);
-    
+        "SELECT id || '|' || recipient || '|' || hex(content) || '|' || timestamp || '|' || status "
+        "FROM sent_sms ORDER BY id DESC LIMIT %d;", max_count);
+
+    /* 正文不定长，排队中的记录不受条数上限约束，按实际大小读取 */
     pthread_mutex_lock(&g_sms_mutex);
-    int ret = db_query_string(sql, output, 256 * 1024);
+    char *output = db_query_rows_alloc(sql, NULL);
     pthread_mutex_unlock(&g_sms_mutex);
-    
-    if (ret != 0 || strlen(output) == 0) {
-        printf("[SMS] 获取发送记录列表失败或为空\n");
-        free(output);
-        return 0;
+
+    if (!output) {
+        printf("[SMS] 获取发送记录列表失败\n");
+        return -1;
     }
-    
+
     /* 解析输出 - 格式: id|recipient|hex_content|timestamp|status\n */
-    int count = 0;
     char *line = output;
-    char *next_line;
-    
     while (line && *line && count < max_count) {
-        /* 找到行尾 */
-        next_line = strchr(line, '\n');
-        if (next_line) {
-            *next_line = '\0';
-            next_line++;
-        }
-        
-        /* 跳过空行 */
-        if (strlen(line) == 0) {
-            line = next_line;
-            continue;
-        }
-        
-        /* 解析字段: id|recipient|hex_content|timestamp|status */
+        char *next_line = strchr(line, '\n');
+        if (next_line) *next_line++ = '\0';
+
         char *fields[5] = {NULL};
         int field_count = 0;
         char *p = line;
-        char *field_start = p;
-        
+        fields[field_count++] = p;
         while (*p && field_count < 5) {
             if (*p == '|') {
                 *p = '\0';
-                fields[field_count++] = field_start;
-                field_start = p + 1;
+                fields[field_count++] = p + 1;
             }
             p++;
         }
-        if (field_count < 5 && field_start) {
-            fields[field_count++] = field_start;
-        }
-        
-        if (field_count >= 5) {
-            messages[count].id = atoi(fields[0]);
-            strncpy(messages[count].recipient, fields[1], sizeof(messages[count].recipient) - 1);
-            messages[count].recipient[sizeof(messages[count].recipient) - 1] = '\0';
-            
-            /* hex解码content */
-            hex_decode(fields[2], messages[count].content, sizeof(messages[count].content));
-            
-            messages[count].timestamp = (time_t)atol(fields[3]);
-            strncpy(messages[count].status, fields[4], sizeof(messages[count].status) - 1);
-            messages[count].status[sizeof(messages[count].status) - 1] = '\0';
+
+        if (field_count == 5) {
+            const char *body = decode_body(fields[2]);
+            if (!body) break;
+            memset(&msg, 0, sizeof(msg));
+            msg.id = atoi(fields[0]);
+            g_strlcpy(msg.recipient, fields[1], sizeof(msg.recipient));
+            msg.content = body;
+            msg.content_len = strlen(body);
+            msg.timestamp = (time_t)atol(fields[3]);
+            g_strlcpy(msg.status, fields[4], sizeof(msg.status));
+            cb(&msg, user_data);
             count++;
         }
-        
         line = next_line;
     }
-    
+
     free(output);
-    printf("[SMS] 获取到 %d 条发送记录\n", count);
     return count;
 }
 
@@ -970,7 +1297,11 @@ static void load_sms_config(void) {
         }
     }
     
-    printf("[SMS] 配置加载完成: 收件箱最大=%d, 发件箱最大=%d\n", g_max_sms_count, g_max_sent_count);
+    g_max_sms_kb = config_get_int("sms_max_kb", DEFAULT_MAX_SMS_KB);
+    if (g_max_sms_kb < 0) g_max_sms_kb = 0;
+    
+    printf("[SMS] 配置加载完成: 收件箱最大=%d, 发件箱最大=%d, 容量上限=%dKB\n",
+           g_max_sms_count, g_max_sent_count, g_max_sms_kb);
 }
 
 /* 设置最大存储数量 */
@@ -991,6 +1322,7 @@ int sms_set_max_count(int count) {
     
     if (ret == 0) {
         g_max_sms_count = count;
+        sms_schedule_trim();
     }
     
     return ret;
@@ -1014,8 +1346,29 @@ int sms_set_max_sent_count(int count) {
     
     if (ret == 0) {
         g_max_sent_count = count;
+        sms_schedule_trim();
     }
     
     return ret;
 }
 
+/* 获取短信容量上限 (KB) */
+int sms_get_max_kb(void) {
+    return g_max_sms_kb;
+}
+
+/* 设置短信容量上限 (KB) */
+int sms_set_max_kb(int kb) {
+    if (kb < 0 || kb > SMS_MAX_KB_LIMIT) {
+        printf("短信容量上限必须在0-%d KB之间\n", SMS_MAX_KB_LIMIT);
+        return -1;
+    }
+    
+    int ret = config_set_int("sms_max_kb", kb);
+    if (ret == 0) {
+        g_max_sms_kb = kb;
+        sms_schedule_trim();
+    }
+    
+    return ret;
+}
@@ -0,0 +1,214 @@
+/**
+ * @file sms_journal.c
+ * @brief 短信收件日志实现
+ *
+ * 单文件追加写，O_APPEND 保证顺序; 写入不完整时截回原长度。
+ * 掉电留下的半截记录由长度和 CRC 识别，打开时截掉; 中间的损坏数据
+ * 在重放时跳过。只有重放覆盖了整个文件才允许清空。
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <glib.h>
+#include "mongoose.h"
+#include "sms_journal.h"
+
+#define HEADER_SIZE     12
+#define FIXED_SIZE      16      /* timestamp + parts + is_read */
+
+static int g_fd = -1;
+static char *g_path = NULL;
+static size_t g_replayed_size = 0;      /* 上次重放时的文件长度 */
+
+/* 解析 off 处的一条记录，成功返回记录总长，损坏或截断返回 0 */
+static size_t parse_record(const char *data, size_t size, size_t off, SmsJournalRecord *rec) {
+    uint32_t header[3];
+    if (off + HEADER_SIZE > size) return 0;
+    memcpy(header, data + off, HEADER_SIZE);
+    uint32_t len = header[1];
+
+    if (header[0] != SMS_JOURNAL_MAGIC || len < FIXED_SIZE + 4 ||
+        len > SMS_JOURNAL_MAX_RECORD || off + HEADER_SIZE + len > size) {
+        return 0;
+    }
+    const char *p = data + off + HEADER_SIZE;
+    if (mg_crc32(0, p, len) != header[2] || p[len - 1] != '\0') return 0;
+
+    int64_t ts;
+    int32_t parts, is_read;
+    memcpy(&ts, p, 8);
+    memcpy(&parts, p + 8, 4);
+    memcpy(&is_read, p + 12, 4);
+
+    /* 4 个以 \0 结尾的字符串 */
+    const char *strs[4];
+    const char *s = p + FIXED_SIZE, *end = p + len;
+    int i;
+    for (i = 0; i < 4 && s < end; i++) {
+        strs[i] = s;
+        s += strlen(s) + 1;
+    }
+    if (i < 4 || s != end) return 0;
+
+    rec->timestamp = (time_t)ts;
+    rec->parts = parts;
+    rec->is_read = is_read;
+    rec->sender = strs[0];
+    rec->sent_time = strs[1];
+    rec->hash = strs[2];
+    rec->content = strs[3];
+    return HEADER_SIZE + len;
+}
+
+/*
+ * 遍历全部有效记录 (cb 可为 NULL)
+ * 中间的损坏数据 (写入失败且回退失败) 跳过，向后找下一条有效记录，
+ * 后面追加的短信不会因此丢失
+ * @param valid_end 输出最后一条有效记录的结束位置
+ * @return 有效记录数
+ */
+static int scan_records(const char *data, size_t size, SmsJournalCallback cb, void *user_data,
+                        size_t *valid_end) {
+    size_t off = 0, skipped = 0;
+    int count = 0;
+
+    *valid_end = 0;
+    while (off + HEADER_SIZE <= size) {
+        SmsJournalRecord rec;
+        size_t n = parse_record(data, size, off, &rec);
+        if (n == 0) {
+            off++;
+            continue;
+        }
+        skipped += off - *valid_end;
+        if (cb) cb(&rec, user_data);
+        count++;
+        off += n;
+        *valid_end = off;
+    }
+
+    if (skipped > 0) {
+        printf("[SMS Journal] 跳过 %zu 字节损坏数据\n", skipped);
+    }
+    return count;
+}
+
+int sms_journal_open(const char *db_path) {
+    if (g_fd >= 0) return 0;
+
+    char *dir = g_path_get_dirname(db_path);
+    g_free(g_path);
+    g_path = g_build_filename(dir, SMS_JOURNAL_FILE, NULL);
+    g_free(dir);
+
+    g_fd = open(g_path, O_RDWR | O_APPEND | O_CREAT | O_CLOEXEC, 0600);
+    if (g_fd < 0) {
+        printf("[SMS Journal] 无法打开日志 %s\n", g_path);
+        return -1;
+    }
+
+    /* 掉电留下的半截记录先截掉，新记录不能追加在垃圾数据后面 */
+    gchar *data = NULL;
+    gsize size = 0;
+    if (g_file_get_contents(g_path, &data, &size, NULL) && size > 0) {
+        size_t valid_end;
+        scan_records(data, size, NULL, NULL, &valid_end);
+        if (valid_end < size) {
+            printf("[SMS Journal] 截掉日志尾部 %zu 字节不完整数据\n", (size_t)(size - valid_end));
+            if (ftruncate(g_fd, (off_t)valid_end) != 0) {
+                printf("[SMS Journal] 截断日志失败\n");
+            }
+        }
+    }
+    g_free(data);
+    return 0;
+}
+
+void sms_journal_close(void) {
+    if (g_fd >= 0) {
+        close(g_fd);
+        g_fd = -1;
+    }
+}
+
+int sms_journal_append(const SmsJournalRecord *rec) {
+    if (g_fd < 0) return -1;
+
+    size_t lens[4] = {
+        strlen(rec->sender), strlen(rec->sent_time), strlen(rec->hash), strlen(rec->content)
+    };
+    size_t payload_len = FIXED_SIZE + lens[0] + lens[1] + lens[2] + lens[3] + 4;
+    if (payload_len > SMS_JOURNAL_MAX_RECORD) return -1;
+
+    char *buf = g_malloc(HEADER_SIZE + payload_len);
+    char *p = buf + HEADER_SIZE;
+    int64_t ts = (int64_t)rec->timestamp;
+    int32_t parts = rec->parts, is_read = rec->is_read;
+
+    memcpy(p, &ts, 8);
+    memcpy(p + 8, &parts, 4);
+    memcpy(p + 12, &is_read, 4);
+    p += FIXED_SIZE;
+    const char *strs[4] = { rec->sender, rec->sent_time, rec->hash, rec->content };
+    for (int i = 0; i < 4; i++) {
+        memcpy(p, strs[i], lens[i] + 1);
+        p += lens[i] + 1;
+    }
+
+    uint32_t header[3] = {
+        SMS_JOURNAL_MAGIC, (uint32_t)payload_len,
+        mg_crc32(0, buf + HEADER_SIZE, payload_len)
+    };
+    memcpy(buf, header, HEADER_SIZE);
+
+    struct stat st;
+    off_t old_size = fstat(g_fd, &st) == 0 ? st.st_size : -1;
+    size_t total = HEADER_SIZE + payload_len;
+    ssize_t n = write(g_fd, buf, total);
+    g_free(buf);
+
+    if (n != (ssize_t)total || fdatasync(g_fd) != 0) {
+        printf("[SMS Journal] 写入失败\n");
+        if (n > 0 && old_size >= 0 && ftruncate(g_fd, old_size) != 0) {
+            printf("[SMS Journal] 回退半截记录失败\n");
+        }
+        return -1;
+    }
+    return 0;
+}
+
+int sms_journal_replay(SmsJournalCallback cb, void *user_data) {
+    gchar *data = NULL;
+    gsize size = 0;
+    size_t valid_end;
+
+    if (!g_path) return -1;
+    if (!g_file_get_contents(g_path, &data, &size, NULL)) return -1;
+
+    int count = scan_records(data, size, cb, user_data, &valid_end);
+    g_replayed_size = size;
+    g_free(data);
+    return count;
+}
+
+int sms_journal_reset(void) {
+    struct stat st;
+
+    if (g_fd < 0) return -1;
+    /* 重放之后又有新数据时不清空，下次重放连同已入库的记录一起去重 */
+    if (fstat(g_fd, &st) != 0 || (size_t)st.st_size != g_replayed_size) return -1;
+    if (ftruncate(g_fd, 0) != 0) return -1;
+    fdatasync(g_fd);
+    g_replayed_size = 0;
+    return 0;
+}
+
+int sms_journal_empty(void) {
+    struct stat st;
+    return g_fd < 0 || fstat(g_fd, &st) != 0 || st.st_size == 0;
+}
@@ -0,0 +1,374 @@
+/**
+ * @file sms_outbox.c
+ * @brief 短信发送队列实现
+ *
+ * 全部在主循环中运行: 定时器按间隔取出一条，异步调用 SendMessage，
+ * 返回的消息对象路径记入跟踪表，收到 State=sent/failed 后落库并移除。
+ * oFono 不可用时任务留在队首，oFono 重新出现后由 sms_outbox_resync 恢复。
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <glib.h>
+#include <gio/gio.h>
+#include "mongoose.h"
+#include "sms_outbox.h"
+#include "sms.h"
+#include "database.h"
+#include "http_utils.h"
+#include "json_builder.h"
+
+#define OUTBOX_MODEM_PATH       "/ril_0"
+#define OUTBOX_CALL_TIMEOUT_MS  30000
+#define OUTBOX_STATE_TIMEOUT_S  180     /* 交给 oFono 后等待最终状态的上限 */
+#define OUTBOX_SWEEP_MS         10000
+
+typedef struct {
+    int id;
+    char recipient[64];
+    char *content;
+    gint64 submitted_us;    /* 交给 oFono 的时间 */
+} OutboxJob;
+
+static GQueue g_queue = G_QUEUE_INIT;
+static GHashTable *g_tracking = NULL;   /* 消息对象路径 -> OutboxJob */
+static int g_interval_ms = SMS_OUTBOX_DEFAULT_MS;
+static gint64 g_last_send_us = 0;
+static guint g_dispatch_timer = 0;
+static guint g_sweep_timer = 0;
+static int g_calling = 0;               /* SendMessage 调用进行中 */
+static GDBusConnection *g_sub_conn = NULL;
+static guint g_state_sub = 0;
+static unsigned long g_sent = 0, g_failed = 0;
+
+static void outbox_schedule(void);
+
+static void job_free(gpointer data) {
+    OutboxJob *job = (OutboxJob *)data;
+    if (!job) return;
+    g_free(job->content);
+    g_free(job);
+}
+
+static void job_finish(OutboxJob *job, int ok, const char *reason) {
+    sms_sent_set_status(job->id, ok ? "sent" : "failed");
+    if (ok) {
+        g_sent++;
+        printf("[Outbox] #%d 已发送到 %s\n", job->id, job->recipient);
+    } else {
+        g_failed++;
+        printf("[Outbox] #%d 发送失败: %s\n", job->id, reason ? reason : "未知原因");
+    }
+}
+
+/* org.ofono.Message.PropertyChanged(State) */
+static void on_message_property_changed(GDBusConnection *conn, const gchar *sender_name,
+    const gchar *object_path, const gchar *interface_name, const gchar *signal_name,
+    GVariant *parameters, gpointer user_data) {
+    (void)conn; (void)sender_name; (void)interface_name; (void)signal_name; (void)user_data;
+
+    if (!g_tracking || !g_variant_is_of_type(parameters, G_VARIANT_TYPE("(sv)"))) return;
+
+    OutboxJob *job = g_hash_table_lookup(g_tracking, object_path);
+    if (!job) return;
+
+    const gchar *name = NULL;
+    GVariant *value = NULL;
+    g_variant_get(parameters, "(&sv)", &name, &value);
+
+    if (g_strcmp0(name, "State") == 0 && g_variant_is_of_type(value, G_VARIANT_TYPE_STRING)) {
+        const gchar *state = g_variant_get_string(value, NULL);
+        if (g_strcmp0(state, "sent") == 0 || g_strcmp0(state, "failed") == 0) {
+            job_finish(job, state[0] == 's', "网络拒绝");
+            g_hash_table_remove(g_tracking, object_path);
+        }
+    }
+    g_variant_unref(value);
+}
+
+/* 连接变化 (oFono/D-Bus 重连) 时重新订阅状态信号 */
+static void ensure_state_subscription(GDBusConnection *conn) {
+    if (conn == g_sub_conn) return;
+
+    if (g_sub_conn) {
+        g_dbus_connection_signal_unsubscribe(g_sub_conn, g_state_sub);
+        g_object_unref(g_sub_conn);
+    }
+    g_sub_conn = g_object_ref(conn);
+    g_state_sub = g_dbus_connection_signal_subscribe(
+        conn, "org.ofono", "org.ofono.Message", "PropertyChanged",
+        NULL, NULL, G_DBUS_SIGNAL_FLAGS_NONE,
+        on_message_property_changed, NULL, NULL);
+}
+
+/* 超时未收到最终状态的按失败处理 */
+static gboolean sweep_tracking(gpointer user_data) {
+    GHashTableIter iter;
+    gpointer key, value;
+    gint64 now = g_get_monotonic_time();
+    (void)user_data;
+
+    g_hash_table_iter_init(&iter, g_tracking);
+    while (g_hash_table_iter_next(&iter, &key, &value)) {
+        OutboxJob *job = (OutboxJob *)value;
+        if (now - job->submitted_us > (gint64)OUTBOX_STATE_TIMEOUT_S * G_USEC_PER_SEC) {
+            job_finish(job, 0, "等待状态超时");
+            g_hash_table_iter_remove(&iter);
+        }
+    }
+
+    if (g_hash_table_size(g_tracking) == 0) {
+        g_sweep_timer = 0;
+        return G_SOURCE_REMOVE;
+    }
+    return G_SOURCE_CONTINUE;
+}
+
+static void on_send_reply(GObject *source, GAsyncResult *res, gpointer user_data) {
+    OutboxJob *job = (OutboxJob *)user_data;
+    GError *error = NULL;
+    GVariant *result = g_dbus_connection_call_finish(G_DBUS_CONNECTION(source), res, &error);
+
+    g_calling = 0;
+    if (!result) {
+        job_finish(job, 0, error ? error->message : NULL);
+        if (error) g_error_free(error);
+        job_free(job);
+    } else {
+        const gchar *path = NULL;
+        g_variant_get(result, "(&o)", &path);
+        /* 已交给 oFono，重启后不能再按 pending 重发 */
+        sms_sent_set_status(job->id, "submitted");
+        job->submitted_us = g_get_monotonic_time();
+        g_hash_table_replace(g_tracking, g_strdup(path), job);
+        if (g_sweep_timer == 0) {
+            g_sweep_timer = g_timeout_add(OUTBOX_SWEEP_MS, sweep_tracking, NULL);
+        }
+        g_variant_unref(result);
+    }
+    outbox_schedule();
+}
+
+static gboolean dispatch_next(gpointer user_data) {
+    (void)user_data;
+    g_dispatch_timer = 0;
+
+    OutboxJob *job = g_queue_peek_head(&g_queue);
+    if (!job || g_calling) return G_SOURCE_REMOVE;
+
+    GDBusConnection *conn = sms_get_dbus_connection();
+    if (!conn) return G_SOURCE_REMOVE;     /* 等 oFono 出现后恢复 */
+    ensure_state_subscription(conn);
+
+    g_queue_pop_head(&g_queue);
+    g_calling = 1;
+    g_last_send_us = g_get_monotonic_time();
+    g_dbus_connection_call(conn, "org.ofono", OUTBOX_MODEM_PATH,
+        "org.ofono.MessageManager", "SendMessage",
+        g_variant_new("(ss)", job->recipient, job->content),
+        G_VARIANT_TYPE("(o)"), G_DBUS_CALL_FLAGS_NONE,
+        OUTBOX_CALL_TIMEOUT_MS, NULL, on_send_reply, job);
+    return G_SOURCE_REMOVE;
+}
+
+/* 按最小间隔安排下一次发送 */
+static void outbox_schedule(void) {
+    if (g_dispatch_timer > 0 || g_calling || g_queue_is_empty(&g_queue)) return;
+
+    gint64 wait_ms = (g_last_send_us + (gint64)g_interval_ms * 1000 - g_get_monotonic_time()) / 1000;
+    if (wait_ms < 0) wait_ms = 0;
+    g_dispatch_timer = g_timeout_add((guint)wait_ms, dispatch_next, NULL);
+}
+
+static void queue_job(int id, const char *recipient, const char *content) {
+    OutboxJob *job = g_new0(OutboxJob, 1);
+    job->id = id;
+    g_strlcpy(job->recipient, recipient, sizeof(job->recipient));
+    job->content = g_strdup(content);
+    g_queue_push_tail(&g_queue, job);
+}
+
+int sms_outbox_enqueue(const char *recipient, const char *content) {
+    int id;
+    return sms_outbox_enqueue_many(&recipient, 1, content, &id) == 1 ? id : -1;
+}
+
+int sms_outbox_enqueue_many(const char *const *recipients, int count, const char *content, int *ids) {
+    const char *valid[SMS_OUTBOX_MAX_RECIPIENTS];
+    int valid_ids[SMS_OUTBOX_MAX_RECIPIENTS];
+    int pos[SMS_OUTBOX_MAX_RECIPIENTS];
+    int n = 0;
+
+    if (!recipients || !ids || count <= 0 || count > SMS_OUTBOX_MAX_RECIPIENTS) return -1;
+    for (int i = 0; i < count; i++) ids[i] = -1;
+    if (!content || !content[0] || strlen(content) > SMS_OUTBOX_MAX_CONTENT) return 0;
+
+    /* 号码无效或超出队列剩余容量的收件人被拒绝 */
+    int room = SMS_OUTBOX_MAX_QUEUE - (int)g_queue_get_length(&g_queue);
+    for (int i = 0; i < count; i++) {
+        const char *r = recipients[i];
+        if (!r || !r[0] || strlen(r) >= sizeof(((OutboxJob *)0)->recipient)) continue;
+        if (n >= room) {
+            printf("[Outbox] 队列已满，拒绝发送到 %s\n", r);
+            continue;
+        }
+        valid[n] = r;
+        pos[n] = i;
+        n++;
+    }
+    if (n == 0) return 0;
+
+    /* 全部收件人一次写库，HTTP 线程只等一次 sqlite3 */
+    if (sms_sent_insert_many(valid, n, content, "pending", valid_ids) != n) return -1;
+
+    for (int k = 0; k < n; k++) {
+        ids[pos[k]] = valid_ids[k];
+        queue_job(valid_ids[k], valid[k], content);
+    }
+    outbox_schedule();
+    return n;
+}
+
+/*
+ * 上次运行未发出的 pending 记录重新排队。
+ * submitted 记录已交给 oFono，结果无从得知，标记为 unknown 而不重发。
+ */
+static void restore_pending(void) {
+    db_execute("UPDATE sent_sms SET status = 'unknown' WHERE status = 'submitted';");
+
+    char *rows = db_query_rows_alloc(
+        "SELECT id || '|' || recipient || '|' || hex(content) FROM sent_sms "
+        "WHERE status = 'pending' ORDER BY id;", NULL);
+    int restored = 0;
+
+    if (!rows) return;
+    for (char *line = strtok(rows, "\n"); line; line = strtok(NULL, "\n")) {
+        char *f1 = strchr(line, '|');
+        char *f2 = f1 ? strchr(f1 + 1, '|') : NULL;
+        if (!f2) continue;
+        *f1 = '\0';
+        *f2 = '\0';
+
+        size_t size = strlen(f2 + 1) / 2 + 1;
+        char *content = g_malloc(size);
+        db_hex_decode(f2 + 1, content, size);
+        if (content[0] && strlen(f1 + 1) < sizeof(((OutboxJob *)0)->recipient)) {
+            queue_job(atoi(line), f1 + 1, content);
+            restored++;
+        }
+        g_free(content);
+    }
+    free(rows);
+
+    if (restored > 0) {
+        printf("[Outbox] 恢复 %d 条未发送的短信\n", restored);
+        outbox_schedule();
+    }
+}
+
+/* 断开期间错过的状态变化: 按 oFono 当前的消息属性补齐 */
+static void on_get_messages(GObject *source, GAsyncResult *res, gpointer user_data) {
+    GError *error = NULL;
+    GVariant *result = g_dbus_connection_call_finish(G_DBUS_CONNECTION(source), res, &error);
+    (void)user_data;
+
+    if (!result) {
+        printf("[Outbox] 获取 oFono 消息列表失败: %s\n", error ? error->message : "未知错误");
+        if (error) g_error_free(error);
+        return;
+    }
+
+    GVariantIter *iter = NULL;
+    const gchar *path = NULL;
+    GVariant *props = NULL;
+    g_variant_get(result, "(a(oa{sv}))", &iter);
+    while (g_variant_iter_loop(iter, "(&o@a{sv})", &path, &props)) {
+        OutboxJob *job = g_hash_table_lookup(g_tracking, path);
+        const gchar *state = NULL;
+        if (!job || !g_variant_lookup(props, "State", "&s", &state)) continue;
+        if (g_strcmp0(state, "sent") == 0 || g_strcmp0(state, "failed") == 0) {
+            job_finish(job, state[0] == 's', "网络拒绝");
+            g_hash_table_remove(g_tracking, path);
+        }
+    }
+    /* 已从列表消失的消息结果未知，留给超时清理 */
+    g_variant_iter_free(iter);
+    g_variant_unref(result);
+}
+
+void sms_outbox_resync(void) {
+    GDBusConnection *conn = sms_get_dbus_connection();
+    if (!conn) return;
+
+    ensure_state_subscription(conn);
+
+    /* 恢复因 oFono 不可用而停下的队列 */
+    outbox_schedule();
+
+    if (g_tracking && g_hash_table_size(g_tracking) > 0) {
+        g_dbus_connection_call(conn, "org.ofono", OUTBOX_MODEM_PATH,
+            "org.ofono.MessageManager", "GetMessages", NULL,
+            G_VARIANT_TYPE("(a(oa{sv}))"), G_DBUS_CALL_FLAGS_NONE,
+            OUTBOX_CALL_TIMEOUT_MS, NULL, on_get_messages, NULL);
+    }
+}
+
+void sms_outbox_init(void) {
+    g_interval_ms = config_get_int("sms_send_interval_ms", SMS_OUTBOX_DEFAULT_MS);
+    if (g_interval_ms < SMS_OUTBOX_MIN_MS) g_interval_ms = SMS_OUTBOX_MIN_MS;
+
+    g_tracking = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, job_free);
+    restore_pending();
+}
+
+void sms_outbox_get_stats(SmsOutboxStats *st) {
+    st->queued = (int)g_queue_get_length(&g_queue) + g_calling;
+    st->tracking = g_tracking ? (int)g_hash_table_size(g_tracking) : 0;
+    st->interval_ms = g_interval_ms;
+    st->sent = g_sent;
+    st->failed = g_failed;
+}
+
+/* GET /api/sms/outbox */
+void handle_sms_outbox(struct mg_connection *c, struct mg_http_message *hm) {
+    HTTP_CHECK_GET(c, hm);
+
+    SmsOutboxStats st;
+    sms_outbox_get_stats(&st);
+
+    JsonBuilder *j = json_new();
+    json_obj_open(j);
+    json_add_int(j, "queued", st.queued);
+    json_add_int(j, "tracking", st.tracking);
+    json_add_int(j, "interval_ms", st.interval_ms);
+    json_add_ulong(j, "sent", st.sent);
+    json_add_ulong(j, "failed", st.failed);
+
+    json_arr_open(j, "pending");
+    for (GList *l = g_queue_peek_head_link(&g_queue); l; l = l->next) {
+        OutboxJob *job = (OutboxJob *)l->data;
+        json_arr_obj_open(j);
+        json_add_int(j, "id", job->id);
+        json_add_str(j, "recipient", job->recipient);
+        json_add_str(j, "state", "queued");
+        json_obj_close(j);
+    }
+    if (g_tracking) {
+        GHashTableIter iter;
+        gpointer key, value;
+        g_hash_table_iter_init(&iter, g_tracking);
+        while (g_hash_table_iter_next(&iter, &key, &value)) {
+            OutboxJob *job = (OutboxJob *)value;
+            json_arr_obj_open(j);
+            json_add_int(j, "id", job->id);
+            json_add_str(j, "recipient", job->recipient);
+            json_add_str(j, "state", "sending");
+            json_obj_close(j);
+        }
+    }
+    json_arr_close(j);
+
+    json_obj_close(j);
+    HTTP_OK_FREE(c, json_finish(j));
+}
@@ -0,0 +1,564 @@
+/**
+ * @file sms_rule.c
+ * @brief 短信规则引擎实现
+ *
+ * 规则最多 SMS_RULE_MAX 条，按 (priority DESC, id) 排好序，
+ * 候选集合用 64 位掩码表示: 精确号码查哈希表得到掩码，再并上前缀规则和任意规则，
+ * 按位从低到高 (即优先级从高到低) 匹配内容正则，命中 stop 规则后不再继续。
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <glib.h>
+#include "mongoose.h"
+#include "sms_rule.h"
+#include "sms_thread.h"
+#include "sms_outbox.h"
+#include "webhook.h"
+#include "database.h"
+#include "http_utils.h"
+#include "json_builder.h"
+
+#define LITERAL_SIZE(n)         ((n) * 2 + 20)
+#define SCRIPT_TIMEOUT_SECS     60
+
+typedef struct {
+    int id;
+    int enabled;
+    int priority;
+    int stop;                   /* 命中后不再匹配后续规则 */
+    SmsRuleAction action;
+    char name[SMS_RULE_NAME_SIZE];
+    char sender[SMS_RULE_SENDER_SIZE];      /* 用户填写的原始形式 */
+    char peer[SMS_PEER_SIZE];               /* 规范化后的号码或前缀 */
+    int prefix;                             /* sender 以 * 结尾 */
+    char pattern[SMS_RULE_PATTERN_SIZE];
+    char target[SMS_RULE_TARGET_SIZE];
+    GRegex *re;                             /* 空 pattern 为 NULL */
+    unsigned long hits;
+} SmsRule;
+
+typedef struct {
+    GPid pid;
+    guint timer;
+} ScriptRun;
+
+static const char *ACTION_NAMES[SMS_RULE_ACTION_COUNT] = { "forward", "webhook", "script", "read" };
+
+static const char *RULES_TABLE_SQL =
+    "CREATE TABLE IF NOT EXISTS sms_rules ("
+    "id INTEGER PRIMARY KEY AUTOINCREMENT, name TEXT NOT NULL DEFAULT '', "
+    "enabled INTEGER NOT NULL DEFAULT 1, priority INTEGER NOT NULL DEFAULT 0, "
+    "sender TEXT NOT NULL DEFAULT '', pattern TEXT NOT NULL DEFAULT '', "
+    "action TEXT NOT NULL, target TEXT NOT NULL DEFAULT '', stop INTEGER NOT NULL DEFAULT 0);";
+
+static SmsRule g_rules[SMS_RULE_MAX];
+static int g_rule_count = 0;
+static GHashTable *g_exact = NULL;      /* peer -> guint64 掩码 */
+static guint64 g_prefix_mask = 0;
+static guint64 g_any_mask = 0;
+static int g_scripts_running = 0;
+
+static int action_from_name(const char *name) {
+    for (int i = 0; i < SMS_RULE_ACTION_COUNT; i++) {
+        if (name && strcmp(name, ACTION_NAMES[i]) == 0) return i;
+    }
+    return -1;
+}
+
+/* "前缀*" 拆出前缀并规范化，返回是否为前缀规则 */
+static int normalize_sender(const char *sender, char *peer, size_t size) {
+    char buf[SMS_RULE_SENDER_SIZE];
+    size_t len = strlen(sender);
+    int prefix = len > 0 && sender[len - 1] == '*';
+
+    g_strlcpy(buf, sender, sizeof(buf));
+    if (prefix) buf[len - 1] = '\0';
+    if (buf[0]) sms_peer_normalize(buf, peer, size);
+    else peer[0] = '\0';
+    return prefix;
+}
+
+static void free_rules(void) {
+    for (int i = 0; i < g_rule_count; i++) {
+        if (g_rules[i].re) g_regex_unref(g_rules[i].re);
+    }
+    g_rule_count = 0;
+    if (g_exact) g_hash_table_remove_all(g_exact);
+    g_prefix_mask = 0;
+    g_any_mask = 0;
+}
+
+/* 按优先级顺序建立候选索引，禁用的规则不进索引 */
+static void build_index(void) {
+    for (int i = 0; i < g_rule_count; i++) {
+        SmsRule *r = &g_rules[i];
+        guint64 bit = (guint64)1 << i;
+        if (!r->enabled) continue;
+
+        if (r->peer[0] == '\0') {
+            g_any_mask |= bit;
+        } else if (r->prefix) {
+            g_prefix_mask |= bit;
+        } else {
+            guint64 *mask = g_hash_table_lookup(g_exact, r->peer);
+            if (!mask) {
+                mask = g_new0(guint64, 1);
+                g_hash_table_insert(g_exact, g_strdup(r->peer), mask);
+            }
+            *mask |= bit;
+        }
+    }
+}
+
+/* 从数据库重新载入并编译全部规则，命中计数按 id 保留 */
+static void reload_rules(void) {
+    struct { int id; unsigned long hits; } old[SMS_RULE_MAX];
+    int old_count = g_rule_count;
+
+    for (int i = 0; i < old_count; i++) {
+        old[i].id = g_rules[i].id;
+        old[i].hits = g_rules[i].hits;
+    }
+    free_rules();
+
+    char *rows = db_query_rows_alloc(
+        "SELECT id || '|' || enabled || '|' || priority || '|' || stop || '|' || action || '|' || "
+        "hex(name) || '|' || hex(sender) || '|' || hex(pattern) || '|' || hex(target) "
+        "FROM sms_rules ORDER BY priority DESC, id;", NULL);
+    if (!rows) return;
+
+    for (char *line = strtok(rows, "\n"); line && g_rule_count < SMS_RULE_MAX;
+         line = strtok(NULL, "\n")) {
+        char *f[9];
+        int n = 0;
+        for (char *p = line; n < 9; n++) {
+            f[n] = p;
+            p = strchr(p, '|');
+            if (!p) { n++; break; }
+            *p++ = '\0';
+        }
+        if (n != 9) continue;
+
+        SmsRule *r = &g_rules[g_rule_count];
+        memset(r, 0, sizeof(*r));
+        r->id = atoi(f[0]);
+        r->enabled = atoi(f[1]);
+        r->priority = atoi(f[2]);
+        r->stop = atoi(f[3]);
+        int action = action_from_name(f[4]);
+        if (action < 0) continue;
+        r->action = (SmsRuleAction)action;
+        db_hex_decode(f[5], r->name, sizeof(r->name));
+        db_hex_decode(f[6], r->sender, sizeof(r->sender));
+        db_hex_decode(f[7], r->pattern, sizeof(r->pattern));
+        db_hex_decode(f[8], r->target, sizeof(r->target));
+        r->prefix = normalize_sender(r->sender, r->peer, sizeof(r->peer));
+
+        if (r->pattern[0]) {
+            GError *error = NULL;
+            r->re = g_regex_new(r->pattern, G_REGEX_OPTIMIZE, 0, &error);
+            if (!r->re) {
+                printf("[SMS Rule] 规则 #%d 正则无效，已跳过: %s\n", r->id, error->message);
+                g_error_free(error);
+                continue;
+            }
+        }
+
+        for (int i = 0; i < old_count; i++) {
+            if (old[i].id == r->id) { r->hits = old[i].hits; break; }
+        }
+        g_rule_count++;
+    }
+    free(rows);
+
+    build_index();
+    printf("[SMS Rule] 已载入 %d 条规则\n", g_rule_count);
+}
+
+/* 返回命中规则的掩码 (位序即优先级顺序) */
+static guint64 match_rules(const char *sender, const char *content) {
+    char peer[SMS_PEER_SIZE];
+    guint64 candidates = g_any_mask;
+    guint64 matched = 0;
+
+    sms_peer_normalize(sender, peer, sizeof(peer));
+    guint64 *exact = g_exact ? g_hash_table_lookup(g_exact, peer) : NULL;
+    if (exact) candidates |= *exact;
+
+    for (guint64 m = g_prefix_mask; m; m &= m - 1) {
+        SmsRule *r = &g_rules[__builtin_ctzll(m)];
+        if (strncmp(peer, r->peer, strlen(r->peer)) == 0) {
+            candidates |= (guint64)1 << __builtin_ctzll(m);
+        }
+    }
+
+    for (; candidates; candidates &= candidates - 1) {
+        int i = __builtin_ctzll(candidates);
+        SmsRule *r = &g_rules[i];
+        if (r->re && !g_regex_match(r->re, content, 0, NULL)) continue;
+        matched |= (guint64)1 << i;
+        if (r->stop) break;
+    }
+    return matched;
+}
+
+/*============================================================================
+ * 动作
+ *============================================================================*/
+
+static void forward_sms(const SmsRule *r, const char *sender, const char *content) {
+    char peer[SMS_PEER_SIZE], target_peer[SMS_PEER_SIZE];
+
+    /* 不转发给发件人自己，避免两台设备互相转发形成环路 */
+    sms_peer_normalize(sender, peer, sizeof(peer));
+    sms_peer_normalize(r->target, target_peer, sizeof(target_peer));
+    if (strcmp(peer, target_peer) == 0) return;
+
+    char *text = g_strdup_printf("[%s] %s", sender, content);
+    size_t len = strlen(text);
+    if (len > SMS_OUTBOX_MAX_CONTENT) {
+        /* 按 UTF-8 字符边界截断 */
+        len = SMS_OUTBOX_MAX_CONTENT;
+        while (len > 0 && ((unsigned char)text[len] & 0xC0) == 0x80) len--;
+        text[len] = '\0';
+    }
+    if (sms_outbox_enqueue(r->target, text) < 0) {
+        printf("[SMS Rule] 规则 #%d 转发到 %s 失败\n", r->id, r->target);
+    }
+    g_free(text);
+}
+
+static void call_webhook(const SmsRule *r, const char *sender, const char *content, time_t timestamp) {
+    char time_str[32];
+    strftime(time_str, sizeof(time_str), "%Y-%m-%d %H:%M:%S", localtime(&timestamp));
+
+    JsonBuilder *j = json_new();
+    json_obj_open(j);
+    json_add_int(j, "rule_id", r->id);
+    json_add_str(j, "rule", r->name);
+    json_add_str(j, "sender", sender);
+    json_add_str(j, "content", content);
+    json_add_str(j, "time", time_str);
+    json_add_long(j, "timestamp", (long long)timestamp);
+    json_obj_close(j);
+
+    char *body = json_finish(j);
+    webhook_enqueue(r->target, "Content-Type: application/json", body, strlen(body));
+    free(body);
+}
+
+static void on_script_exit(GPid pid, gint status, gpointer user_data) {
+    ScriptRun *run = (ScriptRun *)user_data;
+    (void)status;
+
+    if (run->timer) g_source_remove(run->timer);
+    g_spawn_close_pid(pid);
+    g_free(run);
+    g_scripts_running--;
+}
+
+static gboolean on_script_timeout(gpointer user_data) {
+    ScriptRun *run = (ScriptRun *)user_data;
+    run->timer = 0;
+    printf("[SMS Rule] 脚本运行超时，终止 pid=%d\n", (int)run->pid);
+    kill(run->pid, SIGKILL);
+    return G_SOURCE_REMOVE;
+}
+
+/* 脚本参数: $1 发件人, $2 内容; 同时以 SMS_* 环境变量提供 */
+static void run_script(const SmsRule *r, const char *sender, const char *content, time_t timestamp) {
+    if (g_scripts_running >= SMS_RULE_MAX_SCRIPTS) {
+        printf("[SMS Rule] 运行中的脚本过多，跳过 %s\n", r->target);
+        return;
+    }
+
+    char *path = g_build_filename(SMS_RULE_SCRIPTS_DIR, r->target, NULL);
+    char ts[24], rule_id[16];
+    snprintf(ts, sizeof(ts), "%ld", (long)timestamp);
+    snprintf(rule_id, sizeof(rule_id), "%d", r->id);
+
+    char **envp = g_get_environ();
+    envp = g_environ_setenv(envp, "SMS_SENDER", sender, TRUE);
+    envp = g_environ_setenv(envp, "SMS_CONTENT", content, TRUE);
+    envp = g_environ_setenv(envp, "SMS_TIMESTAMP", ts, TRUE);
+    envp = g_environ_setenv(envp, "SMS_RULE_ID", rule_id, TRUE);
+
+    char *argv[] = { path, (char *)sender, (char *)content, NULL };
+    GPid pid;
+    GError *error = NULL;
+    if (g_spawn_async(SMS_RULE_SCRIPTS_DIR, argv, envp,
+                      G_SPAWN_DO_NOT_REAP_CHILD | G_SPAWN_STDOUT_TO_DEV_NULL | G_SPAWN_STDERR_TO_DEV_NULL,
+                      NULL, NULL, &pid, &error)) {
+        ScriptRun *run = g_new0(ScriptRun, 1);
+        run->pid = pid;
+        run->timer = g_timeout_add_seconds(SCRIPT_TIMEOUT_SECS, on_script_timeout, run);
+        g_child_watch_add(pid, on_script_exit, run);
+        g_scripts_running++;
+    } else {
+        printf("[SMS Rule] 脚本启动失败 %s: %s\n", path, error->message);
+        g_error_free(error);
+    }
+    g_strfreev(envp);
+    g_free(path);
+}
+
+int sms_rule_apply(const char *sender, const char *content, time_t timestamp, int *mark_read) {
+    int count = 0;
+    *mark_read = 0;
+    if (g_rule_count == 0) return 0;
+
+    for (guint64 m = match_rules(sender, content); m; m &= m - 1) {
+        SmsRule *r = &g_rules[__builtin_ctzll(m)];
+        r->hits++;
+        count++;
+        printf("[SMS Rule] 命中规则 #%d %s -> %s\n", r->id, r->name, ACTION_NAMES[r->action]);
+
+        switch (r->action) {
+        case SMS_RULE_FORWARD:   forward_sms(r, sender, content); break;
+        case SMS_RULE_WEBHOOK:   call_webhook(r, sender, content, timestamp); break;
+        case SMS_RULE_SCRIPT:    run_script(r, sender, content, timestamp); break;
+        case SMS_RULE_MARK_READ: *mark_read = 1; break;
+        default: break;
+        }
+    }
+    return count;
+}
+
+void sms_rule_init(void) {
+    db_execute(RULES_TABLE_SQL);
+    if (!g_exact) {
+        g_exact = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, g_free);
+    }
+    reload_rules();
+}
+
+/*============================================================================
+ * HTTP API
+ *============================================================================*/
+
+static void add_rule_json(JsonBuilder *j, const SmsRule *r) {
+    json_arr_obj_open(j);
+    json_add_int(j, "id", r->id);
+    json_add_str(j, "name", r->name);
+    json_add_bool(j, "enabled", r->enabled);
+    json_add_int(j, "priority", r->priority);
+    json_add_str(j, "sender", r->sender);
+    json_add_str(j, "pattern", r->pattern);
+    json_add_str(j, "action", ACTION_NAMES[r->action]);
+    json_add_str(j, "target", r->target);
+    json_add_bool(j, "stop", r->stop);
+    json_add_ulong(j, "hits", r->hits);
+    json_obj_close(j);
+}
+
+/* GET /api/sms/rules */
+void handle_sms_rules_list(struct mg_connection *c, struct mg_http_message *hm) {
+    HTTP_CHECK_GET(c, hm);
+
+    JsonBuilder *j = json_new();
+    json_obj_open(j);
+    json_arr_open(j, "rules");
+    for (int i = 0; i < g_rule_count; i++) {
+        add_rule_json(j, &g_rules[i]);
+    }
+    json_arr_close(j);
+    json_add_int(j, "max", SMS_RULE_MAX);
+    json_obj_close(j);
+    HTTP_OK_FREE(c, json_finish(j));
+}
+
+static void reply_error(struct mg_connection *c, int code, const char *msg) {
+    JsonBuilder *j = json_new();
+    json_obj_open(j);
+    json_add_str(j, "error", msg);
+    json_obj_close(j);
+    HTTP_JSON_FREE(c, code, json_finish(j));
+}
+
+/* 把请求字段复制到定长缓冲，超长返回 -1 */
+static int get_field(struct mg_http_message *hm, const char *path, char *out, size_t size) {
+    char *val = mg_json_get_str(hm->body, path);
+    int ret = 0;
+    out[0] = '\0';
+    if (val) {
+        if (strlen(val) >= size) ret = -1;
+        else strcpy(out, val);
+        free(val);
+    }
+    return ret;
+}
+
+/* 校验动作目标，失败返回错误信息 */
+static const char *check_target(SmsRuleAction action, const char *target) {
+    switch (action) {
+    case SMS_RULE_FORWARD:
+        if (!target[0] || strlen(target) >= SMS_PEER_SIZE) return "转发号码无效";
+        for (const char *p = target; *p; p++) {
+            if (!g_ascii_isdigit(*p) && *p != '+') return "转发号码只能包含数字和 +";
+        }
+        return NULL;
+    case SMS_RULE_WEBHOOK:
+        if (strncmp(target, "http://", 7) != 0 && strncmp(target, "https://", 8) != 0) {
+            return "Webhook 地址必须以 http:// 或 https:// 开头";
+        }
+        return NULL;
+    case SMS_RULE_SCRIPT: {
+        if (!target[0] || target[0] == '.' || strchr(target, '/')) return "脚本名称无效";
+        char *path = g_build_filename(SMS_RULE_SCRIPTS_DIR, target, NULL);
+        int ok = g_file_test(path, G_FILE_TEST_IS_REGULAR);
+        g_free(path);
+        return ok ? NULL : "脚本不存在，请先在脚本管理中上传";
+    }
+    default:
+        return NULL;
+    }
+}
+
+/* POST /api/sms/rules
+ * {"id":0,"name":"","enabled":true,"priority":0,"sender":"1069*","pattern":"验证码",
+ *  "action":"forward|webhook|script|read","target":"","stop":false} */
+void handle_sms_rules_save(struct mg_connection *c, struct mg_http_message *hm) {
+    HTTP_CHECK_POST(c, hm);
+
+    char name[SMS_RULE_NAME_SIZE], sender[SMS_RULE_SENDER_SIZE];
+    char pattern[SMS_RULE_PATTERN_SIZE], target[SMS_RULE_TARGET_SIZE], action_name[16];
+    bool enabled = true, stop = false;
+
+    if (get_field(hm, "$.name", name, sizeof(name)) != 0 ||
+        get_field(hm, "$.sender", sender, sizeof(sender)) != 0 ||
+        get_field(hm, "$.pattern", pattern, sizeof(pattern)) != 0 ||
+        get_field(hm, "$.target", target, sizeof(target)) != 0 ||
+        get_field(hm, "$.action", action_name, sizeof(action_name)) != 0) {
+        HTTP_ERROR(c, 400, "字段过长");
+        return;
+    }
+    long id = mg_json_get_long(hm->body, "$.id", 0);
+    long priority = mg_json_get_long(hm->body, "$.priority", 0);
+    mg_json_get_bool(hm->body, "$.enabled", &enabled);
+    mg_json_get_bool(hm->body, "$.stop", &stop);
+
+    int action = action_from_name(action_name);
+    if (action < 0) {
+        HTTP_ERROR(c, 400, "未知的动作类型");
+        return;
+    }
+    char *star = strchr(sender, '*');
+    if (star && star[1] != '\0') {
+        HTTP_ERROR(c, 400, "号码通配符 * 只能放在末尾");
+        return;
+    }
+    const char *err = check_target((SmsRuleAction)action, target);
+    if (err) {
+        HTTP_ERROR(c, 400, err);
+        return;
+    }
+    if (pattern[0]) {
+        GError *error = NULL;
+        GRegex *re = g_regex_new(pattern, G_REGEX_OPTIMIZE, 0, &error);
+        if (!re) {
+            char msg[320];
+            snprintf(msg, sizeof(msg), "内容正则无效: %s", error->message);
+            g_error_free(error);
+            reply_error(c, 400, msg);
+            return;
+        }
+        g_regex_unref(re);
+    }
+
+    char name_lit[LITERAL_SIZE(SMS_RULE_NAME_SIZE)], sender_lit[LITERAL_SIZE(SMS_RULE_SENDER_SIZE)];
+    char pattern_lit[LITERAL_SIZE(SMS_RULE_PATTERN_SIZE)], target_lit[LITERAL_SIZE(SMS_RULE_TARGET_SIZE)];
+    db_text_literal(name, name_lit, sizeof(name_lit));
+    db_text_literal(sender, sender_lit, sizeof(sender_lit));
+    db_text_literal(pattern, pattern_lit, sizeof(pattern_lit));
+    db_text_literal(target, target_lit, sizeof(target_lit));
+
+    GString *sql = g_string_new(NULL);
+    if (id > 0) {
+        char check[96];
+        snprintf(check, sizeof(check), "SELECT COUNT(*) FROM sms_rules WHERE id = %ld;", id);
+        if (db_query_int(check, 0) == 0) {
+            g_string_free(sql, TRUE);
+            HTTP_ERROR(c, 404, "规则不存在");
+            return;
+        }
+        g_string_printf(sql,
+            "UPDATE sms_rules SET name = %s, enabled = %d, priority = %ld, sender = %s, pattern = %s, "
+            "action = '%s', target = %s, stop = %d WHERE id = %ld;SELECT %ld;",
+            name_lit, enabled ? 1 : 0, priority, sender_lit, pattern_lit,
+            ACTION_NAMES[action], target_lit, stop ? 1 : 0, id, id);
+    } else {
+        if (db_query_int("SELECT COUNT(*) FROM sms_rules;", 0) >= SMS_RULE_MAX) {
+            g_string_free(sql, TRUE);
+            HTTP_ERROR(c, 400, "规则数量已达上限");
+            return;
+        }
+        g_string_printf(sql,
+            "INSERT INTO sms_rules (name, enabled, priority, sender, pattern, action, target, stop) "
+            "VALUES (%s, %d, %ld, %s, %s, '%s', %s, %d);SELECT last_insert_rowid();",
+            name_lit, enabled ? 1 : 0, priority, sender_lit, pattern_lit,
+            ACTION_NAMES[action], target_lit, stop ? 1 : 0);
+    }
+
+    char *out = db_query_rows_alloc(sql->str, NULL);
+    g_string_free(sql, TRUE);
+    int saved_id = out ? atoi(out) : 0;
+    free(out);
+    if (saved_id <= 0) {
+        HTTP_ERROR(c, 500, "保存规则失败");
+        return;
+    }
+
+    reload_rules();
+
+    JsonBuilder *j = json_new();
+    json_obj_open(j);
+    json_add_str(j, "status", "success");
+    json_add_int(j, "id", saved_id);
+    json_obj_close(j);
+    HTTP_OK_FREE(c, json_finish(j));
+}
+
+/* DELETE /api/sms/rules/:id */
+void handle_sms_rules_delete(struct mg_connection *c, struct mg_http_message *hm) {
+    HTTP_CHECK_DELETE(c, hm);
+
+    const char *p = strstr(hm->uri.buf, "/api/sms/rules/");
+    int id = p ? atoi(p + 15) : 0;
+    if (id <= 0) {
+        HTTP_ERROR(c, 400, "无效的规则ID");
+        return;
+    }
+
+    char sql[96];
+    snprintf(sql, sizeof(sql), "DELETE FROM sms_rules WHERE id = %d;", id);
+    if (db_execute(sql) != 0) {
+        HTTP_ERROR(c, 500, "删除规则失败");
+        return;
+    }
+    reload_rules();
+    HTTP_SUCCESS(c, "规则已删除");
+}
+
+/* POST /api/sms/rules/test */
+void handle_sms_rules_test(struct mg_connection *c, struct mg_http_message *hm) {
+    HTTP_CHECK_POST(c, hm);
+
+    char *sender = mg_json_get_str(hm->body, "$.sender");
+    char *content = mg_json_get_str(hm->body, "$.content");
+    guint64 matched = match_rules(sender ? sender : "", content ? content : "");
+    free(sender);
+    free(content);
+
+    JsonBuilder *j = json_new();
+    json_obj_open(j);
+    json_arr_open(j, "matched");
+    for (guint64 m = matched; m; m &= m - 1) {
+        add_rule_json(j, &g_rules[__builtin_ctzll(m)]);
+    }
+    json_arr_close(j);
+    json_obj_close(j);
+    HTTP_OK_FREE(c, json_finish(j));
+}
@@ -0,0 +1,281 @@
+/**
+ * @file sms_thread.c
+ * @brief 短信会话索引实现
+ *
+ * 写入短信时在同一条 sqlite3 调用里 INSERT OR IGNORE + UPDATE 会话行，
+ * 兼容不支持 UPSERT 的旧版 sqlite3。删除与已读变化由触发器回退计数，
+ * 删除的恰好是最后一条时重新取该会话最新一条作为预览。
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <glib.h>
+#include "mongoose.h"
+#include "sms_thread.h"
+#include "database.h"
+#include "http_utils.h"
+#include "json_builder.h"
+
+#define THREAD_ROW_BYTES   (SMS_PEER_SIZE * 2 + SMS_PREVIEW_CHARS * 4 + 64)
+#define PREVIEW_BYTES      (SMS_PREVIEW_CHARS * 4 + 1)
+#define LITERAL_SIZE(n)    ((n) * 2 + 20)
+
+/* 最新一条消息 (收发合并) 的时间、预览、方向、原始号码 */
+#define LATEST_OF_PEER(peer) \
+    "(SELECT ts, substr(replace(replace(content, char(13), ' '), char(10), ' '), 1, 60), dir, addr FROM (" \
+    "SELECT timestamp ts, content, 0 dir, sender addr FROM sms WHERE peer = " peer " " \
+    "UNION ALL SELECT timestamp, content, 1, recipient FROM sent_sms WHERE peer = " peer ") " \
+    "ORDER BY ts DESC LIMIT 1)"
+
+static const char *THREAD_TRIGGERS_SQL =
+    "CREATE TRIGGER IF NOT EXISTS sms_thread_ad AFTER DELETE ON sms BEGIN "
+    "UPDATE sms_threads SET total = total - 1, unread = unread - (old.is_read = 0) WHERE peer = old.peer;"
+    "DELETE FROM sms_threads WHERE peer = old.peer AND total <= 0;"
+    "UPDATE sms_threads SET (last_ts, last_preview, last_dir, address) = " LATEST_OF_PEER("old.peer")
+    " WHERE peer = old.peer AND last_ts <= old.timestamp; END;"
+    "CREATE TRIGGER IF NOT EXISTS sent_sms_thread_ad AFTER DELETE ON sent_sms BEGIN "
+    "UPDATE sms_threads SET total = total - 1 WHERE peer = old.peer;"
+    "DELETE FROM sms_threads WHERE peer = old.peer AND total <= 0;"
+    "UPDATE sms_threads SET (last_ts, last_preview, last_dir, address) = " LATEST_OF_PEER("old.peer")
+    " WHERE peer = old.peer AND last_ts <= old.timestamp; END;"
+    "CREATE TRIGGER IF NOT EXISTS sms_thread_au AFTER UPDATE OF is_read ON sms BEGIN "
+    "UPDATE sms_threads SET unread = unread + (new.is_read = 0) - (old.is_read = 0) WHERE peer = new.peer; END;";
+
+/* 从 sms/sent_sms 全量重建 (仅升级时执行一次) */
+static const char *THREAD_REBUILD_SQL =
+    "DELETE FROM sms_threads;"
+    "INSERT INTO sms_threads (peer, address, last_ts, last_preview, last_dir, unread, total) "
+    "SELECT peer, addr, MAX(ts), substr(replace(replace(content, char(13), ' '), char(10), ' '), 1, 60), dir, SUM(unread), COUNT(*) FROM ("
+    "SELECT peer, sender addr, timestamp ts, content, 0 dir, is_read = 0 unread FROM sms "
+    "UNION ALL SELECT peer, recipient, timestamp, content, 1, 0 FROM sent_sms) "
+    "WHERE peer IS NOT NULL GROUP BY peer;";
+
+void sms_peer_normalize(const char *addr, char *out, size_t size) {
+    size_t j = 0;
+    int digits_only = 1;
+
+    if (size == 0) return;
+    for (const char *p = addr; *p && j < size - 1; p++) {
+        if (*p == ' ' || *p == '-' || *p == '(' || *p == ')' || *p == '\t') continue;
+        if (!isdigit((unsigned char)*p) && !(*p == '+' && j == 0)) digits_only = 0;
+        out[j++] = *p;
+    }
+    out[j] = '\0';
+    if (!digits_only) return;
+
+    /* 国内手机号: +86/0086/86 + 1xxxxxxxxxx */
+    const char *num = out;
+    if (strncmp(num, "+86", 3) == 0) num += 3;
+    else if (strncmp(num, "0086", 4) == 0) num += 4;
+    else if (strncmp(num, "86", 2) == 0 && strlen(num) == 13) num += 2;
+    if (num != out && strlen(num) == 11 && num[0] == '1') {
+        memmove(out, num, 12);
+    }
+}
+
+/* 截取前 SMS_PREVIEW_CHARS 个字符，换行替换为空格 */
+static void make_preview(const char *content, char *out, size_t size) {
+    size_t j = 0;
+    int chars = 0;
+
+    for (const unsigned char *p = (const unsigned char *)content; *p && j < size - 1; p++) {
+        if ((*p & 0xC0) != 0x80 && ++chars > SMS_PREVIEW_CHARS) break;
+        out[j++] = (*p == '\n' || *p == '\r') ? ' ' : (char)*p;
+    }
+    /* 缓冲区截断在多字节字符中间时回退到字符边界 */
+    while (j > 0 && ((unsigned char)out[j - 1] & 0x80)) {
+        size_t k = j - 1;
+        while (k > 0 && ((unsigned char)out[k] & 0xC0) == 0x80) k--;
+        unsigned char lead = (unsigned char)out[k];
+        size_t need = lead >= 0xF0 ? 4 : lead >= 0xE0 ? 3 : lead >= 0xC0 ? 2 : 1;
+        if (j - k >= need) break;
+        j = k;
+    }
+    out[j] = '\0';
+}
+
+int sms_thread_update_sql(char *buf, size_t size, const char *peer, const char *addr,
+                          const char *content, time_t timestamp, int outgoing) {
+    char preview[PREVIEW_BYTES];
+    char peer_lit[LITERAL_SIZE(SMS_PEER_SIZE)];
+    char addr_lit[LITERAL_SIZE(SMS_PEER_SIZE)];
+    char preview_lit[LITERAL_SIZE(PREVIEW_BYTES)];
+
+    make_preview(content, preview, sizeof(preview));
+    if (db_text_literal(peer, peer_lit, sizeof(peer_lit)) != 0 ||
+        db_text_literal(addr, addr_lit, sizeof(addr_lit)) != 0 ||
+        db_text_literal(preview, preview_lit, sizeof(preview_lit)) != 0) {
+        return -1;
+    }
+
+    int n = snprintf(buf, size,
+        "INSERT OR IGNORE INTO sms_threads (peer) VALUES (%s);"
+        "UPDATE sms_threads SET address = %s, last_ts = %ld, last_preview = %s, last_dir = %d, "
+        "unread = unread + %d, total = total + 1 WHERE peer = %s;",
+        peer_lit, addr_lit, (long)timestamp, preview_lit, outgoing ? 1 : 0,
+        outgoing ? 0 : 1, peer_lit);
+    return (n < 0 || (size_t)n >= size) ? -1 : n;
+}
+
+/* 旧数据库的短信没有 peer，按原始号码批量回填 */
+static int backfill_peers(void) {
+    static char addrs[16 * 1024];
+    char peer[SMS_PEER_SIZE];
+    char peer_lit[LITERAL_SIZE(SMS_PEER_SIZE)];
+    char addr_lit[LITERAL_SIZE(SMS_PEER_SIZE)];
+
+    if (db_query_rows("SELECT sender FROM sms WHERE peer IS NULL "
+                      "UNION SELECT recipient FROM sent_sms WHERE peer IS NULL;",
+                      NULL, addrs, sizeof(addrs)) != 0 || addrs[0] == '\0') {
+        return 0;
+    }
+
+    GString *sql = g_string_new("BEGIN;");
+    int count = 0;
+    for (char *line = strtok(addrs, "\n"); line; line = strtok(NULL, "\n")) {
+        if (strlen(line) >= SMS_PEER_SIZE) continue;
+        sms_peer_normalize(line, peer, sizeof(peer));
+        db_text_literal(peer, peer_lit, sizeof(peer_lit));
+        db_text_literal(line, addr_lit, sizeof(addr_lit));
+        g_string_append_printf(sql,
+            "UPDATE sms SET peer = %s WHERE peer IS NULL AND sender = %s;"
+            "UPDATE sent_sms SET peer = %s WHERE peer IS NULL AND recipient = %s;",
+            peer_lit, addr_lit, peer_lit, addr_lit);
+        count++;
+    }
+    g_string_append(sql, THREAD_REBUILD_SQL);
+    g_string_append(sql, "COMMIT;");
+
+    int ret = db_execute(sql->str);
+    g_string_free(sql, TRUE);
+    printf("[SMS] 会话索引回填 %d 个号码%s\n", count, ret == 0 ? "" : " (失败)");
+    return ret;
+}
+
+void sms_thread_init(void) {
+    db_execute(THREAD_TRIGGERS_SQL);
+    backfill_peers();
+}
+
+/* GET /api/sms/threads?limit=&before_ts=&before_peer= */
+void handle_sms_threads(struct mg_connection *c, struct mg_http_message *hm) {
+    HTTP_CHECK_GET(c, hm);
+
+    char num[24], before_peer[SMS_PEER_SIZE] = "";
+    char where[256] = "1";
+    char sql[512];
+    long before_ts = 0;
+    int limit = 50;
+
+    if (mg_http_get_var(&hm->query, "limit", num, sizeof(num)) > 0) limit = atoi(num);
+    if (limit <= 0) limit = 50;
+    if (limit > SMS_THREADS_MAX_LIMIT) limit = SMS_THREADS_MAX_LIMIT;
+    if (mg_http_get_var(&hm->query, "before_ts", num, sizeof(num)) > 0) before_ts = atol(num);
+    mg_http_get_var(&hm->query, "before_peer", before_peer, sizeof(before_peer));
+
+    /* keyset 游标 (last_ts, peer)，同一秒内的多个会话不会被跳过 */
+    if (before_ts > 0) {
+        char peer_lit[LITERAL_SIZE(SMS_PEER_SIZE)];
+        db_text_literal(before_peer, peer_lit, sizeof(peer_lit));
+        snprintf(where, sizeof(where), "last_ts < %ld OR (last_ts = %ld AND peer < %s)",
+                 before_ts, before_ts, peer_lit);
+    }
+    snprintf(sql, sizeof(sql),
+        "SELECT peer || '|' || address || '|' || last_ts || '|' || last_dir || '|' || unread || '|' || total "
+        "|| '|' || last_preview FROM sms_threads WHERE %s ORDER BY last_ts DESC, peer DESC LIMIT %d;",
+        where, limit + 1);
+
+    size_t out_size = (size_t)(limit + 1) * THREAD_ROW_BYTES + 256;
+    char *output = (char *)malloc(out_size);
+    if (!output) {
+        HTTP_ERROR(c, 500, "内存不足");
+        return;
+    }
+    if (db_query_rows(sql, NULL, output, out_size) != 0) {
+        free(output);
+        HTTP_ERROR(c, 500, "获取会话列表失败");
+        return;
+    }
+
+    JsonBuilder *j = json_new();
+    json_obj_open(j);
+    json_arr_open(j, "threads");
+
+    int rows = 0;
+    char *last_peer = NULL;
+    long last_ts = 0;
+    for (char *line = strtok(output, "\n"); line; line = strtok(NULL, "\n")) {
+        /* 预览在最后一列，其中的 '|' 不再拆分 */
+        char *f[7];
+        int n = 0;
+        f[n++] = line;
+        for (char *p = line; *p && n < 7; p++) {
+            if (*p == '|') {
+                *p = '\0';
+                f[n++] = p + 1;
+            }
+        }
+        if (n != 7) continue;
+        if (++rows > limit) break;
+
+        last_peer = f[0];
+        last_ts = atol(f[2]);
+        time_t ts = (time_t)last_ts;
+        char time_str[32];
+        strftime(time_str, sizeof(time_str), "%Y-%m-%dT%H:%M:%S", localtime(&ts));
+
+        json_arr_obj_open(j);
+        json_add_str(j, "peer", f[0]);
+        json_add_str(j, "address", f[1]);
+        json_add_long(j, "last_ts", last_ts);
+        json_add_str(j, "timestamp", time_str);
+        json_add_str(j, "direction", atoi(f[3]) ? "out" : "in");
+        json_add_int(j, "unread", atoi(f[4]));
+        json_add_int(j, "total", atoi(f[5]));
+        json_add_str(j, "preview", f[6]);
+        json_obj_close(j);
+    }
+    json_arr_close(j);
+
+    json_add_bool(j, "has_more", rows > limit);
+    if (rows > limit && last_peer) {
+        json_key_obj_open(j, "cursor");
+        json_add_long(j, "before_ts", last_ts);
+        json_add_str(j, "before_peer", last_peer);
+        json_obj_close(j);
+    } else {
+        json_add_null(j, "cursor");
+    }
+    json_add_int(j, "unread_total", db_query_int("SELECT COALESCE(SUM(unread), 0) FROM sms_threads;", 0));
+    json_obj_close(j);
+
+    free(output);
+    HTTP_OK_FREE(c, json_finish(j));
+}
+
+/* POST /api/sms/threads/read */
+void handle_sms_thread_read(struct mg_connection *c, struct mg_http_message *hm) {
+    HTTP_CHECK_POST(c, hm);
+
+    char sql[256];
+    char *addr = mg_json_get_str(hm->body, "$.peer");
+
+    if (addr && addr[0]) {
+        char peer[SMS_PEER_SIZE];
+        char peer_lit[LITERAL_SIZE(SMS_PEER_SIZE)];
+        sms_peer_normalize(addr, peer, sizeof(peer));
+        db_text_literal(peer, peer_lit, sizeof(peer_lit));
+        snprintf(sql, sizeof(sql), "UPDATE sms SET is_read = 1 WHERE peer = %s AND is_read = 0;", peer_lit);
+    } else {
+        snprintf(sql, sizeof(sql), "UPDATE sms SET is_read = 1 WHERE is_read = 0;");
+    }
+    free(addr);
+
+    if (db_execute_safe(sql) == 0) {
+        HTTP_SUCCESS(c, "已标记为已读");
+    } else {
+        HTTP_ERROR(c, 500, "标记已读失败");
+    }
+}
@@ -13,63 +13,88 @@
 #include "dbus_core.h"
 #include "exec_utils.h"
 #include "ofono.h"
-
-/* 读取文件内容 */
-static int read_file(const char *path, char *buf, size_t size) {
-    FILE *f = fopen(path, "r");
-    if (!f) return -1;
-    size_t n = fread(buf, 1, size - 1, f);
-    buf[n] = '\0';
-    fclose(f);
-    return 0;
-}
+#include "sim_identity.h"
+#include "thermal.h"
+#include "cpu_monitor.h"
+#include "proc_reader.h"
+
+/* 反复读取的文件 (fd 常驻) */
+static char g_meminfo_buf[2048];
+static ProcFile g_meminfo = PROC_FILE_INIT("/proc/meminfo", g_meminfo_buf);
+static char g_uptime_buf[64];
+static ProcFile g_uptime = PROC_FILE_INIT("/proc/uptime", g_uptime_buf);
+static char g_bat_status_buf[32];
+static ProcFile g_bat_status = PROC_FILE_INIT("/sys/class/power_supply/battery/status", g_bat_status_buf);
+static char g_bat_health_buf[32];
+static ProcFile g_bat_health = PROC_FILE_INIT("/sys/class/power_supply/battery/health", g_bat_health_buf);
+static char g_bat_capacity_buf[16];
+static ProcFile g_bat_capacity = PROC_FILE_INIT("/sys/class/power_supply/battery/capacity", g_bat_capacity_buf);
+
+/* connman 保存设置时会整体替换文件，不能保持 fd */
+static char g_connman_buf[4096];
+static ProcFile g_connman = PROC_FILE_ONESHOT("/var/lib/connman/settings", g_connman_buf);
 
 /* 解析 /proc/meminfo */
 static void parse_meminfo(SystemInfo *info) {
-    char buf[4096];
-    if (read_file("/proc/meminfo", buf, sizeof(buf)) != 0) return;
-
-    char *line = strtok(buf, "\n");
-    while (line) {
-        unsigned long val;
-        if (sscanf(line, "MemTotal: %lu kB", &val) == 1) {
-            info->total_ram = val / 1024;
-        } else if (sscanf(line, "MemFree: %lu kB", &val) == 1) {
-            info->free_ram = val / 1024;
-        } else if (sscanf(line, "Cached: %lu kB", &val) == 1) {
-            info->cached_ram = val / 1024;
+    ProcScan scan;
+    ProcKV kv;
+    int found = 0;
+
+    if (proc_file_read(&g_meminfo) <= 0) return;
+
+    scan = proc_scan_begin(&g_meminfo, ':');
+    while (found < 3 && proc_scan_next(&scan, &kv)) {
+        if (proc_kv_is(&kv, "MemTotal")) {
+            info->total_ram = (unsigned long)(proc_kv_ll(&kv) / 1024);
+            found++;
+        } else if (proc_kv_is(&kv, "MemFree")) {
+            info->free_ram = (unsigned long)(proc_kv_ll(&kv) / 1024);
+            found++;
+        } else if (proc_kv_is(&kv, "Cached")) {
+            info->cached_ram = (unsigned long)(proc_kv_ll(&kv) / 1024);
+            found++;
         }
-        line = strtok(NULL, "\n");
     }
 }
 
+/* 读取单行 sysfs 文本 (去除换行) */
+static int read_line(ProcFile *f, char *out, size_t size) {
+    if (proc_file_read(f) <= 0) return -1;
+    f->buf[strcspn(f->buf, "\n")] = '\0';
+    snprintf(out, size, "%s", f->buf);
+    return 0;
+}
+
 double get_uptime(void) {
-    char buf[64];
-    if (read_file("/proc/uptime", buf, sizeof(buf)) != 0) return -1;
-    double uptime;
-    if (sscanf(buf, "%lf", &uptime) == 1) return uptime;
-    return -1;
+    if (proc_file_read(&g_uptime) <= 0) return -1;
+    char *end;
+    double uptime = g_ascii_strtod(g_uptime.buf, &end);
+    return end != g_uptime.buf ? uptime : -1;
 }
 
 
 int get_serial(char *serial, size_t size) {
     char buf[1024];
-    if (read_file("/home/cpuinfo", buf, sizeof(buf)) != 0) return -1;
+    ProcFile f = PROC_FILE_ONESHOT("/home/cpuinfo", buf);
+    ProcScan scan;
+    ProcKV kv;
 
-    char *p = strstr(buf, "Serial");
-    if (!p) return -1;
+    if (proc_file_read(&f) <= 0) return -1;
 
-    /* 跳过 "Serial" 和非数字字符 */
-    p += 6;
-    while (*p && (*p < '0' || *p > '9')) p++;
+    scan = proc_scan_begin(&f, ':');
+    while (proc_scan_next(&scan, &kv)) {
+        if (!proc_kv_is(&kv, "Serial")) continue;
 
-    /* 提取数字 */
-    size_t i = 0;
-    while (*p >= '0' && *p <= '9' && i < size - 1) {
-        serial[i++] = *p++;
+        /* 只取数字部分 */
+        size_t i = 0, k = 0;
+        while (k < kv.val_len && (kv.val[k] < '0' || kv.val[k] > '9')) k++;
+        while (k < kv.val_len && kv.val[k] >= '0' && kv.val[k] <= '9' && i < size - 1) {
+            serial[i++] = kv.val[k++];
+        }
+        serial[i] = '\0';
+        return i > 0 ? 0 : -1;
     }
-    serial[i] = '\0';
-    return i > 0 ? 0 : -1;
+    return -1;
 }
 
 int get_current_slot(char *slot, char *ril_path) {
@@ -120,47 +145,25 @@ int get_signal_strength(char *strength, size_t size) {
 }
 
 double get_thermal_temp(void) {
-    char output[64];
-    if (run_command(output, sizeof(output), "sh", "-c",
-        "cat /sys/class/thermal/thermal_zone*/temp | awk '{sum+=$1} END {printf \"%.2f\", sum/NR/1000}'",
-        NULL) != 0) {
-        return -1;
-    }
-    double temp;
-    if (sscanf(output, "%lf", &temp) == 1) return temp;
-    return -1;
+    return thermal_get_average();
 }
 
 
 /* 前向声明 airplane.h 中的函数 */
-extern int get_imei(char *imei, size_t size);
-extern int get_iccid(char *iccid, size_t size);
-extern int get_imsi(char *imsi, size_t size);
-extern const char *get_carrier_from_imsi(const char *imsi);
 extern int get_airplane_mode(void);
 
-int get_system_info(SystemInfo *info) {
+/* 静态字段: 进程生命周期内不变 */
+void sysinfo_read_static(SystemInfo *info) {
     struct utsname uts;
-    char buf[256];
 
-    /* 初始化默认值 */
-    memset(info, 0, sizeof(SystemInfo));
     strcpy(info->hostname, "N/A");
     strcpy(info->sysname, "N/A");
     strcpy(info->release, "N/A");
     strcpy(info->version, "N/A");
     strcpy(info->machine, "N/A");
     strcpy(info->bridge_status, "N/A");
-    strcpy(info->sim_slot, "N/A");
-    strcpy(info->signal_strength, "N/A");
-    strcpy(info->power_status, "N/A");
-    strcpy(info->battery_health, "N/A");
-    strcpy(info->ssid, "N/A");
     strcpy(info->passwd, "N/A");
-    strcpy(info->select_network_mode, "N/A");
-    strcpy(info->network_mode, "N/A");
-    strcpy(info->network_type, "N/A");
-    strcpy(info->network_band, "N/A");
+    info->serial[0] = '\0';
     info->is_activated = 1;
 
     /* uname 信息 */
@@ -172,71 +175,79 @@ int get_system_info(SystemInfo *info) {
         strncpy(info->hostname, uts.nodename, sizeof(info->hostname) - 1);
     }
 
+    /* 序列号 */
+    get_serial(info->serial, sizeof(info->serial));
+}
+
+/* 慢变字段: 内存、温度、电池、WiFi 名称、CPU */
+void sysinfo_read_slow(SystemInfo *info) {
+    strcpy(info->power_status, "N/A");
+    strcpy(info->battery_health, "N/A");
+    strcpy(info->ssid, "N/A");
+    info->battery_capacity = 0;
+
     /* 内存信息 */
     parse_meminfo(info);
 
     /* 运行时间 */
     info->uptime = get_uptime();
 
-    /* 序列号 */
-    get_serial(info->serial, sizeof(info->serial));
-
-    /* SIM 卡槽 */
-    char ril_path[32];
-    if (get_current_slot(info->sim_slot, ril_path) == 0) {
-        strncpy(info->network_mode, ril_path, sizeof(info->network_mode) - 1);
-    }
-
-    /* 信号强度 */
-    get_signal_strength(info->signal_strength, sizeof(info->signal_strength));
-
     /* 温度 */
     info->thermal_temp = get_thermal_temp();
 
-    /* 电源状态 */
-    if (read_file("/sys/class/power_supply/battery/status", buf, sizeof(buf)) == 0) {
-        buf[strcspn(buf, "\n")] = '\0';
-        strncpy(info->power_status, buf, sizeof(info->power_status) - 1);
+    /* 电源状态 / 电池健康 / 电池容量 */
+    read_line(&g_bat_status, info->power_status, sizeof(info->power_status));
+    read_line(&g_bat_health, info->battery_health, sizeof(info->battery_health));
+    long long capacity;
+    if (proc_file_read_ll(&g_bat_capacity, &capacity) == 0) {
+        info->battery_capacity = (unsigned int)capacity;
     }
 
-    /* 电池健康 */
-    if (read_file("/sys/class/power_supply/battery/health", buf, sizeof(buf)) == 0) {
-        buf[strcspn(buf, "\n")] = '\0';
-        strncpy(info->battery_health, buf, sizeof(info->battery_health) - 1);
+    /* WiFi 信息 */
+    if (proc_file_read(&g_connman) > 0) {
+        ProcScan scan = proc_scan_begin(&g_connman, '=');
+        ProcKV kv;
+        while (proc_scan_next(&scan, &kv)) {
+            if (proc_kv_is(&kv, "Tethering.Identifier")) {
+                proc_kv_copy(&kv, info->ssid, sizeof(info->ssid));
+                break;
+            }
+        }
     }
 
-    /* 电池容量 */
-    if (read_file("/sys/class/power_supply/battery/capacity", buf, sizeof(buf)) == 0) {
-        info->battery_capacity = atoi(buf);
-    }
+    /* CPU 使用率 */
+    info->cpu_usage = get_cpu_usage();
+}
 
-    /* IMEI */
-    get_imei(info->imei, sizeof(info->imei));
+/* 模组字段: D-Bus/AT 查询，身份信息来自缓存 */
+void sysinfo_read_modem(SystemInfo *info) {
+    char ril_path[32] = "unknown";
 
-    /* ICCID */
-    get_iccid(info->iccid, sizeof(info->iccid));
+    strcpy(info->sim_slot, "N/A");
+    strcpy(info->signal_strength, "N/A");
+    strcpy(info->select_network_mode, "N/A");
+    strcpy(info->network_mode, "N/A");
 
-    /* IMSI 和运营商 */
-    if (get_imsi(info->imsi, sizeof(info->imsi)) == 0) {
-        const char *carrier = get_carrier_from_imsi(info->imsi);
-        strncpy(info->carrier, carrier, sizeof(info->carrier) - 1);
+    /* SIM 卡槽 */
+    if (get_current_slot(info->sim_slot, ril_path) == 0) {
+        strncpy(info->network_mode, ril_path, sizeof(info->network_mode) - 1);
     }
 
+    /* 信号强度 */
+    get_signal_strength(info->signal_strength, sizeof(info->signal_strength));
+
+    /* IMEI/ICCID/IMSI/运营商 (来自身份缓存，SIM 事件时才重读) */
+    SimIdentity identity;
+    sim_identity_get(&identity);
+    snprintf(info->imei, sizeof(info->imei), "%s", identity.imei);
+    snprintf(info->iccid, sizeof(info->iccid), "%s", identity.iccid);
+    snprintf(info->imsi, sizeof(info->imsi), "%s", identity.imsi);
+    snprintf(info->carrier, sizeof(info->carrier), "%s", identity.carrier);
+
     /* 飞行模式 */
     int airplane = get_airplane_mode();
     info->airplane_mode = (airplane == 1) ? 1 : 0;
 
-    /* WiFi 信息 */
-    if (read_file("/var/lib/connman/settings", buf, sizeof(buf)) == 0) {
-        char *p = strstr(buf, "Tethering.Identifier=");
-        if (p) {
-            p += strlen("Tethering.Identifier=");
-            char *end = strchr(p, '\n');
-            if (end) *end = '\0';
-            strncpy(info->ssid, p, sizeof(info->ssid) - 1);
-        }
-    }
-
     /* 网络模式选择 - 使用 ofono D-Bus 接口 */
     char mode_buf[64] = {0};
     if (strcmp(ril_path, "unknown") != 0 && strlen(ril_path) > 0) {
@@ -251,10 +262,13 @@ int get_system_info(SystemInfo *info) {
 
     /* QoS 签约速率 */
     get_qos_info(&info->qci, &info->downlink_rate, &info->uplink_rate);
+}
 
-    /* CPU 使用率 */
-    info->cpu_usage = get_cpu_usage();
-
+int get_system_info(SystemInfo *info) {
+    memset(info, 0, sizeof(SystemInfo));
+    sysinfo_read_static(info);
+    sysinfo_read_slow(info);
+    sysinfo_read_modem(info);
     return 0;
 }
 
@@ -336,91 +350,7 @@ int get_network_type_and_band(char *net_type, size_t type_size, char *band, size
     return 0;
 }
 
-/* 获取 CPU 使用率 - 通过读取 /proc/stat 计算 */
-/* /proc/stat 格式: cpu user nice system idle iowait irq softirq steal guest guest_nice */
-/* CPU使用率 = 100 - (idle_diff / total_diff * 100) */
-
-/* 静态变量保存上次采样数据 */
-static unsigned long long prev_user = 0, prev_nice = 0, prev_system = 0;
-static unsigned long long prev_idle = 0, prev_iowait = 0, prev_irq = 0;
-static unsigned long long prev_softirq = 0, prev_steal = 0;
-static int cpu_initialized = 0;
-
+/* 获取 CPU 使用率 - 由 cpu_monitor 定时采样，这里只取最近结果 */
 double get_cpu_usage(void) {
-    char buf[1024];
-    unsigned long long user, nice, system, idle, iowait, irq, softirq, steal;
-    
-    /* 读取 /proc/stat */
-    FILE *f = fopen("/proc/stat", "r");
-    if (!f) return 0;
-    
-    if (fgets(buf, sizeof(buf), f) == NULL) {
-        fclose(f);
-        return 0;
-    }
-    fclose(f);
-    
-    /* 解析第一行 cpu 数据 */
-    /* 格式: cpu  user nice system idle iowait irq softirq steal [guest guest_nice] */
-    int ret = sscanf(buf, "cpu %llu %llu %llu %llu %llu %llu %llu %llu",
-                     &user, &nice, &system, &idle, &iowait, &irq, &softirq, &steal);
-    if (ret < 4) return 0;
-    
-    /* 如果某些字段不存在，设为0 */
-    if (ret < 5) iowait = 0;
-    if (ret < 6) irq = 0;
-    if (ret < 7) softirq = 0;
-    if (ret < 8) steal = 0;
-    
-    /* 首次调用，保存数据并返回0 */
-    if (!cpu_initialized) {
-        prev_user = user;
-        prev_nice = nice;
-        prev_system = system;
-        prev_idle = idle;
-        prev_iowait = iowait;
-        prev_irq = irq;
-        prev_softirq = softirq;
-        prev_steal = steal;
-        cpu_initialized = 1;
-        return 0;
-    }
-    
-    /* 计算差值 */
-    unsigned long long user_diff = user - prev_user;
-    unsigned long long nice_diff = nice - prev_nice;
-    unsigned long long system_diff = system - prev_system;
-    unsigned long long idle_diff = idle - prev_idle;
-    unsigned long long iowait_diff = iowait - prev_iowait;
-    unsigned long long irq_diff = irq - prev_irq;
-    unsigned long long softirq_diff = softirq - prev_softirq;
-    unsigned long long steal_diff = steal - prev_steal;
-    
-    /* 总时间差 */
-    unsigned long long total_diff = user_diff + nice_diff + system_diff + idle_diff +
-                                    iowait_diff + irq_diff + softirq_diff + steal_diff;
-    
-    /* 保存当前值供下次使用 */
-    prev_user = user;
-    prev_nice = nice;
-    prev_system = system;
-    prev_idle = idle;
-    prev_iowait = iowait;
-    prev_irq = irq;
-    prev_softirq = softirq;
-    prev_steal = steal;
-    
-    /* 避免除零 */
-    if (total_diff == 0) return 0;
-    
-    /* CPU使用率 = 100 - idle百分比 */
-    /* idle时间包括 idle + iowait */
-    double idle_percent = (double)(idle_diff + iowait_diff) / total_diff * 100.0;
-    double usage = 100.0 - idle_percent;
-    
-    /* 限制范围 0-100 */
-    if (usage < 0) usage = 0;
-    if (usage > 100) usage = 100;
-    
-    return usage;
+    return cpu_monitor_total();
 }
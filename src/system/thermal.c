@@ -0,0 +1,251 @@
+/**
+ * @file thermal.c
+ * @brief 温度传感器读取与过热保护实现
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <dirent.h>
+#include <glib.h>
+#include "mongoose.h"
+#include "thermal.h"
+#include "proc_reader.h"
+#include "charge.h"
+#include "database.h"
+#include "http_utils.h"
+#include "json_builder.h"
+
+#define THERMAL_SYSFS "/sys/class/thermal"
+
+typedef struct {
+    ThermalZone info;
+    char path[64];
+    char buf[24];
+    ProcFile file;          /* temp 文件 (fd 常驻) */
+} ZoneEntry;
+
+static ZoneEntry g_zones[THERMAL_MAX_ZONES];
+static int g_zone_count = 0;
+
+/* 过热保护 */
+static int g_limit = 0;             /* 停止充电的温度 (摄氏度)，0 表示关闭 */
+static int g_resume = 0;            /* 恢复充电的温度 */
+static int g_inhibited = 0;         /* 是否处于过热保护状态 */
+static int g_restore = 0;           /* 解除时是否需要重新开启充电 (保护前充电开着) */
+static guint g_watch_timer = 0;
+
+static int read_zone(ZoneEntry *z) {
+    long long v;
+
+    if (proc_file_read_ll(&z->file, &v) != 0) {
+        z->info.valid = 0;
+        return -1;
+    }
+    z->info.temp_mc = (int)v;
+    z->info.valid = 1;
+    return 0;
+}
+
+static void discover_zones(void) {
+    DIR *dir = opendir(THERMAL_SYSFS);
+    struct dirent *ent;
+
+    if (!dir) {
+        printf("[Thermal] 无法打开 %s\n", THERMAL_SYSFS);
+        return;
+    }
+    while ((ent = readdir(dir)) != NULL && g_zone_count < THERMAL_MAX_ZONES) {
+        int index;
+        if (sscanf(ent->d_name, "thermal_zone%d", &index) != 1) continue;
+
+        ZoneEntry *z = &g_zones[g_zone_count];
+        memset(z, 0, sizeof(*z));
+        z->info.index = index;
+        snprintf(z->path, sizeof(z->path), THERMAL_SYSFS "/thermal_zone%d/temp", index);
+        proc_file_init(&z->file, z->path, z->buf, sizeof(z->buf));
+        if (proc_file_read(&z->file) < 0) continue;
+
+        char path[64], type[32];
+        snprintf(path, sizeof(path), THERMAL_SYSFS "/thermal_zone%d/type", index);
+        ProcFile tf = PROC_FILE_ONESHOT(path, type);
+        if (proc_file_read(&tf) > 0) {
+            type[strcspn(type, "\n")] = '\0';
+            snprintf(z->info.type, sizeof(z->info.type), "%s", type);
+        }
+        g_zone_count++;
+    }
+    closedir(dir);
+}
+
+int thermal_refresh(void) {
+    int ok = 0;
+    for (int i = 0; i < g_zone_count; i++) {
+        if (read_zone(&g_zones[i]) == 0) ok++;
+    }
+    return ok;
+}
+
+int thermal_get_zones(ThermalZone *out, int max) {
+    int n = g_zone_count < max ? g_zone_count : max;
+    for (int i = 0; i < n; i++) {
+        out[i] = g_zones[i].info;
+    }
+    return n;
+}
+
+double thermal_get_average(void) {
+    long long sum = 0;
+    int n = 0;
+
+    thermal_refresh();
+    for (int i = 0; i < g_zone_count; i++) {
+        if (!g_zones[i].info.valid) continue;
+        sum += g_zones[i].info.temp_mc;
+        n++;
+    }
+    return n > 0 ? (double)sum / n / 1000.0 : -1;
+}
+
+double thermal_get_max(void) {
+    int max = 0, found = 0;
+
+    for (int i = 0; i < g_zone_count; i++) {
+        if (!g_zones[i].info.valid) continue;
+        if (!found || g_zones[i].info.temp_mc > max) max = g_zones[i].info.temp_mc;
+        found = 1;
+    }
+    return found ? max / 1000.0 : -1;
+}
+
+int thermal_charging_inhibited(void) {
+    return g_inhibited;
+}
+
+/* ==================== 过热保护 ==================== */
+
+/* 解除保护，只恢复由保护自身关闭的充电 */
+static void release_inhibit(void) {
+    /* 恢复后若智能充电认为已充满，会在随后的电池 uevent 中再次停止 */
+    if (g_restore) set_charging(1);
+    g_inhibited = 0;
+    g_restore = 0;
+}
+
+void thermal_charging_overridden(void) {
+    g_restore = 0;
+}
+
+static gboolean thermal_watch_tick(gpointer user_data) {
+    (void)user_data;
+
+    thermal_refresh();
+    double max = thermal_get_max();
+    if (max < 0) return G_SOURCE_CONTINUE;
+
+    if (!g_inhibited && max >= g_limit) {
+        /* 充电本来就关着 (如手动停止) 时只记录状态，解除时不去打开 */
+        int was_on = get_charging() != 0;
+        printf("[Thermal] 温度 %.1f°C >= %d°C，停止充电\n", max, g_limit);
+        if (!was_on || set_charging(0) == 0) {
+            g_inhibited = 1;
+            g_restore = was_on;
+        }
+    } else if (g_inhibited && max <= g_resume) {
+        release_inhibit();
+        printf("[Thermal] 温度 %.1f°C <= %d°C，解除过热保护\n", max, g_resume);
+    }
+    return G_SOURCE_CONTINUE;
+}
+
+static void apply_watch_config(void) {
+    if (g_limit > 0 && g_zone_count > 0) {
+        if (g_watch_timer == 0) {
+            g_watch_timer = g_timeout_add_seconds(THERMAL_WATCH_SECS, thermal_watch_tick, NULL);
+        }
+        thermal_watch_tick(NULL);
+        return;
+    }
+
+    if (g_watch_timer > 0) {
+        g_source_remove(g_watch_timer);
+        g_watch_timer = 0;
+    }
+    /* 关闭保护时不要让充电停留在被保护停止的状态 */
+    if (g_inhibited) release_inhibit();
+}
+
+static void load_watch_config(void) {
+    g_limit = config_get_int("thermal_limit", 0);
+    g_resume = config_get_int("thermal_resume", g_limit - THERMAL_DEFAULT_HYST);
+    if (g_resume >= g_limit) g_resume = g_limit - THERMAL_DEFAULT_HYST;
+}
+
+void thermal_init(void) {
+    discover_zones();
+    thermal_refresh();
+    printf("[Thermal] 发现 %d 个温区\n", g_zone_count);
+
+    load_watch_config();
+    if (g_limit > 0) {
+        printf("[Thermal] 过热保护: >= %d°C 停止充电, <= %d°C 恢复\n", g_limit, g_resume);
+    }
+    apply_watch_config();
+}
+
+/* GET/POST /api/thermal - 各温区温度和过热保护配置 */
+void handle_thermal(struct mg_connection *c, struct mg_http_message *hm) {
+    HTTP_HANDLE_OPTIONS(c, hm);
+
+    if (http_is_method(hm, "POST")) {
+        double limit = 0, resume = 0;
+        if (!mg_json_get_num(hm->body, "$.limit", &limit)) {
+            HTTP_ERROR(c, 400, "Missing limit");
+            return;
+        }
+        if (!mg_json_get_num(hm->body, "$.resume", &resume)) {
+            resume = limit - THERMAL_DEFAULT_HYST;
+        }
+        if (limit < 0 || limit > 120 || (limit > 0 && resume >= limit)) {
+            HTTP_ERROR(c, 400, "Invalid limit/resume (0-120, resume < limit)");
+            return;
+        }
+        g_limit = (int)limit;
+        g_resume = (int)resume;
+        config_set_int("thermal_limit", g_limit);
+        config_set_int("thermal_resume", g_resume);
+        apply_watch_config();
+    } else if (!http_is_method(hm, "GET")) {
+        http_method_error(c);
+        return;
+    }
+
+    double avg = thermal_get_average();
+
+    JsonBuilder *j = json_new();
+    json_obj_open(j);
+    json_add_double(j, "average", avg);
+    json_add_double(j, "max", thermal_get_max());
+    json_arr_open(j, "zones");
+    for (int i = 0; i < g_zone_count; i++) {
+        const ThermalZone *z = &g_zones[i].info;
+        json_arr_obj_open(j);
+        json_add_int(j, "zone", z->index);
+        json_add_str(j, "type", z->type);
+        if (z->valid) {
+            json_add_double(j, "temp", z->temp_mc / 1000.0);
+        } else {
+            json_add_null(j, "temp");
+        }
+        json_obj_close(j);
+    }
+    json_arr_close(j);
+    json_key_obj_open(j, "protection");
+    json_add_int(j, "limit", g_limit);
+    json_add_int(j, "resume", g_resume);
+    json_add_bool(j, "active", g_watch_timer > 0);
+    json_add_bool(j, "charging_inhibited", g_inhibited);
+    json_obj_close(j);
+    json_obj_close(j);
+    HTTP_OK_FREE(c, json_finish(j));
+}
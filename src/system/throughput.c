@@ -0,0 +1,228 @@
+/**
+ * @file throughput.c
+ * @brief 实时网速监测实现
+ *
+ * 环形缓冲为单写者: 采样回调写入槽位后再原子地推进 head，
+ * 读者复制完数据后重新检查 head，丢弃期间可能被覆盖的槽位。
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <glib.h>
+#include "mongoose.h"
+#include "throughput.h"
+#include "net_counter.h"
+#include "push_channel.h"
+#include "database.h"
+#include "http_utils.h"
+#include "json_builder.h"
+
+#define THROUGHPUT_IFACE       "sipa_eth0"
+#define THROUGHPUT_LEASE_SECS  10       /* HTTP 查询后保持采样的时长 */
+#define THROUGHPUT_EWMA_TAU_MS 2000     /* 平滑时间常数 */
+#define THROUGHPUT_PUSH_MS     1000     /* 推送间隔 (1Hz) */
+#define RING_MASK              (THROUGHPUT_RING_SIZE - 1)
+
+static ThroughputSample g_ring[THROUGHPUT_RING_SIZE];
+static gint g_head = 0;                 /* 下一个写入位置 (只增不减) */
+
+static NetCounter g_nc;
+static int g_interval_ms = THROUGHPUT_DEFAULT_MS;
+static guint g_timer = 0;
+static gint64 g_lease_until_us = 0;
+static gint64 g_last_us = 0;            /* 上次采样的单调时间 */
+static gint64 g_last_push_us = 0;
+static double g_rx_avg = 0, g_tx_avg = 0;
+
+static void throughput_schedule(void);
+
+static int has_demand(void) {
+    return push_watchers(PUSH_TOPIC_THROUGHPUT) > 0 || g_get_monotonic_time() < g_lease_until_us;
+}
+
+static void ring_push(const ThroughputSample *s) {
+    gint head = g_atomic_int_get(&g_head);
+    g_ring[head & RING_MASK] = *s;
+    g_atomic_int_set(&g_head, head + 1);
+}
+
+int throughput_history(ThroughputSample *out, int max) {
+    gint head = g_atomic_int_get(&g_head);
+    int n = head < THROUGHPUT_RING_SIZE ? head : THROUGHPUT_RING_SIZE;
+    if (n > max) n = max;
+
+    for (int i = 0; i < n; i++) {
+        out[i] = g_ring[(head - n + i) & RING_MASK];
+    }
+
+    /* 复制期间写者前进了多少，就丢掉多少最旧的槽位 */
+    int overrun = g_atomic_int_get(&g_head) - head - (THROUGHPUT_RING_SIZE - n);
+    if (overrun > 0) {
+        if (overrun >= n) return 0;
+        memmove(out, out + overrun, sizeof(*out) * (n - overrun));
+        n -= overrun;
+    }
+    return n;
+}
+
+/* 峰值窗口内的最大瞬时速率 */
+static void window_peak(gint64 now_ms, uint32_t *rx_peak, uint32_t *tx_peak) {
+    static ThroughputSample buf[THROUGHPUT_RING_SIZE];
+    int n = throughput_history(buf, THROUGHPUT_RING_SIZE);
+
+    *rx_peak = *tx_peak = 0;
+    for (int i = n - 1; i >= 0 && now_ms - buf[i].time_ms <= THROUGHPUT_PEAK_WINDOW_MS; i--) {
+        if (buf[i].rx_rate > *rx_peak) *rx_peak = buf[i].rx_rate;
+        if (buf[i].tx_rate > *tx_peak) *tx_peak = buf[i].tx_rate;
+    }
+}
+
+static void fill_status(ThroughputStatus *st) {
+    gint head = g_atomic_int_get(&g_head);
+
+    memset(st, 0, sizeof(*st));
+    if (head > 0) {
+        const ThroughputSample *last = &g_ring[(head - 1) & RING_MASK];
+        st->time_ms = last->time_ms;
+        st->rx_rate = last->rx_rate;
+        st->tx_rate = last->tx_rate;
+    }
+    st->rx_avg = (uint32_t)g_rx_avg;
+    st->tx_avg = (uint32_t)g_tx_avg;
+    window_peak(g_get_real_time() / 1000, &st->rx_peak, &st->tx_peak);
+    st->interval_ms = g_interval_ms;
+    st->active = g_timer > 0;
+}
+
+/* 推送帧直接格式化，不经过 JsonBuilder */
+static void publish_frame(void) {
+    ThroughputStatus st;
+    char frame[192];
+
+    fill_status(&st);
+    snprintf(frame, sizeof(frame),
+             "{\"t\":%lld,\"rx\":%u,\"tx\":%u,\"rx_avg\":%u,\"tx_avg\":%u,\"rx_peak\":%u,\"tx_peak\":%u}",
+             (long long)st.time_ms, st.rx_rate, st.tx_rate, st.rx_avg, st.tx_avg,
+             st.rx_peak, st.tx_peak);
+    push_publish(PUSH_TOPIC_THROUGHPUT, frame);
+}
+
+static gboolean throughput_tick(gpointer user_data) {
+    uint64_t last_rx = g_nc.total_rx, last_tx = g_nc.total_tx;
+    int primed = g_nc.primed;
+    gint64 now = g_get_monotonic_time();
+    (void)user_data;
+
+    if (!has_demand()) {
+        g_timer = 0;
+        printf("[Throughput] 无人观看，停止采样\n");
+        return G_SOURCE_REMOVE;
+    }
+
+    if (net_counter_update(&g_nc) != 0 || !primed || now <= g_last_us) {
+        g_last_us = now;
+        return G_SOURCE_CONTINUE;
+    }
+
+    double dt_ms = (double)(now - g_last_us) / 1000.0;
+    double rx_rate = (double)(g_nc.total_rx - last_rx) * 1000.0 / dt_ms;
+    double tx_rate = (double)(g_nc.total_tx - last_tx) * 1000.0 / dt_ms;
+    g_last_us = now;
+
+    /* 按实际间隔计算平滑系数，采样抖动时结果一致 */
+    double alpha = dt_ms / (THROUGHPUT_EWMA_TAU_MS + dt_ms);
+    g_rx_avg += alpha * (rx_rate - g_rx_avg);
+    g_tx_avg += alpha * (tx_rate - g_tx_avg);
+
+    ThroughputSample s;
+    s.time_ms = g_get_real_time() / 1000;
+    s.rx_rate = rx_rate > UINT32_MAX ? UINT32_MAX : (uint32_t)rx_rate;
+    s.tx_rate = tx_rate > UINT32_MAX ? UINT32_MAX : (uint32_t)tx_rate;
+    ring_push(&s);
+
+    if (now - g_last_push_us >= (THROUGHPUT_PUSH_MS - THROUGHPUT_MIN_MS / 2) * 1000LL) {
+        g_last_push_us = now;
+        publish_frame();
+    }
+    return G_SOURCE_CONTINUE;
+}
+
+/* 有需求且未运行时启动采样 (停止由回调自行判断) */
+static void throughput_schedule(void) {
+    if (g_timer > 0 || !has_demand()) return;
+
+    /* 重新建立基线，空闲期间的流量不计入速率 */
+    g_nc.primed = 0;
+    net_counter_update(&g_nc);
+    g_last_us = g_get_monotonic_time();
+    g_rx_avg = g_tx_avg = 0;
+    g_timer = g_timeout_add(g_interval_ms, throughput_tick, NULL);
+    printf("[Throughput] 开始采样, 间隔 %dms\n", g_interval_ms);
+}
+
+static void on_watchers_changed(unsigned topic, int watchers) {
+    (void)topic;
+    if (watchers > 0) throughput_schedule();
+}
+
+void throughput_init(void) {
+    g_interval_ms = config_get_int("throughput_interval_ms", THROUGHPUT_DEFAULT_MS);
+    if (g_interval_ms < THROUGHPUT_MIN_MS) g_interval_ms = THROUGHPUT_MIN_MS;
+    if (g_interval_ms > THROUGHPUT_MAX_MS) g_interval_ms = THROUGHPUT_MAX_MS;
+
+    net_counter_init(&g_nc, THROUGHPUT_IFACE);
+    push_set_watch_callback(PUSH_TOPIC_THROUGHPUT, on_watchers_changed);
+}
+
+void throughput_get_status(ThroughputStatus *st) {
+    g_lease_until_us = g_get_monotonic_time() + (gint64)THROUGHPUT_LEASE_SECS * G_USEC_PER_SEC;
+    throughput_schedule();
+    fill_status(st);
+}
+
+/* GET /api/traffic/throughput?samples=N - 当前网速和最近采样 */
+void handle_traffic_throughput(struct mg_connection *c, struct mg_http_message *hm) {
+    HTTP_CHECK_GET(c, hm);
+
+    static ThroughputSample buf[THROUGHPUT_RING_SIZE];
+    char num[16] = {0};
+    int samples = 0;
+    if (mg_http_get_var(&hm->query, "samples", num, sizeof(num)) > 0) {
+        samples = atoi(num);
+        if (samples < 0) samples = 0;
+        if (samples > THROUGHPUT_RING_SIZE) samples = THROUGHPUT_RING_SIZE;
+    }
+
+    ThroughputStatus st;
+    throughput_get_status(&st);
+
+    JsonBuilder *j = json_new();
+    json_obj_open(j);
+    json_add_bool(j, "active", st.active);
+    json_add_int(j, "interval_ms", st.interval_ms);
+    json_add_long(j, "t", st.time_ms);
+    json_add_long(j, "rx", st.rx_rate);
+    json_add_long(j, "tx", st.tx_rate);
+    json_add_long(j, "rx_avg", st.rx_avg);
+    json_add_long(j, "tx_avg", st.tx_avg);
+    json_add_long(j, "rx_peak", st.rx_peak);
+    json_add_long(j, "tx_peak", st.tx_peak);
+
+    /* 采样用 [t, rx, tx] 紧凑数组表示 */
+    if (samples > 0) {
+        int n = throughput_history(buf, samples);
+        GString *arr = g_string_sized_new(n * 40 + 2);
+        g_string_append_c(arr, '[');
+        for (int i = 0; i < n; i++) {
+            g_string_append_printf(arr, "%s[%lld,%u,%u]", i ? "," : "",
+                                   (long long)buf[i].time_ms, buf[i].rx_rate, buf[i].tx_rate);
+        }
+        g_string_append_c(arr, ']');
+        json_add_raw(j, "samples", arr->str);
+        g_string_free(arr, TRUE);
+    }
+
+    json_obj_close(j);
+    HTTP_OK_FREE(c, json_finish(j));
+}
@@ -17,12 +17,29 @@
 #include "airplane.h"  /* 飞行模式控制 */
 #include "http_utils.h"
 #include "json_builder.h"
+#include "net_counter.h"
+#include "traffic_history.h"
 
 #define VNSTAT_DB "/var/lib/vnstat/vnstat.db"
+#define VNSTAT_BIN "/home/root/6677/vnstat"
+#define VNSTATD_BIN "/home/root/6677/vnstatd"
 #define NETWORK_IFACE "sipa_eth0"
+#define BOOT_ID_PATH "/proc/sys/kernel/random/boot_id"
 
-static int is_flow_control_running = 0;
-static pthread_t flow_control_thread;
+#define TRAFFIC_SAMPLE_SECS   10    /* 采样间隔: 远小于 32 位计数器在满速下的回绕周期 */
+#define TRAFFIC_PERSIST_SECS  300   /* 累计值写入数据库的间隔 */
+#define TRAFFIC_STATE_KEY     "traffic_counter"
+
+/* 流量控制检查间隔: 离上限越近、速率越高，检查越频繁 */
+#define QUOTA_MIN_INTERVAL_MS  250
+#define QUOTA_MAX_INTERVAL_MS  30000
+
+/* 网卡累计计数 (互斥锁保护，可在任意线程读取) */
+static NetCounter g_counter;
+static pthread_mutex_t g_counter_mutex = PTHREAD_MUTEX_INITIALIZER;
+static uint64_t g_saved_rx = 0, g_saved_tx = 0;     /* 最近一次持久化的累计值 */
+static char g_boot_id[40] = {0};
+static guint g_sample_timer = 0;
 
 /* 流量配置 */
 typedef struct {
@@ -30,6 +47,19 @@ typedef struct {
     int switch_on;
 } TrafficConfig;
 
+/* 流量控制状态 (仅在主循环中访问) */
+typedef struct {
+    int applied;            /* 已设置的飞行模式: -1=未知, 0=在线, 1=飞行 */
+    long long last_total;   /* 上次检查时的累计流量 */
+    gint64 last_us;         /* 上次检查时间, 0 表示无 */
+    double rate;            /* 平滑后的速率 (字节/秒) */
+    long long eta_ms;       /* 预计到达上限的时间, -1 表示无法预测 */
+    guint timer;
+} QuotaState;
+
+static TrafficConfig g_config;          /* 配置缓存，只在启动和修改时访问数据库 */
+static QuotaState g_quota = {-1, 0, 0, 0, -1, 0};
+
 /* 读取流量配置 - 从SQLite数据库读取 */
 static TrafficConfig read_traffic_config(void) {
     TrafficConfig config;
@@ -38,20 +68,27 @@ static TrafficConfig read_traffic_config(void) {
     return config;
 }
 
-/* 保存流量配置 - 写入SQLite数据库 */
+static void quota_evaluate(void);
+
+/* 保存流量配置 - 写入SQLite数据库并通知流量控制 */
 static void save_traffic_config(TrafficConfig *config) {
     config_set_int("traffic_switch", config->switch_on);
     config_set_ll("traffic_much", config->much);
+    g_config = *config;
+    quota_evaluate();
 }
 
 
-/* 从 vnstat 获取流量数据 */
+/* 从 vnstat 获取流量数据 (仅用于首次迁移累计值) */
 static void get_traffic_from_vnstat(long long *rx, long long *tx) {
     char output[4096];
     *rx = 0;
     *tx = 0;
 
-    if (run_command(output, sizeof(output), "/home/root/6677/vnstat", 
+    if (access(VNSTAT_BIN, X_OK) != 0) {
+        return;
+    }
+    if (run_command(output, sizeof(output), VNSTAT_BIN,
                     "-i", NETWORK_IFACE, "--json", NULL) != 0) {
         return;
     }
@@ -62,6 +99,119 @@ static void get_traffic_from_vnstat(long long *rx, long long *tx) {
     *tx = mg_json_get_long(json, "$.interfaces[0].traffic.total.tx", 0);
 }
 
+static void read_boot_id(void) {
+    FILE *fp = fopen(BOOT_ID_PATH, "r");
+    if (fp) {
+        if (fgets(g_boot_id, sizeof(g_boot_id), fp)) {
+            g_boot_id[strcspn(g_boot_id, "\r\n")] = '\0';
+        }
+        fclose(fp);
+    }
+}
+
+/*
+ * 持久化累计值: "rx,tx,last_rx,last_tx,ifindex,boot_id" 存为一个配置项，
+ * 每次只需一次 sqlite3 调用。last_* 用于重启服务 (未重启系统) 后接续计数。
+ */
+static void persist_counter(void) {
+    char value[160];
+    uint64_t rx, tx;
+
+    pthread_mutex_lock(&g_counter_mutex);
+    rx = g_counter.total_rx;
+    tx = g_counter.total_tx;
+    snprintf(value, sizeof(value), "%llu,%llu,%llu,%llu,%d,%s",
+             (unsigned long long)rx, (unsigned long long)tx,
+             (unsigned long long)g_counter.last_rx, (unsigned long long)g_counter.last_tx,
+             g_counter.ifindex, g_boot_id);
+    pthread_mutex_unlock(&g_counter_mutex);
+
+    if (config_set(TRAFFIC_STATE_KEY, value) == 0) {
+        g_saved_rx = rx;
+        g_saved_tx = tx;
+    }
+}
+
+/* 加载持久化的累计值，并把上次保存之后的流量补记进来 */
+static void restore_counter(void) {
+    char value[160];
+    unsigned long long rx, tx, last_rx, last_tx;
+    int ifindex;
+    char boot_id[40] = {0};
+
+    net_counter_init(&g_counter, NETWORK_IFACE);
+    read_boot_id();
+
+    if (config_get(TRAFFIC_STATE_KEY, value, sizeof(value)) == 0 &&
+        sscanf(value, "%llu,%llu,%llu,%llu,%d,%39s", &rx, &tx, &last_rx, &last_tx,
+               &ifindex, boot_id) >= 5) {
+        g_counter.total_rx = rx;
+        g_counter.total_tx = tx;
+        if (strcmp(boot_id, g_boot_id) == 0 && ifindex == g_counter.ifindex) {
+            /* 同一次开机、同一网卡: 从上次记录的原始计数继续 */
+            g_counter.last_rx = last_rx;
+            g_counter.last_tx = last_tx;
+        }
+        /* 否则网卡计数从 0 开始，当前原始值全部是新流量 */
+        g_counter.primed = 1;
+    } else {
+        /* 首次运行: 从 vnstat 迁移历史累计值 (如果存在) */
+        long long vrx, vtx;
+        get_traffic_from_vnstat(&vrx, &vtx);
+        g_counter.total_rx = vrx > 0 ? (uint64_t)vrx : 0;
+        g_counter.total_tx = vtx > 0 ? (uint64_t)vtx : 0;
+        printf("流量累计值初始化: rx=%lld, tx=%lld (来自 vnstat)\n", vrx, vtx);
+    }
+
+    net_counter_update(&g_counter);
+    persist_counter();
+}
+
+/* 定时采样，防止 32 位计数器在两次读取之间回绕多次 */
+static gboolean traffic_sample_tick(gpointer user_data) {
+    static int ticks = 0;
+    (void)user_data;
+
+    pthread_mutex_lock(&g_counter_mutex);
+    net_counter_update(&g_counter);
+    int dirty = g_counter.total_rx != g_saved_rx || g_counter.total_tx != g_saved_tx;
+    pthread_mutex_unlock(&g_counter_mutex);
+
+    if (++ticks >= TRAFFIC_PERSIST_SECS / TRAFFIC_SAMPLE_SECS) {
+        ticks = 0;
+        if (dirty) persist_counter();
+    }
+    return G_SOURCE_CONTINUE;
+}
+
+void traffic_get_totals(long long *rx, long long *tx) {
+    pthread_mutex_lock(&g_counter_mutex);
+    net_counter_update(&g_counter);
+    *rx = (long long)g_counter.total_rx;
+    *tx = (long long)g_counter.total_tx;
+    pthread_mutex_unlock(&g_counter_mutex);
+}
+
+void traffic_flush(void) {
+    pthread_mutex_lock(&g_counter_mutex);
+    net_counter_update(&g_counter);
+    pthread_mutex_unlock(&g_counter_mutex);
+    persist_counter();
+    traffic_history_flush();
+}
+
+/* 清零累计流量 */
+static void reset_traffic_totals(void) {
+    pthread_mutex_lock(&g_counter_mutex);
+    net_counter_update(&g_counter);
+    g_counter.total_rx = 0;
+    g_counter.total_tx = 0;
+    pthread_mutex_unlock(&g_counter_mutex);
+    persist_counter();
+    traffic_history_reset();
+    if (g_config.switch_on) quota_evaluate();
+}
+
 /* 格式化字节数 */
 static void format_bytes(long long bytes, char *buf, size_t size) {
     const char *units[] = {"B", "KB", "MB", "GB", "TB"};
@@ -74,55 +224,113 @@ static void format_bytes(long long bytes, char *buf, size_t size) {
     snprintf(buf, size, "%.3f %s", value, units[idx]);
 }
 
-/* 流量控制线程 */
-static void *flow_control_thread_func(void *arg) {
-    (void)arg;
-    while (1) {
-        TrafficConfig config = read_traffic_config();
-        if (config.switch_on == 0) {
-            /* 关闭流量控制时，关闭飞行模式恢复网络 */
-            set_airplane_mode(0);
-            is_flow_control_running = 0;
-            break;
-        }
+/* ==================== 流量控制 ==================== */
+
+/* 只在状态变化时调用 D-Bus，失败时保持未知以便下次重试 */
+static void quota_apply(int airplane) {
+    if (g_quota.applied == airplane) return;
+
+    printf("流量控制: %s\n", airplane ? "流量超限，开启飞行模式" : "恢复网络，关闭飞行模式");
+    if (set_airplane_mode(airplane) == 0) {
+        g_quota.applied = airplane;
+    } else {
+        g_quota.applied = -1;
+    }
+}
+
+void traffic_quota_invalidate(void) {
+    g_quota.applied = -1;
+    if (g_config.switch_on) quota_evaluate();
+}
+
+static gboolean quota_tick(gpointer user_data) {
+    (void)user_data;
+    g_quota.timer = 0;
+    quota_evaluate();
+    return G_SOURCE_REMOVE;
+}
 
-        long long rx, tx;
-        get_traffic_from_vnstat(&rx, &tx);
-        long long total = rx + tx;
+/*
+ * 检查一次用量并安排下一次检查。
+ * 下一次检查放在按当前速率预计到达上限的一半时间处，越接近上限间隔越短，
+ * 超限时最多多用 QUOTA_MIN_INTERVAL_MS 的线速流量。
+ */
+static void quota_evaluate(void) {
+    if (g_quota.timer > 0) {
+        g_source_remove(g_quota.timer);
+        g_quota.timer = 0;
+    }
 
-        if (total >= config.much) {
-            set_airplane_mode(1);  /* 流量超限，开启飞行模式 */
-        } else {
-            set_airplane_mode(0);  /* 流量正常，关闭飞行模式 */
+    if (!g_config.switch_on) {
+        /* 关闭流量控制时，恢复网络 */
+        quota_apply(0);
+        g_quota.last_us = 0;
+        g_quota.rate = 0;
+        g_quota.eta_ms = -1;
+        return;
+    }
+
+    long long rx, tx;
+    gint64 now = g_get_monotonic_time();
+    traffic_get_totals(&rx, &tx);
+    long long total = rx + tx;
+
+    /* 瞬时速率与平滑速率取较大者，突发下载时不会低估 */
+    double predict_rate = 0;
+    if (g_quota.last_us > 0 && now > g_quota.last_us && total >= g_quota.last_total) {
+        double inst = (double)(total - g_quota.last_total) * G_USEC_PER_SEC / (double)(now - g_quota.last_us);
+        g_quota.rate = g_quota.rate * 0.7 + inst * 0.3;
+        predict_rate = inst > g_quota.rate ? inst : g_quota.rate;
+    } else {
+        g_quota.rate = 0;
+    }
+    g_quota.last_total = total;
+    g_quota.last_us = now;
+
+    long long remaining = g_config.much - total;
+    quota_apply(remaining <= 0 ? 1 : 0);
+
+    guint interval = QUOTA_MAX_INTERVAL_MS;
+    g_quota.eta_ms = -1;
+    if (remaining > 0 && predict_rate >= 1.0) {
+        double eta_ms = (double)remaining / predict_rate * 1000.0;
+        g_quota.eta_ms = (long long)eta_ms;
+        if (eta_ms / 2 < interval) {
+            interval = eta_ms / 2 > QUOTA_MIN_INTERVAL_MS ? (guint)(eta_ms / 2) : QUOTA_MIN_INTERVAL_MS;
         }
-        sleep(15);
     }
-    return NULL;
+    g_quota.timer = g_timeout_add(interval, quota_tick, NULL);
 }
 
-/* 初始化 vnstat 数据库 */
+/* 初始化 vnstat 数据库 (可选，配置项 traffic_vnstat=1 时启用) */
 static void init_vnstat_db(void) {
     struct stat st;
     char output[256];
+    if (!config_get_int("traffic_vnstat", 0) || access(VNSTATD_BIN, X_OK) != 0) {
+        return;
+    }
     if (stat(VNSTAT_DB, &st) != 0) {
-        run_command(output, sizeof(output), "/home/root/6677/vnstatd", "--initdb", NULL);
+        run_command(output, sizeof(output), VNSTATD_BIN, "--initdb", NULL);
         char cmd[256];
-        snprintf(cmd, sizeof(cmd), "/home/root/6677/vnstat --add -i %s", NETWORK_IFACE);
+        snprintf(cmd, sizeof(cmd), VNSTAT_BIN " --add -i %s", NETWORK_IFACE);
         run_command(output, sizeof(output), "sh", "-c", cmd, NULL);
     }
-    run_command(output, sizeof(output), "/home/root/6677/vnstatd", "--noadd", "--config", "/home/root/6677/vnstatd.conf", "-d", NULL);
+    run_command(output, sizeof(output), VNSTATD_BIN, "--noadd", "--config", "/home/root/6677/vnstatd.conf", "-d", NULL);
 }
 
 /* 初始化流量统计 */
 void init_traffic(void) {
+    restore_counter();
+    if (g_sample_timer == 0) {
+        g_sample_timer = g_timeout_add_seconds(TRAFFIC_SAMPLE_SECS, traffic_sample_tick, NULL);
+    }
+    traffic_history_init();
     init_vnstat_db();
 
     /* 启动流量控制 */
-    TrafficConfig config = read_traffic_config();
-    if (config.switch_on && !is_flow_control_running) {
-        is_flow_control_running = 1;
-        pthread_create(&flow_control_thread, NULL, flow_control_thread_func, NULL);
-        pthread_detach(flow_control_thread);
+    g_config = read_traffic_config();
+    if (g_config.switch_on) {
+        quota_evaluate();
     }
     printf("流量统计已初始化\n");
 }
@@ -133,7 +341,7 @@ void handle_get_traffic_total(struct mg_connection *c, struct mg_http_message *h
     HTTP_CHECK_GET(c, hm);
 
     long long rx, tx;
-    get_traffic_from_vnstat(&rx, &tx);
+    traffic_get_totals(&rx, &tx);
 
     char rx_str[32], tx_str[32], total_str[32];
     format_bytes(rx, rx_str, sizeof(rx_str));
@@ -153,12 +361,17 @@ void handle_get_traffic_total(struct mg_connection *c, struct mg_http_message *h
 void handle_get_traffic_config(struct mg_connection *c, struct mg_http_message *hm) {
     HTTP_CHECK_GET(c, hm);
 
-    TrafficConfig config = read_traffic_config();
-    
+    long long rx, tx;
+    traffic_get_totals(&rx, &tx);
+
     JsonBuilder *j = json_new();
     json_obj_open(j);
-    json_add_long(j, "much", config.much);
-    json_add_int(j, "switch", config.switch_on);
+    json_add_long(j, "much", g_config.much);
+    json_add_int(j, "switch", g_config.switch_on);
+    json_add_long(j, "used", rx + tx);
+    json_add_bool(j, "cutoff", g_quota.applied == 1 && g_config.switch_on);
+    json_add_long(j, "rate", (long long)g_quota.rate);
+    json_add_long(j, "eta_ms", g_quota.eta_ms);
     json_obj_close(j);
     HTTP_OK_FREE(c, json_finish(j));
 }
@@ -173,9 +386,12 @@ void handle_set_traffic_limit(struct mg_connection *c, struct mg_http_message *h
 
     /* 如果没有参数，清除统计 */
     if (switch_val < 0 || much_val < 0) {
-        char output[256];
-        run_command(output, sizeof(output), "rm", "-f", VNSTAT_DB, NULL);
-        init_vnstat_db();
+        reset_traffic_totals();
+        if (config_get_int("traffic_vnstat", 0)) {
+            char output[256];
+            run_command(output, sizeof(output), "rm", "-f", VNSTAT_DB, NULL);
+            init_vnstat_db();
+        }
         
         JsonBuilder *j = json_new();
         json_obj_open(j);
@@ -191,15 +407,6 @@ void handle_set_traffic_limit(struct mg_connection *c, struct mg_http_message *h
     config.much = much_val;
     save_traffic_config(&config);
 
-    if (config.switch_on == 0) {
-        /* 关闭流量控制时，立即关闭飞行模式恢复网络 */
-        set_airplane_mode(0);
-    } else if (!is_flow_control_running) {
-        is_flow_control_running = 1;
-        pthread_create(&flow_control_thread, NULL, flow_control_thread_func, NULL);
-        pthread_detach(flow_control_thread);
-    }
-
     JsonBuilder *j = json_new();
     json_obj_open(j);
     json_add_bool(j, "success", 1);
@@ -0,0 +1,417 @@
+/**
+ * @file traffic_history.c
+ * @brief 流量历史时间序列存储实现
+ *
+ * 文件布局: [ThHeader][分钟桶][小时桶][日桶][月桶]，大小固定。
+ * 运行时整个镜像常驻内存，按 4KB 页记录脏页，定时用 pwrite 写回。
+ * 不使用 MAP_SHARED 映射: 内核回写会每隔数十秒刷一次脏页，无法限制写入频率。
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <glib.h>
+#include "mongoose.h"
+#include "traffic_history.h"
+#include "traffic.h"
+#include "database.h"
+#include "http_utils.h"
+#include "json_builder.h"
+
+#define TH_MAGIC          0x54484953u   /* "THIS" */
+#define TH_VERSION        1
+#define TH_PAGE_SIZE      4096
+#define TH_MIN_VALID_TS   1577836800    /* 2020-01-01, 之前视为时钟未同步 */
+
+enum { TH_SECOND, TH_MINUTE, TH_HOUR, TH_DAY, TH_MONTH, TH_TIER_COUNT };
+
+/* 汇总级别: step 为 0 表示按自然月 */
+typedef struct {
+    const char *name;
+    int step;
+    int slots;
+} ThTier;
+
+static const ThTier g_tiers[TH_TIER_COUNT] = {
+    {"second", 1,     300},     /* 5 分钟, 仅内存 */
+    {"minute", 60,    1440},    /* 1 天 */
+    {"hour",   3600,  1080},    /* 45 天 */
+    {"day",    86400, 800},     /* 约 2 年 */
+    {"month",  0,     120},     /* 10 年 */
+};
+
+typedef struct {
+    uint32_t ts;        /* 桶起始时间, 与当前时间不符时视为空桶 */
+    uint32_t reserved;
+    uint64_t rx;
+    uint64_t tx;
+} ThBucket;
+
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t slots[TH_TIER_COUNT];
+    uint32_t last_ts;
+    uint8_t reserved[32];
+} ThHeader;
+
+static ThBucket g_seconds[300];
+static uint8_t *g_image = NULL;         /* 文件镜像 */
+static size_t g_image_size = 0;
+static size_t g_tier_off[TH_TIER_COUNT];
+static uint8_t *g_dirty = NULL;         /* 脏页位图 */
+static int g_fd = -1;
+
+static int g_primed = 0;
+static long long g_last_rx = 0, g_last_tx = 0;
+static uint64_t g_pending_rx = 0, g_pending_tx = 0;   /* 时钟同步前的流量 */
+
+/* ==================== 桶定位 ==================== */
+
+static int is_calendar(int tier) {
+    return tier == TH_DAY || tier == TH_MONTH;
+}
+
+static time_t bucket_start(int tier, time_t ts) {
+    struct tm tm;
+
+    if (!is_calendar(tier)) {
+        return ts - ts % g_tiers[tier].step;
+    }
+    /* 日/月按本地时间对齐 */
+    localtime_r(&ts, &tm);
+    tm.tm_hour = tm.tm_min = tm.tm_sec = 0;
+    if (tier == TH_MONTH) tm.tm_mday = 1;
+    tm.tm_isdst = -1;
+    return mktime(&tm);
+}
+
+static time_t bucket_next(int tier, time_t start) {
+    struct tm tm;
+
+    if (!is_calendar(tier)) {
+        return start + g_tiers[tier].step;
+    }
+    localtime_r(&start, &tm);
+    if (tier == TH_MONTH) tm.tm_mon++;
+    else tm.tm_mday++;
+    tm.tm_isdst = -1;
+    return mktime(&tm);
+}
+
+static ThBucket *tier_bucket(int tier, time_t start) {
+    uint32_t idx;
+    struct tm tm;
+
+    if (!is_calendar(tier)) {
+        idx = (uint32_t)(start / g_tiers[tier].step);
+    } else {
+        localtime_r(&start, &tm);
+        idx = tier == TH_MONTH ? (uint32_t)(tm.tm_year * 12 + tm.tm_mon)
+                               : (uint32_t)((start + tm.tm_gmtoff) / 86400);
+    }
+    idx %= (uint32_t)g_tiers[tier].slots;
+
+    if (tier == TH_SECOND) return &g_seconds[idx];
+    return (ThBucket *)(g_image + g_tier_off[tier]) + idx;
+}
+
+/* 最早可能保留数据的时间 */
+static time_t tier_oldest(int tier, time_t now) {
+    int step = g_tiers[tier].step ? g_tiers[tier].step : 31 * 86400;
+    return now - (time_t)step * (g_tiers[tier].slots - 1);
+}
+
+/* ==================== 文件镜像 ==================== */
+
+static void mark_dirty(const void *p, size_t len) {
+    size_t off = (const uint8_t *)p - g_image;
+    for (size_t page = off / TH_PAGE_SIZE; page <= (off + len - 1) / TH_PAGE_SIZE; page++) {
+        g_dirty[page / 8] |= (uint8_t)(1u << (page % 8));
+    }
+}
+
+static void image_format(void) {
+    ThHeader *h = (ThHeader *)g_image;
+
+    memset(g_image, 0, g_image_size);
+    h->magic = TH_MAGIC;
+    h->version = TH_VERSION;
+    for (int i = 0; i < TH_TIER_COUNT; i++) h->slots[i] = (uint32_t)g_tiers[i].slots;
+    mark_dirty(g_image, g_image_size);
+}
+
+static int image_valid(void) {
+    const ThHeader *h = (const ThHeader *)g_image;
+
+    if (h->magic != TH_MAGIC || h->version != TH_VERSION) return 0;
+    for (int i = 0; i < TH_TIER_COUNT; i++) {
+        if (h->slots[i] != (uint32_t)g_tiers[i].slots) return 0;
+    }
+    return 1;
+}
+
+int traffic_history_flush(void) {
+    size_t pages = (g_image_size + TH_PAGE_SIZE - 1) / TH_PAGE_SIZE;
+    int written = 0;
+
+    if (!g_image || g_fd < 0) return -1;
+
+    for (size_t page = 0; page < pages; page++) {
+        if (!(g_dirty[page / 8] & (1u << (page % 8)))) continue;
+
+        size_t off = page * TH_PAGE_SIZE;
+        size_t len = g_image_size - off < TH_PAGE_SIZE ? g_image_size - off : TH_PAGE_SIZE;
+        if (pwrite(g_fd, g_image + off, len, (off_t)off) != (ssize_t)len) {
+            printf("[TrafficHistory] 写回失败: page %zu\n", page);
+            return -1;
+        }
+        g_dirty[page / 8] &= (uint8_t)~(1u << (page % 8));
+        written++;
+    }
+    if (written > 0) {
+        fdatasync(g_fd);
+    }
+    return written;
+}
+
+/* ==================== 采样 ==================== */
+
+static void record(time_t now, uint64_t rx, uint64_t tx) {
+    ThHeader *h = (ThHeader *)g_image;
+
+    for (int tier = 0; tier < TH_TIER_COUNT; tier++) {
+        time_t start = bucket_start(tier, now);
+        ThBucket *b = tier_bucket(tier, start);
+
+        if (b->ts != (uint32_t)start) {
+            memset(b, 0, sizeof(*b));
+            b->ts = (uint32_t)start;
+        }
+        b->rx += rx;
+        b->tx += tx;
+        if (tier != TH_SECOND) mark_dirty(b, sizeof(*b));
+    }
+    h->last_ts = (uint32_t)now;
+    mark_dirty(h, sizeof(*h));
+}
+
+static gboolean history_sample_tick(gpointer user_data) {
+    long long rx, tx;
+    time_t now = time(NULL);
+    (void)user_data;
+
+    traffic_get_totals(&rx, &tx);
+    if (!g_primed) {
+        g_last_rx = rx;
+        g_last_tx = tx;
+        g_primed = 1;
+        return G_SOURCE_CONTINUE;
+    }
+
+    /* 累计值被清零时本次增量记为 0 */
+    g_pending_rx += rx >= g_last_rx ? (uint64_t)(rx - g_last_rx) : 0;
+    g_pending_tx += tx >= g_last_tx ? (uint64_t)(tx - g_last_tx) : 0;
+    g_last_rx = rx;
+    g_last_tx = tx;
+
+    /* 开机后 ntpdate 同步前时间不可信，流量先暂存 */
+    if (now < TH_MIN_VALID_TS) {
+        return G_SOURCE_CONTINUE;
+    }
+    if (g_pending_rx || g_pending_tx) {
+        record(now, g_pending_rx, g_pending_tx);
+        g_pending_rx = 0;
+        g_pending_tx = 0;
+    }
+    return G_SOURCE_CONTINUE;
+}
+
+static gboolean history_flush_tick(gpointer user_data) {
+    (void)user_data;
+    traffic_history_flush();
+    return G_SOURCE_CONTINUE;
+}
+
+void traffic_history_reset(void) {
+    if (!g_image) return;
+    memset(g_seconds, 0, sizeof(g_seconds));
+    image_format();
+    traffic_history_flush();
+}
+
+int traffic_history_init(void) {
+    struct stat st;
+    int loaded = 0;
+
+    if (g_image) return 0;
+
+    /* 计算各级在镜像中的偏移 */
+    g_image_size = sizeof(ThHeader);
+    for (int i = TH_MINUTE; i < TH_TIER_COUNT; i++) {
+        g_tier_off[i] = g_image_size;
+        g_image_size += sizeof(ThBucket) * g_tiers[i].slots;
+    }
+    g_image = g_malloc0(g_image_size);
+    g_dirty = g_malloc0((g_image_size / TH_PAGE_SIZE + 8) / 8);
+
+    g_fd = open(TRAFFIC_HISTORY_FILE, O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if (g_fd < 0) {
+        printf("[TrafficHistory] 无法打开 %s，历史仅保存在内存\n", TRAFFIC_HISTORY_FILE);
+    } else if (fstat(g_fd, &st) == 0 && (size_t)st.st_size == g_image_size &&
+               pread(g_fd, g_image, g_image_size, 0) == (ssize_t)g_image_size &&
+               image_valid()) {
+        loaded = 1;
+    }
+
+    if (!loaded) {
+        image_format();
+        if (g_fd >= 0 && ftruncate(g_fd, (off_t)g_image_size) == 0) {
+            traffic_history_flush();
+        }
+    }
+
+    int flush_min = config_get_int("traffic_history_flush_min", TRAFFIC_HISTORY_FLUSH_DEFAULT);
+    if (flush_min < 1) flush_min = 1;
+
+    g_timeout_add_seconds(1, history_sample_tick, NULL);
+    g_timeout_add_seconds((guint)flush_min * 60, history_flush_tick, NULL);
+
+    printf("[TrafficHistory] %s %s (%zu 字节), 每 %d 分钟写回\n",
+           loaded ? "已加载" : "已新建", TRAFFIC_HISTORY_FILE, g_image_size, flush_min);
+    return g_fd >= 0 ? 0 : -1;
+}
+
+/* ==================== 查询 ==================== */
+
+static int parse_tier_name(const char *s) {
+    for (int i = 0; i < TH_TIER_COUNT; i++) {
+        if (strcmp(s, g_tiers[i].name) == 0) return i;
+    }
+    return -1;
+}
+
+/* 选择不超过 step 的最粗级别 */
+static int tier_for_step(long step) {
+    int tier = TH_SECOND;
+    for (int i = TH_SECOND; i <= TH_DAY; i++) {
+        if (g_tiers[i].step <= step) tier = i;
+    }
+    return tier;
+}
+
+/* 未指定 step 时: 点数不超过 300 的最细级别 */
+static int tier_for_span(long span) {
+    for (int i = TH_SECOND; i <= TH_DAY; i++) {
+        if (span / g_tiers[i].step <= 300) return i;
+    }
+    return TH_MONTH;
+}
+
+static long query_long(struct mg_http_message *hm, const char *name, long def) {
+    char buf[32];
+    if (mg_http_get_var(&hm->query, name, buf, sizeof(buf)) > 0) {
+        return atol(buf);
+    }
+    return def;
+}
+
+/* GET /api/traffic/history?from=&to=&step= - 按时间范围查询流量 */
+void handle_traffic_history(struct mg_connection *c, struct mg_http_message *hm) {
+    HTTP_CHECK_GET(c, hm);
+
+    if (!g_image) {
+        HTTP_ERROR(c, 503, "Traffic history not initialized");
+        return;
+    }
+
+    time_t now = time(NULL);
+    long to = query_long(hm, "to", (long)now);
+    long from = query_long(hm, "from", to - 3600);
+    if (from > to) {
+        HTTP_ERROR(c, 400, "from must not be greater than to");
+        return;
+    }
+
+    /* step: 秒数或级别名 (second/minute/hour/day/month) */
+    char step_str[16] = {0};
+    long step = 0;
+    int tier;
+    mg_http_get_var(&hm->query, "step", step_str, sizeof(step_str));
+    if (step_str[0] == '\0') {
+        tier = tier_for_span(to - from);
+        step = g_tiers[tier].step;
+    } else if ((tier = parse_tier_name(step_str)) >= 0) {
+        step = g_tiers[tier].step;
+    } else if ((step = atol(step_str)) > 0) {
+        tier = tier_for_step(step);
+    } else {
+        HTTP_ERROR(c, 400, "Invalid step");
+        return;
+    }
+
+    /* 日历级别按桶输出，其余按 step 聚合 */
+    int per_bucket = is_calendar(tier) && (step == 0 || step == g_tiers[tier].step);
+    long est = (to - from) / (per_bucket ? (tier == TH_MONTH ? 28 * 86400 : 86400) : step) + 1;
+    if (est > TRAFFIC_HISTORY_MAX_POINTS) {
+        HTTP_ERROR(c, 400, "Too many points, increase step");
+        return;
+    }
+
+    /* 早于保留期的桶必然为空，跳过 */
+    time_t begin = from;
+    if (begin < tier_oldest(tier, now)) begin = tier_oldest(tier, now);
+    time_t origin = bucket_start(tier, from);
+    time_t end = to < now ? to : now;
+
+    JsonBuilder *j = json_new();
+    json_obj_open(j);
+    json_add_long(j, "from", from);
+    json_add_long(j, "to", to);
+    json_add_long(j, "step", step);
+    json_add_str(j, "tier", g_tiers[tier].name);
+    json_arr_open(j, "points");
+
+    uint64_t sum_rx = 0, sum_tx = 0, out_rx = 0, out_tx = 0;
+    time_t out_ts = -1;
+    for (time_t b = bucket_start(tier, begin); b <= end; b = bucket_next(tier, b)) {
+        time_t key = per_bucket ? b : origin + ((b - origin) / step) * step;
+        if (key != out_ts) {
+            if (out_ts >= 0) {
+                json_arr_obj_open(j);
+                json_add_long(j, "t", out_ts);
+                json_add_long(j, "rx", (long long)out_rx);
+                json_add_long(j, "tx", (long long)out_tx);
+                json_obj_close(j);
+            }
+            out_ts = key;
+            out_rx = out_tx = 0;
+        }
+
+        const ThBucket *bk = tier_bucket(tier, b);
+        if (bk->ts == (uint32_t)b) {
+            out_rx += bk->rx;
+            out_tx += bk->tx;
+            sum_rx += bk->rx;
+            sum_tx += bk->tx;
+        }
+    }
+    if (out_ts >= 0) {
+        json_arr_obj_open(j);
+        json_add_long(j, "t", out_ts);
+        json_add_long(j, "rx", (long long)out_rx);
+        json_add_long(j, "tx", (long long)out_tx);
+        json_obj_close(j);
+    }
+
+    json_arr_close(j);
+    json_add_long(j, "rx_total", (long long)sum_rx);
+    json_add_long(j, "tx_total", (long long)sum_tx);
+    json_obj_close(j);
+    HTTP_OK_FREE(c, json_finish(j));
+}
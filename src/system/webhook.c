@@ -0,0 +1,498 @@
+/**
+ * @file webhook.c
+ * @brief Webhook 异步投递队列实现
+ *
+ * 磁盘队列文件格式: "UWH1 <attempts> <url_len> <headers_len> <body_len>\n" + url + headers + body
+ * 先写 .tmp 再 rename，断电时不会留下半个任务。
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#include <glib.h>
+#include "mongoose.h"
+#include "webhook.h"
+#include "http_utils.h"
+#include "json_builder.h"
+
+#define WEBHOOK_MAX_SLOTS  4        /* 连接槽位 (进行中 + 空闲保持) */
+#define WEBHOOK_TICK_MS    1000
+
+typedef struct {
+    long long id;
+    int attempts;
+    gint64 due_us;              /* 下次可投递的单调时间 */
+    char *url;
+    char *headers;              /* 规范化后的 "Name: value\r\n" 序列 */
+    char *body;
+    size_t body_len;
+} WebhookJob;
+
+/* 一个到端点的连接 */
+typedef struct {
+    struct mg_connection *c;
+    char endpoint[160];         /* scheme://host:port */
+    WebhookJob *job;            /* NULL 表示空闲 */
+    int connected;
+    gint64 since_us;            /* 请求开始或进入空闲的时间 */
+    char error[128];
+} WebhookSlot;
+
+static struct mg_mgr *g_mgr = NULL;
+static GQueue g_jobs = G_QUEUE_INIT;        /* 待投递任务，按 ID 排序 */
+static WebhookSlot g_slots[WEBHOOK_MAX_SLOTS];
+static long long g_next_id = 1;
+static guint g_timer = 0;
+static WebhookStats g_stats;
+
+static void webhook_pump(void);
+
+/* ==================== 磁盘队列 ==================== */
+
+static void spool_path(long long id, char *path, size_t size, const char *suffix) {
+    snprintf(path, size, WEBHOOK_SPOOL_DIR "/%lld.job%s", id, suffix);
+}
+
+static int spool_write(const WebhookJob *job) {
+    char path[128], tmp[128];
+    size_t url_len = strlen(job->url), hdr_len = strlen(job->headers);
+
+    spool_path(job->id, path, sizeof(path), "");
+    spool_path(job->id, tmp, sizeof(tmp), ".tmp");
+
+    FILE *fp = fopen(tmp, "wb");
+    if (!fp) return -1;
+    fprintf(fp, "UWH1 %d %zu %zu %zu\n", job->attempts, url_len, hdr_len, job->body_len);
+    fwrite(job->url, 1, url_len, fp);
+    fwrite(job->headers, 1, hdr_len, fp);
+    fwrite(job->body, 1, job->body_len, fp);
+    int failed = ferror(fp);
+    if (fclose(fp) != 0 || failed || rename(tmp, path) != 0) {
+        unlink(tmp);
+        return -1;
+    }
+    return 0;
+}
+
+static void spool_remove(long long id) {
+    char path[128];
+    spool_path(id, path, sizeof(path), "");
+    unlink(path);
+}
+
+static char *read_exact(FILE *fp, size_t len) {
+    char *buf = g_malloc(len + 1);
+    if (fread(buf, 1, len, fp) != len) {
+        g_free(buf);
+        return NULL;
+    }
+    buf[len] = '\0';
+    return buf;
+}
+
+static WebhookJob *spool_load(long long id) {
+    char path[128];
+    int attempts;
+    size_t url_len, hdr_len, body_len;
+
+    spool_path(id, path, sizeof(path), "");
+    FILE *fp = fopen(path, "rb");
+    if (!fp) return NULL;
+
+    WebhookJob *job = NULL;
+    if (fscanf(fp, "UWH1 %d %zu %zu %zu", &attempts, &url_len, &hdr_len, &body_len) == 4 &&
+        fgetc(fp) == '\n' && url_len < 1024 && hdr_len < 4096 && body_len < 65536) {
+        job = g_new0(WebhookJob, 1);
+        job->id = id;
+        job->attempts = attempts;
+        job->url = read_exact(fp, url_len);
+        job->headers = read_exact(fp, hdr_len);
+        job->body = read_exact(fp, body_len);
+        job->body_len = body_len;
+        if (!job->url || !job->headers || !job->body) {
+            g_free(job->url);
+            g_free(job->headers);
+            g_free(job->body);
+            g_free(job);
+            job = NULL;
+        }
+    }
+    fclose(fp);
+    if (!job) {
+        printf("[Webhook] 丢弃损坏的队列文件 %s\n", path);
+        unlink(path);
+    }
+    return job;
+}
+
+static gint job_cmp(gconstpointer a, gconstpointer b, gpointer user_data) {
+    const WebhookJob *ja = a, *jb = b;
+    (void)user_data;
+    return ja->id < jb->id ? -1 : ja->id > jb->id;
+}
+
+static void job_free(WebhookJob *job) {
+    if (!job) return;
+    g_free(job->url);
+    g_free(job->headers);
+    g_free(job->body);
+    g_free(job);
+}
+
+/* ==================== 投递 ==================== */
+
+static void endpoint_of(const char *url, char *out, size_t size) {
+    struct mg_str host = mg_url_host(url);
+    snprintf(out, size, "%s://%.*s:%u", mg_url_is_ssl(url) ? "https" : "http",
+             (int)host.len, host.buf, mg_url_port(url));
+}
+
+static int inflight_count(void) {
+    int n = 0;
+    for (int i = 0; i < WEBHOOK_MAX_SLOTS; i++) {
+        if (g_slots[i].job) n++;
+    }
+    return n;
+}
+
+static void send_request(WebhookSlot *slot) {
+    const WebhookJob *job = slot->job;
+    struct mg_str host = mg_url_host(job->url);
+
+    mg_printf(slot->c,
+              "POST %s HTTP/1.1\r\n"
+              "Host: %.*s\r\n"
+              "User-Agent: UOOLS-webhook\r\n"
+              "Content-Length: %lu\r\n"
+              "%s\r\n",
+              mg_url_uri(job->url), (int)host.len, host.buf,
+              (unsigned long)job->body_len, job->headers);
+    mg_send(slot->c, job->body, job->body_len);
+    slot->since_us = g_get_monotonic_time();
+}
+
+/* 任务结束: 成功删除，可重试的放回队列 */
+static void job_finish(WebhookJob *job, int status, const char *error, gint64 started_us) {
+    g_stats.last_status = status;
+    g_stats.last_latency_ms = (int)((g_get_monotonic_time() - started_us) / 1000);
+    snprintf(g_stats.last_error, sizeof(g_stats.last_error), "%s", error ? error : "");
+
+    if (status >= 200 && status < 300) {
+        g_stats.delivered++;
+        g_stats.last_success = time(NULL);
+        spool_remove(job->id);
+        job_free(job);
+        return;
+    }
+
+    /* 4xx 除 408/429 外重试也不会成功 */
+    int permanent = status >= 400 && status < 500 && status != 408 && status != 429;
+    job->attempts++;
+    if (permanent || job->attempts >= WEBHOOK_MAX_ATTEMPTS) {
+        printf("[Webhook] 任务 %lld 放弃 (状态 %d, 已尝试 %d 次)\n", job->id, status, job->attempts);
+        g_stats.failed++;
+        spool_remove(job->id);
+        job_free(job);
+        return;
+    }
+
+    int delay = WEBHOOK_BACKOFF_BASE << (job->attempts - 1);
+    if (delay > WEBHOOK_BACKOFF_MAX) delay = WEBHOOK_BACKOFF_MAX;
+    job->due_us = g_get_monotonic_time() + (gint64)delay * G_USEC_PER_SEC;
+    g_stats.retries++;
+    spool_write(job);
+    g_queue_insert_sorted(&g_jobs, job, job_cmp, NULL);
+    printf("[Webhook] 任务 %lld 失败 (状态 %d %s)，%d 秒后重试\n",
+           job->id, status, error ? error : "", delay);
+}
+
+static void release_slot(WebhookSlot *slot) {
+    slot->c = NULL;
+    slot->job = NULL;
+    slot->connected = 0;
+    slot->endpoint[0] = '\0';
+    slot->error[0] = '\0';
+}
+
+static void conn_handler(struct mg_connection *c, int ev, void *ev_data) {
+    WebhookSlot *slot = (WebhookSlot *)c->fn_data;
+
+    if (!slot || slot->c != c) return;     /* 槽位已被回收 */
+
+    if (ev == MG_EV_CONNECT) {
+        if (slot->job && mg_url_is_ssl(slot->job->url)) {
+            struct mg_tls_opts opts;
+            memset(&opts, 0, sizeof(opts));
+            opts.name = mg_url_host(slot->job->url);
+            opts.skip_verification = 1;     /* 设备上没有 CA 证书库 */
+            mg_tls_init(c, &opts);
+        }
+        slot->connected = 1;
+        if (slot->job) send_request(slot);
+    } else if (ev == MG_EV_HTTP_MSG) {
+        struct mg_http_message *hm = (struct mg_http_message *)ev_data;
+        WebhookJob *job = slot->job;
+        if (!job) return;
+
+        gint64 started = slot->since_us;
+        struct mg_str *conn_hdr = mg_http_get_header(hm, "Connection");
+        int keep = !(conn_hdr && mg_strcasecmp(*conn_hdr, mg_str("close")) == 0);
+
+        slot->job = NULL;
+        slot->since_us = g_get_monotonic_time();
+        if (!keep) {
+            c->is_draining = 1;
+            release_slot(slot);
+        }
+        job_finish(job, mg_http_status(hm), NULL, started);
+        webhook_pump();
+    } else if (ev == MG_EV_ERROR) {
+        snprintf(slot->error, sizeof(slot->error), "%s", (const char *)ev_data);
+    } else if (ev == MG_EV_CLOSE) {
+        WebhookJob *job = slot->job;
+        gint64 started = slot->since_us;
+        char error[128];
+
+        snprintf(error, sizeof(error), "%s", slot->error[0] ? slot->error : "连接关闭");
+        release_slot(slot);
+        if (job) {
+            job_finish(job, 0, error, started);
+            webhook_pump();
+        }
+    }
+}
+
+/* 为任务分配连接: 优先复用同端点的空闲连接 */
+static void dispatch(WebhookJob *job, gint64 now) {
+    char endpoint[160];
+    WebhookSlot *slot = NULL;
+
+    endpoint_of(job->url, endpoint, sizeof(endpoint));
+
+    for (int i = 0; i < WEBHOOK_MAX_SLOTS; i++) {
+        WebhookSlot *s = &g_slots[i];
+        if (s->c && !s->job && s->connected && strcmp(s->endpoint, endpoint) == 0) {
+            s->job = job;
+            send_request(s);
+            return;
+        }
+    }
+
+    for (int i = 0; i < WEBHOOK_MAX_SLOTS && !slot; i++) {
+        if (!g_slots[i].c) slot = &g_slots[i];
+    }
+    /* 没有空槽位时关闭空闲最久的连接 */
+    if (!slot) {
+        for (int i = 0; i < WEBHOOK_MAX_SLOTS; i++) {
+            WebhookSlot *s = &g_slots[i];
+            if (!s->job && (!slot || s->since_us < slot->since_us)) slot = s;
+        }
+        if (!slot) {
+            g_queue_push_head(&g_jobs, job);
+            return;
+        }
+        slot->c->is_draining = 1;
+        release_slot(slot);
+    }
+
+    struct mg_connection *c = mg_http_connect(g_mgr, job->url, conn_handler, slot);
+    if (!c) {
+        job_finish(job, 0, "无效的 URL", now);
+        return;
+    }
+    slot->c = c;
+    slot->job = job;
+    slot->connected = 0;
+    slot->since_us = now;
+    slot->error[0] = '\0';
+    snprintf(slot->endpoint, sizeof(slot->endpoint), "%s", endpoint);
+}
+
+static gboolean webhook_tick(gpointer user_data) {
+    (void)user_data;
+    g_timer = 0;
+    webhook_pump();
+    return G_SOURCE_REMOVE;
+}
+
+static void webhook_pump(void) {
+    gint64 now = g_get_monotonic_time();
+    int active = 0;
+
+    if (!g_mgr) return;
+
+    /* 超时的请求和空闲过久的连接 */
+    for (int i = 0; i < WEBHOOK_MAX_SLOTS; i++) {
+        WebhookSlot *s = &g_slots[i];
+        if (!s->c) continue;
+        gint64 limit = s->job ? WEBHOOK_TIMEOUT_SECS : WEBHOOK_IDLE_SECS;
+        if (now - s->since_us >= limit * G_USEC_PER_SEC) {
+            if (s->job) snprintf(s->error, sizeof(s->error), "请求超时");
+            s->c->is_closing = 1;       /* MG_EV_CLOSE 中处理任务 */
+        }
+        active = 1;
+    }
+
+    /* 按 ID 顺序取到期任务，直到并发上限 */
+    GList *l = g_jobs.head;
+    while (l && inflight_count() < WEBHOOK_MAX_INFLIGHT) {
+        GList *next = l->next;
+        WebhookJob *job = l->data;
+        if (job->due_us <= now) {
+            g_queue_delete_link(&g_jobs, l);
+            dispatch(job, now);
+        }
+        l = next;
+    }
+
+    if ((active || g_jobs.length > 0) && g_timer == 0) {
+        g_timer = g_timeout_add(WEBHOOK_TICK_MS, webhook_tick, NULL);
+    }
+}
+
+/* ==================== 接口 ==================== */
+
+/* 把用户填写的 "Name: value" 行规范化为 HTTP 头，缺省补 Content-Type */
+static char *normalize_headers(const char *headers) {
+    GString *out = g_string_new("");
+    int has_type = 0;
+
+    if (headers) {
+        gchar **lines = g_strsplit(headers, "\n", -1);
+        for (int i = 0; lines[i]; i++) {
+            char *line = g_strstrip(lines[i]);
+            if (!*line || !strchr(line, ':')) continue;
+            if (g_ascii_strncasecmp(line, "Host:", 5) == 0 ||
+                g_ascii_strncasecmp(line, "Content-Length:", 15) == 0) {
+                continue;
+            }
+            if (g_ascii_strncasecmp(line, "Content-Type:", 13) == 0) has_type = 1;
+            g_string_append_printf(out, "%s\r\n", line);
+        }
+        g_strfreev(lines);
+    }
+    if (!has_type) g_string_append(out, "Content-Type: application/json\r\n");
+    return g_string_free(out, FALSE);
+}
+
+long long webhook_enqueue(const char *url, const char *headers, const char *body, size_t len) {
+    if (!url || (strncmp(url, "http://", 7) != 0 && strncmp(url, "https://", 8) != 0)) {
+        return -1;
+    }
+
+    /* 队列满时丢弃最旧的任务 */
+    while (g_jobs.length >= WEBHOOK_MAX_QUEUE) {
+        WebhookJob *old = g_queue_pop_head(&g_jobs);
+        printf("[Webhook] 队列已满，丢弃任务 %lld\n", old->id);
+        spool_remove(old->id);
+        job_free(old);
+        g_stats.dropped++;
+    }
+
+    WebhookJob *job = g_new0(WebhookJob, 1);
+    job->id = g_next_id++;
+    job->url = g_strdup(url);
+    job->headers = normalize_headers(headers);
+    job->body = g_malloc(len + 1);
+    memcpy(job->body, body, len);
+    job->body[len] = '\0';
+    job->body_len = len;
+    job->due_us = 0;
+
+    if (spool_write(job) != 0) {
+        printf("[Webhook] 写入队列文件失败: %s (仅保存在内存)\n", strerror(errno));
+    }
+    g_queue_push_tail(&g_jobs, job);
+    printf("[Webhook] 任务 %lld 入队 -> %s\n", job->id, url);
+
+    webhook_pump();
+    return job->id;
+}
+
+void webhook_init(void) {
+    DIR *dir;
+    struct dirent *ent;
+
+    if (mkdir(WEBHOOK_SPOOL_DIR, 0755) != 0 && errno != EEXIST) {
+        printf("[Webhook] 无法创建队列目录 %s\n", WEBHOOK_SPOOL_DIR);
+        return;
+    }
+
+    dir = opendir(WEBHOOK_SPOOL_DIR);
+    if (!dir) return;
+    while ((ent = readdir(dir)) != NULL) {
+        long long id;
+        char suffix[8] = {0};
+        if (sscanf(ent->d_name, "%lld.%7s", &id, suffix) != 2) continue;
+        if (strcmp(suffix, "job") != 0) {
+            /* 上次写到一半的临时文件 */
+            char path[300];
+            snprintf(path, sizeof(path), WEBHOOK_SPOOL_DIR "/%s", ent->d_name);
+            unlink(path);
+            continue;
+        }
+        WebhookJob *job = spool_load(id);
+        if (!job) continue;
+        g_queue_insert_sorted(&g_jobs, job, job_cmp, NULL);
+        if (id >= g_next_id) g_next_id = id + 1;
+    }
+    closedir(dir);
+
+    if (g_jobs.length > 0) {
+        printf("[Webhook] 恢复 %u 个未投递任务\n", g_jobs.length);
+    }
+}
+
+void webhook_start(struct mg_mgr *mgr) {
+    g_mgr = mgr;
+    webhook_pump();
+}
+
+void webhook_get_stats(WebhookStats *out) {
+    *out = g_stats;
+    out->queued = (int)g_jobs.length;
+    out->inflight = inflight_count();
+    out->idle_conns = 0;
+    for (int i = 0; i < WEBHOOK_MAX_SLOTS; i++) {
+        if (g_slots[i].c && !g_slots[i].job) out->idle_conns++;
+    }
+}
+
+/* GET /api/sms/webhook/status - 投递队列状态 */
+void handle_webhook_status(struct mg_connection *c, struct mg_http_message *hm) {
+    HTTP_CHECK_GET(c, hm);
+
+    WebhookStats st;
+    webhook_get_stats(&st);
+
+    JsonBuilder *j = json_new();
+    json_obj_open(j);
+    json_add_int(j, "queued", st.queued);
+    json_add_int(j, "inflight", st.inflight);
+    json_add_int(j, "idle_conns", st.idle_conns);
+    json_add_ulong(j, "delivered", st.delivered);
+    json_add_ulong(j, "failed", st.failed);
+    json_add_ulong(j, "retries", st.retries);
+    json_add_ulong(j, "dropped", st.dropped);
+    json_add_int(j, "last_status", st.last_status);
+    json_add_str(j, "last_error", st.last_error);
+    json_add_int(j, "last_latency_ms", st.last_latency_ms);
+    json_add_long(j, "last_success", (long long)st.last_success);
+    json_arr_open(j, "pending");
+    for (GList *l = g_jobs.head; l; l = l->next) {
+        const WebhookJob *job = l->data;
+        gint64 wait = (job->due_us - g_get_monotonic_time()) / G_USEC_PER_SEC;
+        json_arr_obj_open(j);
+        json_add_long(j, "id", job->id);
+        json_add_int(j, "attempts", job->attempts);
+        json_add_long(j, "retry_in", wait > 0 ? wait : 0);
+        json_obj_close(j);
+    }
+    json_arr_close(j);
+    json_obj_close(j);
+    HTTP_OK_FREE(c, json_finish(j));
+}
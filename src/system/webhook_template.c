@@ -0,0 +1,206 @@
+/**
+ * @file webhook_template.c
+ * @brief Webhook 请求体模板实现
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <glib.h>
+#include "webhook_template.h"
+
+static const char *g_var_names[TPL_VAR_COUNT] = {"sender", "content", "time"};
+
+static const struct {
+    const char *name;
+    TplEscape escape;
+} g_escape_names[] = {
+    {"raw", TPL_ESC_RAW}, {"json", TPL_ESC_JSON}, {"url", TPL_ESC_URL}, {"form", TPL_ESC_FORM},
+};
+
+TplEscape tpl_default_escape(const char *headers) {
+    if (!headers) return TPL_ESC_JSON;
+
+    const char *p = headers;
+    while (p && *p) {
+        while (*p == ' ' || *p == '\r' || *p == '\n') p++;
+        if (g_ascii_strncasecmp(p, "Content-Type:", 13) == 0) {
+            const char *eol = strchr(p, '\n');
+            size_t len = eol ? (size_t)(eol - p) : strlen(p);
+            char line[128];
+            snprintf(line, sizeof(line), "%.*s", (int)len, p);
+            char *lower = g_ascii_strdown(line, -1);
+            TplEscape esc = strstr(lower, "x-www-form-urlencoded") ? TPL_ESC_FORM :
+                            strstr(lower, "json") ? TPL_ESC_JSON : TPL_ESC_RAW;
+            g_free(lower);
+            return esc;
+        }
+        p = strchr(p, '\n');
+    }
+    return TPL_ESC_JSON;
+}
+
+static int add_segment(WebhookTemplate *tpl, uint8_t var, uint8_t escape, size_t off, size_t len) {
+    /* 相邻字面量合并 */
+    if (var == TPL_LITERAL && tpl->count > 0) {
+        TplSegment *last = &tpl->segs[tpl->count - 1];
+        if (last->var == TPL_LITERAL && last->off + last->len == off && last->len + len <= UINT16_MAX) {
+            last->len += (uint16_t)len;
+            return 0;
+        }
+    }
+    if (tpl->count >= TPL_MAX_SEGMENTS || len > UINT16_MAX) return -1;
+    /* 最后一个片段留给字面量，片段用尽后剩余原文都能合并进去 */
+    if (var != TPL_LITERAL && tpl->count >= TPL_MAX_SEGMENTS - 1) return -1;
+
+    TplSegment *seg = &tpl->segs[tpl->count++];
+    seg->var = var;
+    seg->escape = escape;
+    seg->off = (uint32_t)off;
+    seg->len = (uint16_t)len;
+    return 0;
+}
+
+/* 解析 "name" 或 "name|escape"，失败返回 -1 */
+static int parse_placeholder(const char *p, size_t len, TplEscape def, uint8_t *var, uint8_t *escape) {
+    const char *bar = memchr(p, '|', len);
+    size_t name_len = bar ? (size_t)(bar - p) : len;
+
+    *escape = (uint8_t)def;
+    if (bar) {
+        size_t esc_len = len - name_len - 1;
+        int found = 0;
+        for (size_t i = 0; i < G_N_ELEMENTS(g_escape_names); i++) {
+            if (strlen(g_escape_names[i].name) == esc_len &&
+                strncmp(g_escape_names[i].name, bar + 1, esc_len) == 0) {
+                *escape = (uint8_t)g_escape_names[i].escape;
+                found = 1;
+            }
+        }
+        if (!found) return -1;
+    }
+    for (int i = 0; i < TPL_VAR_COUNT; i++) {
+        if (strlen(g_var_names[i]) == name_len && strncmp(g_var_names[i], p, name_len) == 0) {
+            *var = (uint8_t)i;
+            return 0;
+        }
+    }
+    return -1;
+}
+
+int tpl_compile(WebhookTemplate *tpl, const char *src, TplEscape def) {
+    int ret = 0;
+
+    tpl_free(tpl);
+    tpl->src = g_strdup(src ? src : "");
+
+    const char *s = tpl->src;
+    size_t lit_start = 0, i = 0;
+    while (s[i]) {
+        if (s[i] == '#' && s[i + 1] == '{') {
+            const char *close = strchr(s + i + 2, '}');
+            uint8_t var, escape;
+            if (close && parse_placeholder(s + i + 2, (size_t)(close - s - i - 2), def, &var, &escape) == 0) {
+                if (i > lit_start) ret |= add_segment(tpl, TPL_LITERAL, 0, lit_start, i - lit_start);
+                /* 片段用尽时保留占位符原文 */
+                if (add_segment(tpl, var, escape, i, 0) != 0) {
+                    ret = -1;
+                    add_segment(tpl, TPL_LITERAL, 0, i, (size_t)(close - s) + 1 - i);
+                }
+                i = (size_t)(close - s) + 1;
+                lit_start = i;
+                continue;
+            }
+        }
+        i++;
+    }
+    if (i > lit_start) ret |= add_segment(tpl, TPL_LITERAL, 0, lit_start, i - lit_start);
+    return ret;
+}
+
+void tpl_free(WebhookTemplate *tpl) {
+    g_free(tpl->src);
+    tpl->src = NULL;
+    tpl->count = 0;
+}
+
+/* ==================== 渲染 ==================== */
+
+typedef struct {
+    char *p;
+    char *end;              /* 预留 '\0' */
+    int overflow;
+} OutBuf;
+
+static void out_put(OutBuf *o, const char *s, size_t n) {
+    size_t room = (size_t)(o->end - o->p);
+    if (n > room) {
+        n = room;
+        o->overflow = 1;
+    }
+    memcpy(o->p, s, n);
+    o->p += n;
+}
+
+static void put_escaped(OutBuf *o, const char *s, TplEscape esc) {
+    static const char hex[] = "0123456789ABCDEF";
+
+    if (esc == TPL_ESC_RAW) {
+        out_put(o, s, strlen(s));
+        return;
+    }
+
+    /* 连续不需要转义的字符整段复制 */
+    const char *run = s;
+    for (; *s; s++) {
+        unsigned char c = (unsigned char)*s;
+        char tmp[8];
+        size_t n = 0;
+
+        if (esc == TPL_ESC_JSON) {
+            if (c == '"' || c == '\\') {
+                tmp[0] = '\\'; tmp[1] = (char)c; n = 2;
+            } else if (c == '\n') {
+                tmp[0] = '\\'; tmp[1] = 'n'; n = 2;
+            } else if (c == '\r') {
+                tmp[0] = '\\'; tmp[1] = 'r'; n = 2;
+            } else if (c == '\t') {
+                tmp[0] = '\\'; tmp[1] = 't'; n = 2;
+            } else if (c < 0x20) {
+                memcpy(tmp, "\\u00", 4);
+                tmp[4] = hex[c >> 4]; tmp[5] = hex[c & 15]; n = 6;
+            }
+        } else {
+            int keep = g_ascii_isalnum(c) || c == '-' || c == '_' || c == '.' || c == '~';
+            if (c == ' ' && esc == TPL_ESC_FORM) {
+                tmp[0] = '+'; n = 1;
+            } else if (!keep) {
+                tmp[0] = '%'; tmp[1] = hex[c >> 4]; tmp[2] = hex[c & 15]; n = 3;
+            }
+        }
+
+        if (n > 0) {
+            out_put(o, run, (size_t)(s - run));
+            out_put(o, tmp, n);
+            run = s + 1;
+        }
+    }
+    out_put(o, run, (size_t)(s - run));
+}
+
+int tpl_render(const WebhookTemplate *tpl, const char *const values[TPL_VAR_COUNT],
+               char *out, size_t size) {
+    OutBuf o = {out, out + (size > 0 ? size - 1 : 0), 0};
+
+    if (size == 0) return -1;
+    for (int i = 0; i < tpl->count && !o.overflow; i++) {
+        const TplSegment *seg = &tpl->segs[i];
+        if (seg->var == TPL_LITERAL) {
+            out_put(&o, tpl->src + seg->off, seg->len);
+        } else {
+            const char *v = values[seg->var];
+            put_escaped(&o, v ? v : "", (TplEscape)seg->escape);
+        }
+    }
+    *o.p = '\0';
+    return o.overflow ? -1 : (int)(o.p - out);
+}
@@ -241,17 +241,34 @@ export async function getCurrentBand() {
   return request('/api/current_band')
 }
 
+// 等待射频重配置任务完成（锁频/锁小区为异步任务）
+export async function waitRadioJob(jobId, timeoutMs = 30000) {
+  if (!jobId) return null
+  const deadline = Date.now() + timeoutMs
+  while (Date.now() < deadline) {
+    const job = await request(`/api/radio_job?id=${jobId}`)
+    if (job.state === 'done') return job
+    if (job.state === 'failed') throw new Error(job.message || '射频重配置失败')
+    await new Promise(resolve => setTimeout(resolve, 300))
+  }
+  throw new Error('射频重配置超时')
+}
+
 // 锁定频段
 export async function lockBands(bands) {
-  return request('/api/lock_bands', {
+  const res = await request('/api/lock_bands', {
     method: 'POST',
     body: JSON.stringify({ bands })
   })
+  await waitRadioJob(res.job_id)
+  return res
 }
 
 // 解锁所有频段
 export async function unlockBands() {
-  return request('/api/unlock_bands', { method: 'POST' })
+  const res = await request('/api/unlock_bands', { method: 'POST' })
+  await waitRadioJob(res.job_id)
+  return res
 }
 
 // 获取小区信息
@@ -261,7 +278,7 @@ export async function getCells() {
 
 // 锁定小区
 export async function lockCell(technology, arfcn, pci) {
-  return request('/api/lock_cell', {
+  const res = await request('/api/lock_cell', {
     method: 'POST',
     body: JSON.stringify({ 
       technology, 
@@ -269,11 +286,15 @@ export async function lockCell(technology, arfcn, pci) {
       pci: pci.toString() 
     })
   })
+  await waitRadioJob(res.Data?.job_id)
+  return res
 }
 
 // 解锁小区
 export async function unlockCell() {
-  return request('/api/unlock_cell', { method: 'POST' })
+  const res = await request('/api/unlock_cell', { method: 'POST' })
+  await waitRadioJob(res.Data?.job_id)
+  return res
 }
 
 
@@ -307,10 +328,16 @@ export async function chargeOff() {
 
 // 执行AT命令
 export async function executeAT(command) {
-  return request('/api/at', {
+  const response = await authFetch('/api/at', {
     method: 'POST',
+    headers: { 'Content-Type': 'application/json' },
     body: JSON.stringify({ command })
   })
+  // 409: 锁频/锁小区任务占用 AT 通道，响应体与普通失败格式相同
+  if (!response.ok && response.status !== 409) {
+    throw new Error(`HTTP错误: ${response.status}`)
+  }
+  return response.json()
 }
 
 // ==================== USB模式切换API ====================
@@ -335,6 +335,7 @@ export default {
     deleteAll: 'Delete All',
     markRead: 'Mark as Read',
     markUnread: 'Mark as Unread',
+    search: 'Search messages',
     noMessages: 'No messages',
     noSentRecords: 'No sent records',
     sendSuccess: 'SMS sent successfully',
@@ -353,6 +354,9 @@ export default {
     pageInfo: 'Page {current} / {total}',
     sentTo: 'Sent to',
     sentStatus: 'Sent',
+    pendingStatus: 'Sending',
+    failedStatus: 'Failed',
+    unknownStatus: 'Unknown',
     smsDetail: 'SMS Detail',
     receiveTime: 'Receive Time',
     quickReply: 'Quick Reply',
@@ -371,6 +375,24 @@ export default {
     save: 'Save',
     test: 'Test',
     webhookSaved: 'Webhook config saved!',
+    rules: 'SMS Rules',
+    rulesDesc: 'Match new messages by sender and content to forward, push, run a script or mark as read',
+    noRules: 'No rules yet',
+    addRule: 'Add Rule',
+    ruleSaved: 'Rule saved',
+    ruleName: 'Rule name',
+    ruleSender: 'Sender (number or prefix*, empty for any)',
+    rulePattern: 'Content regex (empty for any)',
+    rulePriority: 'Priority (higher first)',
+    ruleStop: 'Stop evaluating later rules on match',
+    ruleHits: '{n} hits',
+    ruleAction_forward: 'Forward to number',
+    ruleAction_webhook: 'Call webhook',
+    ruleAction_script: 'Run script',
+    ruleAction_read: 'Mark as read',
+    ruleTarget_forward: 'Target number',
+    ruleTarget_webhook: 'https://example.com/hook',
+    ruleTarget_script: 'Script name (.sh uploaded in Scripts)',
     testSent: 'Test notification sent!',
     testFailed: 'Test failed',
     saveFailed: 'Save failed',
@@ -379,6 +401,8 @@ export default {
     inboxMaxStorageDesc: 'Maximum number of received SMS (10-150)',
     outboxMaxStorage: 'Outbox Max Storage',
     outboxMaxStorageDesc: 'Maximum number of sent records (1-50)',
+    maxStorageSize: 'Max storage size',
+    maxStorageSizeDesc: 'Total message size per inbox/outbox; oldest messages are removed beyond it (0 = unlimited)',
     items: 'items',
     currentInbox: 'Current Inbox',
     currentOutbox: 'Current Outbox',
@@ -334,6 +334,7 @@ export default {
     deleteAll: '删除全部',
     markRead: '标记已读',
     markUnread: '标记未读',
+    search: '搜索短信内容',
     noMessages: '暂无短信',
     noSentRecords: '暂无发送记录',
     sendSuccess: '短信发送成功！',
@@ -352,6 +353,9 @@ export default {
     pageInfo: '第 {current} / {total} 页',
     sentTo: '发送至',
     sentStatus: '已发送',
+    pendingStatus: '发送中',
+    failedStatus: '发送失败',
+    unknownStatus: '状态未知',
     smsDetail: '短信详情',
     receiveTime: '接收时间',
     quickReply: '快速回复',
@@ -370,6 +374,24 @@ export default {
     save: '保存',
     test: '测试',
     webhookSaved: 'Webhook配置已保存！',
+    rules: '短信规则',
+    rulesDesc: '按发件人和内容匹配新短信，自动转发、推送、运行脚本或标记已读',
+    noRules: '暂无规则',
+    addRule: '添加规则',
+    ruleSaved: '规则已保存',
+    ruleName: '规则名称',
+    ruleSender: '发件人 (号码或前缀*，留空为任意)',
+    rulePattern: '内容正则 (留空为任意)',
+    rulePriority: '优先级 (大的先匹配)',
+    ruleStop: '命中后停止匹配后续规则',
+    ruleHits: '命中 {n} 次',
+    ruleAction_forward: '转发到号码',
+    ruleAction_webhook: '调用 Webhook',
+    ruleAction_script: '运行脚本',
+    ruleAction_read: '标记已读',
+    ruleTarget_forward: '目标号码',
+    ruleTarget_webhook: 'https://example.com/hook',
+    ruleTarget_script: '脚本名称 (脚本管理中上传的 .sh)',
     testSent: '测试通知已发送！',
     testFailed: '测试失败',
     saveFailed: '保存失败',
@@ -378,6 +400,8 @@ export default {
     inboxMaxStorageDesc: '接收短信的最大存储条数 (10-150)',
     outboxMaxStorage: '发件箱最大存储',
     outboxMaxStorageDesc: '发送记录的最大存储条数 (1-50)',
+    maxStorageSize: '最大存储容量',
+    maxStorageSizeDesc: '收件箱和发件箱各自的短信内容总大小，超出后删除最旧的短信 (0 表示不限)',
     items: '条',
     currentInbox: '当前收件箱',
     currentOutbox: '当前发件箱',
@@ -182,7 +182,9 @@ import {
   faMobileAlt,
   faMagic,
   faPen,
-  faFolderOpen
+  faFolderOpen,
+  faFilter,
+  faPause
 } from '@fortawesome/free-solid-svg-icons'
 
 // 注册所有图标到库
@@ -320,7 +322,9 @@ library.add(
   faMobileAlt,
   faMagic,
   faPen,
-  faFolderOpen
+  faFolderOpen,
+  faFilter,
+  faPause
 )
 
 // 启用 DOM 监视器，自动将 <i class="fas fa-xxx"> 转换为 SVG